@@ -5,11 +5,13 @@
 #include "build_config.h"
 
 #include <string>
+#include <cstdint>
 
 namespace Common
 {
     MAKE_HANDLE(ArchiveFileHandle, uint32_t);
 
+    class ThreadPool;
     class Archive;
     struct ArchiveFileHandleRAII {
         Archive *archive = nullptr;
@@ -43,6 +45,9 @@ namespace Common
         }
     };
 
+    // A read only collection of files, either a directory or a archive file.
+    //  Archive files only read their file table when opened, the files are read (and decompressed)
+    //  the first time they are mapped, and released when the last handle to them is closed.
     class Archive {
     public:
 
@@ -58,7 +63,19 @@ namespace Common
         COMMON_API void closeFile( ArchiveFileHandle handle );
 
         COMMON_API size_t fileSize( ArchiveFileHandle handle );
+        // The content of the file, valid until the handle is closed.
+        //  Returns nullptr if the file can't be read (ex. if it is corrupt).
         COMMON_API const void* mapFile( ArchiveFileHandle handle );
+        // Copies 'size' bytes from 'offset' in the file to 'out', without loading the whole file if it is chunked
+        //  (the chunks in the range are decompressed, large files are chunked by ArchiveWriter).
+        //  Returns false if the range isn't inside the file, or if it can't be read.
+        COMMON_API bool readRange( ArchiveFileHandle handle, uint64_t offset, size_t size, void *out );
+
+        // Opens 'count' files and loads them in parallel on 'pool' (or the global pool), so mapFile on them is instant.
+        //  The files are decompressed into one buffer, that is released once all of them are closed.
+        //  handles[i] is the handle of names[i], invalid if the file doesn't exist (the handles must be closed as usual).
+        //  Returns the number of names whose file is loaded (a name that is listed twice counts twice).
+        COMMON_API size_t prefetch( const std::string *names, size_t count, ArchiveFileHandle *handles, ThreadPool *pool=nullptr );
 
         size_t fileSize( ArchiveFileHandleRAII &handle ) {
             return fileSize(handle.handle);
@@ -66,6 +83,9 @@ namespace Common
         const void* mapFile( ArchiveFileHandleRAII &handle ) {
             return mapFile(handle.handle);
         }
+        bool readRange( ArchiveFileHandleRAII &handle, uint64_t offset, size_t size, void *out ) {
+            return readRange(handle.handle, offset, size, out);
+        }
     
         COMMON_API const char* name();
 
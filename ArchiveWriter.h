@@ -0,0 +1,82 @@
+#pragma once
+
+#include "PImplHelper.h"
+#include "build_config.h"
+
+#include <string>
+#include <cstdint>
+
+// Builds archive files that Archive::OpenArchive can read.
+//  The files are loaded, hashed and compressed in parallel when the archive is written,
+//  files added from disk are only read then (and only a batch of them is kept in memory at once).
+//
+// Usage:
+//      ArchiveWriter::Settings settings;
+//      settings.compressionLevel = 12;
+//
+//      ArchiveWriter writer(settings);
+//      writer.addFileFromDisk("textures/rock.dds", "content/textures/rock.dds");
+//      writer.addFile("version.txt", version.data(), version.size());
+//      if (!writer.write("content.archive")) {
+//          ...
+//      }
+namespace Common
+{
+    class ThreadPool;
+
+    class ArchiveWriter {
+    public:
+        struct Settings {
+            // The LZ4 HC level (1 to 12), 0 stores the files as is.
+            //  Files that doesn't get smaller are always stored.
+            int compressionLevel = 9;
+            // Compressed files larger than this (or than 32 MiB) are split into chunks of 128 KiB that are compressed on their own,
+            //  so Archive::readRange only decompresses the chunks it reads. The chunks compresses a bit worse than the whole file.
+            uint64_t chunkedFileSize = 1024 * 1024;
+            // Files with the same content are only stored once, found by their hash (and compared before they are merged)
+            bool deduplicate = true;
+            // Where the files are loaded and compressed, nullptr is the global pool
+            ThreadPool *pool = nullptr;
+        };
+
+        struct Stats {
+            uint32_t files = 0,
+                     // Files that share the data of a earlier file
+                     duplicates = 0,
+                     // Files that are compressed as a whole, and that are split into chunks
+                     compressed = 0,
+                     chunked = 0;
+            // Of all files, and of the data in the archive
+            uint64_t size = 0,
+                     storedSize = 0;
+        };
+
+    public:
+        COMMON_API ArchiveWriter();
+        COMMON_API explicit ArchiveWriter( const Settings &settings );
+        COMMON_API ~ArchiveWriter();
+
+        ArchiveWriter( const ArchiveWriter& ) = delete;
+        ArchiveWriter& operator = ( const ArchiveWriter& ) = delete;
+
+        // Adds a copy of the data. Returns false if the name is already added, or if it is too long.
+        COMMON_API bool addFile( const std::string &name, const void *data, size_t size );
+        // The file at 'path' is read when the archive is written. Returns false if the name can't be added.
+        COMMON_API bool addFileFromDisk( const std::string &name, const std::string &path );
+
+        // The data is ordered by when the files are first used in 'names' (ex. a trace of the files opened while loading a level),
+        //  so files used together are close in the archive. Files that isn't in it are placed after, in the order they were added.
+        //  Names that isn't added are ignored.
+        COMMON_API void setAccessOrder( const std::string *names, size_t count );
+
+        COMMON_API size_t fileCount() const;
+
+        // Writes the added files as a archive to 'path', the files are kept so it can be written again.
+        //  Returns false (and logs the reason) if a file can't be read or the archive can't be written.
+        COMMON_API bool write( const std::string &path, Stats *stats=nullptr );
+
+    private:
+        struct Impl;
+        PImplHelper<Impl, 256> mImpl;
+    };
+}
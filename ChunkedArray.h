@@ -0,0 +1,286 @@
+#pragma once
+
+#include "IAllocator.h"
+#include "IteratorAdopter.h"
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cassert>
+
+namespace Common
+{
+    // A array that stores its elements in fixed size chunks.
+    //  Chunks are allocated on demand and are never moved or reallocated,
+    //  so growing the array never copies any elements and pointers to
+    //  elements stays valid until the element itself is removed.
+    //
+    // The chunks can optionally be allocated from a IAllocator,
+    //  the allocator must hand out real addresses (not offsets) that are
+    //  suitable aligned for Type, and outlive the array.
+    template< typename Type, size_t ChunkSize_ = 1024 >
+    class ChunkedArray {
+    public:
+        static constexpr const size_t ChunkSize = ChunkSize_;
+        static constexpr const size_t ChunkBytes = ChunkSize * sizeof(Type);
+
+        static_assert(ChunkSize > 0, "ChunkSize must be atleast 1");
+        static_assert(alignof(Type) <= alignof(std::max_align_t), "Over aligned types isn't supported");
+
+        using value_type = Type;
+
+        template< typename Value >
+        class IteratorBase;
+
+        using iterator = IteratorBase<Type>;
+        using const_iterator = IteratorBase<const Type>;
+
+    public:
+        ChunkedArray() = default;
+        explicit ChunkedArray( IAllocator *allocator ) :
+            mAllocator(allocator)
+        {}
+
+        ~ChunkedArray() {
+            clear();
+            shrink_to_fit();
+        }
+
+        ChunkedArray( const ChunkedArray &copy ) :
+            mAllocator(copy.mAllocator)
+        {
+            reserve(copy.mSize);
+            for (size_t i=0; i < copy.mSize; ++i) {
+                push_back(copy[i]);
+            }
+        }
+
+        ChunkedArray( ChunkedArray &&move ) noexcept {
+            swap(move);
+        }
+
+        ChunkedArray& operator = ( const ChunkedArray &copy ) {
+            if (this == &copy) return *this;
+
+            ChunkedArray tmp(copy);
+            swap(tmp);
+            return *this;
+        }
+
+        ChunkedArray& operator = ( ChunkedArray &&move ) noexcept {
+            ChunkedArray tmp(std::move(move));
+            swap(tmp);
+            return *this;
+        }
+
+        void swap( ChunkedArray &other ) noexcept {
+            std::swap(mChunks, other.mChunks);
+            std::swap(mSize, other.mSize);
+            std::swap(mAllocator, other.mAllocator);
+        }
+
+    public:
+        size_t size() const {
+            return mSize;
+        }
+
+        bool empty() const {
+            return mSize == 0;
+        }
+
+        size_t capacity() const {
+            return mChunks.size() * ChunkSize;
+        }
+
+        size_t chunkCount() const {
+            return mChunks.size();
+        }
+
+        IAllocator* allocator() const {
+            return mAllocator;
+        }
+
+        Type& operator [] ( size_t idx ) {
+            assert (idx < mSize);
+            return mChunks[idx / ChunkSize][idx % ChunkSize];
+        }
+        const Type& operator [] ( size_t idx ) const {
+            assert (idx < mSize);
+            return mChunks[idx / ChunkSize][idx % ChunkSize];
+        }
+
+        Type& front() {
+            return (*this)[0];
+        }
+        const Type& front() const {
+            return (*this)[0];
+        }
+
+        Type& back() {
+            return (*this)[mSize-1];
+        }
+        const Type& back() const {
+            return (*this)[mSize-1];
+        }
+
+        // Makes sure that there is room for atleast 'count' elements
+        void reserve( size_t count ) {
+            while (capacity() < count) {
+                allocateChunk();
+            }
+        }
+
+        template< typename... Args >
+        Type& emplace_back( Args&&... args ) {
+            reserve(mSize+1);
+
+            Type *ptr = &mChunks[mSize / ChunkSize][mSize % ChunkSize];
+            new (ptr) Type(std::forward<Args>(args)...);
+            mSize++;
+            return *ptr;
+        }
+
+        void push_back( const Type &value ) {
+            emplace_back(value);
+        }
+        void push_back( Type &&value ) {
+            emplace_back(std::move(value));
+        }
+
+        void pop_back() {
+            assert (mSize > 0);
+            back().~Type();
+            mSize--;
+        }
+
+        void resize( size_t count ) {
+            reserve(count);
+            while (mSize < count) {
+                emplace_back();
+            }
+            while (mSize > count) {
+                pop_back();
+            }
+        }
+
+        // Destroys all elements, but keep the chunks
+        void clear() {
+            while (mSize > 0) {
+                pop_back();
+            }
+        }
+
+        // Releases chunks that aren't used
+        void shrink_to_fit() {
+            size_t used = (mSize + ChunkSize - 1) / ChunkSize;
+            while (mChunks.size() > used) {
+                freeChunk(mChunks.back());
+                mChunks.pop_back();
+            }
+        }
+
+        iterator begin() {
+            return iterator(this, 0);
+        }
+        iterator end() {
+            return iterator(this, mSize);
+        }
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+        const_iterator end() const {
+            return const_iterator(this, mSize);
+        }
+
+    public:
+        template< typename Value >
+        class IteratorBase :
+            public IteratorAdopter<IteratorBase<Value>, Value, std::random_access_iterator_tag>
+        {
+            using array_type = typename std::conditional<
+                                   std::is_const<Value>::value,
+                                   const ChunkedArray,
+                                   ChunkedArray
+                               >::type;
+
+            array_type *mArray = nullptr;
+            size_t mIndex = 0;
+
+        public:
+            IteratorBase() = default;
+            IteratorBase( const IteratorBase& ) = default;
+            IteratorBase& operator = ( const IteratorBase& ) = default;
+
+            IteratorBase( array_type *array, size_t index ) :
+                mArray(array),
+                mIndex(index)
+            {}
+
+            size_t index() const {
+                return mIndex;
+            }
+
+            Value& dereference() const {
+                return (*mArray)[mIndex];
+            }
+
+            bool equal( const IteratorBase &other ) const {
+                return mIndex == other.mIndex;
+            }
+
+            void increment() {
+                ++mIndex;
+            }
+            void decrement() {
+                --mIndex;
+            }
+            void advance( ptrdiff_t n ) {
+                mIndex += n;
+            }
+            ptrdiff_t distance( const IteratorBase &other ) const {
+                return ptrdiff_t(other.mIndex) - ptrdiff_t(mIndex);
+            }
+        };
+
+    private:
+        void allocateChunk() {
+            void *memory = nullptr;
+            if (mAllocator) {
+                uintptr_t ptr = mAllocator->allocate(ChunkBytes);
+                if (ptr == IAllocator::NULL_PTR) {
+                    throw std::bad_alloc();
+                }
+                memory = reinterpret_cast<void*>(ptr);
+            }
+            else {
+                memory = ::operator new(ChunkBytes);
+            }
+            assert ((reinterpret_cast<uintptr_t>(memory) % alignof(Type)) == 0);
+
+            Type *chunk = static_cast<Type*>(memory);
+            try {
+                mChunks.push_back(chunk);
+            }
+            catch (...) {
+                freeChunk(chunk);
+                throw;
+            }
+        }
+
+        void freeChunk( Type *chunk ) {
+            if (mAllocator) {
+                mAllocator->free(reinterpret_cast<uintptr_t>(chunk));
+            }
+            else {
+                ::operator delete(chunk);
+            }
+        }
+
+    private:
+        std::vector<Type*> mChunks;
+        size_t mSize = 0;
+        IAllocator *mAllocator = nullptr;
+    };
+}
@@ -3,6 +3,7 @@
 #include "StringEqual.h"
 
 #include <sstream>
+#include <cstring>
 
 namespace Common
 {
@@ -69,11 +70,11 @@ namespace Common
         }
 
         template< typename Type >
-        bool get( const char *name, Type &val, const Type &default) const {
+        bool get( const char *name, Type &val, const Type &defaultVal ) const {
             if (getCommandLineArg(argc, argv, name, val, equalFlags)) {
                 return true;
             }
-            val = default;
+            val = defaultVal;
             return false;
         }
 
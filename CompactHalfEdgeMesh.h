@@ -0,0 +1,128 @@
+#pragma once
+
+#include "build_config.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace Common
+{
+    // A compact alternative to HalfEdgeMesh, for meshes to large to store with a handle per element.
+    //  Elements are plain indexes into structure of array tables, and most of the topology is implicit:
+    //      - the two half edges of edge 'e' are 2*e and 2*e+1, so the pair of half edge 'h' is h^1 and its edge is h/2
+    //      - only next, the target vertex and the face is stored for each half edge, prev is found by walking around the vertex
+    //  This makes a half edge 12 bytes (edges are free), compared to about 32 bytes for the half edge and edge in HalfEdgeMesh.
+    //
+    // The topology is built in bulk from indexed buffers, it can't be edited element by element.
+    //  The accessors are inline, so traversals don't have to call into the library.
+    class CompactHalfEdgeMesh {
+    public:
+        using Index = uint32_t;
+        static constexpr Index INVALID = ~Index(0);
+
+    public:
+        // Replaces the mesh with faces built from indexed polygon buffers (see HalfEdgeMeshBase::buildFromIndexed).
+        //  The indices are used as vertex indexes, face 'f' is the f:th face in the buffers, and getFaceHEdge(f) leaves its first vertex.
+        // Returns false without modifying the mesh if the input is invalid or non-manifold (the reason is logged).
+        COMMON_API bool buildFromIndexed( const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount, ThreadPool *pool=nullptr );
+
+        COMMON_API void clear();
+        COMMON_API void swap( CompactHalfEdgeMesh &other );
+
+        // Number of bytes allocated for the topology
+        COMMON_API size_t memoryUsage() const;
+
+        size_t vertexCount() const {
+            return mVertexHEdge.size();
+        }
+        size_t hedgeCount() const {
+            return mHEdgeNext.size();
+        }
+        size_t edgeCount() const {
+            return mHEdgeNext.size() / 2;
+        }
+        size_t faceCount() const {
+            return mFaceHEdge.size();
+        }
+
+        static Index getHEdgePair( Index hedge ) {
+            return hedge ^ 1;
+        }
+        static Index getHEdgeEdge( Index hedge ) {
+            return hedge >> 1;
+        }
+        Index getHEdgeNext( Index hedge ) const {
+            return mHEdgeNext[hedge];
+        }
+        // Walks around the origin vertex, so the cost depends on its valence, not the size of the face
+        Index getHEdgePrev( Index hedge ) const {
+            Index out = hedge;
+            while (true) {
+                Index in = out ^ 1;
+                if (mHEdgeNext[in] == hedge) return in;
+                out = mHEdgeNext[in];
+            }
+        }
+        // The vertex the half edge points to
+        Index getHEdgeVertex( Index hedge ) const {
+            return mHEdgeVertex[hedge];
+        }
+        // The vertex the half edge leaves
+        Index getHEdgeOrigin( Index hedge ) const {
+            return mHEdgeVertex[hedge ^ 1];
+        }
+        // INVALID for border half edges
+        Index getHEdgeFace( Index hedge ) const {
+            return mHEdgeFace[hedge];
+        }
+        bool isBorderHEdge( Index hedge ) const {
+            return mHEdgeFace[hedge] == INVALID;
+        }
+
+        // A half edge leaving the vertex, a border half edge if there is one (INVALID for isolated vertexes).
+        //  The other outgoing half edges are found with getHEdgeNext(getHEdgePair(hedge)).
+        Index getVertexHEdge( Index vertex ) const {
+            return mVertexHEdge[vertex];
+        }
+        bool isBorderVertex( Index vertex ) const {
+            Index hedge = mVertexHEdge[vertex];
+            return hedge != INVALID && mHEdgeFace[hedge] == INVALID;
+        }
+
+        static Index getEdgeHEdge( Index edge ) {
+            return edge << 1;
+        }
+        std::pair<Index, Index> getEdgeVertexes( Index edge ) const {
+            return {mHEdgeVertex[(edge << 1) | 1], mHEdgeVertex[edge << 1]};
+        }
+        std::pair<Index, Index> getEdgeFaces( Index edge ) const {
+            return {mHEdgeFace[edge << 1], mHEdgeFace[(edge << 1) | 1]};
+        }
+        bool isBorderEdge( Index edge ) const {
+            return mHEdgeFace[edge << 1] == INVALID || mHEdgeFace[(edge << 1) | 1] == INVALID;
+        }
+
+        Index getFaceHEdge( Index face ) const {
+            return mFaceHEdge[face];
+        }
+
+        // Debuging functions
+#if COMMON_DEBUG_LEVEL > 0
+        // Verify that the internal state is correct (all the expected invariants are true)
+        COMMON_API void verifyInvariants() const;
+#endif
+
+    private:
+        // Half edges
+        std::vector<Index> mHEdgeNext,
+                           mHEdgeVertex,
+                           mHEdgeFace;
+        // Vertexes
+        std::vector<Index> mVertexHEdge;
+        // Faces
+        std::vector<Index> mFaceHEdge;
+    };
+}
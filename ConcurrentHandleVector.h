@@ -0,0 +1,351 @@
+#pragma once
+
+#include "HandleType.h"
+#include "HandleVector.h"
+
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <climits>
+#include <cstdint>
+#include <cassert>
+
+// A HandleVector that allows handles to be created, free'd and looked up from multiple threads at the same time.
+//  - free slots are kept in a lock-free stack, the head is tagged with a counter to protect against ABA
+//  - values are stored in chunks that are never moved, the chunks are published atomically
+//  - the handle stored in each slot is updated atomically, and acts as the publication point for the value
+//
+// find/valid/get are safe to call while other threads create or free other handles,
+// a handle that is free'd concurrently gets rejected by the generation check.
+// The pointer returned from find is only valid as long as the caller can guarantee that
+// the handle isn't free'd (the same rule as for a ordinary pointer).
+//
+// clear, forEach and the destructor are NOT thread safe.
+template< typename Handle, typename Value, unsigned GenerationBits_=HANDLE_VECTOR_DEFAULT, unsigned DataBits_=HANDLE_VECTOR_DEFAULT, typename Handle::underlaying_type DataValue_=0, size_t ChunkSize_=1024 >
+class ConcurrentHandleVector {
+public:
+    using underlaying_type = typename Handle::underlaying_type;
+
+    static constexpr const unsigned TypeBits = CHAR_BIT * sizeof (underlaying_type);
+    static constexpr const unsigned GenerationBits = (GenerationBits_ == HANDLE_VECTOR_DEFAULT) ? 8 : GenerationBits_;
+    static constexpr const unsigned DataBits = (DataBits_ == HANDLE_VECTOR_DEFAULT) ? 1 : DataBits_;
+    static constexpr const unsigned IndexBits = TypeBits - GenerationBits - DataBits;
+    static constexpr const size_t ChunkSize = ChunkSize_;
+
+    static constexpr const underlaying_type IndexMask = HandleVectorInternal::LowBitMask<underlaying_type>(IndexBits);
+    static constexpr const underlaying_type GenerationMask = HandleVectorInternal::LowBitMask<underlaying_type>(GenerationBits);
+    static constexpr const underlaying_type DataMask = HandleVectorInternal::LowBitMask<underlaying_type>(DataBits);
+
+    // Index 0 is reserved for the null handle
+    static constexpr const size_t MaxValues = (size_t)IndexMask;
+
+    static constexpr const underlaying_type DataValue = DataValue_ & DataMask;
+
+    static constexpr const unsigned IndexOffset = 0;
+    static constexpr const unsigned GenerationOffset = IndexBits;
+    static constexpr const unsigned DataOffset = IndexBits + GenerationBits;
+
+    static constexpr const size_t MaxChunks = (MaxValues + ChunkSize - 1) / ChunkSize;
+
+    static_assert (std::is_base_of<BaseHandle, Handle>::value, "HandleType isn't a handle!");
+    static_assert (sizeof(underlaying_type) <= sizeof(uint32_t), "The free list packs a index and a tag into 64 bits, handles larger than 32 bits isn't supported");
+    static_assert ((GenerationBits+DataBits) < TypeBits, "Invalid number of GenerationBits and DataBits!");
+    static_assert ((DataValue_&~DataMask) == 0, "Invalid DataValue, doesn't match the specifed DataBits!");
+    static_assert (DataBits > 0, "Atleast 1 DataBit is neaded!, (for internal bookkepping)");
+    static_assert (ChunkSize > 0, "ChunkSize must be atleast 1");
+
+    static constexpr bool IsHandleFromThis( Handle handle ) {
+        return GetData(handle) == DataValue;
+    }
+
+private:
+    static constexpr underlaying_type MaskAndOffset( underlaying_type value, underlaying_type mask, underlaying_type offset ) {
+        return (value&mask) << offset;
+    }
+
+    static constexpr underlaying_type OffsetAndMask( underlaying_type value, underlaying_type mask, underlaying_type offset ) {
+        return (value>>offset) & mask;
+    }
+
+    static constexpr underlaying_type GetIndex( Handle handle ) {
+        return OffsetAndMask((underlaying_type)handle, IndexMask, IndexOffset);
+    }
+    static constexpr underlaying_type GetGeneration( Handle handle ) {
+        return OffsetAndMask((underlaying_type)handle, GenerationMask, GenerationOffset);
+    }
+    static constexpr underlaying_type GetData( Handle handle ) {
+        return OffsetAndMask((underlaying_type)handle, DataMask, DataOffset);
+    }
+    static constexpr Handle CreateHandle( underlaying_type generation, underlaying_type index, underlaying_type data ) {
+        return Handle(MaskAndOffset(data, DataMask, DataOffset) |
+                      MaskAndOffset(generation, GenerationMask, GenerationOffset) |
+                      MaskAndOffset(index, IndexMask, IndexOffset)
+        );
+    }
+
+    static constexpr const underlaying_type FreeDataValue = DataValue ^ DataMask;
+    static constexpr bool IsHandleFree( Handle handle ) {
+        return GetData(handle) == FreeDataValue;
+    }
+
+    // The free list head is a index (low 32 bits) and a tag (high 32 bits)
+    //  the tag is incremented on every change, so a stale head can't be swapped in (ABA)
+    static constexpr uint64_t PackHead( underlaying_type index, uint32_t tag ) {
+        return (uint64_t(tag) << 32) | uint64_t(index);
+    }
+    static constexpr underlaying_type HeadIndex( uint64_t head ) {
+        return underlaying_type(head & 0xFFFFFFFF);
+    }
+    static constexpr uint32_t HeadTag( uint64_t head ) {
+        return uint32_t(head >> 32);
+    }
+
+    struct Slot {
+        std::atomic<underlaying_type> handle{CreateHandle(0, 0, FreeDataValue)};
+        std::atomic<underlaying_type> next{0};
+        std::aligned_union_t<0, Value> storage;
+
+        Value* value() {
+            return reinterpret_cast<Value*>(&storage);
+        }
+        const Value* value() const {
+            return reinterpret_cast<const Value*>(&storage);
+        }
+    };
+
+public:
+    ConcurrentHandleVector() {
+        for (auto &chunk : mChunks) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~ConcurrentHandleVector() {
+        clear();
+        for (auto &chunk : mChunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentHandleVector( const ConcurrentHandleVector& ) = delete;
+    ConcurrentHandleVector& operator = ( const ConcurrentHandleVector& ) = delete;
+
+public:
+    Handle create( const Value &value ) {
+        return emplace(value);
+    }
+
+    Handle create( Value &&value ) {
+        return emplace(std::move(value));
+    }
+
+    template< typename... Args >
+    Handle emplace( Args&&... args ) {
+        underlaying_type index = popFreeSlot();
+        if (index == 0) return Handle();
+
+        Slot &slot = slotAt(index);
+        underlaying_type generation = GetGeneration(Handle(slot.handle.load(std::memory_order_relaxed)));
+
+        try {
+            new (slot.value()) Value(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            // The slot is still free, give it back
+            pushFreeSlot(index);
+            throw;
+        }
+
+        // Publish the value
+        Handle handle = CreateHandle(generation+1, index, DataValue);
+        slot.handle.store(handle, std::memory_order_release);
+        return handle;
+    }
+
+    bool free( Handle handle ) {
+        Slot *slot = findSlot(handle);
+        if (!slot) return false;
+
+        // Only one thread can win the race to free the handle
+        underlaying_type expected = handle;
+        Handle freed = CreateHandle(GetGeneration(handle), 0, FreeDataValue);
+        if (!slot->handle.compare_exchange_strong(expected, freed, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            return false;
+        }
+
+        slot->value()->~Value();
+        pushFreeSlot(GetIndex(handle));
+        return true;
+    }
+
+    bool valid( Handle handle ) const {
+        return findSlot(handle) != nullptr;
+    }
+
+    Value* find( Handle handle ) {
+        Slot *slot = findSlot(handle);
+        if (!slot) return nullptr;
+        return slot->value();
+    }
+
+    const Value* find( Handle handle ) const {
+        const Slot *slot = findSlot(handle);
+        if (!slot) return nullptr;
+        return slot->value();
+    }
+
+    // Copies the value, and verifies that the handle wasn't free'd during the copy.
+    //  Only avalible for trivially copyable values, since the copy may race with a free.
+    bool get( Handle handle, Value &value ) const {
+        static_assert(std::is_trivially_copyable<Value>::value, "get requires a trivially copyable Value, use find instead");
+
+        const Slot *slot = findSlot(handle);
+        if (!slot) return false;
+
+        value = *slot->value();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->handle.load(std::memory_order_relaxed) == (underlaying_type)handle;
+    }
+
+    // NOT thread safe
+    template< typename Func >
+    void forEachWithHandle( Func &&func ) {
+        forEachSlot(
+            [&]( underlaying_type, Slot &slot ) {
+                Handle handle(slot.handle.load(std::memory_order_acquire));
+                if (IsHandleFree(handle)) return;
+                func(handle, *slot.value());
+            }
+        );
+    }
+
+    // NOT thread safe
+    template< typename Func >
+    void forEach( Func &&func ) {
+        forEachWithHandle(
+            [&]( Handle, Value &value ) {
+                func(value);
+            }
+        );
+    }
+
+    // Free's all handles, NOT thread safe
+    void clear() {
+        forEachSlot(
+            [&]( underlaying_type, Slot &slot ) {
+                Handle handle(slot.handle.load(std::memory_order_relaxed));
+                if (IsHandleFree(handle)) return;
+
+                slot.value()->~Value();
+                slot.handle.store(CreateHandle(GetGeneration(handle), 0, FreeDataValue), std::memory_order_relaxed);
+            }
+        );
+
+        // Rebuild the free list in index order
+        mFreeListHead.store(0, std::memory_order_relaxed);
+        for (size_t i=underlying_size(); i > 0; --i) {
+            if (mChunks[(i-1) / ChunkSize].load(std::memory_order_relaxed) == nullptr) continue;
+            pushFreeSlot(underlaying_type(i));
+        }
+    }
+
+    size_t underlying_size() const {
+        size_t size = mSize.load(std::memory_order_acquire);
+        return size < MaxValues ? size : MaxValues;
+    }
+
+private:
+    // Calls func(index, slot) for every slot below underlying_size(), NOT thread safe.
+    //  The chunks that failed to allocate are skipped (their indexes are reserved, but never handed out).
+    template< typename Func >
+    void forEachSlot( Func &&func ) {
+        size_t size = underlying_size();
+        for (size_t begin=0; begin < size; begin += ChunkSize) {
+            Slot *chunk = mChunks[begin / ChunkSize].load(std::memory_order_acquire);
+            if (!chunk) continue;
+
+            size_t end = std::min(begin + ChunkSize, size);
+            for (size_t i=begin; i < end; ++i) {
+                func(underlaying_type(i+1), chunk[i - begin]);
+            }
+        }
+    }
+
+    Slot& slotAt( underlaying_type index ) {
+        size_t idx = size_t(index) - 1;
+        return mChunks[idx / ChunkSize].load(std::memory_order_acquire)[idx % ChunkSize];
+    }
+
+    const Slot* findSlot( Handle handle ) const {
+        return const_cast<ConcurrentHandleVector*>(this)->findSlot(handle);
+    }
+
+    Slot* findSlot( Handle handle ) {
+        // data missmatch, handle isn't from this container
+        if (GetData(handle) != DataValue) return nullptr;
+
+        underlaying_type index = GetIndex(handle);
+        if (index == 0) return nullptr;
+
+        size_t idx = size_t(index) - 1;
+        Slot *chunk = mChunks[idx / ChunkSize].load(std::memory_order_acquire);
+        if (!chunk) return nullptr;
+
+        Slot &slot = chunk[idx % ChunkSize];
+        if (slot.handle.load(std::memory_order_acquire) != (underlaying_type)handle) {
+            // missmatch of generation or handle is free
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    underlaying_type popFreeSlot() {
+        uint64_t head = mFreeListHead.load(std::memory_order_acquire);
+        while (true) {
+            underlaying_type index = HeadIndex(head);
+            if (index == 0) {
+                return allocateSlot();
+            }
+
+            // The slot memory is never released, so reading next is safe even if
+            // another thread pops the slot first (the tag makes our CAS fail in that case)
+            underlaying_type next = slotAt(index).next.load(std::memory_order_relaxed);
+            if (mFreeListHead.compare_exchange_weak(head, PackHead(next, HeadTag(head)+1), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return index;
+            }
+        }
+    }
+
+    void pushFreeSlot( underlaying_type index ) {
+        Slot &slot = slotAt(index);
+
+        uint64_t head = mFreeListHead.load(std::memory_order_relaxed);
+        do {
+            slot.next.store(HeadIndex(head), std::memory_order_relaxed);
+        } while (!mFreeListHead.compare_exchange_weak(head, PackHead(index, HeadTag(head)+1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    underlaying_type allocateSlot() {
+        size_t idx = mSize.fetch_add(1, std::memory_order_relaxed);
+        if (idx >= MaxValues) return 0;
+
+        // If the allocation throws the index stays reserved without a chunk,
+        //  the chunk is allocated by the next slot in it (and skipped by clear, forEach and the destructor until then)
+        std::atomic<Slot*> &chunk = mChunks[idx / ChunkSize];
+        if (chunk.load(std::memory_order_acquire) == nullptr) {
+            Slot *expected = nullptr;
+            Slot *allocated = new Slot[ChunkSize];
+            if (!chunk.compare_exchange_strong(expected, allocated, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                // Another thread published the chunk first
+                delete[] allocated;
+            }
+        }
+        return underlaying_type(idx + 1);
+    }
+
+private:
+    std::atomic<uint64_t> mFreeListHead{0};
+    std::atomic<size_t> mSize{0};
+    std::atomic<Slot*> mChunks[MaxChunks];
+};
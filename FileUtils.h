@@ -18,12 +18,17 @@ namespace FileUtils
         const void *ptr = nullptr;
         size_t size = 0;
     };
-    COMMON_API FileMapping* mapFile( const std::string &filename, int offset=0, int size=-1 );
+    // Maps 'size' bytes (or the rest of the file if size is negative) from 'offset' read only into memory,
+    //  the pages are read on demand by the os. Throws std::runtime_error if the file can't be mapped,
+    //  or if the range isn't inside the file. Free the mapping with unmapFile.
+    COMMON_API FileMapping* mapFile( const std::string &filename, uint64_t offset=0, int64_t size=-1 );
     COMMON_API void unmapFile( FileMapping *ptr );
     
     COMMON_API std::string getFileContent( const std::string &filename, bool isBinary );
 
     COMMON_API std::vector<std::string> getFileList( const std::string &path );
+    // The sub directories of 'path', without "." and ".."
+    COMMON_API std::vector<std::string> getDirectoryList( const std::string &path );
 
     // removes filename from path -
     // "hello/world" => "hello/"
@@ -4,6 +4,12 @@
 #include "HandleType.h"
 #include "PImplHelper.h"
 #include "HandleVector.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <vector>
+#include <string>
+#include <type_traits>
 
 // A half edge structure for storing a mesh topology
 //  Read about half edge structure here:
@@ -15,10 +21,12 @@
 
 namespace Common
 {
+    class Archive;
     class HalfEdgeMeshBase;
     namespace internal 
     {
         struct HalfEdgeMeshBaseImpl;
+        struct HalfEdgeMeshTopology;
         HalfEdgeMeshBaseImpl* getImpl( HalfEdgeMeshBase &mesh );
         const HalfEdgeMeshBaseImpl* getImpl( const HalfEdgeMeshBase &mesh );
     }
@@ -63,6 +71,86 @@ namespace Common
         class FaceFaceRange;
     }
 
+    // Writes the tables of a serialized mesh (see HalfEdgeMeshBase::save, the layout is described in src/HalfEdgeMeshSerialize.cpp)
+    //  Derived meshes stores their HandleVector's with it in onSave, after the topology.
+    class HalfEdgeMeshWriter {
+    public:
+        // Appends the slots of 'vector' verbatim as the next table.
+        //  Returns false if the values can't be stored (they must be trivially copyable).
+        template< typename Vector >
+        bool write( const Vector &vector ) {
+            using Value = typename Vector::value_type;
+            using underlaying_type = typename Vector::underlaying_type;
+            if constexpr (std::is_trivially_copyable_v<Value>) {
+                void *handles = nullptr, *values = nullptr;
+                size_t table = addTable(vector.underlying_size(), sizeof(underlaying_type), sizeof(Value), handles, values);
+
+                underlaying_type freeListHead = 0, freeListTail = 0, newSlotGeneration = 0;
+                vector.saveSlots(handles, values, freeListHead, freeListTail, newSlotGeneration);
+                setSlotState(table, freeListHead, freeListTail, newSlotGeneration);
+                return true;
+            }
+            else {
+                return unsupportedType();
+            }
+        }
+
+    private:
+        friend class HalfEdgeMeshBase;
+        HalfEdgeMeshWriter();
+
+        COMMON_API size_t addTable( size_t count, size_t handleSize, size_t valueSize, void *&handles, void *&values );
+        COMMON_API void setSlotState( size_t table, uint64_t freeListHead, uint64_t freeListTail, uint64_t newSlotGeneration );
+        COMMON_API bool unsupportedType();
+
+        std::vector<uint8_t> finish();
+
+        std::vector<uint8_t> mData;
+        uint32_t mTableCount = 0;
+    };
+
+    // Reads the tables written by HalfEdgeMeshWriter, in the same order as they were written.
+    class HalfEdgeMeshReader {
+    public:
+        // Replaces the content of 'vector' with the next table.
+        //  Returns false if there are no more tables, or if the table doesn't match the type of the vector or is inconsistent.
+        template< typename Vector >
+        bool read( Vector &vector ) {
+            using Value = typename Vector::value_type;
+            using underlaying_type = typename Vector::underlaying_type;
+            if constexpr (std::is_trivially_copyable_v<Value>) {
+                const void *handles = nullptr, *values = nullptr;
+                size_t count = 0;
+                uint64_t freeListHead = 0, freeListTail = 0, newSlotGeneration = 0;
+                if (!nextTable(sizeof(underlaying_type), sizeof(Value), count, handles, values, freeListHead, freeListTail, newSlotGeneration)) return false;
+                const uint64_t maxValue = (underlaying_type)~underlaying_type(0);
+                if (freeListHead > maxValue || freeListTail > maxValue || newSlotGeneration > maxValue ||
+                    !vector.loadSlots(handles, values, count, (underlaying_type)freeListHead, (underlaying_type)freeListTail, (underlaying_type)newSlotGeneration)) {
+                    return inconsistentTable();
+                }
+                return true;
+            }
+            else {
+                return unsupportedType();
+            }
+        }
+
+    private:
+        friend class HalfEdgeMeshBase;
+        HalfEdgeMeshReader( const void *data, size_t size );
+
+        COMMON_API bool nextTable( size_t handleSize, size_t valueSize, size_t &count, const void *&handles, const void *&values, uint64_t &freeListHead, uint64_t &freeListTail, uint64_t &newSlotGeneration );
+        COMMON_API bool inconsistentTable();
+        COMMON_API bool unsupportedType();
+
+        bool open();
+        bool atEnd() const;
+
+        const uint8_t *mData;
+        size_t mSize, mOffset = 0;
+        uint32_t mTableCount = 0, mTable = 0;
+    };
+
     class HalfEdgeMeshBase {
     public:
         MAKE_HANDLE(VertexHandle, uint32_t);
@@ -119,10 +207,23 @@ namespace Common
         using FaceEdgeRange   = HalfEdgeMeshIterators::FaceEdgeRange;
         using FaceFaceRange   = HalfEdgeMeshIterators::FaceFaceRange;
 
+        // The result of compact(), the element with the old handle oldX[i] now has the handle newX[i]
+        struct CompactRemap {
+            std::vector<VertexHandle> oldVertexes, newVertexes;
+            std::vector<HEdgeHandle> oldHEdges, newHEdges;
+            std::vector<EdgeHandle> oldEdges, newEdges;
+            std::vector<FaceHandle> oldFaces, newFaces;
+        };
+
     public:
         COMMON_API HalfEdgeMeshBase();
         COMMON_API virtual ~HalfEdgeMeshBase();
 
+        // A copy is a snapshot, the element tables are stored in chunks that are shared with the copy
+        //  and cloned the first time either mesh writes to them. So copying is O(chunks), and edits only clones the chunks they touch.
+        //  The meshes are still independent, a snapshot can be read (or edited) on another thread while the original is edited.
+        //  Pointers from findData is only valid until the mesh is copied, and with the edge index enabled the copy rebuilds it (O(edges)).
+        //  The smart handles and iterators looks up their cached element pointers again when the chunks are shared or cloned.
         COMMON_API HalfEdgeMeshBase( const HalfEdgeMeshBase &copy );
         COMMON_API HalfEdgeMeshBase( HalfEdgeMeshBase &&move );
         
@@ -136,6 +237,72 @@ namespace Common
         COMMON_API FaceHandle createFace( const VertexHandle *vertexes, size_t vertexCount );
         COMMON_API FaceHandle createFace( const HEdgeHandle *hedges, size_t count );
 
+        // Builds faces from indexed polygon buffers, much faster than calling createFace for each face.
+        //  'vertexCount' new vertexes are created, and 'indices' refers to these (0 to vertexCount-1).
+        //  faceSizes[i] is the number of vertexes in face i (the faces indices follows each other),
+        //  if faceSizes is null all faces are triangles.
+        //  The new handles are written to vertexesOut and facesOut if they aren't null.
+        //  The topology is built on 'pool' (or the global pool), the handles are the same no matter the number of threads.
+        // Returns false without modifying the mesh if the input is invalid or non-manifold (the reason is logged).
+        COMMON_API bool buildFromIndexed( const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount, 
+                                          VertexHandle *vertexesOut=nullptr, FaceHandle *facesOut=nullptr, ThreadPool *pool=nullptr );
+
+        // Topological editing, each operation only touches the elements around the edited one.
+        //  The onXCreated/onXDestroyed hooks are called for every element that is added or removed,
+        //  handles to removed elements becomes invalid, all other handles stays valid.
+
+        // Removes the face, its half edges becomes border half edges.
+        //  Edges that are left without faces are removed, and so are vertexes left without edges if 'removeIsolatedVertexes' is true.
+        COMMON_API bool removeFace( FaceHandle face, bool removeIsolatedVertexes=true );
+        // Removes the vertex together with all its edges and faces, the neighboring vertexes are kept.
+        COMMON_API bool removeVertex( VertexHandle vertex );
+        // Rotates the edge between two triangles, so it connects the two vertexes opposite to it.
+        //  Returns false for border edges, non triangles and if the vertexes already are connected.
+        COMMON_API bool flipEdge( EdgeHandle edge );
+        // Inserts a new vertex on the edge, the faces on each side gets one more vertex.
+        //  The edge keeps its first vertex (see getEdgeVertexes), a new edge connects the new vertex with the second one.
+        COMMON_API VertexHandle splitEdge( EdgeHandle edge );
+        // Splits the face in two with a new edge between two of its vertexes, they must not already be connected.
+        //  The face keeps the part that starts with v1, the new face (that is returned) starts with v2.
+        COMMON_API FaceHandle splitFace( FaceHandle face, VertexHandle v1, VertexHandle v2 );
+        // Tests if the half edge can be collapsed without making the mesh non-manifold (the link condition),
+        //  the cost is proportional to the valence of the two vertexes multiplied.
+        COMMON_API bool isCollapseOk( HEdgeHandle hedge ) const;
+        // Collapses the half edge by merging the vertex it leaves into the vertex it points to,
+        //  triangles on each side of the edge degenerate and are removed.
+        // Returns false without modifying the mesh if isCollapseOk fails.
+        COMMON_API bool collapseEdge( HEdgeHandle hedge );
+
+        // Renumbers the elements so they are stored densely, and releases the memory left by removed elements.
+        //  The faces are ordered breadth first across their edges, the vertexes and edges in the order the faces reaches them
+        //  (elements without faces last), and the two half edges of an edge are next to each other, so walks stays in nearby memory.
+        //  Every handle from before is invalid afterwards, translate them with the returned remap.
+        //  onCompact is called with the remap before this returns (HalfEdgeMesh moves its data to the new handles there).
+        //  The links are rewritten on 'pool' (or the global pool), the result is the same no matter the number of threads.
+        COMMON_API CompactRemap compact( ThreadPool *pool=nullptr );
+
+        // Serialization to a flat binary format with a version header and a checksum (see src/HalfEdgeMeshSerialize.cpp).
+        //  The topology tables are stored verbatim, so every handle is the same after loading,
+        //  and loading is one copy of each table instead of rebuilding the topology with createFace.
+        //  Derived meshes stores their tables after the topology in onSave (HalfEdgeMesh stores its data, which must be trivially copyable).
+        // Returns an empty vector if a table can't be stored (the reason is logged).
+        COMMON_API std::vector<uint8_t> save() const;
+        // Replaces the mesh with one from save(), 'data' doesn't have to be aligned (ex. a mapped file).
+        //  The checksum catches corrupt data, the tables are then verified to be consistent (but the topology isn't verified,
+        //  except that every half edge must have a pair when the edge index is enabled).
+        // Returns false and leaves the mesh empty if the data is invalid, the reason is logged.
+        COMMON_API bool load( const void *data, size_t size );
+        // Loads 'file' from 'archive', see load above.
+        COMMON_API bool load( Archive &archive, const std::string &file );
+
+        // An optional hash index of the half edges by their vertexes, it is disabled by default.
+        //  Without it findHEdge, findEdge, createEdge and createFace walks all edges around v1, which is slow for
+        //  vertexes with thousands of edges. With it they are O(1), at the cost of memory and a hash table update for
+        //  each edge that is created, removed or moved by an edit. Enabling it indexes the current edges.
+        //  The setting is kept when the mesh is copied, moved, cleared, compacted or loaded.
+        COMMON_API void setEdgeIndexEnabled( bool enabled );
+        COMMON_API bool isEdgeIndexEnabled() const;
+
         COMMON_API HEdgeHandle findHEdge( VertexHandle v1, VertexHandle v2 ) const;
         COMMON_API EdgeHandle findEdge( VertexHandle v1, VertexHandle v2 ) const;
 
@@ -174,6 +341,17 @@ namespace Common
         COMMON_API FaceIterator facesBegin() const;
         COMMON_API FaceIterator facesEnd() const;
 
+        // Parallel iteration, the elements are split into chunks of 'grainSize' that is run on 'pool' (or the global pool)
+        //  func is called concurrently, and the mesh must not be modified until the call returns
+        COMMON_API void parallelForEachVertex( const std::function<void(VertexHandle)> &func, size_t grainSize=1024, ThreadPool *pool=nullptr ) const;
+        COMMON_API void parallelForEachHEdge( const std::function<void(HEdgeHandle)> &func, size_t grainSize=1024, ThreadPool *pool=nullptr ) const;
+        COMMON_API void parallelForEachEdge( const std::function<void(EdgeHandle)> &func, size_t grainSize=1024, ThreadPool *pool=nullptr ) const;
+        COMMON_API void parallelForEachFace( const std::function<void(FaceHandle)> &func, size_t grainSize=1024, ThreadPool *pool=nullptr ) const;
+
+        // The topology tables (see HalfEdgeMeshTopology.h), for the header only circulators in HalfEdgeMeshCirculator.h.
+        //  Fetch it once outside hot loops, the reference is valid as long as the mesh is.
+        COMMON_API const internal::HalfEdgeMeshTopology& topology() const;
+
         COMMON_API VertexVertexRange vertexVertexes( VertexHandle vertex ) const;
         COMMON_API VertexVertexIterator vertexVertexesBegin( VertexHandle vertex ) const;
         COMMON_API VertexVertexIterator vertexVertexesEnd( VertexHandle vertex ) const;
@@ -232,6 +410,11 @@ namespace Common
         COMMON_API virtual void onFaceDestroyed( FaceHandle handle ) {}
 
         COMMON_API virtual void onClear() {}
+        COMMON_API virtual void onCompact( const CompactRemap &remap ) {}
+
+        // Called by save & load to store extra tables after the topology, they must be read in the same order as they are written
+        COMMON_API virtual bool onSave( HalfEdgeMeshWriter &writer ) const { return true; }
+        COMMON_API virtual bool onLoad( HalfEdgeMeshReader &reader ) { return true; }
 
     private:
         friend struct internal::HalfEdgeMeshBaseImpl;
@@ -239,7 +422,7 @@ namespace Common
         friend  internal::HalfEdgeMeshBaseImpl* internal::getImpl( HalfEdgeMeshBase& );
         friend  const internal::HalfEdgeMeshBaseImpl* internal::getImpl( const HalfEdgeMeshBase& );
 
-        PImplHelper<internal::HalfEdgeMeshBaseImpl, 144> mImpl;
+        PImplHelper<internal::HalfEdgeMeshBaseImpl, 280> mImpl;
     };
 
     template< typename VertexData, typename HEdgeData,  typename EdgeData, typename FaceData >
@@ -270,6 +453,22 @@ namespace Common
         _CREATE_DATA_METHODS(FaceHandle, FaceData, mFaces);
 #undef _CREATE_DATA_METHODS
 
+        // Parallel iteration over the element data, func is called as func(handle, data)
+#define _CREATE_PARALLEL_DATA_METHODS(Name, member)                                                                 \
+        template< typename Func >                                                                                   \
+        void parallelForEach##Name##Data( Func &&func, size_t grainSize=1024, ThreadPool *pool=nullptr ) {          \
+            member.parallelForEachWithHandle(std::forward<Func>(func), grainSize, pool);                            \
+        }                                                                                                           \
+        template< typename Func >                                                                                   \
+        void parallelForEach##Name##Data( Func &&func, size_t grainSize=1024, ThreadPool *pool=nullptr ) const {    \
+            member.parallelForEachWithHandle(std::forward<Func>(func), grainSize, pool);                            \
+        }
+        _CREATE_PARALLEL_DATA_METHODS(Vertex, mVertexes);
+        _CREATE_PARALLEL_DATA_METHODS(HEdge, mHEdges);
+        _CREATE_PARALLEL_DATA_METHODS(Edge, mEdges);
+        _CREATE_PARALLEL_DATA_METHODS(Face, mFaces);
+#undef _CREATE_PARALLEL_DATA_METHODS
+
 
     protected:
         virtual void onVertexCreated( VertexHandle handle ) override {
@@ -305,10 +504,28 @@ namespace Common
             mFaces.clear();
         }
 
+        virtual void onCompact( const CompactRemap &remap ) override {
+            mVertexes.relocate(remap.oldVertexes.data(), remap.newVertexes.data(), remap.oldVertexes.size());
+            mHEdges.relocate(remap.oldHEdges.data(), remap.newHEdges.data(), remap.oldHEdges.size());
+            mEdges.relocate(remap.oldEdges.data(), remap.newEdges.data(), remap.oldEdges.size());
+            mFaces.relocate(remap.oldFaces.data(), remap.newFaces.data(), remap.oldFaces.size());
+        }
+
+        virtual bool onSave( HalfEdgeMeshWriter &writer ) const override {
+            return writer.write(mVertexes) && writer.write(mHEdges) && writer.write(mEdges) && writer.write(mFaces);
+        }
+        virtual bool onLoad( HalfEdgeMeshReader &reader ) override {
+            return reader.read(mVertexes) && reader.read(mHEdges) && reader.read(mEdges) && reader.read(mFaces);
+        }
+
     private:
-        ManuelHandleVector<VertexHandle, VertexData> mVertexes;
-        ManuelHandleVector<HEdgeHandle, HEdgeData> mHEdges;
-        ManuelHandleVector<EdgeHandle, EdgeData> mEdges;
-        ManuelHandleVector<FaceHandle, FaceData> mFaces;
+        // Chunked so pointers from findData stays valid while the mesh grows,
+        //  shared so copies of the mesh shares the data until it is written
+        using DataStorage = HandleVectorStorage::SharedChunked<4096>;
+
+        ManuelHandleVector<VertexHandle, VertexData, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, DataStorage> mVertexes;
+        ManuelHandleVector<HEdgeHandle, HEdgeData, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, DataStorage> mHEdges;
+        ManuelHandleVector<EdgeHandle, EdgeData, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, DataStorage> mEdges;
+        ManuelHandleVector<FaceHandle, FaceData, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, DataStorage> mFaces;
     };
 }
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "HalfEdgeMeshTopology.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+
+// Whole mesh analyses, for validating imported meshes.
+//  They walk the topology tables directly in a few linear passes (side tables are indexed by slot),
+//  instead of one api call per element like isBorderFace or the circulators.
+//  The results refers to the mesh as it was, they are invalid once the mesh is edited.
+//
+// Usage:
+//      ManifoldReport report = validateManifold(mesh);
+//      if (!report.isManifold()) {
+//          ...
+//      }
+//      MeshComponents components = labelComponents(mesh);
+//      for (const MeshComponents::Component &component : components.components) {
+//          if (component.genus > 0) ...
+//      }
+
+namespace Common
+{
+    struct MeshBoundaryLoops {
+        // The half edges without a face, loop i is hedges[loopStart[i]] to hedges[loopStart[i+1]-1],
+        //  in the order next walks them. The loops are ordered by their first half edge (which is the one with the lowest slot).
+        std::vector<HalfEdgeMeshBase::HEdgeHandle> hedges;
+        std::vector<uint32_t> loopStart;
+
+        size_t size() const {
+            return loopStart.empty() ? 0 : loopStart.size() - 1;
+        }
+    };
+
+    struct MeshComponents {
+        static const uint32_t INVALID = ~0u;
+
+        struct Component {
+            uint32_t vertexes = 0,
+                     edges = 0,
+                     faces = 0,
+                     boundaryLoops = 0;
+            // V - E + F
+            int64_t eulerCharacteristic = 0;
+            // From 2 - 2g - b = V - E + F, it only means something if the component is a manifold
+            //  (a isolated vertex has genus 0)
+            int64_t genus = 0;
+        };
+
+        // Ordered by the lowest slot of their vertexes
+        std::vector<Component> components;
+
+        // The component of each vertex and face slot, INVALID for free slots
+        std::vector<uint32_t> vertexLabels,
+                              faceLabels;
+
+        uint32_t vertexComponent( HalfEdgeMeshBase::VertexHandle vertex ) const {
+            return vertexLabels[internal::VertexVector::SlotIndex(vertex)];
+        }
+        uint32_t faceComponent( HalfEdgeMeshBase::FaceHandle face ) const {
+            return faceLabels[internal::FaceVector::SlotIndex(face)];
+        }
+
+        // Of the whole mesh
+        int64_t eulerCharacteristic() const;
+        int64_t genus() const;
+    };
+
+    struct ManifoldReport {
+        // Half edges with links that doesn't agree (pair->pair, next->prev, the edge of the pair or the face of next),
+        //  or that links to removed elements. Vertexes, edges and faces whose half edge is removed or doesn't belong to them
+        //  are reported in the lists below. The loops can't be walked safely if there is any of these, so the other checks are skipped.
+        std::vector<HalfEdgeMeshBase::HEdgeHandle> brokenHEdges;
+        // Faces with less than 3 vertexes, or that passes the same vertex more than once
+        std::vector<HalfEdgeMeshBase::FaceHandle> degenerateFaces;
+        // Edges without a face on either side, and edges from a vertex to itself
+        std::vector<HalfEdgeMeshBase::EdgeHandle> nonManifoldEdges;
+        // Vertexes where the faces around it doesn't form a single fan (ex. two cones touching at their tips)
+        std::vector<HalfEdgeMeshBase::VertexHandle> nonManifoldVertexes;
+
+        bool isManifold() const {
+            return brokenHEdges.empty() && degenerateFaces.empty() && nonManifoldEdges.empty() && nonManifoldVertexes.empty();
+        }
+    };
+
+    COMMON_API MeshBoundaryLoops findBoundaryLoops( const HalfEdgeMeshBase &mesh );
+    // Vertexes connected by edges are in the same component, the work is split over 'pool' (or the global pool)
+    COMMON_API MeshComponents labelComponents( const HalfEdgeMeshBase &mesh, ThreadPool *pool=nullptr );
+    // Unlike verifyInvariants this is avalible in release builds, and reports the problems instead of asserting.
+    //  The lists are ordered by slot, the work is split over 'pool' (or the global pool)
+    COMMON_API ManifoldReport validateManifold( const HalfEdgeMeshBase &mesh, ThreadPool *pool=nullptr );
+
+    inline int64_t MeshComponents::eulerCharacteristic() const {
+        int64_t result = 0;
+        for (const Component &component : components) {
+            result += component.eulerCharacteristic;
+        }
+        return result;
+    }
+    inline int64_t MeshComponents::genus() const {
+        int64_t result = 0;
+        for (const Component &component : components) {
+            result += component.genus;
+        }
+        return result;
+    }
+}
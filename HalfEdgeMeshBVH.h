@@ -0,0 +1,112 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <functional>
+#include <limits>
+#include <cstdint>
+
+// A bounding volume hierarchy over the faces of a HalfEdgeMesh, for ray casts and closest point queries.
+//  Faces with more than 3 vertexes are split into a triangle fan, every triangle remembers its face.
+//  The positions are read through a accessor when the tree is built or refit, and copied into the
+//  triangles so the queries doesn't have to call back into the mesh.
+//
+// The tree is built top down with the surface area heuristic (binned), the top levels are split
+//  on one thread and the subtrees are then built in parallel on the thread pool.
+//  Each node stores the bounds of both its children next to each other, so the two slab tests
+//  are done together (and vectorized by the compiler) without fetching the children.
+//
+// Usage:
+//      HalfEdgeMeshBVH bvh;
+//      bvh.build(mesh, [](const Vertex &vertex) { return vertex.position; });
+//      HalfEdgeMeshBVH::Hit hit;
+//      if (bvh.raycast(origin, direction, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit)) {
+//          ... hit.face, hit.distance, hit.point
+//      }
+//      // after moving vertexes (without changing the topology)
+//      bvh.refit(mesh, [](const Vertex &vertex) { return vertex.position; });
+
+namespace Common
+{
+    class HalfEdgeMeshBVH {
+    public:
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+        using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+
+        using GetPosition = std::function<void(VertexHandle vertex, float *xyz)>;
+
+        static constexpr float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+
+        struct Hit {
+            FaceHandle face;
+            float distance = 0;
+            float point[3] = {0, 0, 0};
+        };
+
+    public:
+        // Builds the tree over every face in the mesh on 'pool' (or the global pool),
+        //  the tree is the same no matter the number of threads.
+        COMMON_API void build( const HalfEdgeMeshBase &mesh, const GetPosition &getPosition, ThreadPool *pool=nullptr );
+        // Reads the positions again and updates the bounds, the tree is kept as it is.
+        //  Much cheaper than a rebuild after vertexes has moved, but the faces must be the same as when it was built.
+        //  The queries gets slower if the vertexes has moved far, rebuild it then.
+        COMMON_API void refit( const GetPosition &getPosition, ThreadPool *pool=nullptr );
+
+        COMMON_API void clear();
+
+        // Finds the closest face hit by the ray within maxDistance, 'direction' doesn't have to be normalized
+        //  (the distance is then in units of its length). Both sides of the faces are hit.
+        COMMON_API bool raycast( const float *origin, const float *direction, float maxDistance, Hit &hit ) const;
+        // Finds the closest point on any face within maxDistance
+        COMMON_API bool closestPoint( const float *point, float maxDistance, Hit &hit ) const;
+
+        size_t triangleCount() const {
+            return mTriangles.size();
+        }
+        size_t nodeCount() const {
+            return mNodes.size();
+        }
+
+        // Same as above, 'position' takes a const reference to the vertex data and returns its position
+        //  as something that can be indexed with 0-2 (a pointer to 3 floats, a std::array, ...)
+        template< typename VertexData, typename HEdgeData, typename EdgeData, typename FaceData, typename PositionFunc >
+        void build( const HalfEdgeMesh<VertexData, HEdgeData, EdgeData, FaceData> &mesh, PositionFunc position, ThreadPool *pool=nullptr ) {
+            build(static_cast<const HalfEdgeMeshBase&>(mesh), positionGetter(mesh, position), pool);
+        }
+        template< typename VertexData, typename HEdgeData, typename EdgeData, typename FaceData, typename PositionFunc >
+        void refit( const HalfEdgeMesh<VertexData, HEdgeData, EdgeData, FaceData> &mesh, PositionFunc position, ThreadPool *pool=nullptr ) {
+            refit(positionGetter(mesh, position), pool);
+        }
+
+    private:
+        template< typename Mesh, typename PositionFunc >
+        static GetPosition positionGetter( const Mesh &mesh, PositionFunc position ) {
+            return [&mesh, position]( VertexHandle vertex, float *xyz ) {
+                auto &&pos = position(*mesh.findData(vertex));
+                for (int i=0; i < 3; ++i) xyz[i] = float(pos[i]);
+            };
+        }
+
+    private:
+        // The two children of a node are either another node or a range of triangles
+        struct Node {
+            float minX[2], minY[2], minZ[2],
+                  maxX[2], maxY[2], maxZ[2];
+            // The node index, or the first triangle if count > 0
+            uint32_t child[2];
+            uint32_t count[2];
+        };
+        struct Triangle {
+            float p[3][3];
+            VertexHandle vertexes[3];
+            FaceHandle face;
+        };
+
+        friend struct HalfEdgeMeshBVHImpl;
+
+        std::vector<Node> mNodes;
+        std::vector<Triangle> mTriangles;
+    };
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "HalfEdgeMeshTopology.h"
+#include "IteratorAdopter.h"
+
+// Header only versions of the circulators in HalfEdgeMeshIterator.h (VertexVertexIterator, FaceVertexIterator, ...)
+//  They walk the topology tables directly, so every step can be inlined instead of calling into the library.
+//  They visit the same elements in the same order as the iterators in HalfEdgeMeshIterator.h,
+//  which are kept as they are for ABI stability.
+//
+// Usage:
+//      const auto &topology = mesh.topology();
+//      for (auto vertex : mesh.vertexes()) {
+//          for (auto neighbor : HalfEdgeMeshCirculators::vertexVertexes(topology, vertex)) {
+//              ...
+//          }
+//      }
+//
+// The mesh must not be modified while a circulator is used.
+
+namespace Common
+{
+    namespace HalfEdgeMeshCirculators
+    {
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+        using HEdgeHandle = HalfEdgeMeshBase::HEdgeHandle;
+        using EdgeHandle = HalfEdgeMeshBase::EdgeHandle;
+        using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+
+        using Topology = internal::HalfEdgeMeshTopology;
+
+        // Where the walk starts, and how to get to the next half edge
+        struct AroundVertex {
+            using StartHandle = VertexHandle;
+
+            static HEdgeHandle first( const Topology &topology, VertexHandle vertex ) {
+                const internal::Vertex *ptr = topology.vertexes.find(vertex);
+                return ptr ? ptr->hedge : HEdgeHandle();
+            }
+            static HEdgeHandle step( const Topology &topology, const internal::HEdge &hedge ) {
+                return topology.hedges.find(hedge.pair)->next;
+            }
+        };
+        struct AroundFace {
+            using StartHandle = FaceHandle;
+
+            static HEdgeHandle first( const Topology &topology, FaceHandle face ) {
+                const internal::Face *ptr = topology.faces.find(face);
+                return ptr ? ptr->hedge : HEdgeHandle();
+            }
+            static HEdgeHandle step( const Topology&, const internal::HEdge &hedge ) {
+                return hedge.next;
+            }
+        };
+
+        // What is visited for each half edge, half edges that gives a null handle are skipped
+#define _CREATE_GETTER(Name, Handle_, expr)                                                         \
+        struct Name {                                                                               \
+            using Handle = Handle_;                                                                 \
+            static Handle get( const Topology &topology, HEdgeHandle handle, const internal::HEdge &hedge ) { \
+                (void)topology; (void)handle;                                                       \
+                return expr;                                                                        \
+            }                                                                                       \
+        };
+
+        _CREATE_GETTER(GetVertex, VertexHandle, hedge.vertex);
+        _CREATE_GETTER(GetHEdge, HEdgeHandle, handle);
+        _CREATE_GETTER(GetPair, HEdgeHandle, hedge.pair);
+        _CREATE_GETTER(GetEdge, EdgeHandle, hedge.edge);
+        _CREATE_GETTER(GetFace, FaceHandle, hedge.face);
+        _CREATE_GETTER(GetPairFace, FaceHandle, topology.hedges.find(hedge.pair)->face);
+
+#undef _CREATE_GETTER
+
+        template< typename Around, typename Get >
+        class Circulator :
+            public IteratorAdopter<Circulator<Around, Get>, typename Get::Handle, std::forward_iterator_tag>
+        {
+        public:
+            using Handle = typename Get::Handle;
+            using StartHandle = typename Around::StartHandle;
+
+            // The end iterator
+            Circulator() :
+                mLap(1)
+            {}
+
+            Circulator( const Topology &topology, StartHandle start ) :
+                mTopology(&topology)
+            {
+                HEdgeHandle first = Around::first(topology, start);
+                load(first);
+                if (!mPtr) {
+                    mLap = 1;
+                    return;
+                }
+
+                // Start on the first half edge that has something to visit
+                while (!Get::get(topology, mHEdge, *mPtr)) {
+                    load(Around::step(topology, *mPtr));
+                    if (mHEdge == first) {
+                        mLap = 1;
+                        load(HEdgeHandle());
+                        return;
+                    }
+                }
+                mHead = mHEdge;
+            }
+
+            bool equal( const Circulator &other ) const {
+                if (mLap != other.mLap) return false;
+                if (mPtr && other.mPtr) {
+                    return mHEdge == other.mHEdge;
+                }
+                return true;
+            }
+
+            Handle dereference() const {
+                if (!mPtr) return Handle();
+                return Get::get(*mTopology, mHEdge, *mPtr);
+            }
+
+            void increment() {
+                if (!mPtr) return;
+                do {
+                    load(Around::step(*mTopology, *mPtr));
+                    if (mHEdge == mHead) {
+                        mLap++;
+                        return;
+                    }
+                } while (!Get::get(*mTopology, mHEdge, *mPtr));
+            }
+
+        private:
+            void load( HEdgeHandle hedge ) {
+                mHEdge = hedge;
+                mPtr = hedge ? mTopology->hedges.find(hedge) : nullptr;
+            }
+
+        private:
+            const Topology *mTopology = nullptr;
+            const internal::HEdge *mPtr = nullptr;
+            HEdgeHandle mHEdge,
+                        mHead;
+            int mLap = 0;
+        };
+
+        template< typename Iter >
+        class Range {
+        public:
+            explicit Range( const Iter &begin ) :
+                mBegin(begin)
+            {}
+
+            Iter begin() const {
+                return mBegin;
+            }
+            Iter end() const {
+                return Iter();
+            }
+
+        private:
+            Iter mBegin;
+        };
+
+        // Iterates over all neigboring vertexes for a given vertex
+        using VertexVertexCirculator = Circulator<AroundVertex, GetVertex>;
+        // Iterates over every outgoing half edge for a given vertex
+        using VertexOHEdgeCirculator = Circulator<AroundVertex, GetHEdge>;
+        // Iterates over the incoming half edges for a given vertex
+        using VertexIHEdgeCirculator = Circulator<AroundVertex, GetPair>;
+        // Iterates over the edges connected to a given vertex
+        using VertexEdgeCirculator   = Circulator<AroundVertex, GetEdge>;
+        // Iterates over all faces sharing this vertex
+        using VertexFaceCirculator   = Circulator<AroundVertex, GetFace>;
+
+        // Iterates over the vertexes that make up the given face
+        using FaceVertexCirculator   = Circulator<AroundFace, GetVertex>;
+        // Iterates over the half edges that make up the given face
+        using FaceHEdgeCirculator    = Circulator<AroundFace, GetHEdge>;
+        // Iterates over the edges that make up the given face
+        using FaceEdgeCirculator     = Circulator<AroundFace, GetEdge>;
+        // Iterates over neighboring faces for the given face
+        using FaceFaceCirculator     = Circulator<AroundFace, GetPairFace>;
+
+#define _CREATE_RANGE_FUNCTION(name, Circulator_, StartHandle)                                      \
+        inline Range<Circulator_> name( const Topology &topology, StartHandle handle ) {            \
+            return Range<Circulator_>(Circulator_(topology, handle));                               \
+        }                                                                                           \
+        inline Range<Circulator_> name( const HalfEdgeMeshBase &mesh, StartHandle handle ) {        \
+            return Range<Circulator_>(Circulator_(mesh.topology(), handle));                        \
+        }
+
+        _CREATE_RANGE_FUNCTION(vertexVertexes, VertexVertexCirculator, VertexHandle);
+        _CREATE_RANGE_FUNCTION(vertexOHEdges, VertexOHEdgeCirculator, VertexHandle);
+        _CREATE_RANGE_FUNCTION(vertexIHEdges, VertexIHEdgeCirculator, VertexHandle);
+        _CREATE_RANGE_FUNCTION(vertexEdges, VertexEdgeCirculator, VertexHandle);
+        _CREATE_RANGE_FUNCTION(vertexFaces, VertexFaceCirculator, VertexHandle);
+
+        _CREATE_RANGE_FUNCTION(faceVertexes, FaceVertexCirculator, FaceHandle);
+        _CREATE_RANGE_FUNCTION(faceHEdges, FaceHEdgeCirculator, FaceHandle);
+        _CREATE_RANGE_FUNCTION(faceEdges, FaceEdgeCirculator, FaceHandle);
+        _CREATE_RANGE_FUNCTION(faceFaces, FaceFaceCirculator, FaceHandle);
+
+#undef _CREATE_RANGE_FUNCTION
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+// Mesh simplification with quadric error metrics
+//  Read about it here:
+//      - Garland & Heckbert, Surface Simplification Using Quadric Error Metrics (1997)
+//
+// Edges are collapsed in order of their error, cheapest first, until the target face count is reached.
+//  The candidates are kept in a priority queue that is updated lazily: every vertex has a version that is bumped
+//  when it is moved, and a candidate is skipped if the version of its vertexes doesn't match when it is popped
+//  (or if its half edge has been removed, which the handle generation detects).
+//  Only the edges around the collapsed vertex are pushed again, so each collapse is O(valence log n).
+//
+// Usage:
+//      struct Vertex { float position[3]; };
+//      HalfEdgeMesh<Vertex, ...> mesh;
+//      ...
+//      DecimationSettings settings;
+//      settings.targetFaceCount = 1000;
+//      decimate(mesh, settings, [](Vertex &vertex) { return vertex.position; });
+
+namespace Common
+{
+    struct DecimationSettings {
+        // Stop when the mesh has this many faces (or less)
+        size_t targetFaceCount = 0;
+        // Stop when the cheapest collapse has a larger error (the squared distance to the original planes)
+        double maxError = std::numeric_limits<double>::max();
+        // How strongly border edges are kept in place, relative to the faces around them
+        double borderWeight = 1000.0;
+        // Reject collapses that rotates the normal of a face by more than this (as cos(angle))
+        double minNormalDot = 0.0;
+    };
+
+    struct DecimationResult {
+        size_t collapses = 0;
+        size_t faceCount = 0;
+        // The largest error of the collapses that was made
+        double maxError = 0.0;
+    };
+
+    using DecimationGetPosition = std::function<void(HalfEdgeMeshBase::VertexHandle vertex, double *xyz)>;
+    using DecimationSetPosition = std::function<void(HalfEdgeMeshBase::VertexHandle vertex, const double *xyz)>;
+
+    // Simplifies a triangle mesh, the positions are read once for each vertex and written back to the vertexes that are moved.
+    //  Returns without modifying the mesh if it has faces that aren't triangles (that is logged).
+    COMMON_API DecimationResult decimate( HalfEdgeMeshBase &mesh, const DecimationSettings &settings,
+                                          const DecimationGetPosition &getPosition, const DecimationSetPosition &setPosition );
+
+    // Same as above, 'position' returns the position of the vertex data as something that can be indexed with 0-2
+    //  (a pointer to 3 floats, a std::array, ...)
+    template< typename VertexData, typename HEdgeData, typename EdgeData, typename FaceData, typename PositionFunc >
+    DecimationResult decimate( HalfEdgeMesh<VertexData, HEdgeData, EdgeData, FaceData> &mesh, const DecimationSettings &settings, PositionFunc position )
+    {
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+
+        auto getPosition = [&]( VertexHandle vertex, double *xyz ) {
+            auto &&pos = position(*mesh.findData(vertex));
+            for (int i=0; i < 3; ++i) xyz[i] = pos[i];
+        };
+        auto setPosition = [&]( VertexHandle vertex, const double *xyz ) {
+            auto &&pos = position(*mesh.findData(vertex));
+            using Scalar = typename std::decay<decltype(pos[0])>::type;
+            for (int i=0; i < 3; ++i) pos[i] = Scalar(xyz[i]);
+        };
+        return decimate(static_cast<HalfEdgeMeshBase&>(mesh), settings, getPosition, setPosition);
+    }
+}
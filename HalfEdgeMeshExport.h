@@ -0,0 +1,67 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+
+// Converts a HalfEdgeMesh to flat index buffers, ready to upload to the gpu.
+//  Every vertex gets a dense index (in the order they are iterated), faces with more than 3 vertexes
+//  are split into a triangle fan from the first vertex of the face, and every triangle remembers its face.
+//  The topology tables are walked directly, so this is much faster than going through faces() and faceVertexes().
+//
+// The adjacency buffer uses the layout of triangle lists with adjacency (GL_TRIANGLES_ADJACENCY, D3D 'triangleadj'):
+//  6 indices per triangle, v0 a0 v1 a1 v2 a2, where 'ai' is the vertex opposite of the edge vi-vi+1 in the neighboring triangle.
+//  Edges on the border of the mesh have no neighbor, they get the vertex opposite of the edge in the triangle itself.
+//
+// Usage:
+//      ExportSettings settings;
+//      settings.adjacency = true;
+//      settings.optimizeVertexCache = true;
+//      IndexedExport result = exportIndexed(mesh, settings);
+//      for (VertexHandle vertex : result.vertexes) {
+//          // copy the vertex data in this order
+//      }
+//      upload(result.triangles);
+
+namespace Common
+{
+    struct ExportSettings {
+        bool triangles = true;
+        bool adjacency = false;
+        bool edges = false;
+        // Reorders the triangles for the post transform vertex cache (Forsyth's algorithm)
+        bool optimizeVertexCache = false;
+        // Numbers the vertexes in the order the triangles first use them (isolated vertexes are placed last)
+        bool optimizeVertexFetch = false;
+        // The size of the simulated cache for optimizeVertexCache
+        uint32_t cacheSize = 32;
+    };
+
+    struct IndexedExport {
+        // The vertex handle for each index
+        std::vector<HalfEdgeMeshBase::VertexHandle> vertexes;
+
+        // 3 indices per triangle, the winding of the faces is kept
+        std::vector<uint32_t> triangles;
+        // The face each triangle comes from
+        std::vector<HalfEdgeMeshBase::FaceHandle> triangleFaces;
+        // 6 indices per triangle, in the same order as 'triangles'
+        std::vector<uint32_t> adjacency;
+
+        // 2 indices per edge, the origin and target of the first half edge of the edge
+        std::vector<uint32_t> edges;
+        // The edge for each pair in 'edges'
+        std::vector<HalfEdgeMeshBase::EdgeHandle> edgeHandles;
+    };
+
+    // The work is split over 'pool' (or the global pool), the result is the same no matter the number of threads.
+    COMMON_API IndexedExport exportIndexed( const HalfEdgeMeshBase &mesh, const ExportSettings &settings=ExportSettings(), ThreadPool *pool=nullptr );
+
+    // Reorders triangles to reuse the post transform vertex cache better (Forsyth's algorithm),
+    //  writes the old index of each triangle to 'order' (triangleCount entries). The indices itself aren't modified.
+    //  Read about it here:
+    //      - Tom Forsyth, Linear-Speed Vertex Cache Optimisation (2006)
+    COMMON_API void optimizeVertexCache( const uint32_t *indices, size_t triangleCount, size_t vertexCount, uint32_t *order, uint32_t cacheSize=32 );
+}
@@ -28,7 +28,7 @@ namespace Common
             public IteratorAdopter<VertexIterator, VertexHandle, std::bidirectional_iterator_tag>
         {
             struct Impl;
-            PImplHelper<Impl, 24> mImpl;
+            PImplHelper<Impl, 48> mImpl;
         public:
             COMMON_API explicit VertexIterator( const HalfEdgeMeshBase &mesh );
             COMMON_API VertexIterator( const HalfEdgeMeshBase &mesh, EndIterator end );
@@ -48,7 +48,7 @@ namespace Common
             public IteratorAdopter<HEdgeIterator, HEdgeHandle, std::bidirectional_iterator_tag>
         {
             struct Impl;
-            PImplHelper<Impl, 24> mImpl;
+            PImplHelper<Impl, 48> mImpl;
         public:
             COMMON_API HEdgeIterator( const HalfEdgeMeshBase &mesh );
             COMMON_API HEdgeIterator( const HalfEdgeMeshBase &mesh, EndIterator end );
@@ -68,7 +68,7 @@ namespace Common
             public IteratorAdopter<EdgeIterator, EdgeHandle, std::bidirectional_iterator_tag>
         {
             struct Impl;
-            PImplHelper<Impl, 24> mImpl;
+            PImplHelper<Impl, 48> mImpl;
         public:
             COMMON_API EdgeIterator( const HalfEdgeMeshBase &mesh );
             COMMON_API EdgeIterator( const HalfEdgeMeshBase &mesh, EndIterator end );
@@ -88,7 +88,7 @@ namespace Common
             public IteratorAdopter<FaceIterator, FaceHandle, std::bidirectional_iterator_tag>
         {
             struct Impl;
-            PImplHelper<Impl, 24> mImpl;
+            PImplHelper<Impl, 48> mImpl;
         public:
             COMMON_API FaceIterator( const HalfEdgeMeshBase &mesh );
             COMMON_API FaceIterator( const HalfEdgeMeshBase &mesh, EndIterator end );
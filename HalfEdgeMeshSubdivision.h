@@ -0,0 +1,88 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <vector>
+
+// Subdivision surfaces, each level refines every face and smooths the vertexes
+//  Read about them here:
+//      - Loop, Smooth Subdivision Surfaces Based on Triangles (1987)
+//      - Catmull & Clark, Recursively generated B-spline surfaces on arbitrary topological meshes (1978)
+//
+// The refined mesh is built from the source topology: every vertex, edge (and face for Catmull-Clark)
+//  of the source gives one new vertex, and the new faces are built with buildFromIndexed in one go.
+//  Each new vertex is a weighted sum of source vertexes (its stencil), which is passed to a blend callback
+//  that computes its data. The faces, stencils and blends are split over the thread pool, so a level is linear time.
+//
+// Border edges and vertexes follows the cubic B-spline along the border (the crease rules),
+//  vertexes with more than two border edges are kept where they are.
+//
+// Usage:
+//      struct Vertex { float position[3]; };
+//      HalfEdgeMesh<Vertex, ...> cage, refined;
+//      ...
+//      subdivide(cage, refined, SubdivisionScheme::CatmullClark,
+//          [](Vertex &out, const Vertex *const *sources, const float *weights, size_t count) {
+//              out = Vertex{};
+//              for (size_t i=0; i < count; ++i) {
+//                  for (int c=0; c < 3; ++c) out.position[c] += weights[i] * sources[i]->position[c];
+//              }
+//          }, 2);
+
+namespace Common
+{
+    enum class SubdivisionScheme {
+        // Triangle meshes only, every triangle is split into 4
+        Loop,
+        // Any polygons, every face with n vertexes is split into n quads
+        CatmullClark
+    };
+
+    // Called once for every vertex in the refined mesh, possibly concurrently from several threads.
+    //  'target' is the new vertex, it is the weighted sum of the 'count' source vertexes (the weights sums to 1,
+    //  a source vertex can be listed more than once).
+    using SubdivisionBlend = std::function<void(HalfEdgeMeshBase::VertexHandle target, const HalfEdgeMeshBase::VertexHandle *sources, const float *weights, size_t count)>;
+
+    // Subdivides 'source' one level into 'target' (which is cleared first, and must not be the same mesh).
+    //  The new vertexes are numbered as the source vertexes, followed by one for each edge and (for Catmull-Clark) one for each face,
+    //  in the order they are iterated. Edges without faces gives vertexes without edges.
+    //  The work is split over 'pool' (or the global pool), the result is the same no matter the number of threads.
+    // Returns false if the mesh can't be subdivided with the scheme (the reason is logged), 'target' is then empty.
+    COMMON_API bool subdivide( const HalfEdgeMeshBase &source, HalfEdgeMeshBase &target, SubdivisionScheme scheme, const SubdivisionBlend &blend, ThreadPool *pool=nullptr );
+
+    // Same as above for 'levels' levels, the vertex data is computed with
+    //  blend(VertexData &out, const VertexData *const *sources, const float *weights, size_t count)
+    //  The other data of 'target' is default constructed.
+    template< typename VertexData, typename HEdgeData, typename EdgeData, typename FaceData, typename BlendFunc >
+    bool subdivide( const HalfEdgeMesh<VertexData, HEdgeData, EdgeData, FaceData> &source, HalfEdgeMesh<VertexData, HEdgeData, EdgeData, FaceData> &target,
+                    SubdivisionScheme scheme, BlendFunc blend, int levels=1, ThreadPool *pool=nullptr )
+    {
+        using Mesh = HalfEdgeMesh<VertexData, HEdgeData, EdgeData, FaceData>;
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+
+        auto level = [&]( const Mesh &from, Mesh &to ) {
+            auto blendData = [&]( VertexHandle vertex, const VertexHandle *sources, const float *weights, size_t count ) {
+                thread_local std::vector<const VertexData*> data;
+                data.resize(count);
+                for (size_t i=0; i < count; ++i) {
+                    data[i] = from.findData(sources[i]);
+                }
+                blend(*to.findData(vertex), data.data(), weights, count);
+            };
+            return subdivide(static_cast<const HalfEdgeMeshBase&>(from), static_cast<HalfEdgeMeshBase&>(to), scheme, blendData, pool);
+        };
+
+        if (!level(source, target)) return false;
+        for (int i=1; i < levels; ++i) {
+            Mesh refined;
+            if (!level(target, refined)) {
+                target.clear();
+                return false;
+            }
+            target = std::move(refined);
+        }
+        return true;
+    }
+}
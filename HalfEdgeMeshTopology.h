@@ -0,0 +1,50 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "HandleVector.h"
+
+// The topology tables behind HalfEdgeMeshBase.
+//  They are public so the header only circulators in HalfEdgeMeshCirculator.h can walk them
+//  without calling into the library, use HalfEdgeMeshBase::topology() to get them.
+//  The layout is internal and may change, don't store pointers into it across edits of the mesh.
+
+namespace Common
+{
+    namespace internal
+    {
+        struct HEdge {
+            HalfEdgeMeshBase::HEdgeHandle pair,
+                                          next,
+                                          prev;
+            HalfEdgeMeshBase::VertexHandle vertex;
+            HalfEdgeMeshBase::FaceHandle face;
+            HalfEdgeMeshBase::EdgeHandle edge;
+        };
+        struct Vertex {
+            HalfEdgeMeshBase::HEdgeHandle hedge;
+        };
+        struct Edge {
+            HalfEdgeMeshBase::HEdgeHandle hedge;
+        };
+        struct Face {
+            HalfEdgeMeshBase::HEdgeHandle hedge;
+        };
+
+        // Chunked storage keeps the pointers cached by the smart handles valid
+        //  when new elements are allocated, they only have to refresh after a free.
+        //  The chunks are shared between copies of the mesh, so a copy is a cheap snapshot
+        using TopologyStorage = HandleVectorStorage::SharedChunked<4096>;
+
+        using VertexVector = HandleVector<HalfEdgeMeshBase::VertexHandle, Vertex, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, TopologyStorage>;
+        using HEdgeVector = HandleVector<HalfEdgeMeshBase::HEdgeHandle, HEdge, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, TopologyStorage>;
+        using EdgeVector = HandleVector<HalfEdgeMeshBase::EdgeHandle, Edge, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, TopologyStorage>;
+        using FaceVector = HandleVector<HalfEdgeMeshBase::FaceHandle, Face, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, TopologyStorage>;
+
+        struct HalfEdgeMeshTopology {
+            VertexVector vertexes;
+            HEdgeVector hedges;
+            EdgeVector edges;
+            FaceVector faces;
+        };
+    }
+}
@@ -3,28 +3,112 @@
 
 #include "HandleType.h"
 #include "IteratorAdopter.h"
+#include "ChunkedArray.h"
+#include "SharedChunkedArray.h"
+#include "ThreadPool.h"
 
 #include <vector>
+#include <algorithm>
 #include <type_traits>
+#include <utility>
+#include <climits>
+#include <cstdint>
 #include <cassert>
+#include <cstring>
 
 static constexpr const unsigned HANDLE_VECTOR_DEFAULT = (unsigned)-1;
-template< typename Handle, typename Value, unsigned GenerationBits_=HANDLE_VECTOR_DEFAULT, unsigned DataBits_=HANDLE_VECTOR_DEFAULT, typename Handle::underlaying_type DataValue_=0, bool ManualHandels_=false > 
+
+namespace HandleVectorInternal
+{
+    // Mask with the 'bits' lowest bits set, safe for any bit count up to the width of Type
+    //  (a plain '(1 << bits) - 1' overflows the int for wide types)
+    template< typename Type >
+    constexpr Type LowBitMask( unsigned bits ) {
+        return bits >= CHAR_BIT * sizeof(Type) ? Type(~Type(0)) : Type((uint64_t(1) << bits) - 1);
+    }
+
+    // Storage that clones shared parts on write has a makeUnique(), that must be called before writing from several threads
+    template< typename Storage, typename = void >
+    struct HasMakeUnique : std::false_type {};
+    template< typename Storage >
+    struct HasMakeUnique<Storage, decltype(std::declval<Storage&>().makeUnique())> : std::true_type {};
+
+    template< typename Storage >
+    typename std::enable_if<HasMakeUnique<Storage>::value>::type MakeUnique( Storage &storage ) {
+        storage.makeUnique();
+    }
+    template< typename Storage >
+    typename std::enable_if<!HasMakeUnique<Storage>::value>::type MakeUnique( Storage& ) {}
+
+    // Storage that shares parts with copies has a version(), that changes when pointers into it may have moved to another copy
+    template< typename Storage, typename = void >
+    struct HasVersion : std::false_type {};
+    template< typename Storage >
+    struct HasVersion<Storage, decltype((void)std::declval<const Storage&>().version())> : std::true_type {};
+
+    template< typename Storage >
+    typename std::enable_if<HasVersion<Storage>::value, uint32_t>::type StorageVersion( const Storage &storage ) {
+        return storage.version();
+    }
+    template< typename Storage >
+    typename std::enable_if<!HasVersion<Storage>::value, uint32_t>::type StorageVersion( const Storage& ) {
+        return 0;
+    }
+}
+
+// Selects how a HandleVector stores its values
+namespace HandleVectorStorage
+{
+    // All values are stored in a single std::vector, 
+    //  growing may reallocate and move every value (invalidating pointers from find)
+    struct Contiguous {
+        template< typename Type >
+        using type = std::vector<Type>;
+    };
+
+    // Values are stored in fixed size chunks that are allocated on demand,
+    //  growing never moves values, so pointers from find stays valid until the value is free'd
+    template< size_t ChunkSize = 1024 >
+    struct Chunked {
+        template< typename Type >
+        using type = Common::ChunkedArray<Type, ChunkSize>;
+    };
+
+    // Like Chunked, but copies shares the chunks and a chunk is cloned the first time it is written (see SharedChunkedArray),
+    //  so copying the vector is O(chunks). Pointers from the non-const find are only valid until the vector is copied.
+    template< size_t ChunkSize = 1024 >
+    struct SharedChunked {
+        template< typename Type >
+        using type = Common::SharedChunkedArray<Type, ChunkSize>;
+    };
+}
+
+// Handles packs a index, a generation and data bits into Handle::underlaying_type.
+//  By default 8 bits are used for the generation (32 bits for 64 bit handles), 
+//  so a slot can be reused 2^GenerationBits times before a stale handle becomes valid again.
+//  With RetireSaturatedSlots_ a slot is retired (never reused) once its generation saturates instead,
+//  so stale handles never becomes valid again, at the cost of slowly growing the vector.
+template< typename Handle, typename Value, unsigned GenerationBits_=HANDLE_VECTOR_DEFAULT, unsigned DataBits_=HANDLE_VECTOR_DEFAULT, typename Handle::underlaying_type DataValue_=0, bool ManualHandels_=false, typename Storage_=HandleVectorStorage::Contiguous, bool RetireSaturatedSlots_=false > 
 class HandleVector {
 public:
     using underlaying_type = typename Handle::underlaying_type;
     using key_vector = std::vector<underlaying_type>;
+    using storage_type = Storage_;
+    using value_type = Value;
     
     static constexpr const unsigned TypeBits = CHAR_BIT * sizeof (underlaying_type);
-    static constexpr const unsigned GenerationBits = (GenerationBits_ == HANDLE_VECTOR_DEFAULT) ? 8 : GenerationBits_;
+    static constexpr const unsigned GenerationBits = (GenerationBits_ == HANDLE_VECTOR_DEFAULT) ? (TypeBits >= 64 ? 32 : 8) : GenerationBits_;
     static constexpr const unsigned DataBits = (DataBits_ == HANDLE_VECTOR_DEFAULT) ? 1 : DataBits_;
     static constexpr const unsigned IndexBits = TypeBits - GenerationBits - DataBits;
     static constexpr const bool ManualHandles = ManualHandels_;
+    static constexpr const bool RetireSaturatedSlots = RetireSaturatedSlots_;
+
+    static constexpr const underlaying_type IndexMask = HandleVectorInternal::LowBitMask<underlaying_type>(IndexBits);
+    static constexpr const underlaying_type GenerationMask = HandleVectorInternal::LowBitMask<underlaying_type>(GenerationBits);
+    static constexpr const underlaying_type DataMask = HandleVectorInternal::LowBitMask<underlaying_type>(DataBits);
 
-    static constexpr const size_t MaxValues = (1 << IndexBits)-1;
-    static constexpr const underlaying_type IndexMask = (1 << IndexBits) - 1;
-    static constexpr const underlaying_type GenerationMask = (1 << GenerationBits) - 1;
-    static constexpr const underlaying_type DataMask = (1 << DataBits) -1;
+    // Index 0 is reserved for the null handle
+    static constexpr const size_t MaxValues = (uint64_t)IndexMask > (uint64_t)SIZE_MAX ? SIZE_MAX : (size_t)IndexMask;
 
     static constexpr const underlaying_type DataValue = DataValue_ & DataMask;
 
@@ -36,12 +120,21 @@ public:
     static_assert ((GenerationBits+DataBits) < TypeBits, "Invalid number of GenerationBits and DataBits!");
     static_assert ((DataValue_&~DataMask) == 0 || DataValue_ == HANDLE_VECTOR_DEFAULT, "Invalid DataValue, doesn't match the specifed DataBits!");
     static_assert (DataBits > 0, "Atleast 1 DataBit is neaded!, (for internal bookkepping)");
+    static_assert (std::is_unsigned<underlaying_type>::value, "Handle must have a unsigned underlaying_type");
+    static_assert (((IndexMask << IndexOffset) & (GenerationMask << GenerationOffset)) == 0 &&
+                   ((IndexMask << IndexOffset) & (DataMask << DataOffset)) == 0 &&
+                   ((GenerationMask << GenerationOffset) & (DataMask << DataOffset)) == 0, "Index, generation and data bits overlap!");
+    static_assert (!(RetireSaturatedSlots_ && ManualHandels_), "Slot retirement isn't supported with manual handles");
 
 
     static constexpr bool IsHandleFromThis(Handle handle) {
         return GetData(handle) == DataValue;
     }
-    
+    // The slot of a handle from this container, in [0, underlying_size()), for side tables indexed by slot
+    static constexpr size_t SlotIndex(Handle handle) {
+        return size_t(GetIndex(handle)) - 1;
+    }
+
 
     template< typename Type >
     class IteratorBase;
@@ -85,10 +178,20 @@ private:
     static constexpr bool IsHandleFree( Handle handle ) {
         return GetData(handle) == FreeDataValue;
     }
+    // A slot is retired if its generation has saturated, it is then never put back on the free list
+    static constexpr bool IsSlotRetired( Handle handle ) {
+        return RetireSaturatedSlots && GetGeneration(handle) == GenerationMask;
+    }
 
     struct ValuePairStorage {
         Handle handle = CreateHandle(0, 0, FreeDataValue);
         std::aligned_union_t<0, Value> storage;
+
+        // The handle and value are copied & moved by the mixins below,
+        //  copying the raw storage here would overwrite the value they assign to
+        ValuePairStorage() = default;
+        ValuePairStorage( const ValuePairStorage& ) {}
+        ValuePairStorage& operator = ( const ValuePairStorage& ) { return *this; }
         
         ~ValuePairStorage() noexcept(std::is_nothrow_destructible_v<Value>) {
             if (isValid()) {
@@ -175,7 +278,7 @@ private:
             else if (base->isValid()) {
                 base->destroy();
             }
-            else {
+            else if (other->isValid()) {
                 base->construct(*other->value());
             }
             base->handle = other->handle;
@@ -251,7 +354,7 @@ private:
             else if (base->isValid()) {
                 base->destroy();
             }
-            else {
+            else if (other->isValid()) {
                 base->construct(std::move(*other->value()));
             }
             base->handle = other->handle;
@@ -305,11 +408,16 @@ private:
 
         ~ValuePair() = default;
     };
-    using value_vector = std::vector<ValuePair>;
+    using value_vector = typename Storage_::template type<ValuePair>;
     
 public:
     HandleVector() = default;
     ~HandleVector() = default;
+
+    // Only avalible for storage types that supports allocators (ex HandleVectorStorage::Chunked)
+    explicit HandleVector( Common::IAllocator *allocator ) :
+        mValues(allocator)
+    {}
     
     HandleVector( const HandleVector &copy ) = default;
     HandleVector( HandleVector &&move ) = default;
@@ -333,15 +441,28 @@ public:
     }
 
     Value* find( Handle handle ) {
-        return const_cast<Value*>(
-            findValue(handle)
-        );
+        const ValuePair *data = nullptr;
+        if (!validate(handle, data)) return nullptr;
+        // Looked up again through the non-const storage, so copy on write storage gets a chance to clone the chunk
+        return mValues[GetIndex(handle)-1].value();
     }
     
     const Value* find( Handle handle ) const {
         return findValue(handle);
     }
 
+    // Clones the values that are shared with copies of the vector (only HandleVectorStorage::SharedChunked shares them),
+    //  this must be done before values are written from several threads (ex. with find from a parallelFor)
+    void makeUnique() {
+        HandleVectorInternal::MakeUnique(mValues);
+    }
+
+    // Changes when the values are shared by a copy, or a shared chunk is cloned (only HandleVectorStorage::SharedChunked shares them),
+    //  pointers from find that are kept must be looked up again when it does. Always 0 for the other storage types.
+    uint32_t storageVersion() const {
+        return HandleVectorInternal::StorageVersion(mValues);
+    }
+
     template< typename Func >
     Handle findIf( Func &&func ) const {
         for (const auto &entry : mValues) {
@@ -394,6 +515,68 @@ public:
         }
     }
     
+    // Runs func on all values in parallel, the slots are split into chunks of 'grainSize'
+    //  that is run on 'pool' (or the global pool), free slots are skipped within each chunk.
+    //  func is called concurrently, and the vector must not be modified until it returns.
+    template< typename Func >
+    void parallelForEach( Func &&func, size_t grainSize=1024, Common::ThreadPool *pool=nullptr ) {
+        parallelForEachWithHandle(
+            [&]( Handle, Value &value ) {
+                func(value);
+            }, 
+            grainSize, pool
+        );
+    }
+
+    template< typename Func >
+    void parallelForEach( Func &&func, size_t grainSize=1024, Common::ThreadPool *pool=nullptr ) const {
+        parallelForEachWithHandle(
+            [&]( Handle, const Value &value ) {
+                func(value);
+            }, 
+            grainSize, pool
+        );
+    }
+
+    template< typename Func >
+    void parallelForEachWithHandle( Func &&func, size_t grainSize=1024, Common::ThreadPool *pool=nullptr ) {
+        if (!pool) pool = &Common::ThreadPool::Global();
+        makeUnique();
+        pool->parallelFor(mValues.size(), grainSize, 
+            [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    auto &entry = mValues[i];
+                    if (IsHandleFree(entry.handle)) continue;
+                    func(entry.handle, *entry.value());
+                }
+            }
+        );
+    }
+
+    template< typename Func >
+    void parallelForEachWithHandle( Func &&func, size_t grainSize=1024, Common::ThreadPool *pool=nullptr ) const {
+        if (!pool) pool = &Common::ThreadPool::Global();
+        pool->parallelFor(mValues.size(), grainSize, 
+            [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    const auto &entry = mValues[i];
+                    if (IsHandleFree(entry.handle)) continue;
+                    func(entry.handle, *entry.value());
+                }
+            }
+        );
+    }
+
+    template< typename Func >
+    void parallelForEachHandle( Func &&func, size_t grainSize=1024, Common::ThreadPool *pool=nullptr ) const {
+        parallelForEachWithHandle(
+            [&]( Handle handle, const Value& ) {
+                func(handle);
+            }, 
+            grainSize, pool
+        );
+    }
+    
     Handle create( const Value &value ) {
         return emplace(value);
     }
@@ -408,8 +591,8 @@ public:
         if (mFreeListHead == 0) {
             if (mValues.size() >= MaxValues) return Handle();
 
-            Handle handle = CreateHandle(0, (underlaying_type)mValues.size()+1, DataValue);
-            mValues.push_back( ValuePair(handle,std::forward<Args>(args)...) );
+            Handle handle = CreateHandle(mNewSlotGeneration, (underlaying_type)mValues.size()+1, DataValue);
+            mValues.emplace_back(handle, std::forward<Args>(args)...);
             return handle;
         }
         
@@ -452,15 +635,14 @@ public:
         const ValuePair *tmp = nullptr;
         if (!validate(handle, tmp)) return false;
 
-        ValuePair *data = const_cast<ValuePair*>(tmp);
-
         underlaying_type index = GetIndex(handle);
+        ValuePair *data = &mValues[index-1];
         underlaying_type generation = GetGeneration(data->handle);
         data->handle = CreateHandle(generation, 0, FreeDataValue);
         data->destroy();
 
 
-        if (ManualHandles == false) {
+        if (ManualHandles == false && !IsSlotRetired(data->handle)) {
             // do we have a free list?
             if (mFreeListHead == 0) { // if not create one
                 mFreeListHead = index;
@@ -476,34 +658,297 @@ public:
         return true;
     }
 
+    // Creates 'count' values, each constructed from 'args', and writes the handles to 'out'.
+    //  Free slots are reused first (the free list is unlinked once), the rest is
+    //  appended as one contiguous range after reserving room for it.
+    //  Returns the number of handles created, less than count if MaxValues is reached.
+    template< typename ...Args, bool Manual = ManualHandles >
+    typename std::enable_if<Manual == false, size_t>::type
+    createN( size_t count, Handle *out, const Args&... args ) {
+        size_t created = 0;
+
+        // Reuse free slots
+        underlaying_type head = mFreeListHead;
+        while (head != 0 && created < count) {
+            ValuePair &entry = mValues[head-1];
+
+            underlaying_type index = head;
+            underlaying_type generation = GetGeneration(entry.handle);
+            head = GetIndex(entry.handle);
+
+            try {
+                entry.construct(args...);
+            }
+            catch (...) {
+                // The slot is still linked to the rest of the popped slots, so they all goes back on the free list
+                mFreeListHead = index;
+                throw;
+            }
+            entry.handle = CreateHandle(generation+1, index, DataValue);
+            out[created++] = entry.handle;
+        }
+        mFreeListHead = head;
+
+        if (created == count) return created;
+
+        // Append the remaining values
+        size_t remaining = count - created;
+        if (mValues.size() + remaining > MaxValues) {
+            remaining = MaxValues - mValues.size();
+        }
+        mValues.reserve(mValues.size() + remaining);
+
+        for (size_t i=0; i < remaining; ++i) {
+            Handle handle = CreateHandle(mNewSlotGeneration, (underlaying_type)mValues.size()+1, DataValue);
+            mValues.emplace_back(handle, args...);
+            out[created++] = handle;
+        }
+        return created;
+    }
+
+    // Free's 'count' handles, invalid handles are ignored.
+    //  The free'd slots are linked together first, and then appended to the free list in one step.
+    //  Returns the number of handles free'd.
+    size_t freeN( const Handle *handles, size_t count ) {
+        underlaying_type first = 0,
+                         last = 0;
+        size_t freed = 0;
+
+        for (size_t i=0; i < count; ++i) {
+            const ValuePair *tmp = nullptr;
+            if (!validate(handles[i], tmp)) continue;
+
+            underlaying_type index = GetIndex(handles[i]);
+            ValuePair *data = &mValues[index-1];
+            underlaying_type generation = GetGeneration(data->handle);
+            data->handle = CreateHandle(generation, 0, FreeDataValue);
+            data->destroy();
+            freed++;
+
+            if (ManualHandles == false && !IsSlotRetired(data->handle)) {
+                if (first == 0) {
+                    first = index;
+                }
+                else {
+                    ValuePair &prev = mValues[last-1];
+                    prev.handle = SetIndex(prev.handle, index);
+                }
+                last = index;
+            }
+        }
+
+        if (ManualHandles == false && first != 0) {
+            // splice the free'd slots onto the free list
+            if (mFreeListHead == 0) {
+                mFreeListHead = first;
+            }
+            else {
+                ValuePair &tail = mValues[mFreeListTail-1];
+                tail.handle = SetIndex(tail.handle, first);
+            }
+            mFreeListTail = last;
+        }
+        return freed;
+    }
+
+    // Makes sure that there is room for atleast 'count' values without reallocating
+    void reserve( size_t count ) {
+        mValues.reserve(count);
+    }
+
     // Free's all handles
+    //  The generations are kept, so handles from before the clear stays invalid
     void clear()
     {
-        if (mValues.empty()) return;
+        mFreeListHead = 0;
+        mFreeListTail = 0;
 
-        underlaying_type index = 1;
-        for (auto &entry : mValues) {
-            index++;
+        for (size_t i=0; i < mValues.size(); ++i) {
+            auto &entry = mValues[i];
             if (!IsHandleFree(entry.handle)) {
                 entry.destroy();
             }
-            
-            entry.handle = CreateHandle(0, index, FreeDataValue);
+
+            entry.handle = CreateHandle(GetGeneration(entry.handle), 0, FreeDataValue);
+            if (ManualHandles || IsSlotRetired(entry.handle)) continue;
+
+            underlaying_type index = (underlaying_type)i + 1;
+            if (mFreeListHead == 0) {
+                mFreeListHead = index;
+            }
+            else {
+                ValuePair &tail = mValues[mFreeListTail-1];
+                tail.handle = SetIndex(tail.handle, index);
+            }
+            mFreeListTail = index;
         }
+    }
 
-        if (ManualHandles == false) {
-            mFreeListHead = 1;
-            mFreeListTail = (underlaying_type)mValues.size();
-            mValues.back().handle = CreateHandle(0,0,FreeDataValue);
+    // Moves the values of 'order' (which must be valid) to the first 'count' slots, in that order,
+    //  other values are destroyed and the memory for the slots after them is released.
+    //  The new handles are written to 'out', the handles from before are invalid afterwards
+    //  (the slots get a new generation, so it counts as a reuse of them, and slots that are added later
+    //  starts above the generations of the released slots).
+    //  With RetireSaturatedSlots the slots with a saturated generation are skipped and stays retired,
+    //  so the values may not end up in the first 'count' slots.
+    template< bool Manual = ManualHandles >
+    typename std::enable_if<Manual == false>::type
+    compact( const Handle *order, size_t count, Handle *out ) {
+        size_t size = mValues.size();
+        std::vector<underlaying_type> generations(size);
+        for (size_t slot=0; slot < size; ++slot) {
+            generations[slot] = GetGeneration(mValues[slot].handle);
+        }
+        auto saturated = [&]( size_t slot ) {
+            return RetireSaturatedSlots && slot < size && generations[slot] == GenerationMask;
+        };
+
+        std::vector<underlaying_type> target(count);
+        size_t keep = 0;
+        for (size_t i=0; i < count; ++i, ++keep) {
+            while (saturated(keep)) ++keep;
+            target[i] = (underlaying_type)keep;
+        }
+        // Retired slots after the values are kept, as the slots added later would start at a saturated generation
+        for (size_t slot=keep; slot < size; ++slot) {
+            if (saturated(slot)) keep = slot + 1;
+        }
+
+        moveToSlots(order, target.data(), count, keep);
+        for (size_t i=0; i < count; ++i) {
+            underlaying_type slot = target[i];
+            underlaying_type generation = slot < size ? generations[slot] + 1 : mNewSlotGeneration;
+            mValues[slot].handle = CreateHandle(generation, slot+1, DataValue);
+            out[i] = mValues[slot].handle;
+        }
+
+        // The other slots that are kept are free, with the generation they had
+        std::vector<bool> isTarget(keep, false);
+        for (size_t i=0; i < count; ++i) {
+            isTarget[target[i]] = true;
+        }
+        for (size_t slot=0; slot < keep; ++slot) {
+            if (isTarget[slot]) continue;
+            ValuePair &entry = mValues[slot];
+            entry.handle = CreateHandle(slot < size ? generations[slot] : mNewSlotGeneration, 0, FreeDataValue);
+            if (IsSlotRetired(entry.handle)) continue;
+
+            underlaying_type index = (underlaying_type)slot + 1;
+            if (mFreeListHead == 0) {
+                mFreeListHead = index;
+            }
+            else {
+                ValuePair &tail = mValues[mFreeListTail-1];
+                tail.handle = SetIndex(tail.handle, index);
+            }
+            mFreeListTail = index;
+        }
+
+        // Stale handles to the released slots must stay invalid when the slots are added again
+        for (size_t slot=keep; slot < size; ++slot) {
+            underlaying_type generation = (generations[slot] + 1) & GenerationMask;
+            mNewSlotGeneration = std::max(mNewSlotGeneration, generation);
         }
     }
 
+    // The same as compact for manual handles, the value of order[i] gets the handle handles[i] (which must have the index i+1).
+    //  Used to keep a vector in sync with another that was compacted.
+    template< bool Manual = ManualHandles >
+    typename std::enable_if<Manual == true>::type
+    relocate( const Handle *order, const Handle *handles, size_t count ) {
+        std::vector<underlaying_type> target(count);
+        for (size_t i=0; i < count; ++i) {
+            assert(GetIndex(handles[i]) == i+1 && IsHandleFromThis(handles[i]));
+            target[i] = (underlaying_type)i;
+        }
+        moveToSlots(order, target.data(), count, count);
+        for (size_t i=0; i < count; ++i) {
+            mValues[i].handle = handles[i];
+        }
+    }
+
+    // Verbatim copies of the slots, for storing the vector in a flat binary format (Value must be trivially copyable).
+    //  Writes underlying_size() handles (as underlaying_type) to 'handles' and values to 'values', the values of free slots are zeroed.
+    //  The free list is linked through the handles of the free slots, its ends are written to 'freeListHead' & 'freeListTail'.
+    //  'newSlotGeneration' is the generation slots that are appended starts at (raised by compact), it must be loaded too.
+    //  The destination doesn't have to be aligned.
+    void saveSlots( void *handles, void *values, underlaying_type &freeListHead, underlaying_type &freeListTail, underlaying_type &newSlotGeneration ) const {
+        static_assert(std::is_trivially_copyable_v<Value>, "saveSlots requires a trivially copyable Value");
+
+        uint8_t *handleOut = static_cast<uint8_t*>(handles),
+                *valueOut = static_cast<uint8_t*>(values);
+        for (size_t i=0; i < mValues.size(); ++i) {
+            const ValuePair &entry = mValues[i];
+            underlaying_type handle = (underlaying_type)entry.handle;
+            memcpy(handleOut + i*sizeof(underlaying_type), &handle, sizeof(underlaying_type));
+            if (entry.isValid()) {
+                memcpy(valueOut + i*sizeof(Value), entry.value(), sizeof(Value));
+            }
+            else {
+                memset(valueOut + i*sizeof(Value), 0, sizeof(Value));
+            }
+        }
+        freeListHead = mFreeListHead;
+        freeListTail = mFreeListTail;
+        newSlotGeneration = mNewSlotGeneration;
+    }
+
+    // Replaces the content with 'count' slots from saveSlots of a vector with the same type, the handles of that vector are valid in this one.
+    //  The slots are verified first (the handles must match their index, and the free list must link free slots from head to tail),
+    //  returns false and leaves the vector empty if they are inconsistent, ex. if they come from a corrupt file.
+    bool loadSlots( const void *handles, const void *values, size_t count, underlaying_type freeListHead, underlaying_type freeListTail, underlaying_type newSlotGeneration ) {
+        static_assert(std::is_trivially_copyable_v<Value>, "loadSlots requires a trivially copyable Value");
+
+        mValues.clear();
+        mFreeListHead = 0;
+        mFreeListTail = 0;
+        mNewSlotGeneration = 0;
+
+        const uint8_t *handleIn = static_cast<const uint8_t*>(handles),
+                      *valueIn = static_cast<const uint8_t*>(values);
+        auto handleAt = [&]( size_t i ) {
+            underlaying_type handle;
+            memcpy(&handle, handleIn + i*sizeof(underlaying_type), sizeof(underlaying_type));
+            return Handle(handle);
+        };
+
+        // The tail is stale once the list has been emptied
+        if (freeListHead == 0) freeListTail = 0;
+        if (count > MaxValues || freeListHead > count || freeListTail > count) return false;
+        if (ManualHandles && freeListHead != 0) return false;
+        if (newSlotGeneration > GenerationMask) return false;
+
+        for (size_t i=0; i < count; ++i) {
+            Handle handle = handleAt(i);
+            if (IsHandleFree(handle) ? GetIndex(handle) > count : (GetIndex(handle) != i+1 || !IsHandleFromThis(handle))) return false;
+        }
+        // Every step must land on a free slot, so a cycle is caught after 'count' steps
+        size_t steps = 0;
+        for (underlaying_type index = freeListHead; index != 0; index = GetIndex(handleAt(index-1))) {
+            if (!IsHandleFree(handleAt(index-1)) || ++steps > count) return false;
+            if ((GetIndex(handleAt(index-1)) == 0) != (index == freeListTail)) return false;
+        }
+
+        mValues.resize(count);
+        for (size_t i=0; i < count; ++i) {
+            ValuePair &entry = mValues[i];
+            entry.handle = handleAt(i);
+            if (entry.isValid()) {
+                memcpy(entry.value(), valueIn + i*sizeof(Value), sizeof(Value));
+            }
+        }
+        mFreeListHead = freeListHead;
+        mFreeListTail = freeListTail;
+        mNewSlotGeneration = newSlotGeneration;
+        return true;
+    }
+
     bool valid( Handle handle )const  {
         const ValuePair *data = nullptr;
         return validate(handle, data);
     }
 
-    size_t underlying_size() {
+    size_t underlying_size() const {
         return mValues.size();
     }
 
@@ -543,7 +988,12 @@ public:
             mIter(iter),
             mBeg(beg),
             mEnd(end)
-        {}
+        {
+            // Start on a used slot, the first ones may have been free'd
+            while (mIter != mEnd && IsHandleFree(mIter->handle)) {
+                ++mIter;
+            }
+        }
 
         const Handle& handle() const {
             return mIter->handle;
@@ -599,15 +1049,87 @@ private:
 
     const Value* findValue( Handle handle ) const {
         const ValuePair *data = nullptr;
-        if (!validate(handle, data)) return false;
+        if (!validate(handle, data)) return nullptr;
         return data->value();
     }
+
+    // Permutes the slots in place so the value of order[i] ends up in slot target[i] (the targets must be unique),
+    //  the other values are destroyed and the slots after 'size' are dropped. The free list is emptied,
+    //  and the handles of the first 'size' slots are left for the caller to set.
+    void moveToSlots( const Handle *order, const underlaying_type *target, size_t count, size_t size ) {
+        size_t total = std::max(size, mValues.size());
+        mValues.resize(total);
+
+        // source[slot] is the slot that is moved to 'slot', the slots that aren't in 'order' fills the rest
+        std::vector<underlaying_type> source(total);
+        std::vector<bool> used(total, false),
+                          isTarget(total, false);
+        for (size_t i=0; i < count; ++i) {
+            assert(valid(order[i]));
+            underlaying_type slot = GetIndex(order[i]) - 1;
+            assert(!used[slot] && !isTarget[target[i]]);
+            source[target[i]] = slot;
+            used[slot] = true;
+            isTarget[target[i]] = true;
+        }
+        size_t next = 0;
+        for (size_t slot=0; slot < total; ++slot) {
+            if (isTarget[slot]) continue;
+            while (used[next]) ++next;
+            source[slot] = (underlaying_type)next;
+            used[next] = true;
+        }
+
+        // Follow each cycle of the permutation, so every value is only moved once
+        std::vector<bool> done(total, false);
+        for (size_t start=0; start < total; ++start) {
+            if (done[start]) continue;
+            done[start] = true;
+            if (source[start] == start) continue;
+
+            ValuePair tmp(std::move(mValues[start]));
+            size_t slot = start;
+            while (source[slot] != start) {
+                mValues[slot] = std::move(mValues[source[slot]]);
+                slot = source[slot];
+                done[slot] = true;
+            }
+            mValues[slot] = std::move(tmp);
+        }
+
+        for (size_t slot=0; slot < size; ++slot) {
+            ValuePair &entry = mValues[slot];
+            if (isTarget[slot] || !entry.isValid()) continue;
+            entry.destroy();
+            entry.handle = CreateHandle(0, 0, FreeDataValue);
+        }
+
+        mValues.resize(size);
+        mValues.shrink_to_fit();
+        mFreeListHead = 0;
+        mFreeListTail = 0;
+    }
 private:
     value_vector mValues;
     underlaying_type mFreeListHead = 0,
                      mFreeListTail = 0;
+    // The generation of slots that are appended, above the generations of the slots that compact has released
+    underlaying_type mNewSlotGeneration = 0;
 };
 
 
-template< typename Handle, typename Value, unsigned GenerationBits_=HANDLE_VECTOR_DEFAULT, unsigned DataBits_=HANDLE_VECTOR_DEFAULT, typename Handle::underlaying_type DataValue_=0>
-using ManuelHandleVector = HandleVector<Handle, Value, GenerationBits_, DataBits_, DataValue_, true>;
\ No newline at end of file
+template< typename Handle, typename Value, unsigned GenerationBits_=HANDLE_VECTOR_DEFAULT, unsigned DataBits_=HANDLE_VECTOR_DEFAULT, typename Handle::underlaying_type DataValue_=0, typename Storage_=HandleVectorStorage::Contiguous>
+using ManuelHandleVector = HandleVector<Handle, Value, GenerationBits_, DataBits_, DataValue_, true, Storage_>;
+
+// HandleVector where pointers returned from find are stable (values are never moved when the vector grows)
+template< typename Handle, typename Value, size_t ChunkSize=1024 >
+using ChunkedHandleVector = HandleVector<Handle, Value, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, HandleVectorStorage::Chunked<ChunkSize>>;
+
+// ChunkedHandleVector where copies shares the chunks until they are written (copying is O(chunks))
+template< typename Handle, typename Value, size_t ChunkSize=1024 >
+using SharedChunkedHandleVector = HandleVector<Handle, Value, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, HandleVectorStorage::SharedChunked<ChunkSize>>;
+
+// HandleVector for long running systems where a stale handle must never become valid again,
+//  uses 64 bit handles with 32 generation bits, and retires slots once their generation saturates
+template< typename Handle, typename Value, typename Storage_=HandleVectorStorage::Contiguous >
+using WideHandleVector = HandleVector<Handle, Value, 32, 1, 0, false, Storage_, true>;
\ No newline at end of file
@@ -51,10 +51,16 @@ namespace Common
             decltype(auto) operator* () {
                 return adopter()->dereference();
             }
+            decltype(auto) operator* () const {
+                return adopter()->dereference();
+            }
 
             decltype(auto) operator -> () {
                 return _derefernce_must_return_a_reference_for_operator_pointer_to_work(adopter());
             }
+            decltype(auto) operator -> () const {
+                return _derefernce_must_return_a_reference_for_operator_pointer_to_work(adopter());
+            }
 
             Adopter& operator ++ () {
                 adopter()->increment();
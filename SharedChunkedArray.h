@@ -0,0 +1,405 @@
+#pragma once
+
+#include "IAllocator.h"
+#include "IteratorAdopter.h"
+
+#include <vector>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+namespace Common
+{
+    // A copy on write version of ChunkedArray.
+    //  Copying the array only copies the chunk table and shares the chunks (O(chunks) instead of O(size)),
+    //  a shared chunk is cloned the first time it is written through a array that shares it.
+    //  So a copy works as a cheap snapshot, and edits only clones the chunks they touch.
+    //
+    // Writes are any non-const access (operator [], back, the iterators) and emplace_back/pop_back,
+    //  so pointers and references from a non-const access are only valid until the array is copied.
+    //  Pointers from a const access are only valid until the chunk is cloned, version() changes
+    //  on both, so pointers that are kept can be looked up again when it does.
+    //
+    // The chunks are reference counted with atomics, and a shared chunk is never written,
+    //  so different arrays sharing chunks can be used (and destroyed) on different threads.
+    //  A single array is still not thread safe, and writing to it from several threads
+    //  (ex. different elements from a parallelFor) requires a call to makeUnique() first.
+    //
+    // The chunks can optionally be allocated from a IAllocator (the same rules as for ChunkedArray),
+    //  copies uses the same allocator.
+    template< typename Type, size_t ChunkSize_ = 1024 >
+    class SharedChunkedArray {
+    public:
+        static constexpr const size_t ChunkSize = ChunkSize_;
+        static constexpr const size_t ChunkBytes = ChunkSize * sizeof(Type);
+
+        static_assert(ChunkSize > 0, "ChunkSize must be atleast 1");
+        static_assert(alignof(Type) <= alignof(std::max_align_t), "Over aligned types isn't supported");
+
+        using value_type = Type;
+
+        template< typename Value >
+        class IteratorBase;
+
+        using iterator = IteratorBase<Type>;
+        using const_iterator = IteratorBase<const Type>;
+
+    public:
+        SharedChunkedArray() = default;
+        explicit SharedChunkedArray( IAllocator *allocator ) :
+            mAllocator(allocator)
+        {}
+
+        ~SharedChunkedArray() {
+            clear();
+            shrink_to_fit();
+        }
+
+        // Shares the used chunks of 'copy', unused chunks (capacity) is never shared
+        SharedChunkedArray( const SharedChunkedArray &copy ) :
+            mSize(copy.mSize),
+            mAllocator(copy.mAllocator)
+        {
+            size_t used = UsedChunks(copy.mSize);
+            mChunks.reserve(used);
+            for (size_t i=0; i < used; ++i) {
+                Type *chunk = copy.mChunks[i];
+                header(chunk)->references.fetch_add(1, std::memory_order_relaxed);
+                mChunks.push_back(chunk);
+            }
+            copy.mVersion.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        SharedChunkedArray( SharedChunkedArray &&move ) noexcept {
+            swap(move);
+        }
+
+        SharedChunkedArray& operator = ( const SharedChunkedArray &copy ) {
+            if (this == &copy) return *this;
+
+            SharedChunkedArray tmp(copy);
+            swap(tmp);
+            return *this;
+        }
+
+        SharedChunkedArray& operator = ( SharedChunkedArray &&move ) noexcept {
+            SharedChunkedArray tmp(std::move(move));
+            swap(tmp);
+            return *this;
+        }
+
+        void swap( SharedChunkedArray &other ) noexcept {
+            std::swap(mChunks, other.mChunks);
+            std::swap(mSize, other.mSize);
+            std::swap(mAllocator, other.mAllocator);
+            mVersion.fetch_add(1, std::memory_order_relaxed);
+            other.mVersion.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    public:
+        size_t size() const {
+            return mSize;
+        }
+
+        bool empty() const {
+            return mSize == 0;
+        }
+
+        size_t capacity() const {
+            return mChunks.size() * ChunkSize;
+        }
+
+        size_t chunkCount() const {
+            return mChunks.size();
+        }
+
+        // The number of chunks that is shared with another array
+        size_t sharedChunkCount() const {
+            size_t count = 0;
+            for (Type *chunk : mChunks) {
+                if (isShared(chunk)) count++;
+            }
+            return count;
+        }
+
+        IAllocator* allocator() const {
+            return mAllocator;
+        }
+
+        // Changes when the chunks are shared by a copy or a shared chunk is cloned,
+        //  the pointers to the elements from before may then point into another array's chunk
+        uint32_t version() const {
+            return mVersion.load(std::memory_order_relaxed);
+        }
+
+        Type& operator [] ( size_t idx ) {
+            assert (idx < mSize);
+            return writableChunk(idx / ChunkSize)[idx % ChunkSize];
+        }
+        const Type& operator [] ( size_t idx ) const {
+            assert (idx < mSize);
+            return mChunks[idx / ChunkSize][idx % ChunkSize];
+        }
+
+        Type& front() {
+            return (*this)[0];
+        }
+        const Type& front() const {
+            return (*this)[0];
+        }
+
+        Type& back() {
+            return (*this)[mSize-1];
+        }
+        const Type& back() const {
+            return (*this)[mSize-1];
+        }
+
+        // Clones all shared chunks, after this the array can be written from several threads at once
+        //  (as long as they write different elements) until it is copied again
+        void makeUnique() {
+            size_t used = UsedChunks(mSize);
+            for (size_t i=0; i < used; ++i) {
+                writableChunk(i);
+            }
+        }
+
+        // Makes sure that there is room for atleast 'count' elements
+        void reserve( size_t count ) {
+            while (capacity() < count) {
+                Type *chunk = allocateChunk();
+                try {
+                    mChunks.push_back(chunk);
+                }
+                catch (...) {
+                    releaseChunk(chunk, 0);
+                    throw;
+                }
+            }
+        }
+
+        template< typename... Args >
+        Type& emplace_back( Args&&... args ) {
+            reserve(mSize+1);
+
+            Type *ptr = &writableChunk(mSize / ChunkSize)[mSize % ChunkSize];
+            new (ptr) Type(std::forward<Args>(args)...);
+            mSize++;
+            return *ptr;
+        }
+
+        void push_back( const Type &value ) {
+            emplace_back(value);
+        }
+        void push_back( Type &&value ) {
+            emplace_back(std::move(value));
+        }
+
+        void pop_back() {
+            assert (mSize > 0);
+            back().~Type();
+            mSize--;
+        }
+
+        void resize( size_t count ) {
+            reserve(count);
+            while (mSize < count) {
+                emplace_back();
+            }
+            while (mSize > count) {
+                pop_back();
+            }
+        }
+
+        // Destroys all elements, but keep the chunks that isn't shared.
+        //  Shared chunks are released without being cloned.
+        void clear() {
+            std::vector<Type*> kept;
+            for (size_t i=0; i < mChunks.size(); ++i) {
+                Type *chunk = mChunks[i];
+                size_t count = ChunkElements(mSize, i);
+                if (isShared(chunk)) {
+                    releaseChunk(chunk, count);
+                    continue;
+                }
+
+                DestroyElements(chunk, count);
+                kept.push_back(chunk);
+            }
+            mChunks.swap(kept);
+            mSize = 0;
+        }
+
+        // Releases chunks that aren't used
+        void shrink_to_fit() {
+            size_t used = UsedChunks(mSize);
+            while (mChunks.size() > used) {
+                releaseChunk(mChunks.back(), 0);
+                mChunks.pop_back();
+            }
+        }
+
+        iterator begin() {
+            return iterator(this, 0);
+        }
+        iterator end() {
+            return iterator(this, mSize);
+        }
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+        const_iterator end() const {
+            return const_iterator(this, mSize);
+        }
+
+    public:
+        template< typename Value >
+        class IteratorBase :
+            public IteratorAdopter<IteratorBase<Value>, Value, std::random_access_iterator_tag>
+        {
+            using array_type = typename std::conditional<
+                                   std::is_const<Value>::value,
+                                   const SharedChunkedArray,
+                                   SharedChunkedArray
+                               >::type;
+
+            array_type *mArray = nullptr;
+            size_t mIndex = 0;
+
+        public:
+            IteratorBase() = default;
+            IteratorBase( const IteratorBase& ) = default;
+            IteratorBase& operator = ( const IteratorBase& ) = default;
+
+            IteratorBase( array_type *array, size_t index ) :
+                mArray(array),
+                mIndex(index)
+            {}
+
+            size_t index() const {
+                return mIndex;
+            }
+
+            Value& dereference() const {
+                return (*mArray)[mIndex];
+            }
+
+            bool equal( const IteratorBase &other ) const {
+                return mIndex == other.mIndex;
+            }
+
+            void increment() {
+                ++mIndex;
+            }
+            void decrement() {
+                --mIndex;
+            }
+            void advance( ptrdiff_t n ) {
+                mIndex += n;
+            }
+            ptrdiff_t distance( const IteratorBase &other ) const {
+                return ptrdiff_t(other.mIndex) - ptrdiff_t(mIndex);
+            }
+        };
+
+    private:
+        // Placed in front of the elements of each chunk
+        struct ChunkHeader {
+            std::atomic<size_t> references;
+        };
+        static constexpr const size_t HeaderBytes = (sizeof(ChunkHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+        static constexpr size_t UsedChunks( size_t size ) {
+            return (size + ChunkSize - 1) / ChunkSize;
+        }
+        // The number of constructed elements in chunk 'chunk' of a array with 'size' elements,
+        //  all arrays that shares a chunk agrees on this as any change to the chunk clones it first
+        static constexpr size_t ChunkElements( size_t size, size_t chunk ) {
+            return size <= chunk * ChunkSize ? 0 :
+                   size - chunk * ChunkSize < ChunkSize ? size - chunk * ChunkSize : ChunkSize;
+        }
+
+        static void DestroyElements( Type *chunk, size_t count ) {
+            for (size_t i=0; i < count; ++i) {
+                chunk[i].~Type();
+            }
+        }
+
+        static ChunkHeader* header( Type *chunk ) {
+            return reinterpret_cast<ChunkHeader*>(reinterpret_cast<char*>(chunk) - HeaderBytes);
+        }
+
+        static bool isShared( Type *chunk ) {
+            return header(chunk)->references.load(std::memory_order_acquire) != 1;
+        }
+
+        // Clones chunk 'idx' if it is shared
+        Type* writableChunk( size_t idx ) {
+            Type *chunk = mChunks[idx];
+            if (!isShared(chunk)) return chunk;
+
+            size_t count = ChunkElements(mSize, idx);
+            Type *clone = allocateChunk();
+            size_t copied = 0;
+            try {
+                for (; copied < count; ++copied) {
+                    new (clone + copied) Type(chunk[copied]);
+                }
+            }
+            catch (...) {
+                DestroyElements(clone, copied);
+                releaseChunk(clone, 0);
+                throw;
+            }
+
+            releaseChunk(chunk, count);
+            mChunks[idx] = clone;
+            mVersion.fetch_add(1, std::memory_order_relaxed);
+            return clone;
+        }
+
+        Type* allocateChunk() {
+            void *memory = nullptr;
+            if (mAllocator) {
+                uintptr_t ptr = mAllocator->allocate(HeaderBytes + ChunkBytes);
+                if (ptr == IAllocator::NULL_PTR) {
+                    throw std::bad_alloc();
+                }
+                memory = reinterpret_cast<void*>(ptr);
+            }
+            else {
+                memory = ::operator new(HeaderBytes + ChunkBytes);
+            }
+            assert ((reinterpret_cast<uintptr_t>(memory) % alignof(Type)) == 0);
+
+            new (memory) ChunkHeader{{1}};
+            return reinterpret_cast<Type*>(static_cast<char*>(memory) + HeaderBytes);
+        }
+
+        // Drops this arrays reference to the chunk, the last reference destroys the 'count' elements and frees it
+        void releaseChunk( Type *chunk, size_t count ) {
+            ChunkHeader *h = header(chunk);
+            if (h->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+            DestroyElements(chunk, count);
+            h->~ChunkHeader();
+            if (mAllocator) {
+                mAllocator->free(reinterpret_cast<uintptr_t>(h));
+            }
+            else {
+                ::operator delete(h);
+            }
+        }
+
+    private:
+        std::vector<Type*> mChunks;
+        size_t mSize = 0;
+        IAllocator *mAllocator = nullptr;
+        // Bumped by copies of a const array too, different threads may copy it at once
+        mutable std::atomic<uint32_t> mVersion{0};
+    };
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Common/build_config.h"
+#include "Common/PImplHelper.h"
+
+#include <functional>
+#include <cstddef>
+
+namespace Common
+{
+    // A small pool of worker threads for data parallel loops.
+    //  A loop is split into chunks of 'grainSize' elements, every thread starts on its own
+    //  share of the chunks, and steals chunks from the other threads when it runs out.
+    //  The calling thread takes part in the work, so a pool without workers runs everything inline.
+    class ThreadPool {
+    public:
+        using RangeFunc = std::function<void(size_t begin, size_t end)>;
+
+        // The built-in pool, it is created on first use with one worker per hardware thread (excluding the caller)
+        static COMMON_API ThreadPool& Global();
+
+    public:
+        COMMON_API explicit ThreadPool( unsigned workerCount );
+        COMMON_API ~ThreadPool();
+
+        ThreadPool( const ThreadPool& ) = delete;
+        ThreadPool& operator = ( const ThreadPool& ) = delete;
+
+        // Number of threads that runs work, including the calling thread
+        COMMON_API unsigned threadCount() const;
+
+        // Calls func(begin, end) for consecutive ranges covering [0, count), and waits until all are done.
+        //  Each range is a whole chunk: begin is a multiple of grainSize and end is min(begin + grainSize, count)
+        //  (a grainSize of 0 is treated as 1), so begin / grainSize can index per chunk data.
+        //  Calls from inside a running loop (or while another thread uses the pool) runs inline, with the same ranges.
+        //  If func throws, the first exception is rethrown after all chunks has finished.
+        COMMON_API void parallelFor( size_t count, size_t grainSize, const RangeFunc &func );
+
+    private:
+        struct Impl;
+        PImplHelper<Impl, 512> mImpl;
+    };
+}
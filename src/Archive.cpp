@@ -1,7 +1,10 @@
 #include "Archive.h"
+#include "Archive.impl.h"
 #include "ErrorUtils.h"
 #include "HandleVector.h"
 #include "FileUtils.h"
+#include "HashTable.h"
+#include "ThreadPool.h"
 
 #include "lz4hc.h"
 #include "lz4frame.h"
@@ -10,22 +13,11 @@
 #include <fstream>
 #include <algorithm>
 #include <string>
+#include <memory>
 #include <cassert>
 
 namespace Common
 {
-#define ARCHIVE_SIGNATURE "Zodiac Archive"
-#define ARCHIVE_SIGNATURE_LEN sizeof(ARCHIVE_SIGNATURE)
-
-    static const int ArchiveVersion = 1;
-
-
-    struct ArchiveHeader {
-        uint8_t sig[ARCHIVE_SIGNATURE_LEN] = ARCHIVE_SIGNATURE;
-        uint32_t version = ArchiveVersion;
-        uint32_t fileCount = 0;
-    };
-
     struct Archive::Impl {
         virtual ~Impl() = default;
         
@@ -53,6 +45,30 @@ namespace Common
             return "";
         }
 
+        // Copies the range from the mapped file
+        virtual bool readRange( ArchiveFileHandle handle, uint64_t offset, size_t size, void *out )
+        {
+            size_t fileSize = this->fileSize(handle);
+            if (offset > fileSize || size > fileSize - offset) return false;
+
+            const void *data = mapFile(handle);
+            if (!data) return false;
+
+            memcpy(out, static_cast<const uint8_t*>(data) + offset, size);
+            return true;
+        }
+
+        // Opens and maps the files one by one
+        virtual size_t prefetch( const std::string *names, size_t count, ArchiveFileHandle *handles, ThreadPool *pool )
+        {
+            size_t loaded = 0;
+            for (size_t i=0; i < count; ++i) {
+                handles[i] = openFile(names[i]);
+                if (handles[i] && mapFile(handles[i])) loaded++;
+            }
+            return loaded;
+        }
+
         template< typename Type >
         static Archive CreateArchive( Type &&impl )
         {
@@ -69,7 +85,7 @@ namespace Common
     namespace Directory
     {
         struct FileHandleInfo {
-            std::string content;
+            std::unique_ptr<FileUtils::FileMapping, MappingDeleter> mapping;
         };
 
         struct Impl :
@@ -87,7 +103,13 @@ namespace Common
                 }
 
                 FileHandleInfo info;
-                info.content = FileUtils::getFileContent(fullPath, true);
+                try {
+                    info.mapping.reset(FileUtils::mapFile(fullPath));
+                }
+                catch (const std::exception &e) {
+                    LOG_ERROR("Failed to map file \"%s\": %s", fullPath.c_str(), e.what());
+                    return ArchiveFileHandle {};
+                }
                 return fileHandles.create(std::move(info));
             }
 
@@ -101,7 +123,7 @@ namespace Common
                 const FileHandleInfo *info = fileHandles.find(handle);
                 if (!info) return 0;
                 
-                return info->content.size();
+                return info->mapping->size;
             }
 
             virtual const void* mapFile( ArchiveFileHandle handle ) override
@@ -109,7 +131,7 @@ namespace Common
                 const FileHandleInfo *info = fileHandles.find(handle);
                 if (!info) return nullptr;
 
-                return info->content.data();
+                return info->mapping->ptr;
             }
 
             virtual const char* name() override
@@ -316,13 +338,424 @@ namespace Common
         };
     }
     
+    // Version 2 maps the archive and only reads the file table when the archive is opened (the layout is in Archive.impl.h).
+    //  Compressed files are decompressed from the mapping the first time they are mapped, and released once the last handle to them is closed.
+    //  Stored files are used straight from the mapping.
+    //  The names are indexed by a hash table when the archive is opened, so openFile doesn't search the table.
+    namespace Ver2 {
+        static const uint32_t NO_FILE = ~0u;
+
+        // The decompressed data of a file, kept while there are handles to it.
+        //  Prefetched files shares a buffer, it is released with the last file in it
+        struct CachedFile {
+            std::shared_ptr<const uint8_t> data;
+            uint32_t handles = 0;
+            bool loaded = false;
+            // Stored files are served from the mapping, so their checksum is only verified once
+            bool verified = false;
+        };
+
+        struct FileHandleInfo {
+            uint32_t file;
+        };
+
+        struct Impl :
+            public Archive::Impl
+        {
+            Impl() = default;
+            Impl(Impl&&) = default;
+
+            std::string path;
+            // The whole archive is mapped, the file table, the names and the stored files are used from it as is
+            std::unique_ptr<FileUtils::FileMapping, MappingDeleter> mapping;
+            ArchiveHeader header;
+            TableHeader tableHeader;
+            const FileTableEntry *fileTable = nullptr;
+            const char *names = nullptr;
+            const uint8_t *fileData = nullptr;
+            std::vector<CachedFile> cache;
+
+            // The first file with each name hash, files with the same hash are chained (in table order) through sameHash.
+            //  HashTable can't be moved, so it is kept behind a pointer
+            std::unique_ptr<HashTable<uint32_t>> nameIndex;
+            std::vector<uint32_t> sameHash;
+
+            HandleVector<ArchiveFileHandle, FileHandleInfo> fileHandles;
+
+            virtual ArchiveFileHandle openFile( const std::string &name ) override
+            {
+                const uint32_t *first = nameIndex->find(nameHash(name.data(), name.size()));
+                for (uint32_t i = first ? *first : NO_FILE; i != NO_FILE; i = sameHash[i]) {
+                    const FileTableEntry &entry = fileTable[i];
+                    if (name.size() == entry.nameLength && memcmp(name.data(), names + entry.nameOffset, entry.nameLength) == 0) {
+                        FileHandleInfo handle;
+                        handle.file = i;
+                        cache[i].handles++;
+                        return fileHandles.create(handle);
+                    }
+                }
+                return ArchiveFileHandle{};
+            }
+
+            void buildNameIndex()
+            {
+                nameIndex.reset(new HashTable<uint32_t>((int)header.fileCount));
+                sameHash.assign(header.fileCount, NO_FILE);
+
+                // Backwards, so the chains are in table order (the first file with a name is found, as with a linear search)
+                for (uint32_t i=header.fileCount; i-- > 0;) {
+                    const FileTableEntry &entry = fileTable[i];
+                    uint64_t hash = nameHash(names + entry.nameOffset, entry.nameLength);
+                    if (const uint32_t *next = nameIndex->find(hash)) {
+                        sameHash[i] = *next;
+                    }
+                    nameIndex->insert(hash, i);
+                }
+            }
+
+            virtual void closeFile( ArchiveFileHandle handle ) override
+            {
+                const FileHandleInfo *info = fileHandles.find(handle);
+                if (!info) return;
+
+                CachedFile &cached = cache[info->file];
+                assert (cached.handles > 0);
+                if (--cached.handles == 0) {
+                    cached.data.reset();
+                    cached.loaded = false;
+                }
+                fileHandles.free(handle);
+            }
+
+            virtual size_t fileSize( ArchiveFileHandle handle ) override
+            {
+                const FileHandleInfo *info = fileHandles.find(handle);
+                if (!info) return 0;
+
+                assert(info->file < header.fileCount);
+                return fileTable[info->file].size;
+            }
+
+            virtual const void* mapFile( ArchiveFileHandle handle ) override
+            {
+                const FileHandleInfo *info = fileHandles.find(handle);
+                if (!info) return nullptr;
+
+                assert(info->file < header.fileCount);
+                const FileTableEntry &entry = fileTable[info->file];
+                CachedFile &cached = cache[info->file];
+
+                if (!(entry.flags & (ENTRY_COMPRESSED | ENTRY_CHUNKED))) {
+                    if (!cached.verified && !verify(info->file, fileData + entry.offset)) {
+                        return nullptr;
+                    }
+                    cached.verified = true;
+                    return fileData + entry.offset;
+                }
+
+                if (!cached.loaded && !load(info->file, cached)) {
+                    return nullptr;
+                }
+                // Empty files still needs a valid pointer
+                static const uint8_t EMPTY = 0;
+                return cached.data ? cached.data.get() : &EMPTY;
+            }
+
+            // Chunked files that isn't loaded only decompresses the chunks in the range,
+            //  other files are mapped (and stay loaded while the handle is open)
+            virtual bool readRange( ArchiveFileHandle handle, uint64_t offset, size_t size, void *out ) override
+            {
+                const FileHandleInfo *info = fileHandles.find(handle);
+                if (!info) return false;
+
+                const FileTableEntry &entry = fileTable[info->file];
+                if (offset > entry.size || size > entry.size - offset) return false;
+                if (size == 0) return true;
+
+                if (!(entry.flags & ENTRY_CHUNKED) || cache[info->file].loaded) {
+                    return Archive::Impl::readRange(handle, offset, size, out);
+                }
+
+                uint8_t *bytes = static_cast<uint8_t*>(out);
+                std::vector<uint8_t> buffer;
+                for (uint64_t chunk = offset / CHUNK_SIZE, last = (offset + size - 1) / CHUNK_SIZE; chunk <= last; ++chunk) {
+                    uint64_t chunkStart = chunk * CHUNK_SIZE,
+                             chunkEnd = std::min(chunkStart + CHUNK_SIZE, entry.size),
+                             begin = std::max(offset, chunkStart),
+                             end = std::min(offset + size, chunkEnd);
+
+                    // Whole chunks are decompressed straight into 'out'
+                    if (begin == chunkStart && end == chunkEnd) {
+                        if (!readChunk(info->file, chunk, bytes + (chunkStart - offset))) return false;
+                        continue;
+                    }
+
+                    buffer.resize(CHUNK_SIZE);
+                    if (!readChunk(info->file, chunk, buffer.data())) return false;
+                    memcpy(bytes + (begin - offset), buffer.data() + (begin - chunkStart), end - begin);
+                }
+                return true;
+            }
+
+            virtual size_t prefetch( const std::string *names, size_t count, ArchiveFileHandle *handles, ThreadPool *pool ) override
+            {
+                if (!pool) pool = &ThreadPool::Global();
+
+                // The files that isn't loaded yet, and where they goes in the buffer (stored files are only verified)
+                std::vector<uint32_t> files;
+                std::vector<uint64_t> offsets;
+                uint64_t bufferSize = 0;
+                for (size_t i=0; i < count; ++i) {
+                    handles[i] = openFile(names[i]);
+                    if (!handles[i]) continue;
+
+                    uint32_t file = fileHandles.find(handles[i])->file;
+                    const FileTableEntry &entry = fileTable[file];
+                    CachedFile &cached = cache[file];
+                    bool compressed = (entry.flags & (ENTRY_COMPRESSED | ENTRY_CHUNKED)) != 0;
+                    if (compressed ? cached.loaded : cached.verified) continue;
+
+                    // Marked up front so files that are listed twice are only loaded once, it is undone if they fails
+                    cached.loaded = compressed;
+                    cached.verified = !compressed;
+                    files.push_back(file);
+                    offsets.push_back(bufferSize);
+                    if (compressed) bufferSize += entry.size;
+                }
+
+                std::shared_ptr<uint8_t> buffer(new uint8_t[bufferSize], std::default_delete<uint8_t[]>());
+                std::vector<uint8_t> ok(files.size(), 0);
+                pool->parallelFor(files.size(), 1, [&]( size_t begin, size_t end ) {
+                    for (size_t i=begin; i < end; ++i) {
+                        const FileTableEntry &entry = fileTable[files[i]];
+                        if (entry.flags & (ENTRY_COMPRESSED | ENTRY_CHUNKED)) {
+                            ok[i] = decompress(files[i], buffer.get() + offsets[i]) && verify(files[i], buffer.get() + offsets[i]);
+                        }
+                        else {
+                            ok[i] = verify(files[i], fileData + entry.offset);
+                        }
+                    }
+                });
+
+                for (size_t i=0; i < files.size(); ++i) {
+                    const FileTableEntry &entry = fileTable[files[i]];
+                    CachedFile &cached = cache[files[i]];
+                    if (!ok[i]) {
+                        cached.loaded = cached.verified = false;
+                        continue;
+                    }
+
+                    if ((entry.flags & (ENTRY_COMPRESSED | ENTRY_CHUNKED)) && entry.size > 0) {
+                        cached.data = std::shared_ptr<const uint8_t>(buffer, buffer.get() + offsets[i]);
+                    }
+                }
+
+                // Counted once the results are known, as a file may be listed several times
+                size_t loaded = 0;
+                for (size_t i=0; i < count; ++i) {
+                    if (!handles[i]) continue;
+
+                    uint32_t file = fileHandles.find(handles[i])->file;
+                    const CachedFile &cached = cache[file];
+                    if (fileTable[file].flags & (ENTRY_COMPRESSED | ENTRY_CHUNKED) ? cached.loaded : cached.verified) loaded++;
+                }
+                return loaded;
+            }
+
+            virtual const char* name() override
+            {
+                return path.c_str();
+            }
+
+            std::string fileName( uint32_t file ) const
+            {
+                const FileTableEntry &entry = fileTable[file];
+                return std::string(names + entry.nameOffset, entry.nameLength);
+            }
+
+            bool verify( uint32_t index, const uint8_t *data ) const
+            {
+                if (checksum(data, fileTable[index].size) != fileTable[index].checksum) {
+                    LOG_ERROR("Invalid file (\"%s\") in archive \"%s\" - checksum missmatch", fileName(index).c_str(), path.c_str());
+                    return false;
+                }
+                return true;
+            }
+
+            // Decompresses straight from the mapping into 'out', which has room for the file.
+            //  Only reads the archive, so files can be decompressed in parallel
+            bool decompress( uint32_t index, uint8_t *out ) const
+            {
+                const FileTableEntry &entry = fileTable[index];
+                if (entry.flags & ENTRY_CHUNKED) {
+                    for (uint64_t chunk=0, count=chunkCount(entry.size); chunk < count; ++chunk) {
+                        if (!readChunk(index, chunk, out + chunk * CHUNK_SIZE)) return false;
+                    }
+                    return true;
+                }
+
+                int ret = LZ4_decompress_safe((const char*)fileData + entry.offset, (char*)out, (int)entry.compressedSize, (int)entry.size);
+                if (ret < 0 || (uint64_t)ret != entry.size) {
+                    LOG_ERROR("Failed to decompress file (\"%s\") in archive \"%s\"", fileName(index).c_str(), path.c_str());
+                    return false;
+                }
+                return true;
+            }
+
+            // Decompresses (and verifies) a chunk of a chunked file into 'out', which has room for CHUNK_SIZE bytes.
+            //  The chunk table is only validated as it is used, so opening a archive doesn't read the tables of all chunked files
+            bool readChunk( uint32_t index, uint64_t chunk, uint8_t *out ) const
+            {
+                const FileTableEntry &entry = fileTable[index];
+                const uint8_t *data = fileData + entry.offset;
+
+                ChunkEntry chunkEntry;
+                memcpy(&chunkEntry, data + chunk * sizeof(ChunkEntry), sizeof(ChunkEntry));
+
+                uint64_t tableSize = chunkCount(entry.size) * sizeof(ChunkEntry),
+                         size = std::min(CHUNK_SIZE, entry.size - chunk * CHUNK_SIZE);
+                if (chunkEntry.offset < tableSize || chunkEntry.offset > entry.compressedSize || chunkEntry.compressedSize > entry.compressedSize - chunkEntry.offset ||
+                    chunkEntry.compressedSize > (uint64_t)LZ4_compressBound((int)size))
+                {
+                    LOG_ERROR("Invalid file (\"%s\") in archive \"%s\" - chunk %llu has invalid offset and/or size", fileName(index).c_str(), path.c_str(), (unsigned long long)chunk);
+                    return false;
+                }
+
+                if (chunkEntry.compressedSize == size) {
+                    memcpy(out, data + chunkEntry.offset, size);
+                }
+                else {
+                    int ret = LZ4_decompress_safe((const char*)data + chunkEntry.offset, (char*)out, (int)chunkEntry.compressedSize, (int)size);
+                    if (ret < 0 || (uint64_t)ret != size) {
+                        LOG_ERROR("Failed to decompress chunk %llu of file (\"%s\") in archive \"%s\"", (unsigned long long)chunk, fileName(index).c_str(), path.c_str());
+                        return false;
+                    }
+                }
+
+                if (checksum(out, size) != chunkEntry.checksum) {
+                    LOG_ERROR("Invalid file (\"%s\") in archive \"%s\" - checksum missmatch in chunk %llu", fileName(index).c_str(), path.c_str(), (unsigned long long)chunk);
+                    return false;
+                }
+                return true;
+            }
+
+            bool load( uint32_t index, CachedFile &cached )
+            {
+                const FileTableEntry &entry = fileTable[index];
+
+                // Empty files has no buffer
+                std::shared_ptr<uint8_t> data;
+                uint8_t empty = 0, *out = &empty;
+                if (entry.size > 0) {
+                    data.reset(new uint8_t[entry.size], std::default_delete<uint8_t[]>());
+                    out = data.get();
+                }
+                if (!decompress(index, out) || !verify(index, out)) {
+                    return false;
+                }
+
+                cached.data = std::move(data);
+                cached.loaded = true;
+                return true;
+            }
+
+            static Archive OpenArchive( const std::string &path, ArchiveHeader header )
+            {
+                if (header.fileCount > MAX_FILE_COUNT) {
+                    LOG_ERROR("Too many files(%i) in archive \"%s\", limit is %i", (int)header.fileCount, path.c_str(), (int)MAX_FILE_COUNT);
+                    return Archive {};
+                }
+
+                Impl impl;
+                try {
+                    impl.mapping.reset(FileUtils::mapFile(path));
+                }
+                catch (const std::exception &e) {
+                    LOG_ERROR("Failed to map archive \"%s\": %s", path.c_str(), e.what());
+                    return Archive {};
+                }
+                const uint8_t *data = static_cast<const uint8_t*>(impl.mapping->ptr);
+                const uint64_t fileSize = impl.mapping->size;
+
+                uint64_t tableStart = sizeof(ArchiveHeader) + sizeof(TableHeader);
+                if (fileSize < tableStart) {
+                    LOG_ERROR("Failed to read file table from archive \"%s\"", path.c_str());
+                    return Archive {};
+                }
+                memcpy(&impl.tableHeader, data + sizeof(ArchiveHeader), sizeof(TableHeader));
+                const TableHeader &tableHeader = impl.tableHeader;
+
+                uint64_t tableSize = uint64_t(header.fileCount) * sizeof(FileTableEntry);
+                if (tableHeader.namesSize > fileSize || tableStart + tableSize + tableHeader.namesSize > tableHeader.dataOffset || tableHeader.dataOffset > fileSize) {
+                    LOG_ERROR("Invalid archive \"%s\" - the file table doesn't fit in the archive", path.c_str());
+                    return Archive {};
+                }
+
+                // The mapping is page aligned, and the table is at a multiple of 8 bytes
+                static_assert((sizeof(ArchiveHeader) + sizeof(TableHeader)) % alignof(FileTableEntry) == 0, "The file table must be aligned");
+                impl.fileTable = reinterpret_cast<const FileTableEntry*>(data + tableStart);
+                impl.names = reinterpret_cast<const char*>(data + tableStart + tableSize);
+                impl.fileData = data + tableHeader.dataOffset;
+
+                uint32_t tableChecksum = checksum(impl.fileTable, tableSize);
+                tableChecksum = checksum(impl.names, tableHeader.namesSize, tableChecksum);
+                if (tableChecksum != tableHeader.checksum) {
+                    LOG_ERROR("Invalid filetable in archive \"%s\" - checksum missmatch", path.c_str());
+                    return Archive {};
+                }
+
+                // Verify file table
+                uint64_t dataSize = fileSize - tableHeader.dataOffset;
+                for (uint32_t i=0; i < header.fileCount; ++i) {
+                    const FileTableEntry &entry = impl.fileTable[i];
+                    if (entry.nameLength >= MAX_FILE_NAME_LENGHT || uint64_t(entry.nameOffset) + entry.nameLength > tableHeader.namesSize) {
+                        LOG_ERROR("Invalid filetable in archive \"%s\" - entry has invalid name", path.c_str());
+                        return Archive {};
+                    }
+
+                    if (entry.offset > dataSize || entry.compressedSize > dataSize - entry.offset) {
+                        LOG_ERROR("Invalid filetable in archive \"%s\" - entry has invalid offset (%llu) and/or size (%llu)", path.c_str(), (unsigned long long)entry.offset, (unsigned long long)entry.compressedSize);
+                        return Archive {};
+                    }
+
+                    bool compressed = (entry.flags & ENTRY_COMPRESSED) != 0,
+                         chunked = (entry.flags & ENTRY_CHUNKED) != 0;
+                    if (compressed && chunked) {
+                        LOG_ERROR("Invalid filetable in archive \"%s\" - entry has invalid flags (%u)", path.c_str(), entry.flags);
+                        return Archive {};
+                    }
+
+                    if (compressed && entry.size > MAX_FILE_SIZE) {
+                        LOG_ERROR("Invalid filetable in archive \"%s\" - entry has to big size (%llu) max is %llu", path.c_str(), (unsigned long long)entry.size, (unsigned long long)MAX_FILE_SIZE);
+                        return Archive {};
+                    }
+
+                    bool validSize = compressed ? entry.compressedSize <= (uint64_t)LZ4_compressBound((int)entry.size) :
+                                     chunked ? chunkCount(entry.size) <= entry.compressedSize / sizeof(ChunkEntry) :
+                                     entry.compressedSize == entry.size;
+                    if (!validSize) {
+                        LOG_ERROR("Invalid filetable in archive \"%s\" - entry has invalid compressed size (%llu)", path.c_str(), (unsigned long long)entry.compressedSize);
+                        return Archive {};
+                    }
+                }
+
+                impl.path = path;
+                impl.header = header;
+                impl.cache.resize(header.fileCount);
+                impl.buildNameIndex();
+
+                return CreateArchive(std::move(impl));
+            }
+        };
+    }
+
     COMMON_API Archive Archive::OpenArchive( const std::string &path )
     {
         if (FileUtils::isDirectory(path)) {
             return Directory::Impl::OpenArchive(path);
         }
 
-        std::ifstream file(path);
+        std::ifstream file(path, std::ios::in | std::ios::binary);
         if (!file) {
             LOG_ERROR("Failed to open file \"%s\"", path.c_str());
             return Archive {};
@@ -341,6 +774,8 @@ namespace Common
         switch (header.version) {
         case 1:
             return Ver1::Impl::OpenArchive(path, file, header);
+        case 2:
+            return Ver2::Impl::OpenArchive(path, header);
         }
 
         LOG_ERROR("Unkown archive version %i for file \"%s\"", header.version, path.c_str());
@@ -371,6 +806,16 @@ namespace Common
         return mImpl->mapFile(handle);
     }
 
+    COMMON_API bool Archive::readRange( ArchiveFileHandle handle, uint64_t offset, size_t size, void *out )
+    {
+        return mImpl->readRange(handle, offset, size, out);
+    }
+
+    COMMON_API size_t Archive::prefetch( const std::string *names, size_t count, ArchiveFileHandle *handles, ThreadPool *pool )
+    {
+        return mImpl->prefetch(names, count, handles, pool);
+    }
+
     COMMON_API const char* Archive::name()
     {
         return mImpl->name();
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Murmur3_32.h"
+#include "FileUtils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// The on disk format of archive files, shared by the reader (Archive.cpp) and the writer (ArchiveWriter.cpp)
+namespace Common
+{
+#define ARCHIVE_SIGNATURE "Zodiac Archive"
+#define ARCHIVE_SIGNATURE_LEN sizeof(ARCHIVE_SIGNATURE)
+
+    static const int ArchiveVersion = 2;
+
+
+    struct MappingDeleter {
+        void operator () ( FileUtils::FileMapping *mapping ) const {
+            FileUtils::unmapFile(mapping);
+        }
+    };
+
+    struct ArchiveHeader {
+        uint8_t sig[ARCHIVE_SIGNATURE_LEN] = ARCHIVE_SIGNATURE;
+        uint32_t version = ArchiveVersion;
+        uint32_t fileCount = 0;
+    };
+
+    // Version 2 layout, all offsets are in bytes:
+    //      ArchiveHeader
+    //      TableHeader
+    //      FileTableEntry[header.fileCount]
+    //      names               - the file names, not nul terminated, FileTableEntry::nameOffset is relative to the start of it
+    //      data                - at TableHeader::dataOffset (from the start of the archive), FileTableEntry::offset is relative to it
+    //
+    // Entries may share their data (the writer stores identical files once), and the data doesn't have to be in table order.
+    namespace Ver2 {
+        static const uint32_t MAX_FILE_NAME_LENGHT = 256;
+        // Limited by the memory used by the file table (40 bytes per file) and the name index
+        static const uint32_t MAX_FILE_COUNT = 1 << 20;
+        // Of files that are compressed as a single block, stored and chunked files has no limit
+        static const uint64_t MAX_FILE_SIZE = 32 * 1024 * 1024; // 32 MiB
+        // Chunked files are split into chunks of this size (the last may be smaller)
+        static const uint64_t CHUNK_SIZE = 128 * 1024;
+        // The checksum is chained over blocks, murmur3_32 takes a 32 bit length
+        static const size_t CHECKSUM_BLOCK_SIZE = 1024 * 1024;
+
+        struct TableHeader {
+            uint64_t namesSize = 0,
+                     dataOffset = 0;
+            // Of the file table and the names
+            uint32_t checksum = 0;
+            uint32_t padding = 0;
+        };
+
+        enum EntryFlags : uint32_t {
+            // The data is a single LZ4 block, otherwise it is stored as is
+            ENTRY_COMPRESSED = 1 << 0,
+            // The data is a chunk table followed by the chunks, each chunk is compressed on its own
+            //  so a range of the file can be read by only decompressing the chunks it covers
+            ENTRY_CHUNKED = 1 << 1,
+        };
+
+        struct FileTableEntry {
+            uint64_t offset = 0,
+                     compressedSize = 0,
+                     size = 0;
+            uint32_t nameOffset = 0,
+                     nameLength = 0;
+            // Of the decompressed data
+            uint32_t checksum = 0;
+            uint32_t flags = 0;
+        };
+
+        // The data of a chunked entry starts with a ChunkEntry for each chunk of the file, in order.
+        //  A chunk is a LZ4 block, or stored as is if compressedSize is the size of the chunk.
+        struct ChunkEntry {
+            // Relative to the start of the entry's data
+            uint64_t offset = 0;
+            uint32_t compressedSize = 0,
+                     // Of the decompressed chunk
+                     checksum = 0;
+        };
+
+        static_assert(sizeof(TableHeader) == 24 && sizeof(FileTableEntry) == 40 && sizeof(ChunkEntry) == 16, "The structs are stored as is in the archive");
+
+        inline uint64_t chunkCount( uint64_t size )
+        {
+            return size / CHUNK_SIZE + (size % CHUNK_SIZE != 0 ? 1 : 0);
+        }
+
+        inline uint32_t checksum( const void *data, size_t size, uint32_t hash=0 )
+        {
+            const char *bytes = static_cast<const char*>(data);
+            for (size_t offset=0; offset < size; offset += CHECKSUM_BLOCK_SIZE) {
+                size_t block = std::min(CHECKSUM_BLOCK_SIZE, size - offset);
+                hash = murmur3_32(bytes + offset, (uint32_t)block, hash);
+            }
+            return hash;
+        }
+
+        static const uint32_t NAME_HASH_SEED = 0x9747b28c;
+
+        inline uint64_t nameHash( const char *name, size_t length )
+        {
+            return (uint64_t(murmur3_32(name, (uint32_t)length)) << 32) | murmur3_32(name, (uint32_t)length, NAME_HASH_SEED);
+        }
+    }
+}
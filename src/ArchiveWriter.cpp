@@ -0,0 +1,490 @@
+#include "ArchiveWriter.h"
+#include "Archive.impl.h"
+#include "ErrorUtils.h"
+#include "FileUtils.h"
+#include "HashTable.h"
+#include "ThreadPool.h"
+
+#include "lz4hc.h"
+
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <exception>
+#include <cassert>
+#include <cstdio>
+
+namespace Common
+{
+    namespace ArchiveWriterImpl
+    {
+        using namespace Ver2;
+
+        // Each file starts at a multiple of this, so stored files used from the mapping are aligned
+        static const uint64_t DATA_ALIGNMENT = 16;
+        // The amount of data (before compression) that is loaded and compressed before it is written
+        static const uint64_t BATCH_SIZE = 256 * 1024 * 1024;
+        static const uint32_t NO_FILE = ~0u;
+
+        struct File {
+            std::string name;
+            // Files from disk are read from 'path', the others are in 'data'
+            bool onDisk = false;
+            std::string path;
+            std::vector<uint8_t> data;
+        };
+
+        // The content of a file while it is used, either the added data or a mapping of the file on disk
+        struct Content {
+            std::unique_ptr<FileUtils::FileMapping, MappingDeleter> mapping;
+            const uint8_t *data = nullptr;
+            uint64_t size = 0;
+        };
+
+        // Throws std::runtime_error if the file can't be read
+        Content load( const File &file )
+        {
+            Content content;
+            if (!file.onDisk) {
+                content.data = file.data.data();
+                content.size = file.data.size();
+                return content;
+            }
+
+            content.mapping.reset(FileUtils::mapFile(file.path));
+            content.data = static_cast<const uint8_t*>(content.mapping->ptr);
+            content.size = content.mapping->size;
+            return content;
+        }
+
+        // Of the data in each file, the 64 bit hash used to find duplicates is the checksum and a second seed
+        struct FileInfo {
+            uint64_t size = 0,
+                     hash = 0;
+            uint32_t checksum = 0;
+            std::string error;
+        };
+
+        // The data is compressed in pieces, a piece is a whole file or a chunk of a chunked file
+        struct Piece {
+            uint32_t file;
+            // In the file
+            uint64_t offset,
+                     size;
+            bool chunk;
+        };
+
+        struct Output {
+            // Empty if the piece is stored as is
+            std::vector<uint8_t> compressed;
+            // Of chunks
+            uint32_t checksum = 0;
+        };
+
+        // Compresses 'size' bytes into 'out', returns false if it doesn't get smaller (it is stored as is then)
+        bool compress( const uint8_t *data, uint64_t size, int level, std::vector<uint8_t> &out )
+        {
+            // Nothing to gain, and LZ4 doesn't accept a null source
+            if (size == 0) return false;
+
+            // The state is large (~256 KiB), so each thread keeps one instead of LZ4 allocating it for each file
+            thread_local std::vector<char> state;
+            state.resize(LZ4_sizeofStateHC());
+
+            out.resize(LZ4_compressBound((int)size));
+            int compressedSize = LZ4_compress_HC_extStateHC(state.data(), (const char*)data, (char*)out.data(), (int)size, (int)out.size(), level);
+            if (compressedSize <= 0 || (uint64_t)compressedSize >= size) {
+                out.clear();
+                out.shrink_to_fit();
+                return false;
+            }
+            out.resize(compressedSize);
+            return true;
+        }
+
+        uint64_t alignData( uint64_t offset )
+        {
+            return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+        }
+    }
+
+    struct ArchiveWriter::Impl {
+        Impl() = default;
+        explicit Impl( const Settings &settings_ ) :
+            settings(settings_)
+        {}
+
+        Settings settings;
+        std::vector<ArchiveWriterImpl::File> files;
+        std::unordered_map<std::string, uint32_t> fileIndex;
+        std::vector<std::string> accessOrder;
+
+        bool add( ArchiveWriterImpl::File &&file )
+        {
+            using namespace ArchiveWriterImpl;
+
+            if (file.name.size() >= MAX_FILE_NAME_LENGHT) {
+                LOG_ERROR("Can't add file \"%s\" to archive - the name is longer than %i characters", file.name.c_str(), (int)MAX_FILE_NAME_LENGHT-1);
+                return false;
+            }
+            if (files.size() >= MAX_FILE_COUNT) {
+                LOG_ERROR("Can't add file \"%s\" to archive - the limit is %i files", file.name.c_str(), (int)MAX_FILE_COUNT);
+                return false;
+            }
+            if (!fileIndex.emplace(file.name, (uint32_t)files.size()).second) {
+                LOG_ERROR("Can't add file \"%s\" to archive - there is already a file with that name", file.name.c_str());
+                return false;
+            }
+
+            files.push_back(std::move(file));
+            return true;
+        }
+
+        // The files in the order they are written
+        std::vector<uint32_t> fileOrder() const
+        {
+            std::vector<uint32_t> rank(files.size(), NO_FILE_RANK);
+            uint32_t next = 0;
+            for (const std::string &name : accessOrder) {
+                auto iter = fileIndex.find(name);
+                if (iter != fileIndex.end() && rank[iter->second] == NO_FILE_RANK) {
+                    rank[iter->second] = next++;
+                }
+            }
+
+            std::vector<uint32_t> order(files.size());
+            for (uint32_t i=0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) {
+                return rank[a] < rank[b];
+            });
+            return order;
+        }
+
+        static constexpr uint32_t NO_FILE_RANK = ~0u;
+
+        // Writes the archive to 'tmpPath', 'path' is only used in errors
+        bool write( const std::string &path, const std::string &tmpPath, Stats &stats );
+    };
+
+    bool ArchiveWriter::Impl::write( const std::string &path, const std::string &tmpPath, Stats &stats )
+    {
+        using namespace ArchiveWriterImpl;
+
+        ThreadPool *pool = settings.pool ? settings.pool : &ThreadPool::Global();
+        const std::vector<uint32_t> order = fileOrder();
+        const uint32_t fileCount = (uint32_t)order.size();
+
+        // Read and hash all files, to find their sizes and duplicates
+        std::vector<FileInfo> infos(fileCount);
+        pool->parallelFor(fileCount, 1, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                FileInfo &info = infos[i];
+                try {
+                    Content content = load(files[order[i]]);
+                    info.size = content.size;
+                    info.checksum = checksum(content.data, content.size);
+                    if (settings.deduplicate) {
+                        info.hash = (uint64_t(info.checksum) << 32) | checksum(content.data, content.size, NAME_HASH_SEED);
+                    }
+                }
+                catch (const std::exception &e) {
+                    info.error = e.what();
+                }
+            }
+        });
+
+        bool failed = false;
+        for (uint32_t i=0; i < fileCount; ++i) {
+            if (!infos[i].error.empty()) {
+                LOG_ERROR("Failed to add file \"%s\" to archive \"%s\": %s", files[order[i]].name.c_str(), path.c_str(), infos[i].error.c_str());
+                failed = true;
+            }
+        }
+        if (failed) return false;
+
+        // The earlier file whose data is used instead, files with the same hash are chained (in order) through sameHash
+        std::vector<uint32_t> source(fileCount, NO_FILE);
+        if (settings.deduplicate) {
+            HashTable<uint32_t> firstWithHash((int)fileCount);
+            std::vector<uint32_t> sameHash(fileCount, NO_FILE);
+
+            for (uint32_t i=0; i < fileCount; ++i) {
+                uint32_t *first = firstWithHash.find(infos[i].hash);
+                if (!first) {
+                    firstWithHash.insert(infos[i].hash, i);
+                    continue;
+                }
+
+                uint32_t last = NO_FILE;
+                for (uint32_t j = *first; j != NO_FILE; last = j, j = sameHash[j]) {
+                    if (infos[j].size != infos[i].size || infos[j].checksum != infos[i].checksum) continue;
+
+                    // Very unlikely to differ, but files are only merged if they are equal
+                    try {
+                        Content a = load(files[order[i]]), b = load(files[order[j]]);
+                        if (a.size == b.size && (a.size == 0 || memcmp(a.data, b.data, a.size) == 0)) {
+                            source[i] = j;
+                            break;
+                        }
+                    }
+                    catch (const std::exception &e) {
+                        LOG_ERROR("Failed to add file \"%s\" to archive \"%s\": %s", files[order[i]].name.c_str(), path.c_str(), e.what());
+                        return false;
+                    }
+                }
+                if (source[i] == NO_FILE) {
+                    sameHash[last] = i;
+                }
+            }
+        }
+
+        // The table (except where the data is) and the names are known before the data is written
+        std::vector<FileTableEntry> table(fileCount);
+        std::string names;
+        for (uint32_t i=0; i < fileCount; ++i) {
+            const File &file = files[order[i]];
+            FileTableEntry &entry = table[i];
+            entry.nameOffset = (uint32_t)names.size();
+            entry.nameLength = (uint32_t)file.name.size();
+            entry.size = infos[i].size;
+            entry.checksum = infos[i].checksum;
+            names += file.name;
+        }
+
+        TableHeader tableHeader;
+        tableHeader.namesSize = names.size();
+        tableHeader.dataOffset = alignData(sizeof(ArchiveHeader) + sizeof(TableHeader) + uint64_t(fileCount) * sizeof(FileTableEntry) + names.size());
+
+        std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) {
+            LOG_ERROR("Failed to open file \"%s\"", tmpPath.c_str());
+            return false;
+        }
+        // The header and the table are written last, when the offsets are known
+        const std::vector<char> zeros(std::max<uint64_t>(tableHeader.dataOffset, DATA_ALIGNMENT), 0);
+        out.write(zeros.data(), tableHeader.dataOffset);
+
+        // Large files are split into chunks, so the chunks of a file are compressed in parallel too
+        const int level = std::min(settings.compressionLevel, LZ4HC_CLEVEL_MAX);
+        std::vector<Piece> pieces;
+        for (uint32_t i=0; i < fileCount; ++i) {
+            if (source[i] != NO_FILE) continue;
+
+            uint64_t size = infos[i].size;
+            if (level <= 0 || (size <= settings.chunkedFileSize && size <= MAX_FILE_SIZE)) {
+                pieces.push_back({i, 0, size, false});
+                continue;
+            }
+            for (uint64_t offset=0; offset < size; offset += CHUNK_SIZE) {
+                pieces.push_back({i, offset, std::min(CHUNK_SIZE, size - offset), true});
+            }
+        }
+
+        // The chunk tables are written after the chunks, when the offsets are known
+        std::vector<ChunkEntry> chunks(pieces.size());
+        uint64_t dataSize = 0;
+        std::vector<Output> outputs;
+        std::vector<Content> contents;
+        std::vector<uint32_t> pieceContent;
+        for (size_t batchStart=0; batchStart < pieces.size();) {
+            size_t batchEnd = batchStart;
+            uint64_t batchSize = 0;
+            while (batchEnd < pieces.size() && (batchEnd == batchStart || batchSize + pieces[batchEnd].size <= BATCH_SIZE)) {
+                batchSize += pieces[batchEnd].size;
+                batchEnd++;
+            }
+
+            // The pieces of a file are next to each other, so each file in the batch is loaded once
+            contents.clear();
+            pieceContent.clear();
+            for (size_t i=batchStart; i < batchEnd; ++i) {
+                uint32_t file = pieces[i].file;
+                if (i == batchStart || file != pieces[i-1].file) {
+                    try {
+                        contents.push_back(load(files[order[file]]));
+                    }
+                    catch (const std::exception &e) {
+                        LOG_ERROR("Failed to add file \"%s\" to archive \"%s\": %s", files[order[file]].name.c_str(), path.c_str(), e.what());
+                        return false;
+                    }
+                    if (contents.back().size != infos[file].size) {
+                        LOG_ERROR("Failed to add file \"%s\" to archive \"%s\": the file changed while the archive was written", files[order[file]].name.c_str(), path.c_str());
+                        return false;
+                    }
+                }
+                pieceContent.push_back((uint32_t)contents.size() - 1);
+            }
+
+            outputs.clear();
+            outputs.resize(batchEnd - batchStart);
+            pool->parallelFor(outputs.size(), 1, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    const Piece &piece = pieces[batchStart + i];
+                    const uint8_t *data = contents[pieceContent[i]].data + piece.offset;
+                    if (level > 0) {
+                        compress(data, piece.size, level, outputs[i].compressed);
+                    }
+                    if (piece.chunk) {
+                        outputs[i].checksum = checksum(data, piece.size);
+                    }
+                }
+            });
+
+            for (size_t i=0; i < outputs.size(); ++i) {
+                const Piece &piece = pieces[batchStart + i];
+                const Output &output = outputs[i];
+                FileTableEntry &entry = table[piece.file];
+
+                if (piece.offset == 0) {
+                    uint64_t offset = alignData(dataSize);
+                    out.write(zeros.data(), offset - dataSize);
+                    entry.offset = dataSize = offset;
+
+                    if (piece.chunk) {
+                        // A placeholder for the chunk table
+                        uint64_t tableSize = chunkCount(entry.size) * sizeof(ChunkEntry);
+                        out.write((const char*)&chunks[batchStart + i], tableSize);
+                        dataSize += tableSize;
+                        entry.flags = ENTRY_CHUNKED;
+                        stats.chunked++;
+                    }
+                    else if (!output.compressed.empty()) {
+                        entry.flags = ENTRY_COMPRESSED;
+                        stats.compressed++;
+                    }
+                }
+
+                if (piece.chunk) {
+                    ChunkEntry &chunk = chunks[batchStart + i];
+                    chunk.offset = dataSize - entry.offset;
+                    chunk.compressedSize = (uint32_t)(output.compressed.empty() ? piece.size : output.compressed.size());
+                    chunk.checksum = output.checksum;
+                }
+                if (!output.compressed.empty()) {
+                    out.write((const char*)output.compressed.data(), output.compressed.size());
+                    dataSize += output.compressed.size();
+                }
+                else {
+                    out.write((const char*)contents[pieceContent[i]].data + piece.offset, piece.size);
+                    dataSize += piece.size;
+                }
+                entry.compressedSize = dataSize - entry.offset;
+            }
+            batchStart = batchEnd;
+        }
+
+        for (size_t i=0; i < pieces.size(); ++i) {
+            if (!pieces[i].chunk || pieces[i].offset != 0) continue;
+
+            const FileTableEntry &entry = table[pieces[i].file];
+            out.seekp(tableHeader.dataOffset + entry.offset);
+            out.write((const char*)&chunks[i], chunkCount(entry.size) * sizeof(ChunkEntry));
+        }
+
+        for (uint32_t i=0; i < fileCount; ++i) {
+            if (source[i] == NO_FILE) continue;
+
+            const FileTableEntry &from = table[source[i]];
+            table[i].offset = from.offset;
+            table[i].compressedSize = from.compressedSize;
+            table[i].flags = from.flags;
+            stats.duplicates++;
+        }
+
+        uint64_t tableSize = uint64_t(fileCount) * sizeof(FileTableEntry);
+        tableHeader.checksum = checksum(table.data(), tableSize);
+        tableHeader.checksum = checksum(names.data(), names.size(), tableHeader.checksum);
+
+        ArchiveHeader header;
+        header.fileCount = fileCount;
+
+        out.seekp(0);
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)&tableHeader, sizeof(tableHeader));
+        out.write((const char*)table.data(), tableSize);
+        out.write(names.data(), names.size());
+        out.close();
+        if (!out) {
+            LOG_ERROR("Failed to write archive \"%s\"", path.c_str());
+            return false;
+        }
+
+        stats.files = fileCount;
+        for (const FileInfo &info : infos) {
+            stats.size += info.size;
+        }
+        stats.storedSize = dataSize;
+        return true;
+    }
+
+    COMMON_API ArchiveWriter::ArchiveWriter() = default;
+    COMMON_API ArchiveWriter::ArchiveWriter( const Settings &settings ) :
+        mImpl(settings)
+    {
+    }
+    COMMON_API ArchiveWriter::~ArchiveWriter() = default;
+
+    COMMON_API bool ArchiveWriter::addFile( const std::string &name, const void *data, size_t size )
+    {
+        using namespace ArchiveWriterImpl;
+
+        File file;
+        file.name = name;
+        file.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        return mImpl->add(std::move(file));
+    }
+
+    COMMON_API bool ArchiveWriter::addFileFromDisk( const std::string &name, const std::string &path )
+    {
+        ArchiveWriterImpl::File file;
+        file.name = name;
+        file.onDisk = true;
+        file.path = path;
+        return mImpl->add(std::move(file));
+    }
+
+    COMMON_API void ArchiveWriter::setAccessOrder( const std::string *names, size_t count )
+    {
+        mImpl->accessOrder.assign(names, names + count);
+    }
+
+    COMMON_API size_t ArchiveWriter::fileCount() const
+    {
+        return mImpl->files.size();
+    }
+
+    COMMON_API bool ArchiveWriter::write( const std::string &path, Stats *stats )
+    {
+        // The archive replaces 'path' once it is complete, so a failed write keeps the archive that was there
+        std::string tmpPath = path + ".tmp";
+        Stats result;
+        bool ok = false;
+        try {
+            ok = mImpl->write(path, tmpPath, result);
+        }
+        catch (...) {
+            std::remove(tmpPath.c_str());
+            throw;
+        }
+
+        if (ok && std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            // rename doesn't replace a existing file on windows
+            std::remove(path.c_str());
+            if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+                LOG_ERROR("Failed to replace archive \"%s\" with \"%s\"", path.c_str(), tmpPath.c_str());
+                ok = false;
+            }
+        }
+        if (!ok) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        if (stats) *stats = result;
+        return true;
+    }
+}
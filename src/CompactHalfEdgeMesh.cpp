@@ -0,0 +1,146 @@
+#include "CompactHalfEdgeMesh.h"
+#include "HalfEdgeMeshBuild.h"
+
+#include "ErrorUtils.h"
+
+namespace Common
+{
+    namespace CompactHalfEdgeMeshImpl
+    {
+        static const size_t GRAIN_SIZE = 4096;
+
+        using Index = CompactHalfEdgeMesh::Index;
+        static const Index INVALID = CompactHalfEdgeMesh::INVALID;
+
+        // The shared builder places the pairs anywhere, this gives the half edges of edge 'e' the indexes 2*e and 2*e+1
+        std::vector<Index> pairedOrder( const internal::IndexedBuild::Topology &topology )
+        {
+            size_t edgeCount = topology.edgeHEdge.size();
+
+            std::vector<Index> order(edgeCount * 2);
+            topology.pool->parallelFor(edgeCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t edge=begin; edge < end; ++edge) {
+                    Index hedge = topology.edgeHEdge[edge];
+                    order[hedge] = Index(edge * 2);
+                    order[topology.hedges[hedge].pair] = Index(edge * 2 + 1);
+                }
+            });
+            return order;
+        }
+    }
+
+    namespace impl = CompactHalfEdgeMeshImpl;
+
+    COMMON_API bool CompactHalfEdgeMesh::buildFromIndexed( const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount, ThreadPool *pool )
+    {
+        internal::IndexedBuild::Topology topology;
+        topology.pool = pool;
+        if (!internal::IndexedBuild::buildTopology(topology, indices, faceSizes, faceCount, vertexCount)) return false;
+
+        std::vector<Index> order = impl::pairedOrder(topology);
+        size_t hedgeCount = order.size();
+
+        CompactHalfEdgeMesh mesh;
+        mesh.mHEdgeNext.resize(hedgeCount);
+        mesh.mHEdgeVertex.resize(hedgeCount);
+        mesh.mHEdgeFace.resize(hedgeCount);
+        mesh.mVertexHEdge.resize(vertexCount);
+        mesh.mFaceHEdge.resize(faceCount);
+
+        topology.pool->parallelFor(hedgeCount, impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                const internal::IndexedBuild::HEdge &src = topology.hedges[i];
+                Index hedge = order[i];
+
+                mesh.mHEdgeNext[hedge] = order[src.next];
+                mesh.mHEdgeVertex[hedge] = src.vertex;
+                mesh.mHEdgeFace[hedge] = src.face;
+            }
+        });
+        topology.pool->parallelFor(vertexCount, impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                Index hedge = topology.vertexHEdge[i];
+                mesh.mVertexHEdge[i] = (hedge != INVALID) ? order[hedge] : INVALID;
+            }
+        });
+        topology.pool->parallelFor(faceCount, impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                mesh.mFaceHEdge[i] = order[topology.faceStart[i]];
+            }
+        });
+
+        swap(mesh);
+        return true;
+    }
+
+    COMMON_API void CompactHalfEdgeMesh::clear()
+    {
+        CompactHalfEdgeMesh empty;
+        swap(empty);
+    }
+
+    COMMON_API void CompactHalfEdgeMesh::swap( CompactHalfEdgeMesh &other )
+    {
+        mHEdgeNext.swap(other.mHEdgeNext);
+        mHEdgeVertex.swap(other.mHEdgeVertex);
+        mHEdgeFace.swap(other.mHEdgeFace);
+        mVertexHEdge.swap(other.mVertexHEdge);
+        mFaceHEdge.swap(other.mFaceHEdge);
+    }
+
+    COMMON_API size_t CompactHalfEdgeMesh::memoryUsage() const
+    {
+        size_t count = mHEdgeNext.capacity() + mHEdgeVertex.capacity() + mHEdgeFace.capacity() +
+                       mVertexHEdge.capacity() + mFaceHEdge.capacity();
+        return count * sizeof(Index);
+    }
+
+#if COMMON_DEBUG_LEVEL > 0
+    COMMON_API void CompactHalfEdgeMesh::verifyInvariants() const
+    {
+        size_t hedgeCount = mHEdgeNext.size();
+        FATAL_ASSERT(hedgeCount % 2 == 0, "Half edges must come in pairs");
+        FATAL_ASSERT(mHEdgeVertex.size() == hedgeCount && mHEdgeFace.size() == hedgeCount, "");
+
+        std::vector<Index> outgoing(mVertexHEdge.size(), 0);
+        for (Index hedge=0; hedge < hedgeCount; ++hedge) {
+            Index next = mHEdgeNext[hedge],
+                  vertex = mHEdgeVertex[hedge];
+            FATAL_ASSERT(next < hedgeCount, "Half edge %u has a invalid next", hedge);
+            FATAL_ASSERT(vertex < mVertexHEdge.size(), "Half edge %u has a invalid vertex", hedge);
+            FATAL_ASSERT(vertex != getHEdgeOrigin(hedge), "Half edge %u is a loop", hedge);
+            FATAL_ASSERT(getHEdgeOrigin(next) == vertex, "Half edge %u isn't connected to its next", hedge);
+            FATAL_ASSERT(mHEdgeFace[next] == mHEdgeFace[hedge], "Half edge %u and its next have different faces", hedge);
+
+            Index face = mHEdgeFace[hedge];
+            FATAL_ASSERT(face == INVALID || face < mFaceHEdge.size(), "Half edge %u has a invalid face", hedge);
+
+            outgoing[getHEdgeOrigin(hedge)]++;
+        }
+
+        for (Index vertex=0; vertex < mVertexHEdge.size(); ++vertex) {
+            Index first = mVertexHEdge[vertex];
+            if (first == INVALID) {
+                FATAL_ASSERT(outgoing[vertex] == 0, "Vertex %u has half edges, but no half edge", vertex);
+                continue;
+            }
+            FATAL_ASSERT(getHEdgeOrigin(first) == vertex, "Vertex %u half edge doesn't leave it", vertex);
+
+            // Walk around the vertex, every outgoing half edge must be reached
+            Index hedge = first,
+                  count = 0;
+            do {
+                FATAL_ASSERT(getHEdgeOrigin(hedge) == vertex, "");
+                count++;
+                hedge = mHEdgeNext[hedge ^ 1];
+            } while (hedge != first && count <= outgoing[vertex]);
+            FATAL_ASSERT(count == outgoing[vertex], "Vertex %u has %u outgoing half edges, but only %u are reachable", vertex, outgoing[vertex], count);
+        }
+
+        for (Index face=0; face < mFaceHEdge.size(); ++face) {
+            Index hedge = mFaceHEdge[face];
+            FATAL_ASSERT(hedge < hedgeCount && mHEdgeFace[hedge] == face, "Face %u half edge doesn't belong to it", face);
+        }
+    }
+#endif
+}
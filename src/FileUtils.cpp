@@ -5,9 +5,20 @@
 #include <stdexcept>
 #include <memory>
 #include <vector>
+#include <cstring>
+#include <cerrno>
 
 #include <sys/stat.h>
 
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
 #include "tinydir.h"
 
 
@@ -83,7 +94,8 @@ namespace FileUtils
         return std::move(content);
     }
 
-    std::vector<std::string> getFileList( const std::string &path )
+    // The regular files, or the sub directories (except "." and ".."), in 'path'
+    static std::vector<std::string> listDirectory( const std::string &path, bool directories )
     {
         tinydir_dir dir;
         if (tinydir_open(&dir, path.c_str()) == -1) {
@@ -99,7 +111,7 @@ namespace FileUtils
             if (tinydir_readfile(&dir, &file) == -1) {
                 THROW(std::runtime_error, "tinydir_readfile error %i: %s", errno, strerror(errno));
             }
-            else if (file.is_reg) {
+            else if (directories ? (file.is_dir && strcmp(file.name, ".") != 0 && strcmp(file.name, "..") != 0) : file.is_reg) {
                 files.emplace_back(file.path);
             }
 
@@ -112,6 +124,16 @@ namespace FileUtils
         return std::move(files);
     }
 
+    std::vector<std::string> getFileList( const std::string &path )
+    {
+        return listDirectory(path, false);
+    }
+
+    std::vector<std::string> getDirectoryList( const std::string &path )
+    {
+        return listDirectory(path, true);
+    }
+
     std::string removeFileName( const std::string &filepath ) {
         auto loc = filepath.find_last_of("/\\");
         if( loc == std::string::npos ) return std::string();
@@ -145,27 +167,115 @@ namespace FileUtils
         return filepath.substr( 0, loc );
     }
 
-    /// @todo implement real file mapping
     struct Mapping {
         FileMapping map;
-        std::vector<uint8_t> content;
+        // The mapped view, it starts at a multiple of the page size (or allocation granularity on windows) before the offset
+        void *view = nullptr;
+        size_t viewSize = 0;
     };
 
-    FileMapping* mapFile( const std::string &filename, int offset, int size )
+    FileMapping* mapFile( const std::string &filename, uint64_t offset, int64_t size )
     {
-        std::string content = getFileContent( filename, true );
-
         std::unique_ptr<Mapping> mapping( new Mapping );
-        mapping->content.assign( content.begin(), content.end() );
-        mapping->map.ptr = mapping->content.data();
-        mapping->map.size = mapping->content.size();
-        
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if( file == INVALID_HANDLE_VALUE ) {
+            THROW( std::runtime_error, "Failed to open file \"%s\"", filename.c_str() );
+        }
+
+        LARGE_INTEGER fileSize;
+        if( !GetFileSizeEx(file, &fileSize) ) {
+            CloseHandle( file );
+            THROW( std::runtime_error, "Failed to get the size of file \"%s\"", filename.c_str() );
+        }
+        uint64_t end = (uint64_t)fileSize.QuadPart;
+#else
+        int file = open( filename.c_str(), O_RDONLY );
+        if( file == -1 ) {
+            THROW( std::runtime_error, "Failed to open file \"%s\" error %i: %s", filename.c_str(), errno, strerror(errno) );
+        }
+
+        struct stat s;
+        if( fstat(file, &s) == -1 ) {
+            close( file );
+            THROW( std::runtime_error, "Failed to get the size of file \"%s\" error %i: %s", filename.c_str(), errno, strerror(errno) );
+        }
+        uint64_t end = (uint64_t)s.st_size;
+#endif
+
+        if( offset > end || (size >= 0 && (uint64_t)size > end - offset) ) {
+#ifdef _WIN32
+            CloseHandle( file );
+#else
+            close( file );
+#endif
+            THROW( std::runtime_error, "Failed to map file \"%s\" - the range (offset %llu, size %lld) is outside of the file (%llu bytes)",
+                   filename.c_str(), (unsigned long long)offset, (long long)size, (unsigned long long)end );
+        }
+        uint64_t length = size >= 0 ? (uint64_t)size : end - offset;
+
+        // Empty ranges can't be mapped
+        if( length == 0 ) {
+#ifdef _WIN32
+            CloseHandle( file );
+#else
+            close( file );
+#endif
+            static const char EMPTY = 0;
+            mapping->map.ptr = &EMPTY;
+            return &mapping.release()->map;
+        }
+
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo( &info );
+        uint64_t viewOffset = offset - offset % info.dwAllocationGranularity;
+
+        HANDLE fileMapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        CloseHandle( file );
+        if( fileMapping == nullptr ) {
+            THROW( std::runtime_error, "Failed to map file \"%s\"", filename.c_str() );
+        }
+
+        mapping->viewSize = (size_t)(offset - viewOffset + length);
+        mapping->view = MapViewOfFile( fileMapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)viewOffset, mapping->viewSize );
+        // The view keeps the mapping alive
+        CloseHandle( fileMapping );
+        if( mapping->view == nullptr ) {
+            THROW( std::runtime_error, "Failed to map file \"%s\"", filename.c_str() );
+        }
+#else
+        uint64_t pageSize = (uint64_t)sysconf( _SC_PAGESIZE );
+        uint64_t viewOffset = offset - offset % pageSize;
+
+        mapping->viewSize = (size_t)(offset - viewOffset + length);
+        mapping->view = mmap( nullptr, mapping->viewSize, PROT_READ, MAP_SHARED, file, (off_t)viewOffset );
+        // The mapping keeps the file open
+        close( file );
+        if( mapping->view == MAP_FAILED ) {
+            THROW( std::runtime_error, "Failed to map file \"%s\" error %i: %s", filename.c_str(), errno, strerror(errno) );
+        }
+#endif
+
+        mapping->map.ptr = static_cast<const char*>(mapping->view) + (offset - viewOffset);
+        mapping->map.size = (size_t)length;
         return &mapping.release()->map;
     }
 
     void unmapFile( FileMapping* ptr )
     {
+        if( !ptr ) return;
+
+        // map is the first member of Mapping
         Mapping *mapping = reinterpret_cast<Mapping*>(ptr);
+        if( mapping->view ) {
+#ifdef _WIN32
+            UnmapViewOfFile( mapping->view );
+#else
+            munmap( mapping->view, mapping->viewSize );
+#endif
+        }
         delete mapping;
     }
 }
@@ -38,6 +38,8 @@ namespace Common
             impl->hedgesLock++;
             impl->edgesLock++;
             impl->facesLock++;
+
+            if (impl->edgeIndex.table) impl->edgeIndex.table->clear();
         }
 
         VertexHandle createVertex( Impl *impl )
@@ -98,8 +100,82 @@ namespace Common
             return !!findFreeHEdge(impl, vertex.hedge());
         }
 
+        void indexEdge( Impl *impl, CHEdgePtr hedge )
+        {
+            HashTable<HEdgeHandle> *table = impl->edgeIndex.table.get();
+            if (!table) return;
+
+            CHEdgePtr pair = hedge.pair();
+            table->insert(EdgeIndex::key(pair->vertex, hedge->vertex), hedge);
+            table->insert(EdgeIndex::key(hedge->vertex, pair->vertex), pair);
+        }
+
+        void unindexEdge( Impl *impl, CHEdgePtr hedge )
+        {
+            HashTable<HEdgeHandle> *table = impl->edgeIndex.table.get();
+            if (!table) return;
+
+            // The entry may already belong to another half edge between the same vertexes,
+            //  while an edit temporarily has two of them (ex. a triangle collapsing into two edges)
+            auto remove = [&]( uint64_t key, HEdgeHandle handle ) {
+                HEdgeHandle *found = table->find(key);
+                if (found && *found == handle) table->remove(key);
+            };
+            CHEdgePtr pair = hedge.pair();
+            remove(EdgeIndex::key(pair->vertex, hedge->vertex), hedge);
+            remove(EdgeIndex::key(hedge->vertex, pair->vertex), pair);
+        }
+
+        void indexVertex( Impl *impl, CVertexPtr vertex )
+        {
+            if (!impl->edgeIndex.table || !vertex->hedge) return;
+
+            CHEdgePtr hedge = vertex.hedge();
+            do {
+                indexEdge(impl, hedge);
+                hedge = hedge.pairNext();
+            } while (hedge != vertex->hedge);
+        }
+
+        void unindexVertex( Impl *impl, CVertexPtr vertex )
+        {
+            if (!impl->edgeIndex.table || !vertex->hedge) return;
+
+            CHEdgePtr hedge = vertex.hedge();
+            do {
+                unindexEdge(impl, hedge);
+                hedge = hedge.pairNext();
+            } while (hedge != vertex->hedge);
+        }
+
+        bool rebuildEdgeIndex( Impl *impl )
+        {
+            HashTable<HEdgeHandle> *table = impl->edgeIndex.table.get();
+            if (!table) return true;
+
+            table->clear();
+            bool ok = true;
+            impl->hedges.forEachWithHandle([&]( HEdgeHandle handle, const HEdge &hedge ) {
+                // Only a loaded mesh can have a half edge without a pair
+                const HEdge *pair = impl->hedges.find(hedge.pair);
+                if (!pair) {
+                    ok = false;
+                    return;
+                }
+                table->insert(EdgeIndex::key(pair->vertex, hedge.vertex), handle);
+            });
+            return ok;
+        }
+
         CHEdgePtr findHEdge( const Impl *impl, CVertexPtr v1, CVertexPtr v2 )
         {
+            if (impl->edgeIndex.table) {
+                if (!(v1 && v2)) return CHEdgePtr();
+
+                const HEdgeHandle *found = impl->edgeIndex.table->find(EdgeIndex::key(v1, v2));
+                return found ? CHEdgePtr(impl, *found) : CHEdgePtr();
+            }
+
             CHEdgePtr hedge = v1.hedge();
             if (!hedge) return CHEdgePtr();
 
@@ -222,6 +298,8 @@ namespace Common
                 h2->prev = e2;
             }
 
+            indexEdge(impl, h1);
+
             impl->onHEdgeCreated(h1);
             impl->onHEdgeCreated(h2);
             impl->onEdgeCreated(edge);
@@ -406,6 +484,7 @@ namespace Common
     {
         *mImpl = *copy.mImpl;
         mImpl->this_ = this;
+        internal::rebuildEdgeIndex(mImpl);
     }
 
     COMMON_API HalfEdgeMeshBase::HalfEdgeMeshBase( HalfEdgeMeshBase &&move )
@@ -418,6 +497,7 @@ namespace Common
     {
         *mImpl = *copy.mImpl;
         mImpl->this_ = this;
+        internal::rebuildEdgeIndex(mImpl);
         return *this;
     }
 
@@ -431,6 +511,33 @@ namespace Common
     COMMON_API void HalfEdgeMeshBase::clear()
     {
         internal::clear(mImpl);
+        onClear();
+    }
+
+    COMMON_API void HalfEdgeMeshBase::setEdgeIndexEnabled( bool enabled )
+    {
+        internal::Impl *impl = mImpl;
+        if (enabled == !!impl->edgeIndex.table) return;
+
+        if (enabled) {
+            impl->edgeIndex.table.reset(new HashTable<HEdgeHandle>(int(impl->hedges.underlying_size())));
+            internal::rebuildEdgeIndex(impl);
+        }
+        else {
+            impl->edgeIndex.table.reset();
+        }
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::isEdgeIndexEnabled() const
+    {
+        const internal::Impl *impl = mImpl;
+        return !!impl->edgeIndex.table;
+    }
+
+    COMMON_API const internal::HalfEdgeMeshTopology& HalfEdgeMeshBase::topology() const
+    {
+        const internal::HalfEdgeMeshBaseImpl *impl = mImpl;
+        return *impl;
     }
 
     COMMON_API HalfEdgeMeshBase::VertexHandle HalfEdgeMeshBase::createVertex()
@@ -589,6 +696,18 @@ namespace Common
 
 #undef _IMPLEMENT_CORE_ITER
 
+#define _IMPLEMENT_PARALLEL_FOR_EACH( Type, member )                                                                                \
+    COMMON_API void HalfEdgeMeshBase::parallelForEach##Type( const std::function<void(Type##Handle)> &func, size_t grainSize, ThreadPool *pool ) const {  \
+        mImpl->member.parallelForEachHandle(func, grainSize, pool);                                                             \
+    }
+
+    _IMPLEMENT_PARALLEL_FOR_EACH(Vertex, vertexes);
+    _IMPLEMENT_PARALLEL_FOR_EACH(HEdge, hedges);
+    _IMPLEMENT_PARALLEL_FOR_EACH(Edge, edges);
+    _IMPLEMENT_PARALLEL_FOR_EACH(Face, faces);
+
+#undef _IMPLEMENT_PARALLEL_FOR_EACH
+
 #define _IMPLEMENT_HEDGE_ITER(Type, name, Handle)                                                       \
     COMMON_API HalfEdgeMeshBase::Type##Range HalfEdgeMeshBase::name( Handle handle ) const {            \
         return Type##Range{name##Begin(handle), name##End(handle)};                                     \
@@ -713,6 +832,18 @@ namespace Common
                 }
             );
 
+            // Check that the edge index finds all hedges
+            if (impl->edgeIndex.table) {
+                impl->hedges.forEachHandle(
+                    [&]( HEdgeHandle handle ) {
+                        CHEdgePtr hedge(impl, handle);
+
+                        const HEdgeHandle *found = impl->edgeIndex.table->find(EdgeIndex::key(hedge.pair()->vertex, hedge->vertex));
+                        FATAL_ASSERT(found && *found == handle, "Half Edge %i is missing in the edge index", (int)handle);
+                    }
+                );
+            }
+
             // Check that all hedges can be reached from its face
             impl->hedges.forEachHandle(
                 [&]( HEdgeHandle handle ) {
@@ -1,7 +1,9 @@
 #include "HalfEdgeMesh.h"
+#include "HalfEdgeMeshTopology.h"
 #include "HashTable.h"
 
 #include <cassert>
+#include <memory>
 
 namespace Common
 {
@@ -12,47 +14,45 @@ namespace Common
         using EdgeHandle = HalfEdgeMeshBase::EdgeHandle;
         using FaceHandle = HalfEdgeMeshBase::FaceHandle;
 
-        struct HEdge {
-            HEdgeHandle pair,
-                        next,
-                        prev;
-            VertexHandle vertex;
-            FaceHandle face;
-            EdgeHandle edge;
-        };
-        struct Vertex {
-            HEdgeHandle hedge;
-        };
-        struct Edge {
-            HEdgeHandle hedge;
-        };
-        struct Face {
-            HEdgeHandle hedge;
-        };
+        // The optional index of the half edges by their end points (see HalfEdgeMeshBase::setEdgeIndexEnabled).
+        //  HashTable can't be copied, so a copy gets an empty table that the mesh rebuilds from the copied topology.
+        struct EdgeIndex {
+            std::unique_ptr<HashTable<HEdgeHandle>> table;
 
-        using VertexVector = HandleVector<VertexHandle, Vertex>;
-        using HEdgeVector = HandleVector<HEdgeHandle, HEdge>;
-        using EdgeVector = HandleVector<EdgeHandle, Edge>;
-        using FaceVector = HandleVector<FaceHandle, Face>;
+            EdgeIndex() = default;
+            EdgeIndex( const EdgeIndex &copy ) :
+                table(copy.table ? new HashTable<HEdgeHandle>() : nullptr)
+            {}
+            EdgeIndex( EdgeIndex&& ) = default;
 
+            EdgeIndex& operator = ( const EdgeIndex &copy ) {
+                table.reset(copy.table ? new HashTable<HEdgeHandle>() : nullptr);
+                return *this;
+            }
+            EdgeIndex& operator = ( EdgeIndex&& ) = default;
 
-        struct HalfEdgeMeshBaseImpl {
+            static uint64_t key( VertexHandle from, VertexHandle to ) {
+                return (uint64_t(from.handle) << 32) | uint64_t(to.handle);
+            }
+        };
+
+        struct HalfEdgeMeshBaseImpl : public HalfEdgeMeshTopology {
             HalfEdgeMeshBase *this_;
 
+            EdgeIndex edgeIndex;
+
             // These *Lock vars is for making sure our smart handle's have cached a valid pointer
-            //  (pointers can be invalidated if new items are allocated, or old ones free'd)
+            //  (pointers are invalidated when old items are free'd, the storage is chunked
+            //   so allocating new items never moves existing ones)
             // In those cases the lock variable is incremented and the next time the smart handle 
-            // tries to use its cached pointer it will refrech it
+            // tries to use its cached pointer it will refrech it.
+            // The tables shares chunks with copies of the mesh, and a shared chunk is cloned by the first non-const lookup in it,
+            //  so the smart handles adds the storageVersion of the table (that changes on both) to the lock
             uint8_t vertexesLock = 0,
                     hedgesLock = 0,
                     edgesLock = 0,
                     facesLock = 0;
 
-            VertexVector vertexes;
-            HEdgeVector hedges;
-            EdgeVector edges;
-            FaceVector faces;
-
             
             void onVertexCreated( VertexHandle handle )  {
                 this_->onVertexCreated(handle);
@@ -79,6 +79,10 @@ namespace Common
             void onFaceDestroyed( FaceHandle handle )  {
                 this_->onFaceDestroyed(handle);
             }
+
+            void onCompact( const HalfEdgeMeshBase::CompactRemap &remap ) {
+                this_->onCompact(remap);
+            }
         };
         
         using Impl = HalfEdgeMeshBaseImpl;
@@ -88,7 +92,7 @@ namespace Common
         {
             // Smart handles enables a easier to chase pointers around
             // They have protection agaist pointer invalidation,
-            // by tracking if any new objects are allocated or free'ing
+            // by tracking if any objects are free'd
 
 #define CREATE_SMART_HANDLE_CONTENT(Name, Member, Type, Handle, const_)         \
             const_ Impl *impl = nullptr;                                        \
@@ -121,13 +125,16 @@ namespace Common
             const_ Type* get() const {                                          \
                 if (impl == nullptr) return nullptr;                            \
                 if (!handle) return nullptr;                                    \
-                if (impl->Member##Lock != lock) ptr = nullptr;                  \
+                if (currentLock() != lock) ptr = nullptr;                       \
                 if (ptr) return ptr;                                            \
                 ptr = impl->Member.find(handle);                                \
                 if (!ptr) handle = Handle();                                    \
-                lock = impl->Member##Lock;                                      \
+                lock = currentLock();                                           \
                 return ptr;                                                     \
             }                                                                   \
+            uint8_t currentLock() const {                                       \
+                return uint8_t(impl->Member##Lock + impl->Member.storageVersion()); \
+            }                                                                   \
             const_ Type* operator -> () const {                                 \
                 const_ Type *ptr = get();                                       \
                 assert (ptr);                                                   \
@@ -159,7 +166,7 @@ namespace Common
                     return CHEdgePtr();
                 }
                 CHEdgePtr prev() const {
-                    if (valid()) return CHEdgePtr{impl, get()->next};
+                    if (valid()) return CHEdgePtr{impl, get()->prev};
                     return CHEdgePtr();
                 }
                 CHEdgePtr pair() const {
@@ -324,13 +331,13 @@ namespace Common
                 return FacePtr();
             }
 
+            // The cached pointer isn't kept, it is from the const lookup that doesn't clone shared chunks
+            //  (see HandleVectorStorage::SharedChunked), so writing through it could change a snapshot of the mesh
             inline VertexPtr asNonConst( const CVertexPtr &ptr )
             {
                 return VertexPtr(
                     const_cast<Impl*>(ptr.impl),
-                    ptr.handle,
-                    const_cast<Vertex*>(ptr.ptr),
-                    ptr.lock
+                    ptr.handle
                 );
             }
 
@@ -338,9 +345,7 @@ namespace Common
             {
                 return HEdgePtr(
                     const_cast<Impl*>(ptr.impl),
-                    ptr.handle,
-                    const_cast<HEdge*>(ptr.ptr),
-                    ptr.lock
+                    ptr.handle
                 );
             }
 
@@ -348,9 +353,7 @@ namespace Common
             {
                 return EdgePtr(
                     const_cast<Impl*>(ptr.impl),
-                    ptr.handle,
-                    const_cast<Edge*>(ptr.ptr),
-                    ptr.lock
+                    ptr.handle
                 );
             }
 
@@ -358,9 +361,7 @@ namespace Common
             {
                 return FacePtr(
                     const_cast<Impl*>(ptr.impl),
-                    ptr.handle,
-                    const_cast<Face*>(ptr.ptr),
-                    ptr.lock
+                    ptr.handle
                 );
             }
 
@@ -393,6 +394,16 @@ namespace Common
 
         bool isFree( Impl *impl, VertexPtr vertex );
 
+        // Keeps the edge index up to date, they do nothing if it is disabled.
+        //  The edge functions updates both half edges of the edge, and the vertex functions every edge around the vertex.
+        //  Unindex before the end points changes, and index once the links are done.
+        void indexEdge( Impl *impl, CHEdgePtr hedge );
+        void unindexEdge( Impl *impl, CHEdgePtr hedge );
+        void indexVertex( Impl *impl, CVertexPtr vertex );
+        void unindexVertex( Impl *impl, CVertexPtr vertex );
+        // Returns false if a half edge doesn't have a pair (the index is then incomplete)
+        bool rebuildEdgeIndex( Impl *impl );
+
         CHEdgePtr findHEdge( const Impl *impl, CVertexPtr v1, CVertexPtr v2 );
         HEdgePtr findHEdge( Impl *impl, VertexPtr v1, VertexPtr v2 );
 
@@ -407,15 +418,25 @@ namespace Common
         FacePtr createFace( Impl *impl, const HEdgeHandle *handles, size_t count );
         FacePtr createFace( Impl *impl, const VertexHandle *handles, size_t vertexCount );
 
+        bool buildFromIndexed( Impl *impl, const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount, VertexHandle *vertexesOut, FaceHandle *facesOut, ThreadPool *pool );
+
+        bool removeFace( Impl *impl, FacePtr face, bool removeIsolatedVertexes );
+        bool removeVertex( Impl *impl, VertexPtr vertex );
+        bool flipEdge( Impl *impl, EdgePtr edge );
+        VertexPtr splitEdge( Impl *impl, EdgePtr edge );
+        FacePtr splitFace( Impl *impl, FacePtr face, VertexPtr v1, VertexPtr v2 );
+        bool isCollapseOk( const Impl *impl, CHEdgePtr hedge );
+        bool collapseEdge( Impl *impl, HEdgePtr hedge );
+
+        HalfEdgeMeshBase::CompactRemap compact( Impl *impl, ThreadPool *pool );
+
 
         // Need dedicated allocate and free functions to
         // make sure that the lock is updated accordingly
+        //  (allocating doesn't need to touch the lock, the storage never moves)
 #define CREATE_ALLOCATE_AND_FREE( Type, TypePtr, Handle, Member )       \
         inline TypePtr allocate##Type ( Impl *impl ) {                  \
             Handle handle = impl->Member.emplace();                     \
-            if (handle) {                                               \
-                impl->Member##Lock++;                                   \
-            }                                                           \
             return TypePtr{impl, handle};                               \
         }                                                               \
         inline void free##Type( Impl *impl, Handle handle ) {           \
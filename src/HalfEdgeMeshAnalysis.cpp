@@ -0,0 +1,241 @@
+#include "HalfEdgeMeshAnalysis.h"
+
+#include <algorithm>
+
+namespace Common
+{
+    namespace AnalysisImpl
+    {
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+        using HEdgeHandle = HalfEdgeMeshBase::HEdgeHandle;
+        using EdgeHandle = HalfEdgeMeshBase::EdgeHandle;
+        using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+        using Topology = internal::HalfEdgeMeshTopology;
+
+        static const size_t GRAIN_SIZE = 1024;
+        static const uint32_t INVALID = MeshComponents::INVALID;
+
+        inline size_t slot( VertexHandle handle ) { return internal::VertexVector::SlotIndex(handle); }
+        inline size_t slot( HEdgeHandle handle ) { return internal::HEdgeVector::SlotIndex(handle); }
+        inline size_t slot( EdgeHandle handle ) { return internal::EdgeVector::SlotIndex(handle); }
+        inline size_t slot( FaceHandle handle ) { return internal::FaceVector::SlotIndex(handle); }
+
+        inline const internal::HEdge& hedge( const Topology &topology, HEdgeHandle handle )
+        {
+            return *topology.hedges.find(handle);
+        }
+
+        // The root of a set is always its lowest slot, so the components are numbered in slot order
+        uint32_t findRoot( std::vector<uint32_t> &parent, uint32_t index )
+        {
+            while (parent[index] != index) {
+                parent[index] = parent[parent[index]];
+                index = parent[index];
+            }
+            return index;
+        }
+
+        // Appends the handles of the flagged slots, in slot order
+        template< typename Vector, typename Handle >
+        void gather( const Vector &vector, const std::vector<uint8_t> &flags, std::vector<Handle> &result )
+        {
+            vector.forEachHandle([&]( Handle handle ) {
+                if (flags[slot(handle)]) result.push_back(handle);
+            });
+        }
+    }
+
+    COMMON_API MeshBoundaryLoops findBoundaryLoops( const HalfEdgeMeshBase &mesh )
+    {
+        using namespace AnalysisImpl;
+
+        const Topology &topology = mesh.topology();
+
+        MeshBoundaryLoops result;
+        result.loopStart.push_back(0);
+
+        std::vector<uint8_t> visited(topology.hedges.underlying_size(), 0);
+        topology.hedges.forEachWithHandle([&]( HEdgeHandle handle, const internal::HEdge &h ) {
+            if (h.face || visited[slot(handle)]) return;
+
+            HEdgeHandle current = handle;
+            do {
+                visited[slot(current)] = 1;
+                result.hedges.push_back(current);
+                current = hedge(topology, current).next;
+            } while (current != handle);
+            result.loopStart.push_back(uint32_t(result.hedges.size()));
+        });
+        return result;
+    }
+
+    COMMON_API MeshComponents labelComponents( const HalfEdgeMeshBase &mesh, ThreadPool *pool )
+    {
+        using namespace AnalysisImpl;
+
+        if (!pool) pool = &ThreadPool::Global();
+        const Topology &topology = mesh.topology();
+
+        MeshComponents result;
+        result.vertexLabels.assign(topology.vertexes.underlying_size(), INVALID);
+        result.faceLabels.assign(topology.faces.underlying_size(), INVALID);
+
+        // The end points of each edge slot, fetched in parallel as it is mostly cache misses
+        std::vector<uint32_t> endPoints(topology.edges.underlying_size() * 2, INVALID);
+        topology.edges.parallelForEachWithHandle([&]( EdgeHandle handle, const internal::Edge &edge ) {
+            const internal::HEdge &h = hedge(topology, edge.hedge);
+            endPoints[slot(handle)*2]   = uint32_t(slot(h.vertex));
+            endPoints[slot(handle)*2+1] = uint32_t(slot(hedge(topology, h.pair).vertex));
+        }, GRAIN_SIZE, pool);
+
+        std::vector<uint32_t> &parent = result.vertexLabels;
+        topology.vertexes.forEachHandle([&]( VertexHandle handle ) {
+            parent[slot(handle)] = uint32_t(slot(handle));
+        });
+        for (size_t i=0; i < endPoints.size(); i += 2) {
+            if (endPoints[i] == INVALID) continue;
+
+            uint32_t a = findRoot(parent, endPoints[i]),
+                     b = findRoot(parent, endPoints[i+1]);
+            if (a < b) parent[b] = a;
+            else if (b < a) parent[a] = b;
+        }
+
+        // The parent of a vertex is never after it, so one pass in slot order replaces the parents with the labels
+        for (size_t i=0; i < parent.size(); ++i) {
+            if (parent[i] == INVALID) continue;
+
+            if (parent[i] == i) {
+                parent[i] = uint32_t(result.components.size());
+                result.components.emplace_back();
+            }
+            else {
+                parent[i] = parent[parent[i]];
+            }
+            result.components[parent[i]].vertexes++;
+        }
+
+        topology.faces.parallelForEachWithHandle([&]( FaceHandle handle, const internal::Face &face ) {
+            result.faceLabels[slot(handle)] = result.vertexLabels[slot(hedge(topology, face.hedge).vertex)];
+        }, GRAIN_SIZE, pool);
+
+        for (size_t i=0; i < endPoints.size(); i += 2) {
+            if (endPoints[i] == INVALID) continue;
+            result.components[result.vertexLabels[endPoints[i]]].edges++;
+        }
+        for (uint32_t label : result.faceLabels) {
+            if (label == INVALID) continue;
+            result.components[label].faces++;
+        }
+
+        MeshBoundaryLoops loops = findBoundaryLoops(mesh);
+        for (size_t i=0; i < loops.size(); ++i) {
+            const internal::HEdge &h = hedge(topology, loops.hedges[loops.loopStart[i]]);
+            result.components[result.vertexLabels[slot(h.vertex)]].boundaryLoops++;
+        }
+
+        for (MeshComponents::Component &component : result.components) {
+            component.eulerCharacteristic = int64_t(component.vertexes) - int64_t(component.edges) + int64_t(component.faces);
+            component.genus = (2 - component.eulerCharacteristic - int64_t(component.boundaryLoops)) / 2;
+        }
+        return result;
+    }
+
+    COMMON_API ManifoldReport validateManifold( const HalfEdgeMeshBase &mesh, ThreadPool *pool )
+    {
+        using namespace AnalysisImpl;
+
+        if (!pool) pool = &ThreadPool::Global();
+        const Topology &topology = mesh.topology();
+
+        std::vector<uint8_t> hedgeFlags(topology.hedges.underlying_size(), 0),
+                             vertexFlags(topology.vertexes.underlying_size(), 0),
+                             edgeFlags(topology.edges.underlying_size(), 0),
+                             faceFlags(topology.faces.underlying_size(), 0);
+
+        // The links, each pass only writes the flags of its own elements
+        topology.hedges.parallelForEachWithHandle([&]( HEdgeHandle handle, const internal::HEdge &h ) {
+            const internal::HEdge *pair = topology.hedges.find(h.pair),
+                                  *next = topology.hedges.find(h.next),
+                                  *prev = topology.hedges.find(h.prev);
+            bool valid = pair && next && prev &&
+                         pair->pair == handle && next->prev == handle && prev->next == handle &&
+                         pair->edge == h.edge && next->face == h.face &&
+                         topology.vertexes.find(h.vertex) && topology.edges.find(h.edge) &&
+                         (!h.face || topology.faces.find(h.face));
+            hedgeFlags[slot(handle)] = !valid;
+        }, GRAIN_SIZE, pool);
+        topology.vertexes.parallelForEachWithHandle([&]( VertexHandle handle, const internal::Vertex &vertex ) {
+            if (!vertex.hedge) return;
+            const internal::HEdge *h = topology.hedges.find(vertex.hedge);
+            const internal::HEdge *pair = h ? topology.hedges.find(h->pair) : nullptr;
+            vertexFlags[slot(handle)] = !pair || pair->vertex != handle;
+        }, GRAIN_SIZE, pool);
+        topology.edges.parallelForEachWithHandle([&]( EdgeHandle handle, const internal::Edge &edge ) {
+            const internal::HEdge *h = topology.hedges.find(edge.hedge);
+            edgeFlags[slot(handle)] = !h || h->edge != handle;
+        }, GRAIN_SIZE, pool);
+        topology.faces.parallelForEachWithHandle([&]( FaceHandle handle, const internal::Face &face ) {
+            const internal::HEdge *h = topology.hedges.find(face.hedge);
+            faceFlags[slot(handle)] = !h || h->face != handle;
+        }, GRAIN_SIZE, pool);
+
+        auto anyFlag = []( const std::vector<uint8_t> &flags ) {
+            return std::find(flags.begin(), flags.end(), 1) != flags.end();
+        };
+        bool broken = anyFlag(hedgeFlags) || anyFlag(vertexFlags) || anyFlag(edgeFlags) || anyFlag(faceFlags);
+
+        // With consistent links next and pair->next are permutations of the half edges,
+        //  so every walk around a face or vertex comes back to where it started
+        if (!broken) {
+            topology.faces.parallelForEachWithHandle([&]( FaceHandle handle, const internal::Face &face ) {
+                thread_local std::vector<VertexHandle> vertexes;
+                vertexes.clear();
+
+                HEdgeHandle current = face.hedge;
+                do {
+                    const internal::HEdge &h = hedge(topology, current);
+                    vertexes.push_back(h.vertex);
+                    current = h.next;
+                } while (current != face.hedge);
+
+                std::sort(vertexes.begin(), vertexes.end());
+                faceFlags[slot(handle)] = vertexes.size() < 3 || std::adjacent_find(vertexes.begin(), vertexes.end()) != vertexes.end();
+            }, GRAIN_SIZE, pool);
+
+            topology.edges.parallelForEachWithHandle([&]( EdgeHandle handle, const internal::Edge &edge ) {
+                const internal::HEdge &h = hedge(topology, edge.hedge),
+                                      &pair = hedge(topology, h.pair);
+                edgeFlags[slot(handle)] = (!h.face && !pair.face) || h.vertex == pair.vertex;
+            }, GRAIN_SIZE, pool);
+
+            // A vertex is a single fan if the walk around it finds all its outgoing half edges,
+            //  and passes at most one gap (a half edge without a face)
+            std::vector<uint32_t> outgoing(topology.vertexes.underlying_size(), 0);
+            topology.hedges.forEach([&]( const internal::HEdge &h ) {
+                outgoing[slot(hedge(topology, h.pair).vertex)]++;
+            });
+
+            topology.vertexes.parallelForEachWithHandle([&]( VertexHandle handle, const internal::Vertex &vertex ) {
+                uint32_t steps = 0, gaps = 0;
+                if (vertex.hedge) {
+                    HEdgeHandle current = vertex.hedge;
+                    do {
+                        const internal::HEdge &h = hedge(topology, current);
+                        if (!h.face) gaps++;
+                        steps++;
+                        current = hedge(topology, h.pair).next;
+                    } while (current != vertex.hedge);
+                }
+                vertexFlags[slot(handle)] = steps != outgoing[slot(handle)] || gaps > 1;
+            }, GRAIN_SIZE, pool);
+        }
+
+        ManifoldReport report;
+        gather(topology.hedges, hedgeFlags, report.brokenHEdges);
+        gather(topology.faces, faceFlags, report.degenerateFaces);
+        gather(topology.edges, edgeFlags, report.nonManifoldEdges);
+        gather(topology.vertexes, vertexFlags, report.nonManifoldVertexes);
+        return report;
+    }
+}
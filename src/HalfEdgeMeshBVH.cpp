@@ -0,0 +1,662 @@
+#include "HalfEdgeMeshBVH.h"
+#include "HalfEdgeMeshIterator.h"
+#include "HalfEdgeMeshCirculator.h"
+
+#include "ErrorUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Common
+{
+    struct HalfEdgeMeshBVHImpl
+    {
+        using Node = HalfEdgeMeshBVH::Node;
+        using Triangle = HalfEdgeMeshBVH::Triangle;
+        using Hit = HalfEdgeMeshBVH::Hit;
+        using VertexHandle = HalfEdgeMeshBVH::VertexHandle;
+        using FaceHandle = HalfEdgeMeshBVH::FaceHandle;
+
+        static const size_t GRAIN_SIZE = 1024;
+        // Ranges smaller than this are always leafs, larger ones only if the SAH says so (up to MAX_LEAF_SIZE)
+        static const uint32_t MIN_LEAF_SIZE = 2;
+        static const uint32_t MAX_LEAF_SIZE = 8;
+        static const uint32_t BIN_COUNT = 16;
+        // Subtrees with less triangles than this are built as one job, which is independent of the
+        //  number of threads so the tree is always the same
+        static const uint32_t JOB_SIZE = 16*1024;
+        static const uint32_t EMPTY = ~0u;
+        static const int STACK_SIZE = 64;
+
+        struct Bounds {
+            float min[3] = { INFINITY,  INFINITY,  INFINITY},
+                  max[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+            void grow( const float *point ) {
+                for (int i=0; i < 3; ++i) {
+                    min[i] = std::min(min[i], point[i]);
+                    max[i] = std::max(max[i], point[i]);
+                }
+            }
+            void grow( const Bounds &other ) {
+                for (int i=0; i < 3; ++i) {
+                    min[i] = std::min(min[i], other.min[i]);
+                    max[i] = std::max(max[i], other.max[i]);
+                }
+            }
+            bool empty() const {
+                return min[0] > max[0];
+            }
+            float area() const {
+                if (empty()) return 0;
+                float x = max[0] - min[0],
+                      y = max[1] - min[1],
+                      z = max[2] - min[2];
+                return 2 * (x*y + y*z + z*x);
+            }
+        };
+
+        // A child of a node, that hasn't been written to its node yet
+        struct Child {
+            Bounds bounds;
+            uint32_t child = EMPTY,
+                     count = 0;
+        };
+
+        // A subtree that is built in parallel, its root is written to 'slot' of 'node'
+        struct Job {
+            uint32_t begin, end;
+            uint32_t node, slot;
+            std::vector<Node> nodes;
+            Child root;
+        };
+
+        struct Build {
+            std::vector<Bounds> bounds;
+            std::vector<float> centroids;
+            std::vector<uint32_t> order;
+            std::vector<Job> jobs;
+        };
+
+        static void setChild( Node &node, uint32_t slot, const Child &child )
+        {
+            node.minX[slot] = child.bounds.min[0];
+            node.minY[slot] = child.bounds.min[1];
+            node.minZ[slot] = child.bounds.min[2];
+            node.maxX[slot] = child.bounds.max[0];
+            node.maxY[slot] = child.bounds.max[1];
+            node.maxZ[slot] = child.bounds.max[2];
+            node.child[slot] = child.child;
+            node.count[slot] = child.count;
+        }
+
+        static Bounds childBounds( const Node &node, uint32_t slot )
+        {
+            Bounds bounds;
+            bounds.min[0] = node.minX[slot];
+            bounds.min[1] = node.minY[slot];
+            bounds.min[2] = node.minZ[slot];
+            bounds.max[0] = node.maxX[slot];
+            bounds.max[1] = node.maxY[slot];
+            bounds.max[2] = node.maxZ[slot];
+            return bounds;
+        }
+
+        static Bounds triangleBounds( const Triangle &triangle )
+        {
+            Bounds bounds;
+            for (int i=0; i < 3; ++i) {
+                bounds.grow(triangle.p[i]);
+            }
+            return bounds;
+        }
+
+        static const float* centroid( const Build &build, uint32_t triangle )
+        {
+            return &build.centroids[triangle*3];
+        }
+
+        // Splits order[begin, end) in two with the surface area heuristic, returns the split point (or 'begin' if it should be a leaf)
+        static uint32_t split( Build &build, uint32_t begin, uint32_t end, const Bounds &bounds, Bounds &leftBounds, Bounds &rightBounds )
+        {
+            uint32_t count = end - begin;
+
+            Bounds centroidBounds;
+            for (uint32_t i=begin; i < end; ++i) {
+                centroidBounds.grow(centroid(build, build.order[i]));
+            }
+
+            int axis = 0;
+            for (int i=1; i < 3; ++i) {
+                if (centroidBounds.max[i] - centroidBounds.min[i] > centroidBounds.max[axis] - centroidBounds.min[axis]) {
+                    axis = i;
+                }
+            }
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+
+            uint32_t mid = begin;
+            if (extent > 0) {
+                Bounds binBounds[BIN_COUNT];
+                uint32_t binCount[BIN_COUNT] = {};
+
+                float scale = BIN_COUNT / extent;
+                auto binOf = [&]( uint32_t triangle ) {
+                    uint32_t bin = uint32_t((centroid(build, triangle)[axis] - centroidBounds.min[axis]) * scale);
+                    return std::min(bin, BIN_COUNT-1);
+                };
+
+                for (uint32_t i=begin; i < end; ++i) {
+                    uint32_t triangle = build.order[i];
+                    uint32_t bin = binOf(triangle);
+                    binCount[bin]++;
+                    binBounds[bin].grow(build.bounds[triangle]);
+                }
+
+                // Sweep from the right, then from the left to find the cheapest split
+                Bounds rightAccum[BIN_COUNT];
+                uint32_t rightCount[BIN_COUNT];
+                {
+                    Bounds accum;
+                    uint32_t accumCount = 0;
+                    for (uint32_t i=BIN_COUNT-1; i > 0; --i) {
+                        accum.grow(binBounds[i]);
+                        accumCount += binCount[i];
+                        rightAccum[i] = accum;
+                        rightCount[i] = accumCount;
+                    }
+                }
+
+                float bestCost = INFINITY;
+                uint32_t bestSplit = 0;
+                Bounds accum;
+                uint32_t accumCount = 0;
+                for (uint32_t i=1; i < BIN_COUNT; ++i) {
+                    accum.grow(binBounds[i-1]);
+                    accumCount += binCount[i-1];
+                    if (accumCount == 0 || rightCount[i] == 0) continue;
+
+                    float cost = accum.area() * accumCount + rightAccum[i].area() * rightCount[i];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestSplit = i;
+                        leftBounds = accum;
+                        rightBounds = rightAccum[i];
+                    }
+                }
+
+                // A leaf is cheaper (intersecting a triangle is about as expensive as a node)
+                if (count <= MAX_LEAF_SIZE && bestCost >= bounds.area() * (count - 1)) {
+                    return begin;
+                }
+
+                if (bestSplit > 0) {
+                    uint32_t *first = build.order.data() + begin,
+                             *last = build.order.data() + end;
+                    mid = uint32_t(std::partition(first, last, [&]( uint32_t triangle ) {
+                        return binOf(triangle) < bestSplit;
+                    }) - build.order.data());
+                }
+            }
+            else if (count <= MAX_LEAF_SIZE) {
+                return begin;
+            }
+
+            if (mid == begin || mid == end) {
+                // All centroids are in the same place, split in the middle
+                mid = begin + count / 2;
+                std::nth_element(build.order.begin() + begin, build.order.begin() + mid, build.order.begin() + end, [&]( uint32_t lhs, uint32_t rhs ) {
+                    float l = centroid(build, lhs)[axis],
+                          r = centroid(build, rhs)[axis];
+                    if (l != r) return l < r;
+                    return lhs < rhs;
+                });
+
+                leftBounds = Bounds();
+                rightBounds = Bounds();
+                for (uint32_t i=begin; i < mid; ++i) leftBounds.grow(build.bounds[build.order[i]]);
+                for (uint32_t i=mid; i < end; ++i) rightBounds.grow(build.bounds[build.order[i]]);
+            }
+            return mid;
+        }
+
+        // Builds the tree for order[begin, end) into 'nodes', ranges small enough are left as jobs if 'jobs' is true
+        static Child buildRange( Build &build, std::vector<Node> &nodes, uint32_t begin, uint32_t end, const Bounds &bounds, bool jobs )
+        {
+            Child result;
+            result.bounds = bounds;
+
+            if (end - begin <= MIN_LEAF_SIZE) {
+                result.child = begin;
+                result.count = end - begin;
+                return result;
+            }
+
+            Bounds childBounds[2];
+            uint32_t mid = split(build, begin, end, bounds, childBounds[0], childBounds[1]);
+            if (mid == begin) {
+                result.child = begin;
+                result.count = end - begin;
+                return result;
+            }
+
+            uint32_t index = uint32_t(nodes.size());
+            nodes.emplace_back();
+
+            uint32_t ranges[2][2] = {{begin, mid}, {mid, end}};
+            for (uint32_t slot=0; slot < 2; ++slot) {
+                uint32_t first = ranges[slot][0],
+                         last = ranges[slot][1];
+
+                if (jobs && last - first > MIN_LEAF_SIZE && last - first <= JOB_SIZE) {
+                    Job job;
+                    job.begin = first;
+                    job.end = last;
+                    job.node = index;
+                    job.slot = slot;
+                    job.root.bounds = childBounds[slot];
+                    build.jobs.push_back(std::move(job));
+                    continue;
+                }
+
+                Child child = buildRange(build, nodes, first, last, childBounds[slot], jobs);
+                setChild(nodes[index], slot, child);
+            }
+
+            result.child = index;
+            return result;
+        }
+
+        static Bounds leafBounds( const HalfEdgeMeshBVH &bvh, uint32_t first, uint32_t count )
+        {
+            Bounds bounds;
+            for (uint32_t i=first; i < first + count; ++i) {
+                bounds.grow(triangleBounds(bvh.mTriangles[i]));
+            }
+            return bounds;
+        }
+
+        // Updates the bounds of every node from its children, the children always comes after their parent
+        static void refitNodes( HalfEdgeMeshBVH &bvh, ThreadPool *pool )
+        {
+            std::vector<Node> &nodes = bvh.mNodes;
+
+            pool->parallelFor(nodes.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    Node &node = nodes[i];
+                    for (uint32_t slot=0; slot < 2; ++slot) {
+                        if (node.count[slot] > 0) {
+                            Child child;
+                            child.bounds = leafBounds(bvh, node.child[slot], node.count[slot]);
+                            child.child = node.child[slot];
+                            child.count = node.count[slot];
+                            setChild(node, slot, child);
+                        }
+                    }
+                }
+            });
+
+            for (size_t i=nodes.size(); i-- > 0;) {
+                Node &node = nodes[i];
+                for (uint32_t slot=0; slot < 2; ++slot) {
+                    if (node.count[slot] > 0 || node.child[slot] == EMPTY) continue;
+
+                    const Node &child = nodes[node.child[slot]];
+                    Child updated;
+                    updated.bounds = childBounds(child, 0);
+                    updated.bounds.grow(childBounds(child, 1));
+                    updated.child = node.child[slot];
+                    setChild(node, slot, updated);
+                }
+            }
+        }
+
+        static void readPositions( Triangle &triangle, const HalfEdgeMeshBVH::GetPosition &getPosition )
+        {
+            for (int i=0; i < 3; ++i) {
+                getPosition(triangle.vertexes[i], triangle.p[i]);
+            }
+        }
+
+        // Möller-Trumbore, both sides of the triangle are hit
+        static bool intersect( const Triangle &triangle, const float *origin, const float *direction, float maxT, float &t )
+        {
+            const float *p0 = triangle.p[0], *p1 = triangle.p[1], *p2 = triangle.p[2];
+
+            float e1[3] = {p1[0]-p0[0], p1[1]-p0[1], p1[2]-p0[2]},
+                  e2[3] = {p2[0]-p0[0], p2[1]-p0[1], p2[2]-p0[2]};
+            float pv[3] = {
+                direction[1]*e2[2] - direction[2]*e2[1],
+                direction[2]*e2[0] - direction[0]*e2[2],
+                direction[0]*e2[1] - direction[1]*e2[0]
+            };
+            float det = e1[0]*pv[0] + e1[1]*pv[1] + e1[2]*pv[2];
+            if (det == 0) return false;
+            float inv = 1.f / det;
+
+            float tv[3] = {origin[0]-p0[0], origin[1]-p0[1], origin[2]-p0[2]};
+            float u = (tv[0]*pv[0] + tv[1]*pv[1] + tv[2]*pv[2]) * inv;
+            if (u < 0 || u > 1) return false;
+
+            float qv[3] = {
+                tv[1]*e1[2] - tv[2]*e1[1],
+                tv[2]*e1[0] - tv[0]*e1[2],
+                tv[0]*e1[1] - tv[1]*e1[0]
+            };
+            float v = (direction[0]*qv[0] + direction[1]*qv[1] + direction[2]*qv[2]) * inv;
+            if (v < 0 || u + v > 1) return false;
+
+            float hit = (e2[0]*qv[0] + e2[1]*qv[1] + e2[2]*qv[2]) * inv;
+            if (hit < 0 || hit > maxT) return false;
+
+            t = hit;
+            return true;
+        }
+
+        // From Real-Time Collision Detection (Ericson), 5.1.5
+        static void closestPointOnTriangle( const Triangle &triangle, const float *point, float *out )
+        {
+            auto sub = []( const float *a, const float *b, float *r ) {
+                r[0] = a[0]-b[0]; r[1] = a[1]-b[1]; r[2] = a[2]-b[2];
+            };
+            auto dot = []( const float *a, const float *b ) {
+                return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+            };
+            auto set = [&]( const float *base, const float *dirA, float sa, const float *dirB, float sb ) {
+                for (int i=0; i < 3; ++i) out[i] = base[i] + dirA[i]*sa + dirB[i]*sb;
+            };
+
+            const float *a = triangle.p[0], *b = triangle.p[1], *c = triangle.p[2];
+            float ab[3], ac[3], ap[3], bp[3], cp[3];
+            sub(b, a, ab); sub(c, a, ac); sub(point, a, ap);
+
+            float d1 = dot(ab, ap), d2 = dot(ac, ap);
+            if (d1 <= 0 && d2 <= 0) return set(a, ab, 0, ac, 0);
+
+            sub(point, b, bp);
+            float d3 = dot(ab, bp), d4 = dot(ac, bp);
+            if (d3 >= 0 && d4 <= d3) return set(b, ab, 0, ac, 0);
+
+            float vc = d1*d4 - d3*d2;
+            if (vc <= 0 && d1 >= 0 && d3 <= 0) return set(a, ab, d1 / (d1 - d3), ac, 0);
+
+            sub(point, c, cp);
+            float d5 = dot(ab, cp), d6 = dot(ac, cp);
+            if (d6 >= 0 && d5 <= d6) return set(c, ab, 0, ac, 0);
+
+            float vb = d5*d2 - d1*d6;
+            if (vb <= 0 && d2 >= 0 && d6 <= 0) return set(a, ab, 0, ac, d2 / (d2 - d6));
+
+            float va = d3*d6 - d5*d4;
+            if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+                float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                float bc[3];
+                sub(c, b, bc);
+                return set(b, bc, w, ab, 0);
+            }
+
+            float denom = 1.f / (va + vb + vc);
+            return set(a, ab, vb * denom, ac, vc * denom);
+        }
+    };
+
+    using Impl = HalfEdgeMeshBVHImpl;
+
+    COMMON_API void HalfEdgeMeshBVH::build( const HalfEdgeMeshBase &mesh, const GetPosition &getPosition, ThreadPool *pool )
+    {
+        if (!pool) pool = &ThreadPool::Global();
+        clear();
+
+        const internal::HalfEdgeMeshTopology &topology = mesh.topology();
+
+        // Each face becomes a triangle fan
+        std::vector<FaceHandle> faces;
+        std::vector<uint32_t> firstTriangle;
+        size_t triangleCount = 0;
+        for (FaceHandle face : mesh.faces()) {
+            size_t count = 0;
+            for (VertexHandle vertex : HalfEdgeMeshCirculators::faceVertexes(topology, face)) {
+                (void)vertex;
+                count++;
+            }
+            faces.push_back(face);
+            firstTriangle.push_back(uint32_t(triangleCount));
+            triangleCount += count - 2;
+        }
+        if (triangleCount >= Impl::EMPTY) {
+            LOG_ERROR("Can't build a BVH over %zu triangles", triangleCount);
+            return;
+        }
+
+        std::vector<Triangle> triangles(triangleCount);
+        pool->parallelFor(faces.size(), Impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t f=begin; f < end; ++f) {
+                Triangle *triangle = &triangles[firstTriangle[f]];
+
+                VertexHandle first, previous;
+                for (VertexHandle vertex : HalfEdgeMeshCirculators::faceVertexes(topology, faces[f])) {
+                    if (!first) {
+                        first = vertex;
+                    }
+                    else if (previous != first) {
+                        triangle->vertexes[0] = first;
+                        triangle->vertexes[1] = previous;
+                        triangle->vertexes[2] = vertex;
+                        triangle->face = faces[f];
+                        Impl::readPositions(*triangle, getPosition);
+                        triangle++;
+                    }
+                    previous = vertex;
+                }
+            }
+        });
+
+        Impl::Build build;
+        build.bounds.resize(triangleCount);
+        build.centroids.resize(triangleCount * 3);
+        build.order.resize(triangleCount);
+        pool->parallelFor(triangleCount, Impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                Impl::Bounds bounds = Impl::triangleBounds(triangles[i]);
+                build.bounds[i] = bounds;
+                for (int axis=0; axis < 3; ++axis) {
+                    build.centroids[i*3 + axis] = (bounds.min[axis] + bounds.max[axis]) * 0.5f;
+                }
+                build.order[i] = uint32_t(i);
+            }
+        });
+
+        Impl::Bounds rootBounds;
+        for (const Impl::Bounds &bounds : build.bounds) {
+            rootBounds.grow(bounds);
+        }
+
+        // The top of the tree on this thread, then the subtrees in parallel
+        Impl::Child root = Impl::buildRange(build, mNodes, 0, uint32_t(triangleCount), rootBounds, true);
+
+        pool->parallelFor(build.jobs.size(), 1, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                Impl::Job &job = build.jobs[i];
+                job.root = Impl::buildRange(build, job.nodes, job.begin, job.end, job.root.bounds, false);
+            }
+        });
+
+        for (Impl::Job &job : build.jobs) {
+            uint32_t offset = uint32_t(mNodes.size());
+            for (Node &node : job.nodes) {
+                for (uint32_t slot=0; slot < 2; ++slot) {
+                    if (node.count[slot] == 0 && node.child[slot] != Impl::EMPTY) {
+                        node.child[slot] += offset;
+                    }
+                }
+                mNodes.push_back(node);
+            }
+            if (job.root.count == 0) {
+                job.root.child += offset;
+            }
+            Impl::setChild(mNodes[job.node], job.slot, job.root);
+        }
+
+        // The root is always a node, even if it only has one leaf
+        if (mNodes.empty() && triangleCount > 0) {
+            Node node;
+            Impl::setChild(node, 0, root);
+            Impl::setChild(node, 1, Impl::Child());
+            mNodes.push_back(node);
+        }
+
+        // The triangles are stored in leaf order
+        mTriangles.resize(triangleCount);
+        pool->parallelFor(triangleCount, Impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                mTriangles[i] = triangles[build.order[i]];
+            }
+        });
+    }
+
+    COMMON_API void HalfEdgeMeshBVH::refit( const GetPosition &getPosition, ThreadPool *pool )
+    {
+        if (!pool) pool = &ThreadPool::Global();
+
+        pool->parallelFor(mTriangles.size(), Impl::GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t i=begin; i < end; ++i) {
+                Impl::readPositions(mTriangles[i], getPosition);
+            }
+        });
+        Impl::refitNodes(*this, pool);
+    }
+
+    COMMON_API void HalfEdgeMeshBVH::clear()
+    {
+        mNodes.clear();
+        mTriangles.clear();
+    }
+
+    COMMON_API bool HalfEdgeMeshBVH::raycast( const float *origin, const float *direction, float maxDistance, Hit &hit ) const
+    {
+        if (mNodes.empty()) return false;
+
+        // A zero component would give 0*inf = NaN in the slab test when the origin is on a bound
+        float inv[3];
+        for (int i=0; i < 3; ++i) {
+            inv[i] = std::abs(direction[i]) > 1e-20f ? 1.f / direction[i] : std::copysign(1e20f, direction[i]);
+        }
+        float best = maxDistance;
+        const Triangle *found = nullptr;
+
+        auto testLeaf = [&]( uint32_t first, uint32_t count ) {
+            for (uint32_t i=first; i < first + count; ++i) {
+                float t;
+                if (Impl::intersect(mTriangles[i], origin, direction, best, t)) {
+                    best = t;
+                    found = &mTriangles[i];
+                }
+            }
+        };
+
+        uint32_t stack[Impl::STACK_SIZE];
+        int size = 0;
+        stack[size++] = 0;
+
+        while (size > 0) {
+            const Node &node = mNodes[stack[--size]];
+
+            float tNear[2];
+            bool hits[2];
+            for (int i=0; i < 2; ++i) {
+                float x0 = (node.minX[i] - origin[0]) * inv[0], x1 = (node.maxX[i] - origin[0]) * inv[0],
+                      y0 = (node.minY[i] - origin[1]) * inv[1], y1 = (node.maxY[i] - origin[1]) * inv[1],
+                      z0 = (node.minZ[i] - origin[2]) * inv[2], z1 = (node.maxZ[i] - origin[2]) * inv[2];
+                float tMin = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.f)),
+                      tMax = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), best));
+                tNear[i] = tMin;
+                hits[i] = tMin <= tMax && node.child[i] != Impl::EMPTY;
+            }
+
+            int nearChild = tNear[1] < tNear[0] ? 1 : 0,
+                farChild = 1 - nearChild;
+
+            for (int i : {nearChild, farChild}) {
+                if (hits[i] && node.count[i] > 0 && tNear[i] <= best) {
+                    testLeaf(node.child[i], node.count[i]);
+                }
+            }
+            for (int i : {farChild, nearChild}) {
+                if (hits[i] && node.count[i] == 0 && tNear[i] <= best) {
+                    FATAL_ASSERT(size < Impl::STACK_SIZE, "BVH is to deep");
+                    stack[size++] = node.child[i];
+                }
+            }
+        }
+
+        if (!found) return false;
+
+        hit.face = found->face;
+        hit.distance = best;
+        for (int i=0; i < 3; ++i) {
+            hit.point[i] = origin[i] + direction[i] * best;
+        }
+        return true;
+    }
+
+    COMMON_API bool HalfEdgeMeshBVH::closestPoint( const float *point, float maxDistance, Hit &hit ) const
+    {
+        if (mNodes.empty()) return false;
+
+        float best = maxDistance * maxDistance;
+        bool found = false;
+
+        auto testLeaf = [&]( uint32_t first, uint32_t count ) {
+            for (uint32_t i=first; i < first + count; ++i) {
+                float closest[3];
+                Impl::closestPointOnTriangle(mTriangles[i], point, closest);
+
+                float dx = closest[0] - point[0],
+                      dy = closest[1] - point[1],
+                      dz = closest[2] - point[2];
+                float distance = dx*dx + dy*dy + dz*dz;
+                if (distance <= best) {
+                    best = distance;
+                    found = true;
+                    hit.face = mTriangles[i].face;
+                    for (int axis=0; axis < 3; ++axis) hit.point[axis] = closest[axis];
+                }
+            }
+        };
+
+        uint32_t stack[Impl::STACK_SIZE];
+        int size = 0;
+        stack[size++] = 0;
+
+        while (size > 0) {
+            const Node &node = mNodes[stack[--size]];
+
+            // Squared distance to the bounds of both children
+            float distance[2];
+            for (int i=0; i < 2; ++i) {
+                float dx = std::max(std::max(node.minX[i] - point[0], point[0] - node.maxX[i]), 0.f),
+                      dy = std::max(std::max(node.minY[i] - point[1], point[1] - node.maxY[i]), 0.f),
+                      dz = std::max(std::max(node.minZ[i] - point[2], point[2] - node.maxZ[i]), 0.f);
+                distance[i] = node.child[i] != Impl::EMPTY ? dx*dx + dy*dy + dz*dz : INFINITY;
+            }
+
+            int nearChild = distance[1] < distance[0] ? 1 : 0,
+                farChild = 1 - nearChild;
+
+            for (int i : {nearChild, farChild}) {
+                if (node.count[i] > 0 && distance[i] <= best) {
+                    testLeaf(node.child[i], node.count[i]);
+                }
+            }
+            for (int i : {farChild, nearChild}) {
+                if (node.count[i] == 0 && distance[i] <= best) {
+                    FATAL_ASSERT(size < Impl::STACK_SIZE, "BVH is to deep");
+                    stack[size++] = node.child[i];
+                }
+            }
+        }
+
+        if (!found) return false;
+        hit.distance = std::sqrt(best);
+        return true;
+    }
+}
@@ -0,0 +1,509 @@
+#include "HalfEdgeMesh.impl.h"
+#include "HalfEdgeMeshBuild.h"
+
+#include "ErrorUtils.h"
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+namespace Common
+{
+    namespace internal
+    {
+        // Building a mesh from indexed buffers is done in two steps:
+        //  - First the whole topology is built with plain indexes, so any invalid or non-manifold input
+        //    can be detected before the mesh is touched.
+        //  - Then all elements are allocated in bulk, and the indexes are translated to handles.
+        //
+        // Every pass runs on the thread pool, but the result never depends on how the work was split:
+        //  the edges and border half edges are numbered in sorted key order, and where several threads could
+        //  write the same value the smallest one is kept. So the same input always gives the same handles.
+        namespace IndexedBuild
+        {
+            static const size_t GRAIN_SIZE = 4096;
+
+            struct Key {
+                uint64_t key;
+                uint32_t hedge;
+
+                friend bool operator < ( const Key &lhs, const Key &rhs ) {
+                    if (lhs.key != rhs.key) return lhs.key < rhs.key;
+                    return lhs.hedge < rhs.hedge;
+                }
+            };
+
+            // A range of the sorted keys, and the edges found in it
+            struct Partition {
+                size_t begin = 0,
+                       end = 0,
+                       error = NONE;
+                uint32_t edgeCount = 0,
+                         borderCount = 0;
+            };
+
+            template< typename Func >
+            void parallelFor( Topology &topology, size_t count, size_t grainSize, const Func &func )
+            {
+                topology.pool->parallelFor(count, grainSize, func);
+            }
+
+            template< typename Type >
+            void atomicMin( std::atomic<Type> &value, Type candidate )
+            {
+                Type current = value.load(std::memory_order_relaxed);
+                while (candidate < current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+            }
+
+            bool checkFace( Topology &topology, const uint32_t *indices, size_t f, size_t vertexCount, bool log )
+            {
+                uint32_t begin = topology.faceStart[f],
+                         end = topology.faceStart[f+1];
+                for (uint32_t i=begin; i < end; ++i) {
+                    if (indices[i] >= vertexCount) {
+                        if (log) LOG_WARNING("Failed to build mesh: face %zu refers to vertex %u, but there is only %zu vertexes", f, indices[i], vertexCount);
+                        return false;
+                    }
+                    for (uint32_t j=begin; j < i; ++j) {
+                        if (indices[i] == indices[j]) {
+                            if (log) LOG_WARNING("Failed to build mesh: face %zu uses vertex %u more than once", f, indices[i]);
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            }
+
+            bool validateFaces( Topology &topology, const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount )
+            {
+                topology.faceStart.resize(faceCount+1);
+
+                size_t indexCount = 0;
+                for (size_t f=0; f < faceCount; ++f) {
+                    uint32_t size = faceSizes ? faceSizes[f] : 3;
+                    if (size < 3) {
+                        LOG_WARNING("Failed to build mesh: face %zu has to few vertexes (%u), a face must have atleast 3 vertexes", f, size);
+                        return false;
+                    }
+                    topology.faceStart[f] = (uint32_t)indexCount;
+                    indexCount += size;
+
+                    if (indexCount >= NONE / 2) {
+                        LOG_WARNING("Failed to build mesh: to many indices");
+                        return false;
+                    }
+                }
+                topology.faceStart[faceCount] = (uint32_t)indexCount;
+                topology.indexCount = indexCount;
+
+                // Only the first invalid face is reported, so the message doesn't depend on the threads
+                std::atomic<size_t> firstInvalid{faceCount};
+                parallelFor(topology, faceCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t f=begin; f < end; ++f) {
+                        if (!checkFace(topology, indices, f, vertexCount, false)) {
+                            atomicMin(firstInvalid, f);
+                            return;
+                        }
+                    }
+                });
+
+                if (firstInvalid != faceCount) {
+                    checkFace(topology, indices, firstInvalid, vertexCount, true);
+                    return false;
+                }
+                return true;
+            }
+
+            void linkFaces( Topology &topology, const uint32_t *indices, size_t faceCount )
+            {
+                topology.hedges.resize(topology.indexCount);
+
+                parallelFor(topology, faceCount, GRAIN_SIZE, [&]( size_t faceBegin, size_t faceEnd ) {
+                    for (size_t f=faceBegin; f < faceEnd; ++f) {
+                        uint32_t begin = topology.faceStart[f],
+                                 end = topology.faceStart[f+1];
+                        for (uint32_t k=begin; k < end; ++k) {
+                            uint32_t next = (k+1 == end) ? begin : k+1,
+                                     prev = (k == begin) ? end-1 : k-1;
+
+                            HEdge &hedge = topology.hedges[k];
+                            hedge.next = next;
+                            hedge.prev = prev;
+                            hedge.vertex = indices[next];
+                            hedge.face = (uint32_t)f;
+                        }
+                    }
+                });
+            }
+
+            // Checks that the half edges sharing a key (keys[begin] to keys[end-1]) can form an edge
+            bool checkEdge( const std::vector<Key> &keys, size_t begin, size_t end, const uint32_t *indices, bool log )
+            {
+                uint32_t v1 = uint32_t(keys[begin].key >> 32),
+                         v2 = uint32_t(keys[begin].key);
+                if (end - begin > 2) {
+                    if (log) LOG_WARNING("Failed to build mesh: the edge between vertex %u and %u is shared by %zu faces (non-manifold)", v1, v2, end-begin);
+                    return false;
+                }
+                if (end - begin == 2 && indices[keys[begin].hedge] == indices[keys[begin+1].hedge]) {
+                    if (log) LOG_WARNING("Failed to build mesh: the faces sharing the edge between vertex %u and %u have inconsistent winding", v1, v2);
+                    return false;
+                }
+                return true;
+            }
+
+            // Sorts the half edges on their (min, max) vertex key.
+            //  The keys are first scattered into partitions by their min vertex, then each partition is sorted on its own.
+            //  Since the partitions are ordered, this gives the same result as sorting all keys at once.
+            void sortKeys( Topology &topology, const uint32_t *indices, size_t faceCount, size_t vertexCount, std::vector<Key> &keys, std::vector<Partition> &partitions )
+            {
+                size_t partitionCount = std::max<size_t>(1, std::min<size_t>(topology.pool->threadCount() * 8, vertexCount)),
+                       chunkCount = (faceCount + GRAIN_SIZE - 1) / GRAIN_SIZE;
+
+                auto partitionOf = [&]( uint64_t v1, uint64_t v2 ) -> size_t {
+                    return size_t(std::min(v1, v2) * partitionCount / vertexCount);
+                };
+
+                // Count the keys each chunk of faces has in each partition (parallelFor runs whole chunks, so faceBegin / GRAIN_SIZE is the chunk)
+                std::vector<uint32_t> offsets(chunkCount * partitionCount, 0);
+                parallelFor(topology, faceCount, GRAIN_SIZE, [&]( size_t faceBegin, size_t faceEnd ) {
+                    uint32_t *counts = &offsets[(faceBegin / GRAIN_SIZE) * partitionCount];
+                    for (uint32_t k=topology.faceStart[faceBegin]; k < topology.faceStart[faceEnd]; ++k) {
+                        counts[partitionOf(indices[k], topology.hedges[k].vertex)]++;
+                    }
+                });
+
+                // Turn the counts into where each chunk writes its keys, the chunks keeps their order within a partition
+                partitions.resize(partitionCount);
+                uint32_t offset = 0;
+                for (size_t p=0; p < partitionCount; ++p) {
+                    partitions[p].begin = offset;
+                    for (size_t chunk=0; chunk < chunkCount; ++chunk) {
+                        uint32_t count = offsets[chunk * partitionCount + p];
+                        offsets[chunk * partitionCount + p] = offset;
+                        offset += count;
+                    }
+                    partitions[p].end = offset;
+                }
+
+                keys.resize(topology.indexCount);
+                parallelFor(topology, faceCount, GRAIN_SIZE, [&]( size_t faceBegin, size_t faceEnd ) {
+                    uint32_t *next = &offsets[(faceBegin / GRAIN_SIZE) * partitionCount];
+                    for (uint32_t k=topology.faceStart[faceBegin]; k < topology.faceStart[faceEnd]; ++k) {
+                        uint64_t v1 = indices[k],
+                                 v2 = topology.hedges[k].vertex;
+
+                        Key &key = keys[next[partitionOf(v1, v2)]++];
+                        key.key = (std::min(v1, v2) << 32) | std::max(v1, v2);
+                        key.hedge = k;
+                    }
+                });
+
+                parallelFor(topology, partitionCount, 1, [&]( size_t begin, size_t end ) {
+                    for (size_t p=begin; p < end; ++p) {
+                        std::sort(keys.begin() + partitions[p].begin, keys.begin() + partitions[p].end);
+                    }
+                });
+            }
+
+            // Matches each half edge with its pair, edges without a pair gets a border half edge
+            bool pairHEdges( Topology &topology, const uint32_t *indices, size_t faceCount, size_t vertexCount )
+            {
+                std::vector<Key> keys;
+                std::vector<Partition> partitions;
+                sortKeys(topology, indices, faceCount, vertexCount, keys, partitions);
+
+                // Count the edges in each partition, all half edges with the same key are in the same partition
+                parallelFor(topology, partitions.size(), 1, [&]( size_t begin, size_t end ) {
+                    for (size_t p=begin; p < end; ++p) {
+                        Partition &partition = partitions[p];
+                        for (size_t i=partition.begin; i < partition.end; ) {
+                            size_t j = i+1;
+                            while (j < partition.end && keys[j].key == keys[i].key) ++j;
+
+                            if (!checkEdge(keys, i, j, indices, false)) {
+                                partition.error = i;
+                                break;
+                            }
+
+                            partition.edgeCount++;
+                            if (j - i == 1) partition.borderCount++;
+                            i = j;
+                        }
+                    }
+                });
+
+                uint32_t edgeCount = 0,
+                         borderCount = 0;
+                for (Partition &partition : partitions) {
+                    if (partition.error != NONE) {
+                        size_t i = partition.error,
+                               j = i+1;
+                        while (j < partition.end && keys[j].key == keys[i].key) ++j;
+                        checkEdge(keys, i, j, indices, true);
+                        return false;
+                    }
+
+                    // From here on the counts are the first edge and border half edge of the partition
+                    uint32_t edges = partition.edgeCount,
+                             borders = partition.borderCount;
+                    partition.edgeCount = edgeCount;
+                    partition.borderCount = borderCount;
+                    edgeCount += edges;
+                    borderCount += borders;
+                }
+
+                size_t indexCount = topology.indexCount;
+                topology.edgeHEdge.resize(edgeCount);
+                topology.hedges.resize(indexCount + borderCount);
+
+                parallelFor(topology, partitions.size(), 1, [&]( size_t begin, size_t end ) {
+                    for (size_t p=begin; p < end; ++p) {
+                        const Partition &partition = partitions[p];
+
+                        uint32_t edge = partition.edgeCount,
+                                 border = uint32_t(indexCount + partition.borderCount);
+                        for (size_t i=partition.begin; i < partition.end; ++edge) {
+                            uint32_t k1 = keys[i].hedge;
+                            topology.edgeHEdge[edge] = k1;
+                            topology.hedges[k1].edge = edge;
+
+                            if (i+1 < partition.end && keys[i+1].key == keys[i].key) {
+                                uint32_t k2 = keys[i+1].hedge;
+                                topology.hedges[k1].pair = k2;
+                                topology.hedges[k2].pair = k1;
+                                topology.hedges[k2].edge = edge;
+                                i += 2;
+                            }
+                            else {
+                                HEdge &hedge = topology.hedges[border];
+                                hedge.pair = k1;
+                                hedge.vertex = indices[k1];
+                                hedge.edge = edge;
+                                topology.hedges[k1].pair = border;
+                                border++;
+                                i += 1;
+                            }
+                        }
+                    }
+                });
+                return true;
+            }
+
+            // Links the border half edges into loops, and selects a outgoing half edge for each vertex
+            //  (a border half edge if there is one, so the vertex is quickly found to be free)
+            bool linkBorders( Topology &topology, const uint32_t *indices, size_t vertexCount )
+            {
+                std::vector<HEdge> &hedges = topology.hedges;
+                size_t indexCount = topology.indexCount;
+
+                // The first face half edge leaving each vertex, and the number of half edges leaving it
+                std::vector<std::atomic<uint32_t>> firstOut(vertexCount),
+                                                   outgoing(vertexCount);
+                parallelFor(topology, vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t vertex=begin; vertex < end; ++vertex) {
+                        firstOut[vertex].store(NONE, std::memory_order_relaxed);
+                        outgoing[vertex].store(0, std::memory_order_relaxed);
+                    }
+                });
+                parallelFor(topology, hedges.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t k=begin; k < end; ++k) {
+                        uint32_t vertex = hedges[hedges[k].pair].vertex;
+                        outgoing[vertex].fetch_add(1, std::memory_order_relaxed);
+                        if (k < indexCount) atomicMin(firstOut[vertex], (uint32_t)k);
+                    }
+                });
+
+                topology.vertexHEdge.resize(vertexCount);
+                parallelFor(topology, vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t vertex=begin; vertex < end; ++vertex) {
+                        topology.vertexHEdge[vertex] = firstOut[vertex].load(std::memory_order_relaxed);
+                    }
+                });
+
+                // For each border half edge ending in a vertex, find the border half edge leaving the vertex
+                //  on the other side of the same fan of faces
+                size_t borderCount = hedges.size() - indexCount;
+                std::vector<uint32_t> fanEnd(borderCount),
+                                      vertexFans(vertexCount, NONE),
+                                      nextFan(borderCount, NONE);
+                parallelFor(topology, borderCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t b=begin; b < end; ++b) {
+                        uint32_t hedge = hedges[indexCount + b].pair;
+                        while (true) {
+                            uint32_t out = hedges[hedges[hedge].prev].pair;
+                            if (hedges[out].face == NONE) {
+                                fanEnd[b] = out;
+                                break;
+                            }
+                            hedge = out;
+                        }
+                    }
+                });
+                for (size_t b=0; b < borderCount; ++b) {
+                    uint32_t vertex = hedges[indexCount + b].vertex;
+                    nextFan[b] = vertexFans[vertex];
+                    vertexFans[vertex] = (uint32_t)b;
+                }
+
+                // A vertex can have multiple fans (ex two faces touching in a single vertex),
+                //  link the fans after each other, so all half edges can be reached when walking around the vertex.
+                parallelFor(topology, vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t vertex=begin; vertex < end; ++vertex) {
+                        uint32_t first = vertexFans[vertex];
+                        if (first == NONE) continue;
+
+                        topology.vertexHEdge[vertex] = fanEnd[first];
+
+                        for (uint32_t b=first; b != NONE; b = nextFan[b]) {
+                            uint32_t nextB = (nextFan[b] != NONE) ? nextFan[b] : first;
+
+                            uint32_t border = uint32_t(indexCount + b),
+                                     out = fanEnd[nextB];
+                            hedges[border].next = out;
+                            hedges[out].prev = border;
+                        }
+                    }
+                });
+
+                // Every half edge leaving a vertex must be reachable when walking around it,
+                //  a closed fan that only touches the rest of the mesh in a vertex isn't.
+                std::atomic<size_t> firstInvalid{vertexCount};
+                parallelFor(topology, vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                    for (size_t vertex=begin; vertex < end; ++vertex) {
+                        uint32_t first = topology.vertexHEdge[vertex];
+                        if (first == NONE) continue;
+
+                        uint32_t expected = outgoing[vertex].load(std::memory_order_relaxed),
+                                 hedge = first,
+                                 count = 0;
+                        do {
+                            count++;
+                            hedge = hedges[hedges[hedge].pair].next;
+                        } while (hedge != first && count <= expected);
+
+                        if (count != expected) {
+                            atomicMin(firstInvalid, vertex);
+                            return;
+                        }
+                    }
+                });
+
+                if (firstInvalid != vertexCount) {
+                    LOG_WARNING("Failed to build mesh: vertex %zu is non-manifold", firstInvalid.load());
+                    return false;
+                }
+                return true;
+            }
+        }
+
+        bool IndexedBuild::buildTopology( Topology &topology, const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount )
+        {
+            if (vertexCount >= NONE) {
+                LOG_WARNING("Failed to build mesh: to many vertexes (%zu)", vertexCount);
+                return false;
+            }
+
+            if (!topology.pool) topology.pool = &ThreadPool::Global();
+
+            if (!validateFaces(topology, indices, faceSizes, faceCount, vertexCount)) return false;
+            linkFaces(topology, indices, faceCount);
+            if (!pairHEdges(topology, indices, faceCount, vertexCount)) return false;
+            if (!linkBorders(topology, indices, vertexCount)) return false;
+            return true;
+        }
+
+        bool buildFromIndexed( Impl *impl, const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount, VertexHandle *vertexesOut, FaceHandle *facesOut, ThreadPool *pool )
+        {
+            using namespace IndexedBuild;
+
+            Topology topology;
+            topology.pool = pool;
+            if (!buildTopology(topology, indices, faceSizes, faceCount, vertexCount)) return false;
+
+            size_t hedgeCount = topology.hedges.size(),
+                   edgeCount = topology.edgeHEdge.size();
+
+            // Allocate all elements, this is done on one thread so the handles are the same every time
+            std::vector<VertexHandle> vertexes(vertexCount);
+            std::vector<HEdgeHandle> hedges(hedgeCount);
+            std::vector<EdgeHandle> edges(edgeCount);
+            std::vector<FaceHandle> faces(faceCount);
+
+            size_t createdVertexes = impl->vertexes.createN(vertexCount, vertexes.data()),
+                   createdHEdges = impl->hedges.createN(hedgeCount, hedges.data()),
+                   createdEdges = impl->edges.createN(edgeCount, edges.data()),
+                   createdFaces = impl->faces.createN(faceCount, faces.data());
+
+            if (createdVertexes != vertexCount || createdHEdges != hedgeCount || createdEdges != edgeCount || createdFaces != faceCount) {
+                impl->vertexes.freeN(vertexes.data(), createdVertexes);
+                impl->hedges.freeN(hedges.data(), createdHEdges);
+                impl->edges.freeN(edges.data(), createdEdges);
+                impl->faces.freeN(faces.data(), createdFaces);
+
+                impl->vertexesLock++;
+                impl->hedgesLock++;
+                impl->edgesLock++;
+                impl->facesLock++;
+
+                LOG_ERROR("Failed to build mesh: couldn't allocate %zu vertexes, %zu half edges, %zu edges and %zu faces", vertexCount, hedgeCount, edgeCount, faceCount);
+                return false;
+            }
+
+            // Translate the indexes to handles, every element is written by a single thread
+            //  (createN wrote the new slots, so their chunks are no longer shared with any snapshot of the mesh)
+            parallelFor(topology, hedgeCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    const IndexedBuild::HEdge &src = topology.hedges[i];
+                    internal::HEdge *hedge = impl->hedges.find(hedges[i]);
+
+                    hedge->pair = hedges[src.pair];
+                    hedge->next = hedges[src.next];
+                    hedge->prev = hedges[src.prev];
+                    hedge->vertex = vertexes[src.vertex];
+                    hedge->face = (src.face != NONE) ? faces[src.face] : FaceHandle();
+                    hedge->edge = edges[src.edge];
+                }
+            });
+            parallelFor(topology, vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    uint32_t hedge = topology.vertexHEdge[i];
+                    impl->vertexes.find(vertexes[i])->hedge = (hedge != NONE) ? hedges[hedge] : HEdgeHandle();
+                }
+            });
+            parallelFor(topology, edgeCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    impl->edges.find(edges[i])->hedge = hedges[topology.edgeHEdge[i]];
+                }
+            });
+            parallelFor(topology, faceCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    impl->faces.find(faces[i])->hedge = hedges[topology.faceStart[i]];
+                }
+            });
+
+            if (HashTable<HEdgeHandle> *table = impl->edgeIndex.table.get()) {
+                for (size_t i=0; i < hedgeCount; ++i) {
+                    const IndexedBuild::HEdge &src = topology.hedges[i];
+                    table->insert(EdgeIndex::key(vertexes[topology.hedges[src.pair].vertex], vertexes[src.vertex]), hedges[i]);
+                }
+            }
+
+            // The hooks can run user code, so they are called in order on the calling thread
+            for (auto handle : vertexes) impl->onVertexCreated(handle);
+            for (auto handle : hedges) impl->onHEdgeCreated(handle);
+            for (auto handle : edges) impl->onEdgeCreated(handle);
+            for (auto handle : faces) impl->onFaceCreated(handle);
+
+            if (vertexesOut) std::copy(vertexes.begin(), vertexes.end(), vertexesOut);
+            if (facesOut) std::copy(faces.begin(), faces.end(), facesOut);
+            return true;
+        }
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::buildFromIndexed( const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount, VertexHandle *vertexesOut, FaceHandle *facesOut, ThreadPool *pool )
+    {
+        return internal::buildFromIndexed(mImpl, indices, faceSizes, faceCount, vertexCount, vertexesOut, facesOut, pool);
+    }
+}
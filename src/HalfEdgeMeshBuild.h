@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace Common
+{
+    namespace internal
+    {
+        // Builds a half edge topology from indexed polygon buffers, using plain indexes.
+        //  Shared by HalfEdgeMeshBase::buildFromIndexed and CompactHalfEdgeMesh::buildFromIndexed.
+        //
+        // Half edge 'k' (k < indexCount) is the edge from indices[k] to the next vertex in the same face,
+        //  border half edges (without a face) are stored after them.
+        namespace IndexedBuild
+        {
+            static const uint32_t NONE = ~uint32_t(0);
+
+            struct HEdge {
+                uint32_t pair = NONE,
+                         next = NONE,
+                         prev = NONE,
+                         vertex = NONE,
+                         face = NONE,
+                         edge = NONE;
+            };
+
+            struct Topology {
+                // The pool the passes runs on, the global pool is used if it's null
+                ThreadPool *pool = nullptr;
+
+                std::vector<uint32_t> faceStart;
+                std::vector<HEdge> hedges;
+                std::vector<uint32_t> edgeHEdge;
+                std::vector<uint32_t> vertexHEdge;
+                size_t indexCount = 0;
+            };
+
+            // Returns false if the input is invalid or non-manifold (the reason is logged)
+            bool buildTopology( Topology &topology, const uint32_t *indices, const uint32_t *faceSizes, size_t faceCount, size_t vertexCount );
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include "HalfEdgeMesh.impl.h"
+
+#include "ErrorUtils.h"
+
+namespace Common
+{
+    namespace internal
+    {
+        namespace Compact
+        {
+            static const size_t GRAIN_SIZE = 4096;
+
+            using Remap = HalfEdgeMeshBase::CompactRemap;
+
+            template< typename Handle >
+            using Marks = ManuelHandleVector<Handle, bool>;
+            template< typename Handle >
+            using Map = ManuelHandleVector<Handle, Handle>;
+
+            template< typename Handle >
+            bool mark( Marks<Handle> &marks, Handle handle )
+            {
+                if (marks.find(handle)) return false;
+                marks.allocate(handle, true);
+                return true;
+            }
+
+            template< typename Handle >
+            void buildMap( Map<Handle> &map, const std::vector<Handle> &oldHandles, const std::vector<Handle> &newHandles )
+            {
+                for (size_t i=0; i < oldHandles.size(); ++i) {
+                    map.allocate(oldHandles[i], newHandles[i]);
+                }
+            }
+
+            template< typename Handle >
+            Handle lookup( const Map<Handle> &map, Handle handle )
+            {
+                if (!handle) return Handle();
+                return *map.find(handle);
+            }
+
+            // The faces breadth first, and the vertexes and edges in the order they are reached
+            void order( const Impl *impl, Remap &remap )
+            {
+                Marks<VertexHandle> vertexMarks;
+                Marks<EdgeHandle> edgeMarks;
+                Marks<FaceHandle> faceMarks;
+
+                // The face list is the queue
+                size_t head = 0;
+                impl->faces.forEachHandle([&]( FaceHandle start ) {
+                    if (!mark(faceMarks, start)) return;
+                    remap.oldFaces.push_back(start);
+
+                    while (head < remap.oldFaces.size()) {
+                        FaceHandle face = remap.oldFaces[head++];
+
+                        HEdgeHandle first = impl->faces.find(face)->hedge,
+                                    current = first;
+                        do {
+                            const HEdge &hedge = *impl->hedges.find(current);
+                            if (mark(vertexMarks, hedge.vertex)) remap.oldVertexes.push_back(hedge.vertex);
+                            if (mark(edgeMarks, hedge.edge)) remap.oldEdges.push_back(hedge.edge);
+
+                            FaceHandle neighbor = impl->hedges.find(hedge.pair)->face;
+                            if (neighbor && mark(faceMarks, neighbor)) remap.oldFaces.push_back(neighbor);
+
+                            current = hedge.next;
+                        } while (current != first);
+                    }
+                });
+
+                impl->vertexes.forEachHandle([&]( VertexHandle vertex ) {
+                    if (mark(vertexMarks, vertex)) remap.oldVertexes.push_back(vertex);
+                });
+                impl->edges.forEachHandle([&]( EdgeHandle edge ) {
+                    if (mark(edgeMarks, edge)) remap.oldEdges.push_back(edge);
+                });
+
+                remap.oldHEdges.reserve(remap.oldEdges.size() * 2);
+                for (EdgeHandle edge : remap.oldEdges) {
+                    HEdgeHandle hedge = impl->edges.find(edge)->hedge;
+                    remap.oldHEdges.push_back(hedge);
+                    remap.oldHEdges.push_back(impl->hedges.find(hedge)->pair);
+                }
+            }
+        }
+
+        HalfEdgeMeshBase::CompactRemap compact( Impl *impl, ThreadPool *pool )
+        {
+            using namespace Compact;
+
+            if (!pool) pool = &ThreadPool::Global();
+
+            Remap remap;
+            order(impl, remap);
+
+            remap.newVertexes.resize(remap.oldVertexes.size());
+            remap.newHEdges.resize(remap.oldHEdges.size());
+            remap.newEdges.resize(remap.oldEdges.size());
+            remap.newFaces.resize(remap.oldFaces.size());
+
+            impl->vertexes.compact(remap.oldVertexes.data(), remap.oldVertexes.size(), remap.newVertexes.data());
+            impl->hedges.compact(remap.oldHEdges.data(), remap.oldHEdges.size(), remap.newHEdges.data());
+            impl->edges.compact(remap.oldEdges.data(), remap.oldEdges.size(), remap.newEdges.data());
+            impl->faces.compact(remap.oldFaces.data(), remap.oldFaces.size(), remap.newFaces.data());
+
+            // Every element has moved, the smart handles must refresh their pointers
+            impl->vertexesLock++;
+            impl->hedgesLock++;
+            impl->edgesLock++;
+            impl->facesLock++;
+
+            Map<VertexHandle> vertexMap;
+            Map<HEdgeHandle> hedgeMap;
+            Map<EdgeHandle> edgeMap;
+            Map<FaceHandle> faceMap;
+            buildMap(vertexMap, remap.oldVertexes, remap.newVertexes);
+            buildMap(hedgeMap, remap.oldHEdges, remap.newHEdges);
+            buildMap(edgeMap, remap.oldEdges, remap.newEdges);
+            buildMap(faceMap, remap.oldFaces, remap.newFaces);
+
+            // The elements still links to the old handles, every element is written so the chunks shared with snapshots are cloned up front
+            impl->hedges.makeUnique();
+            impl->vertexes.makeUnique();
+            impl->edges.makeUnique();
+            impl->faces.makeUnique();
+            pool->parallelFor(remap.newHEdges.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    HEdge &hedge = *impl->hedges.find(remap.newHEdges[i]);
+                    hedge.pair = lookup(hedgeMap, hedge.pair);
+                    hedge.next = lookup(hedgeMap, hedge.next);
+                    hedge.prev = lookup(hedgeMap, hedge.prev);
+                    hedge.vertex = lookup(vertexMap, hedge.vertex);
+                    hedge.face = lookup(faceMap, hedge.face);
+                    hedge.edge = lookup(edgeMap, hedge.edge);
+                }
+            });
+            pool->parallelFor(remap.newVertexes.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    Vertex &vertex = *impl->vertexes.find(remap.newVertexes[i]);
+                    vertex.hedge = lookup(hedgeMap, vertex.hedge);
+                }
+            });
+            pool->parallelFor(remap.newEdges.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    Edge &edge = *impl->edges.find(remap.newEdges[i]);
+                    edge.hedge = lookup(hedgeMap, edge.hedge);
+                }
+            });
+            pool->parallelFor(remap.newFaces.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    Face &face = *impl->faces.find(remap.newFaces[i]);
+                    face.hedge = lookup(hedgeMap, face.hedge);
+                }
+            });
+
+            rebuildEdgeIndex(impl);
+            impl->onCompact(remap);
+            return remap;
+        }
+    }
+
+    COMMON_API HalfEdgeMeshBase::CompactRemap HalfEdgeMeshBase::compact( ThreadPool *pool )
+    {
+        return internal::compact(mImpl, pool);
+    }
+}
@@ -0,0 +1,376 @@
+#include "HalfEdgeMeshDecimation.h"
+#include "HalfEdgeMeshIterator.h"
+#include "HalfEdgeMeshCirculator.h"
+
+#include "ErrorUtils.h"
+
+#include <queue>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace Common
+{
+    namespace Decimation
+    {
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+        using HEdgeHandle = HalfEdgeMeshBase::HEdgeHandle;
+        using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+
+        using Topology = internal::HalfEdgeMeshTopology;
+        namespace Circulators = HalfEdgeMeshCirculators;
+
+        struct Vec3 {
+            double x = 0, y = 0, z = 0;
+
+            friend Vec3 operator + ( const Vec3 &lhs, const Vec3 &rhs ) {
+                return {lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z};
+            }
+            friend Vec3 operator - ( const Vec3 &lhs, const Vec3 &rhs ) {
+                return {lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
+            }
+            friend Vec3 operator * ( const Vec3 &lhs, double rhs ) {
+                return {lhs.x * rhs, lhs.y * rhs, lhs.z * rhs};
+            }
+        };
+
+        inline double dot( const Vec3 &lhs, const Vec3 &rhs ) {
+            return lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z;
+        }
+        inline Vec3 cross( const Vec3 &lhs, const Vec3 &rhs ) {
+            return {
+                lhs.y*rhs.z - lhs.z*rhs.y,
+                lhs.z*rhs.x - lhs.x*rhs.z,
+                lhs.x*rhs.y - lhs.y*rhs.x
+            };
+        }
+        inline double length( const Vec3 &vec ) {
+            return std::sqrt(dot(vec, vec));
+        }
+
+        // The sum of squared distances to a set of planes, as a symmetric 4x4 matrix (only the upper half is stored)
+        struct Quadric {
+            double a2 = 0, ab = 0, ac = 0, ad = 0,
+                           b2 = 0, bc = 0, bd = 0,
+                                   c2 = 0, cd = 0,
+                                           d2 = 0;
+
+            // The plane through 'point' with the unit 'normal'
+            static Quadric plane( const Vec3 &normal, const Vec3 &point, double weight ) {
+                double a = normal.x, b = normal.y, c = normal.z,
+                       d = -dot(normal, point);
+
+                Quadric q;
+                q.a2 = weight*a*a; q.ab = weight*a*b; q.ac = weight*a*c; q.ad = weight*a*d;
+                q.b2 = weight*b*b; q.bc = weight*b*c; q.bd = weight*b*d;
+                q.c2 = weight*c*c; q.cd = weight*c*d;
+                q.d2 = weight*d*d;
+                return q;
+            }
+
+            Quadric& operator += ( const Quadric &other ) {
+                a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+                b2 += other.b2; bc += other.bc; bd += other.bd;
+                c2 += other.c2; cd += other.cd;
+                d2 += other.d2;
+                return *this;
+            }
+            friend Quadric operator + ( Quadric lhs, const Quadric &rhs ) {
+                return lhs += rhs;
+            }
+
+            double error( const Vec3 &p ) const {
+                double error = a2*p.x*p.x + 2*ab*p.x*p.y + 2*ac*p.x*p.z + 2*ad*p.x
+                                          +   b2*p.y*p.y + 2*bc*p.y*p.z + 2*bd*p.y
+                                                         +   c2*p.z*p.z + 2*cd*p.z
+                                                                        +   d2;
+                // Rounding can make it slightly negative
+                return std::max(error, 0.0);
+            }
+
+            // The point with the smallest error, fails if it isn't unique (the planes are parallel)
+            bool minimum( Vec3 &p ) const {
+                // Cofactors of the upper 3x3 matrix
+                double c00 = b2*c2 - bc*bc,
+                       c01 = ac*bc - ab*c2,
+                       c02 = ab*bc - ac*b2,
+                       c11 = a2*c2 - ac*ac,
+                       c12 = ab*ac - a2*bc,
+                       c22 = a2*b2 - ab*ab;
+                double det = a2*c00 + ab*c01 + ac*c02;
+
+                double scale = std::max({std::abs(a2), std::abs(b2), std::abs(c2)});
+                if (std::abs(det) <= 1e-10 * scale*scale*scale) return false;
+
+                double inv = -1.0 / det;
+                p.x = inv * (c00*ad + c01*bd + c02*cd);
+                p.y = inv * (c01*ad + c11*bd + c12*cd);
+                p.z = inv * (c02*ad + c12*bd + c22*cd);
+                return true;
+            }
+        };
+
+        struct VertexInfo {
+            Quadric quadric;
+            Vec3 position;
+            // Bumped every time the vertex changes, invalidating the candidates that was computed with it
+            uint32_t version = 0;
+            bool moved = false;
+        };
+
+        // A edge collapse in the queue, v0 is merged into v1
+        struct Candidate {
+            double cost;
+            HEdgeHandle hedge;
+            VertexHandle v0, v1;
+            uint32_t version0, version1;
+
+            friend bool operator > ( const Candidate &lhs, const Candidate &rhs ) {
+                return lhs.cost > rhs.cost;
+            }
+        };
+
+        struct State {
+            HalfEdgeMeshBase *mesh = nullptr;
+            const Topology *topology = nullptr;
+            DecimationSettings settings;
+
+            ManuelHandleVector<VertexHandle, VertexInfo> vertexes;
+            std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue;
+
+            size_t faceCount = 0;
+        };
+
+        const internal::HEdge& hedge( const State &state, HEdgeHandle handle ) {
+            return *state.topology->hedges.find(handle);
+        }
+        VertexHandle origin( const State &state, const internal::HEdge &hedge ) {
+            return state.topology->hedges.find(hedge.pair)->vertex;
+        }
+        VertexInfo& vertex( State &state, VertexHandle handle ) {
+            return *state.vertexes.find(handle);
+        }
+
+        // Where the merged vertex is placed
+        Vec3 placement( const Quadric &quadric, const Vec3 &p0, const Vec3 &p1 )
+        {
+            Vec3 p;
+            if (quadric.minimum(p)) return p;
+
+            // Pick the best point on the edge instead
+            Vec3 candidates[] = {p0, p1, (p0 + p1) * 0.5};
+            double best = std::numeric_limits<double>::max();
+            for (const Vec3 &candidate : candidates) {
+                double error = quadric.error(candidate);
+                if (error < best) {
+                    best = error;
+                    p = candidate;
+                }
+            }
+            return p;
+        }
+
+        void push( State &state, HEdgeHandle handle )
+        {
+            const internal::HEdge &h = hedge(state, handle);
+            VertexHandle v0 = origin(state, h),
+                         v1 = h.vertex;
+
+            const VertexInfo &info0 = vertex(state, v0),
+                             &info1 = vertex(state, v1);
+
+            Quadric quadric = info0.quadric + info1.quadric;
+            double cost = quadric.error(placement(quadric, info0.position, info1.position));
+
+            state.queue.push({cost, handle, v0, v1, info0.version, info1.version});
+        }
+
+        bool init( State &state, const DecimationGetPosition &getPosition )
+        {
+            const Topology &topology = *state.topology;
+
+            for (VertexHandle handle : state.mesh->vertexes()) {
+                state.vertexes.allocate(handle);
+
+                double xyz[3];
+                getPosition(handle, xyz);
+                vertex(state, handle).position = {xyz[0], xyz[1], xyz[2]};
+            }
+
+            for (FaceHandle face : state.mesh->faces()) {
+                VertexHandle corners[3];
+                size_t count = 0;
+                for (VertexHandle corner : Circulators::faceVertexes(topology, face)) {
+                    if (count < 3) corners[count] = corner;
+                    count++;
+                }
+                if (count != 3) {
+                    LOG_WARNING("Can't decimate the mesh: face %i has %zu vertexes, only triangles are supported", (int)face, count);
+                    return false;
+                }
+
+                const Vec3 &p0 = vertex(state, corners[0]).position,
+                           &p1 = vertex(state, corners[1]).position,
+                           &p2 = vertex(state, corners[2]).position;
+
+                Vec3 normal = cross(p1 - p0, p2 - p0);
+                double area = length(normal);
+                state.faceCount++;
+                if (area <= 0) continue;
+
+                // Weighted by area, so the result doesn't depend on how the surface is tesselated
+                Quadric quadric = Quadric::plane(normal * (1.0 / area), p0, area * 0.5);
+                for (VertexHandle corner : corners) {
+                    vertex(state, corner).quadric += quadric;
+                }
+            }
+
+            // Border edges get a plane perpendicular to their face, that keeps the border from moving inwards
+            for (HEdgeHandle handle : state.mesh->hedges()) {
+                const internal::HEdge &border = hedge(state, handle);
+                if (border.face) continue;
+
+                const internal::HEdge &pair = hedge(state, border.pair);
+                if (!pair.face) continue;
+
+                VertexHandle v0 = origin(state, border),
+                             v1 = border.vertex;
+                const internal::HEdge &next = hedge(state, pair.next);
+
+                const Vec3 &p0 = vertex(state, v0).position,
+                           &p1 = vertex(state, v1).position,
+                           &p2 = vertex(state, next.vertex).position;
+
+                Vec3 edge = p1 - p0;
+                Vec3 normal = cross(edge, cross(edge, p2 - p0));
+                double len = length(normal);
+                if (len <= 0) continue;
+
+                Quadric quadric = Quadric::plane(normal * (1.0 / len), p0, state.settings.borderWeight * dot(edge, edge));
+                vertex(state, v0).quadric += quadric;
+                vertex(state, v1).quadric += quadric;
+            }
+
+            for (auto edge : state.mesh->edges()) {
+                push(state, state.mesh->getEdgeHEdge(edge));
+            }
+            return true;
+        }
+
+        // Tests if moving 'moved' to 'position' would flip (or collapse) any of its faces, except the ones that are removed
+        bool flipsFaces( State &state, VertexHandle moved, VertexHandle other, const Vec3 &position )
+        {
+            const Topology &topology = *state.topology;
+            const Vec3 &p = vertex(state, moved).position;
+
+            for (HEdgeHandle out : Circulators::vertexOHEdges(topology, moved)) {
+                const internal::HEdge &h = hedge(state, out);
+                if (!h.face) continue;
+
+                VertexHandle a = h.vertex,
+                             b = hedge(state, h.next).vertex;
+                // The faces of the collapsed edge
+                if (a == other || b == other) continue;
+
+                const Vec3 &pa = vertex(state, a).position,
+                           &pb = vertex(state, b).position;
+
+                Vec3 before = cross(pa - p, pb - p),
+                     after = cross(pa - position, pb - position);
+
+                double lengths = length(before) * length(after);
+                if (lengths <= 0) return true;
+                if (dot(before, after) < state.settings.minNormalDot * lengths) return true;
+            }
+            return false;
+        }
+
+        // Collapses the candidate if it is still valid, returns the vertex that was kept (or a null handle)
+        VertexHandle collapse( State &state, const Candidate &candidate, DecimationResult &result )
+        {
+            const internal::HEdge *h = state.topology->hedges.find(candidate.hedge);
+            if (!h) return VertexHandle();
+
+            // The vertexes have changed since the candidate was pushed
+            if (h->vertex != candidate.v1 || origin(state, *h) != candidate.v0) return VertexHandle();
+            VertexInfo &info0 = vertex(state, candidate.v0),
+                       &info1 = vertex(state, candidate.v1);
+            if (info0.version != candidate.version0 || info1.version != candidate.version1) return VertexHandle();
+
+            HEdgeHandle handle = candidate.hedge;
+            VertexHandle keep = candidate.v1,
+                         remove = candidate.v0;
+            if (!state.mesh->isCollapseOk(handle)) {
+                handle = h->pair;
+                std::swap(keep, remove);
+                if (!state.mesh->isCollapseOk(handle)) return VertexHandle();
+            }
+
+            Quadric quadric = info0.quadric + info1.quadric;
+            Vec3 position = placement(quadric, info0.position, info1.position);
+
+            if (flipsFaces(state, candidate.v0, candidate.v1, position) ||
+                flipsFaces(state, candidate.v1, candidate.v0, position))
+            {
+                return VertexHandle();
+            }
+
+            size_t removedFaces = (h->face ? 1 : 0) + (hedge(state, h->pair).face ? 1 : 0);
+            if (!state.mesh->collapseEdge(handle)) return VertexHandle();
+
+            VertexInfo &kept = vertex(state, keep);
+            kept.quadric = quadric;
+            kept.position = position;
+            kept.version++;
+            kept.moved = true;
+            state.vertexes.free(remove);
+
+            state.faceCount -= removedFaces;
+            result.collapses++;
+            result.maxError = std::max(result.maxError, candidate.cost);
+            return keep;
+        }
+    }
+
+    COMMON_API DecimationResult decimate( HalfEdgeMeshBase &mesh, const DecimationSettings &settings,
+                                          const DecimationGetPosition &getPosition, const DecimationSetPosition &setPosition )
+    {
+        using namespace Decimation;
+
+        State state;
+        state.mesh = &mesh;
+        state.topology = &mesh.topology();
+        state.settings = settings;
+
+        DecimationResult result;
+        if (!init(state, getPosition)) {
+            return result;
+        }
+
+        while (state.faceCount > settings.targetFaceCount && !state.queue.empty()) {
+            Candidate candidate = state.queue.top();
+            state.queue.pop();
+
+            if (candidate.cost > settings.maxError) break;
+
+            VertexHandle kept = collapse(state, candidate, result);
+            if (!kept) continue;
+
+            // The error of every edge around the vertex has changed
+            for (HEdgeHandle out : Circulators::vertexOHEdges(*state.topology, kept)) {
+                push(state, out);
+            }
+        }
+
+        for (VertexHandle handle : mesh.vertexes()) {
+            const VertexInfo &info = vertex(state, handle);
+            if (info.moved) {
+                double xyz[3] = {info.position.x, info.position.y, info.position.z};
+                setPosition(handle, xyz);
+            }
+        }
+
+        result.faceCount = state.faceCount;
+        return result;
+    }
+}
@@ -0,0 +1,565 @@
+#include "HalfEdgeMesh.impl.h"
+
+#include "ErrorUtils.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace Common
+{
+    namespace internal
+    {
+        // Topological editing
+        //  Every operation only walks the elements around the edited one, and calls the
+        //  onXCreated/onXDestroyed hooks for each element it adds or removes.
+        //  The hooks for destroyed elements are called before the element is free'd.
+
+#define CREATE_DESTROY( Type, Handle )                                  \
+        inline void destroy##Type( Impl *impl, Handle handle ) {        \
+            impl->on##Type##Destroyed(handle);                          \
+            free##Type(impl, handle);                                   \
+        }
+
+        CREATE_DESTROY(Vertex, VertexHandle);
+        CREATE_DESTROY(HEdge, HEdgeHandle);
+        CREATE_DESTROY(Edge, EdgeHandle);
+        CREATE_DESTROY(Face, FaceHandle);
+
+#undef CREATE_DESTROY
+
+        bool isBorderVertex( const Impl *impl, CVertexPtr vertex )
+        {
+            return !!findFreeHEdge(impl, vertex.hedge());
+        }
+
+        // Points the vertex at a border half edge if it has one
+        void adjustOutgoing( Impl *impl, VertexPtr vertex )
+        {
+            if (!vertex || !vertex->hedge) return;
+
+            if (HEdgePtr border = findFreeHEdge(impl, vertex.hedge())) {
+                vertex->hedge = border;
+            }
+        }
+
+        // Removes a edge that doesn't have any faces, the vertexes are kept (even if they become isolated)
+        void unlinkEdge( Impl *impl, EdgePtr edge )
+        {
+            HEdgePtr h1 = edge.hedge(),
+                     h2 = h1.pair();
+
+#if COMMON_DEBUG_LEVEL > 0
+            FATAL_ASSERT(!h1->face && !h2->face, "Only edges without faces can be unlinked");
+#endif
+
+            unindexEdge(impl, h1);
+
+            // h1 goes from v1 to v2
+            VertexPtr v1 = h2.vertex(),
+                      v2 = h1.vertex();
+
+            HEdgePtr h1Prev = h1.prev(),
+                     h1Next = h1.next(),
+                     h2Prev = h2.prev(),
+                     h2Next = h2.next();
+
+            if (h2Next == h1) {
+                v1->hedge = HEdgeHandle();
+            }
+            else {
+                h1Prev->next = h2Next;
+                h2Next->prev = h1Prev;
+                if (v1->hedge == h1) v1->hedge = h2Next;
+            }
+
+            if (h1Next == h2) {
+                v2->hedge = HEdgeHandle();
+            }
+            else {
+                h2Prev->next = h1Next;
+                h1Next->prev = h2Prev;
+                if (v2->hedge == h2) v2->hedge = h1Next;
+            }
+
+            HEdgeHandle hedge1 = h1,
+                        hedge2 = h2;
+            EdgeHandle handle = edge;
+
+            destroyHEdge(impl, hedge1);
+            destroyHEdge(impl, hedge2);
+            destroyEdge(impl, handle);
+        }
+
+        bool removeFace( Impl *impl, FacePtr face, bool removeIsolatedVertexes )
+        {
+            if (!face) return false;
+
+            HEdgePtr hedge = face.hedge();
+            size_t count = 0;
+            do {
+                hedge->face = FaceHandle();
+                hedge = hedge.next();
+                count++;
+            } while (hedge != face->hedge);
+
+            FaceHandle handle = face;
+            destroyFace(impl, handle);
+
+            // Unlinking a edge only touches the links of its neighbors, so the next half edge of the loop
+            //  is the same as before when we get to it
+            for (size_t i=0; i < count; ++i) {
+                HEdgePtr next = hedge.next(),
+                         pair = hedge.pair();
+
+                VertexPtr origin = pair.vertex(),
+                          target = hedge.vertex();
+
+                if (pair->face) {
+                    // The half edges of the face are border half edges now
+                    origin->hedge = hedge;
+                }
+                else {
+                    unlinkEdge(impl, hedge.edge());
+
+                    if (removeIsolatedVertexes) {
+                        if (!origin->hedge) destroyVertex(impl, origin);
+                        if (!target->hedge) destroyVertex(impl, target);
+                    }
+                }
+                hedge = next;
+            }
+            return true;
+        }
+
+        bool removeVertex( Impl *impl, VertexPtr vertex )
+        {
+            if (!vertex) return false;
+
+            if (vertex->hedge) {
+                size_t valence = 0;
+                HEdgePtr hedge = vertex.hedge();
+                do {
+                    valence++;
+                    hedge = hedge.pairNext();
+                } while (hedge != vertex->hedge);
+
+                // Removing the face of one outgoing half edge never removes the next one,
+                //  except for the last, whose edge may have been removed with the first face
+                for (size_t i=0; i < valence && hedge.valid(); ++i) {
+                    HEdgePtr next = hedge.pairNext();
+                    if (hedge->face) {
+                        removeFace(impl, hedge.face(), false);
+                    }
+                    hedge = next;
+                }
+
+                // Only edges without faces are left
+                while (vertex->hedge) {
+                    unlinkEdge(impl, vertex.hedge().edge());
+                }
+            }
+
+            VertexHandle handle = vertex;
+            destroyVertex(impl, handle);
+            return true;
+        }
+
+        bool flipEdge( Impl *impl, EdgePtr edge )
+        {
+            if (!edge) return false;
+
+            /*
+                  c               c
+                 / \             /|\
+                a---b    =>     a | b
+                 \ /             \|/
+                  d               d
+            */
+            HEdgePtr h0 = edge.hedge(),
+                     p0 = h0.pair();
+            if (!h0->face || !p0->face) return false;
+
+            HEdgePtr h1 = h0.next(),
+                     h2 = h1.next(),
+                     p1 = p0.next(),
+                     p2 = p1.next();
+            if (h2->next != h0 || p2->next != p0) return false;
+
+            VertexPtr a = p0.vertex(),
+                      b = h0.vertex(),
+                      c = h1.vertex(),
+                      d = p1.vertex();
+            if (c == d || findHEdge(impl, c, d)) return false;
+
+            FacePtr f0 = h0.face(),
+                    f1 = p0.face();
+
+            if (a->hedge == h0) a->hedge = p1;
+            if (b->hedge == p0) b->hedge = h1;
+
+            unindexEdge(impl, h0);
+            h0->vertex = c;
+            p0->vertex = d;
+
+            // f0 = a -> d -> c
+            p1->next = h0; h0->prev = p1;
+            h0->next = h2; h2->prev = h0;
+            h2->next = p1; p1->prev = h2;
+            // f1 = d -> b -> c
+            p2->next = h1; h1->prev = p2;
+            h1->next = p0; p0->prev = h1;
+            p0->next = p2; p2->prev = p0;
+
+            p1->face = f0;
+            h1->face = f1;
+            f0->hedge = h0;
+            f1->hedge = p0;
+
+            indexEdge(impl, h0);
+            return true;
+        }
+
+        VertexPtr splitEdge( Impl *impl, EdgePtr edge )
+        {
+            if (!edge) return VertexPtr();
+
+            // h goes from a to b, after the split it goes from a to the new vertex m
+            //  and the new edge (g and q) connects m with b.
+            //  a is the first vertex of the edge (the target of edge->hedge)
+            HEdgePtr p = edge.hedge(),
+                     h = p.pair();
+            VertexPtr b = h.vertex();
+
+            VertexPtr m = allocateVertex(impl);
+            EdgePtr newEdge = allocateEdge(impl);
+            HEdgePtr g = allocateHEdge(impl),
+                     q = allocateHEdge(impl);
+
+            if (!(m && newEdge && g && q)) {
+                freeVertex(impl, m);
+                freeEdge(impl, newEdge);
+                freeHEdge(impl, g);
+                freeHEdge(impl, q);
+                return VertexPtr();
+            }
+
+            unindexEdge(impl, p);
+
+            HEdgePtr hNext = h.next(),
+                     pPrev = p.prev();
+
+            newEdge->hedge = g;
+
+            g->edge = newEdge;
+            g->pair = q;
+            g->vertex = b;
+            g->face = h->face;
+
+            q->edge = newEdge;
+            q->pair = g;
+            q->vertex = m;
+            q->face = p->face;
+
+            if (hNext == p) {
+                // b is only connected to this edge
+                g->next = q;
+                q->prev = g;
+            }
+            else {
+                g->next = hNext;
+                hNext->prev = g;
+                pPrev->next = q;
+                q->prev = pPrev;
+            }
+
+            h->next = g;
+            g->prev = h;
+            q->next = p;
+            p->prev = q;
+
+            h->vertex = m;
+            m->hedge = p->face ? HEdgeHandle(g) : HEdgeHandle(p);
+            if (b->hedge == p) b->hedge = q;
+
+            indexEdge(impl, p);
+            indexEdge(impl, g);
+
+            impl->onVertexCreated(m);
+            impl->onHEdgeCreated(g);
+            impl->onHEdgeCreated(q);
+            impl->onEdgeCreated(newEdge);
+
+            return m;
+        }
+
+        FacePtr splitFace( Impl *impl, FacePtr face, VertexPtr v1, VertexPtr v2 )
+        {
+            if (!(face && v1 && v2) || v1 == v2) return FacePtr();
+
+            // The half edges of the face that ends in v1 and v2
+            HEdgePtr in1, in2;
+            HEdgePtr hedge = face.hedge();
+            do {
+                if (hedge->vertex == v1) in1 = hedge;
+                if (hedge->vertex == v2) in2 = hedge;
+                hedge = hedge.next();
+            } while (hedge != face->hedge);
+
+            if (!(in1 && in2)) return FacePtr();
+
+            HEdgePtr out1 = in1.next(),
+                     out2 = in2.next();
+
+            // The vertexes are already connected
+            if (out1->vertex == v2 || out2->vertex == v1) return FacePtr();
+            if (findHEdge(impl, v1, v2)) return FacePtr();
+
+            FacePtr newFace = allocateFace(impl);
+            EdgePtr edge = allocateEdge(impl);
+            HEdgePtr n = allocateHEdge(impl),
+                     m = allocateHEdge(impl);
+
+            if (!(newFace && edge && n && m)) {
+                freeFace(impl, newFace);
+                freeEdge(impl, edge);
+                freeHEdge(impl, n);
+                freeHEdge(impl, m);
+                return FacePtr();
+            }
+
+            // n goes from v1 to v2 in the new face, m goes back in the old one
+            edge->hedge = n;
+
+            n->edge = edge;
+            n->pair = m;
+            n->vertex = v2;
+
+            m->edge = edge;
+            m->pair = n;
+            m->vertex = v1;
+            m->face = face;
+
+            // face = out1 ... in2, m
+            in2->next = m; m->prev = in2;
+            m->next = out1; out1->prev = m;
+            // newFace = out2 ... in1, n
+            in1->next = n; n->prev = in1;
+            n->next = out2; out2->prev = n;
+
+            face->hedge = out1;
+            newFace->hedge = out2;
+
+            hedge = out2;
+            do {
+                hedge->face = newFace;
+                hedge = hedge.next();
+            } while (hedge != newFace->hedge);
+
+            indexEdge(impl, n);
+
+            impl->onHEdgeCreated(n);
+            impl->onHEdgeCreated(m);
+            impl->onEdgeCreated(edge);
+            impl->onFaceCreated(newFace);
+
+            return newFace;
+        }
+
+        bool isCollapseOk( const Impl *impl, CHEdgePtr hedge )
+        {
+            if (!hedge) return false;
+
+            CHEdgePtr pair = hedge.pair();
+            CVertexPtr v0 = pair.vertex(),
+                       v1 = hedge.vertex();
+
+            // Edges without faces should be removed instead
+            if (!hedge->face && !pair->face) return false;
+
+            // The vertexes opposite to the edge in the triangles (or triangular holes) that collapses
+            VertexHandle vl, vr;
+            for (int side=0; side < 2; ++side) {
+                CHEdgePtr h = side ? pair : hedge;
+
+                CHEdgePtr next = h.next(),
+                          prev = next.next();
+                if (prev->next != h) continue;
+
+                // The two remaining edges are merged, they must not have the same face on their other side
+                //  (that includes both being border edges)
+                if (next.pair()->face == prev.pair()->face) return false;
+
+                (side ? vr : vl) = next->vertex;
+            }
+            if (vl && vl == vr) return false;
+
+            // A inner edge between two border vertexes would pinch the surface
+            if (hedge->face && pair->face && isBorderVertex(impl, v0) && isBorderVertex(impl, v1)) {
+                return false;
+            }
+
+            // Link condition: only the opposite vertexes may be neighbors to both v0 and v1.
+            //  The neighbors of v0 are sorted (on the stack unless the valence is high), and looked up from one pass over v1's fan
+            VertexHandle stackNeighbors[32];
+            std::vector<VertexHandle> heapNeighbors;
+            VertexHandle *neighbors = stackNeighbors;
+            size_t neighborCount = 0;
+
+            CHEdgePtr out0 = v0.hedge();
+            do {
+                VertexHandle neighbor = out0->vertex;
+                if (neighbor != v1 && neighbor != vl && neighbor != vr) {
+                    if (neighborCount < std::size(stackNeighbors)) {
+                        stackNeighbors[neighborCount] = neighbor;
+                    }
+                    else {
+                        if (heapNeighbors.empty()) heapNeighbors.assign(stackNeighbors, stackNeighbors + neighborCount);
+                        heapNeighbors.push_back(neighbor);
+                        neighbors = heapNeighbors.data();
+                    }
+                    neighborCount++;
+                }
+                out0 = out0.pairNext();
+            } while (out0 != v0->hedge);
+
+            if (neighborCount == 0) return true;
+            std::sort(neighbors, neighbors + neighborCount);
+
+            CHEdgePtr out1 = v1.hedge();
+            do {
+                if (std::binary_search(neighbors, neighbors + neighborCount, out1->vertex)) return false;
+                out1 = out1.pairNext();
+            } while (out1 != v1->hedge);
+
+            return true;
+        }
+
+        // Removes a face with only two edges (h0 and its next), the edges are merged into the edge of h0->next
+        void collapseLoop( Impl *impl, HEdgePtr h0 )
+        {
+            HEdgePtr h1 = h0.next(),
+                     o0 = h0.pair(),
+                     o1 = h1.pair();
+
+            VertexPtr v0 = h0.vertex(),
+                      v1 = h1.vertex();
+
+            FaceHandle face = h0->face;
+            FacePtr other = o0.face();
+
+            // h1 takes the place of o0
+            HEdgePtr oNext = o0.next(),
+                     oPrev = o0.prev();
+            h1->next = oNext; oNext->prev = h1;
+            oPrev->next = h1; h1->prev = oPrev;
+            h1->face = other;
+
+            if (other && other->hedge == o0) other->hedge = h1;
+            v0->hedge = h1;
+            v1->hedge = o1;
+
+            HEdgeHandle hedge0 = h0,
+                        pair0 = o0;
+            EdgeHandle edge = h0->edge;
+
+            destroyHEdge(impl, hedge0);
+            destroyHEdge(impl, pair0);
+            destroyEdge(impl, edge);
+            if (face) destroyFace(impl, face);
+
+            adjustOutgoing(impl, v0);
+        }
+
+        bool collapseEdge( Impl *impl, HEdgePtr hedge )
+        {
+            if (!isCollapseOk(impl, hedge)) return false;
+
+            HEdgePtr pair = hedge.pair();
+            HEdgePtr hNext = hedge.next(),
+                     hPrev = hedge.prev(),
+                     pNext = pair.next(),
+                     pPrev = pair.prev();
+
+            VertexPtr v0 = pair.vertex(),
+                      v1 = hedge.vertex();
+
+            FacePtr hFace = hedge.face(),
+                    pFace = pair.face();
+
+            // The edges around v0 are indexed again from v1 once it is done
+            unindexVertex(impl, v0);
+
+            // Every half edge ending in v0 ends in v1 instead
+            HEdgePtr out = v0.hedge();
+            do {
+                out.pair()->vertex = v1;
+                out = out.pairNext();
+            } while (out != v0->hedge);
+
+            hPrev->next = hNext; hNext->prev = hPrev;
+            pPrev->next = pNext; pNext->prev = pPrev;
+
+            if (hFace && hFace->hedge == hedge) hFace->hedge = hNext;
+            if (pFace && pFace->hedge == pair) pFace->hedge = pNext;
+            if (v1->hedge == pair) v1->hedge = hNext;
+
+            VertexHandle vertex = v0;
+            HEdgeHandle hedge0 = hedge,
+                        pair0 = pair;
+            EdgeHandle edge = hedge->edge;
+
+            destroyHEdge(impl, hedge0);
+            destroyHEdge(impl, pair0);
+            destroyEdge(impl, edge);
+            destroyVertex(impl, vertex);
+
+            // Triangles becomes loops of two edges
+            if (hNext->next == hPrev) collapseLoop(impl, hNext);
+            if (pNext->next == pPrev) collapseLoop(impl, pNext);
+
+            adjustOutgoing(impl, v1);
+            indexVertex(impl, v1);
+            return true;
+        }
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::removeFace( FaceHandle face, bool removeIsolatedVertexes )
+    {
+        return internal::removeFace(mImpl, internal::FacePtr(mImpl, face), removeIsolatedVertexes);
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::removeVertex( VertexHandle vertex )
+    {
+        return internal::removeVertex(mImpl, internal::VertexPtr(mImpl, vertex));
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::flipEdge( EdgeHandle edge )
+    {
+        return internal::flipEdge(mImpl, internal::EdgePtr(mImpl, edge));
+    }
+
+    COMMON_API HalfEdgeMeshBase::VertexHandle HalfEdgeMeshBase::splitEdge( EdgeHandle edge )
+    {
+        return internal::splitEdge(mImpl, internal::EdgePtr(mImpl, edge));
+    }
+
+    COMMON_API HalfEdgeMeshBase::FaceHandle HalfEdgeMeshBase::splitFace( FaceHandle face, VertexHandle v1, VertexHandle v2 )
+    {
+        return internal::splitFace(mImpl,
+            internal::FacePtr(mImpl, face),
+            internal::VertexPtr(mImpl, v1),
+            internal::VertexPtr(mImpl, v2)
+        );
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::isCollapseOk( HEdgeHandle hedge ) const
+    {
+        return internal::isCollapseOk(mImpl, internal::CHEdgePtr(mImpl, hedge));
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::collapseEdge( HEdgeHandle hedge )
+    {
+        return internal::collapseEdge(mImpl, internal::HEdgePtr(mImpl, hedge));
+    }
+}
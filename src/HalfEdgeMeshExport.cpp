@@ -0,0 +1,348 @@
+#include "HalfEdgeMeshExport.h"
+#include "HalfEdgeMeshIterator.h"
+#include "HalfEdgeMeshTopology.h"
+
+#include "ErrorUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Common
+{
+    namespace ExportImpl
+    {
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+        using HEdgeHandle = HalfEdgeMeshBase::HEdgeHandle;
+        using EdgeHandle = HalfEdgeMeshBase::EdgeHandle;
+        using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+        using Topology = internal::HalfEdgeMeshTopology;
+
+        static const size_t GRAIN_SIZE = 1024;
+        static const uint32_t INVALID = ~0u;
+
+        // The constants from the paper
+        static const float CACHE_DECAY_POWER = 1.5f;
+        static const float LAST_TRIANGLE_SCORE = 0.75f;
+        static const float VALENCE_BOOST_SCALE = 2.0f;
+        static const float VALENCE_BOOST_POWER = 0.5f;
+
+        // The score only depends on the cache position and the number of triangles left, so it is tabulated
+        struct ScoreTable {
+            static const uint32_t MAX_VALENCE = 32;
+
+            std::vector<float> cache;
+            float valence[MAX_VALENCE];
+
+            explicit ScoreTable( uint32_t cacheSize ) :
+                cache(cacheSize + 1, 0.f)
+            {
+                float scale = 1.f / (cacheSize - 3);
+                for (uint32_t i=0; i < cacheSize; ++i) {
+                    // The vertexes of the last triangle, using them again would make a strip
+                    cache[i] = (i < 3) ? LAST_TRIANGLE_SCORE : std::pow(1.f - (i - 3) * scale, CACHE_DECAY_POWER);
+                }
+                // Finish off vertexes with few triangles left, so they don't linger
+                valence[0] = 0.f;
+                for (uint32_t i=1; i < MAX_VALENCE; ++i) {
+                    valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+                }
+            }
+
+            // 'cachePosition' is cacheSize if the vertex isn't in the cache
+            float operator () ( uint32_t cachePosition, uint32_t remaining ) const {
+                if (remaining == 0) return -1.f;
+                return cache[cachePosition] + valence[std::min(remaining, MAX_VALENCE-1)];
+            }
+        };
+
+        const internal::HEdge& hedge( const Topology &topology, HEdgeHandle handle )
+        {
+            return *topology.hedges.find(handle);
+        }
+
+        // The vertex opposite of the half edge in the neighboring fan triangle, or 'own' on the border
+        uint32_t across( const Topology &topology, const ManuelHandleVector<VertexHandle, uint32_t> &vertexIndex, const internal::HEdge &h, uint32_t own )
+        {
+            const internal::HEdge &pair = hedge(topology, h.pair);
+            if (!pair.face) return own;
+
+            // The neighbor is fanned from the target of its first half edge
+            HEdgeHandle first = topology.faces.find(pair.face)->hedge;
+            VertexHandle opposite;
+            if (h.pair == first) {
+                opposite = hedge(topology, hedge(topology, pair.prev).prev).vertex;
+            }
+            else if (h.pair == hedge(topology, first).next) {
+                opposite = hedge(topology, pair.next).vertex;
+            }
+            else {
+                opposite = hedge(topology, first).vertex;
+            }
+            return *vertexIndex.find(opposite);
+        }
+
+        template< typename T >
+        void permute( std::vector<T> &values, const std::vector<uint32_t> &order, size_t stride, ThreadPool *pool )
+        {
+            if (values.empty()) return;
+
+            std::vector<T> result(values.size());
+            pool->parallelFor(order.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    for (size_t k=0; k < stride; ++k) {
+                        result[i*stride + k] = values[order[i]*stride + k];
+                    }
+                }
+            });
+            values.swap(result);
+        }
+
+        void remap( std::vector<uint32_t> &indices, const std::vector<uint32_t> &newIndex, ThreadPool *pool )
+        {
+            pool->parallelFor(indices.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    indices[i] = newIndex[indices[i]];
+                }
+            });
+        }
+    }
+
+    COMMON_API IndexedExport exportIndexed( const HalfEdgeMeshBase &mesh, const ExportSettings &settings, ThreadPool *pool )
+    {
+        using namespace ExportImpl;
+
+        if (!pool) pool = &ThreadPool::Global();
+        const Topology &topology = mesh.topology();
+
+        IndexedExport result;
+
+        ManuelHandleVector<VertexHandle, uint32_t> vertexIndex;
+        for (VertexHandle vertex : mesh.vertexes()) {
+            vertexIndex.allocate(vertex, uint32_t(result.vertexes.size()));
+            result.vertexes.push_back(vertex);
+        }
+
+        if (settings.triangles || settings.adjacency) {
+            std::vector<FaceHandle> faces;
+            std::vector<uint32_t> firstTriangle;
+            size_t triangleCount = 0;
+            for (FaceHandle face : mesh.faces()) {
+                HEdgeHandle first = topology.faces.find(face)->hedge,
+                            current = first;
+                size_t count = 0;
+                do {
+                    count++;
+                    current = hedge(topology, current).next;
+                } while (current != first);
+
+                faces.push_back(face);
+                firstTriangle.push_back(uint32_t(triangleCount));
+                triangleCount += count - 2;
+            }
+
+            result.triangles.resize(triangleCount * 3);
+            result.triangleFaces.resize(triangleCount);
+            if (settings.adjacency) {
+                result.adjacency.resize(triangleCount * 6);
+            }
+
+            pool->parallelFor(faces.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                std::vector<const internal::HEdge*> corners;
+                std::vector<uint32_t> indices;
+
+                for (size_t f=begin; f < end; ++f) {
+                    // corners[i] is the half edge that ends in vertex i of the face
+                    corners.clear();
+                    indices.clear();
+                    HEdgeHandle first = topology.faces.find(faces[f])->hedge,
+                                current = first;
+                    do {
+                        const internal::HEdge &h = hedge(topology, current);
+                        corners.push_back(&h);
+                        indices.push_back(*vertexIndex.find(h.vertex));
+                        current = h.next;
+                    } while (current != first);
+
+                    size_t n = corners.size();
+                    for (size_t i=1; i+1 < n; ++i) {
+                        size_t triangle = firstTriangle[f] + i - 1;
+
+                        uint32_t *out = &result.triangles[triangle*3];
+                        out[0] = indices[0];
+                        out[1] = indices[i];
+                        out[2] = indices[i+1];
+                        result.triangleFaces[triangle] = faces[f];
+
+                        if (!settings.adjacency) continue;
+
+                        // The diagonals of the fan are shared with the previous and next triangle
+                        uint32_t *adjacency = &result.adjacency[triangle*6];
+                        adjacency[0] = indices[0];
+                        adjacency[1] = (i == 1) ? across(topology, vertexIndex, *corners[1], indices[i+1]) : indices[i-1];
+                        adjacency[2] = indices[i];
+                        adjacency[3] = across(topology, vertexIndex, *corners[i+1], indices[0]);
+                        adjacency[4] = indices[i+1];
+                        adjacency[5] = (i+2 == n) ? across(topology, vertexIndex, *corners[0], indices[i]) : indices[i+2];
+                    }
+                }
+            });
+        }
+
+        if (settings.edges) {
+            for (EdgeHandle edge : mesh.edges()) {
+                result.edgeHandles.push_back(edge);
+            }
+            result.edges.resize(result.edgeHandles.size() * 2);
+
+            pool->parallelFor(result.edgeHandles.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+                for (size_t i=begin; i < end; ++i) {
+                    const internal::HEdge &h = hedge(topology, topology.edges.find(result.edgeHandles[i])->hedge);
+                    result.edges[i*2]   = *vertexIndex.find(hedge(topology, h.pair).vertex);
+                    result.edges[i*2+1] = *vertexIndex.find(h.vertex);
+                }
+            });
+        }
+
+        if (settings.optimizeVertexCache && !result.triangleFaces.empty()) {
+            std::vector<uint32_t> order(result.triangleFaces.size());
+            optimizeVertexCache(result.triangles.data(), order.size(), result.vertexes.size(), order.data(), settings.cacheSize);
+
+            permute(result.triangles, order, 3, pool);
+            permute(result.triangleFaces, order, 1, pool);
+            permute(result.adjacency, order, 6, pool);
+        }
+
+        if (settings.optimizeVertexFetch) {
+            std::vector<uint32_t> newIndex(result.vertexes.size(), INVALID);
+            std::vector<VertexHandle> vertexes;
+            vertexes.reserve(result.vertexes.size());
+
+            for (uint32_t index : result.triangles) {
+                if (newIndex[index] == INVALID) {
+                    newIndex[index] = uint32_t(vertexes.size());
+                    vertexes.push_back(result.vertexes[index]);
+                }
+            }
+            for (uint32_t index=0; index < newIndex.size(); ++index) {
+                if (newIndex[index] == INVALID) {
+                    newIndex[index] = uint32_t(vertexes.size());
+                    vertexes.push_back(result.vertexes[index]);
+                }
+            }
+
+            result.vertexes.swap(vertexes);
+            remap(result.triangles, newIndex, pool);
+            remap(result.adjacency, newIndex, pool);
+            remap(result.edges, newIndex, pool);
+        }
+
+        if (!settings.triangles) {
+            result.triangles.clear();
+            result.triangleFaces.clear();
+        }
+        return result;
+    }
+
+    COMMON_API void optimizeVertexCache( const uint32_t *indices, size_t triangleCount, size_t vertexCount, uint32_t *order, uint32_t cacheSize )
+    {
+        using namespace ExportImpl;
+
+        if (cacheSize < 4) cacheSize = 4;
+
+        // The triangles that uses each vertex, the ones that are left to emit are first in each list
+        std::vector<uint32_t> offsets(vertexCount + 1, 0),
+                              remaining(vertexCount, 0),
+                              vertexTriangles(triangleCount * 3);
+        for (size_t i=0; i < triangleCount*3; ++i) {
+            FATAL_ASSERT(indices[i] < vertexCount, "Index %u is out of range", indices[i]);
+            remaining[indices[i]]++;
+        }
+        for (size_t v=0; v < vertexCount; ++v) {
+            offsets[v+1] = offsets[v] + remaining[v];
+        }
+        {
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i=0; i < triangleCount*3; ++i) {
+                vertexTriangles[fill[indices[i]]++] = uint32_t(i / 3);
+            }
+        }
+
+        ScoreTable vertexScore(cacheSize);
+        std::vector<float> score(vertexCount);
+        std::vector<bool> emitted(triangleCount, false);
+
+        for (size_t v=0; v < vertexCount; ++v) {
+            score[v] = vertexScore(cacheSize, remaining[v]);
+        }
+        auto triangleScore = [&]( size_t t ) {
+            return score[indices[t*3]] + score[indices[t*3+1]] + score[indices[t*3+2]];
+        };
+
+        // The cache holds 3 more entries, for the vertexes that are pushed out by the next triangle
+        std::vector<uint32_t> cache, nextCache;
+        cache.reserve(cacheSize + 3);
+        nextCache.reserve(cacheSize + 3);
+
+        uint32_t best = triangleCount > 0 ? 0 : INVALID;
+        for (size_t t=1; t < triangleCount; ++t) {
+            if (triangleScore(t) > triangleScore(best)) best = uint32_t(t);
+        }
+
+        size_t cursor = 0;
+        for (size_t emitCount=0; emitCount < triangleCount; ++emitCount) {
+            if (best == INVALID) {
+                // Nothing in the cache is connected to a triangle that is left, start somewhere else
+                while (emitted[cursor]) cursor++;
+                best = uint32_t(cursor);
+            }
+
+            order[emitCount] = best;
+            emitted[best] = true;
+
+            const uint32_t *triangle = &indices[best*3];
+            for (int k=0; k < 3; ++k) {
+                uint32_t v = triangle[k];
+                uint32_t *first = &vertexTriangles[offsets[v]],
+                         *last = first + remaining[v];
+                std::iter_swap(std::find(first, last, best), last - 1);
+                remaining[v]--;
+            }
+
+            nextCache.clear();
+            for (int k=0; k < 3; ++k) {
+                if (std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end()) {
+                    nextCache.push_back(triangle[k]);
+                }
+            }
+            for (uint32_t v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    nextCache.push_back(v);
+                }
+            }
+            cache.swap(nextCache);
+
+            for (size_t i=0; i < cache.size(); ++i) {
+                uint32_t v = cache[i];
+                score[v] = vertexScore(uint32_t(std::min<size_t>(i, cacheSize)), remaining[v]);
+            }
+
+            // Only the triangles around the cache has changed, the best of them is next
+            best = INVALID;
+            float bestScore = -1.f;
+            for (uint32_t v : cache) {
+                for (uint32_t i=offsets[v]; i < offsets[v] + remaining[v]; ++i) {
+                    uint32_t t = vertexTriangles[i];
+                    float s = triangleScore(t);
+                    if (s > bestScore) {
+                        bestScore = s;
+                        best = t;
+                    }
+                }
+            }
+
+            if (cache.size() > cacheSize) {
+                cache.resize(cacheSize);
+            }
+        }
+    }
+}
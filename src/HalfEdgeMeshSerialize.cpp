@@ -0,0 +1,295 @@
+#include "HalfEdgeMesh.impl.h"
+#include "Archive.h"
+#include "Murmur3_32.h"
+
+#include "ErrorUtils.h"
+
+#include <algorithm>
+
+// The layout of a serialized mesh, every part starts at a multiple of ALIGNMENT bytes from the start
+//  so the arrays can be used in place when the data is mapped at an aligned address:
+//      FileHeader
+//      For each table:
+//          TableHeader
+//          'count' handles, 'handleSize' bytes each
+//          'count' values, 'valueSize' bytes each
+//  The first four tables are the topology (vertexes, half edges, edges & faces),
+//  the tables from HalfEdgeMeshBase::onSave follows them.
+//  The slots are stored as they are in memory (native byte order), free slots included.
+
+namespace Common
+{
+#define MESH_SIGNATURE "HalfEdgeMesh"
+#define MESH_SIGNATURE_LEN sizeof(MESH_SIGNATURE)
+
+    namespace Serialize
+    {
+        static const uint32_t MeshVersion = 2;
+        static const size_t ALIGNMENT = 16;
+        // The checksum is chained over blocks, murmur3_32 takes a 32 bit length
+        static const size_t CHECKSUM_BLOCK_SIZE = 1024 * 1024;
+
+        struct FileHeader {
+            uint8_t sig[16] = MESH_SIGNATURE;
+            uint32_t version = MeshVersion;
+            uint32_t tableCount = 0;
+            // The size of the data, including this header
+            uint64_t size = 0;
+            // Of everything after the header
+            uint32_t checksum = 0;
+            uint32_t padding[3] = {};
+        };
+
+        struct TableHeader {
+            uint64_t count = 0;
+            uint32_t handleSize = 0,
+                     valueSize = 0;
+            uint64_t freeListHead = 0,
+                     freeListTail = 0;
+            // The generation appended slots starts at, see HandleVector::saveSlots (added in version 2)
+            uint64_t newSlotGeneration = 0,
+                     padding = 0;
+        };
+
+        static_assert(sizeof(FileHeader) % ALIGNMENT == 0 && sizeof(TableHeader) % ALIGNMENT == 0, "The headers must keep the alignment");
+
+        uint64_t alignUp( uint64_t offset )
+        {
+            return (offset + ALIGNMENT-1) & ~uint64_t(ALIGNMENT-1);
+        }
+
+        uint32_t checksum( const uint8_t *data, size_t size )
+        {
+            uint32_t hash = 0;
+            for (size_t offset=0; offset < size; offset += CHECKSUM_BLOCK_SIZE) {
+                size_t block = std::min(CHECKSUM_BLOCK_SIZE, size - offset);
+                hash = murmur3_32(reinterpret_cast<const char*>(data + offset), (uint32_t)block, hash);
+            }
+            return hash;
+        }
+    }
+
+    HalfEdgeMeshWriter::HalfEdgeMeshWriter()
+    {
+        mData.resize(sizeof(Serialize::FileHeader));
+    }
+
+    COMMON_API size_t HalfEdgeMeshWriter::addTable( size_t count, size_t handleSize, size_t valueSize, void *&handles, void *&values )
+    {
+        using namespace Serialize;
+
+        size_t offset = mData.size(),
+               handlesOffset = offset + sizeof(TableHeader),
+               valuesOffset = (size_t)alignUp(handlesOffset + count*handleSize),
+               end = (size_t)alignUp(valuesOffset + count*valueSize);
+
+        // The padding is zeroed, so the same mesh always gives the same bytes
+        mData.resize(end);
+
+        TableHeader header;
+        header.count = count;
+        header.handleSize = (uint32_t)handleSize;
+        header.valueSize = (uint32_t)valueSize;
+        memcpy(mData.data() + offset, &header, sizeof(header));
+
+        handles = mData.data() + handlesOffset;
+        values = mData.data() + valuesOffset;
+        mTableCount++;
+        return offset;
+    }
+
+    COMMON_API void HalfEdgeMeshWriter::setSlotState( size_t table, uint64_t freeListHead, uint64_t freeListTail, uint64_t newSlotGeneration )
+    {
+        Serialize::TableHeader header;
+        memcpy(&header, mData.data() + table, sizeof(header));
+        header.freeListHead = freeListHead;
+        header.freeListTail = freeListTail;
+        header.newSlotGeneration = newSlotGeneration;
+        memcpy(mData.data() + table, &header, sizeof(header));
+    }
+
+    COMMON_API bool HalfEdgeMeshWriter::unsupportedType()
+    {
+        LOG_ERROR("Failed to save mesh - the data of table %u isn't trivially copyable", mTableCount);
+        return false;
+    }
+
+    std::vector<uint8_t> HalfEdgeMeshWriter::finish()
+    {
+        using namespace Serialize;
+
+        FileHeader header;
+        header.tableCount = mTableCount;
+        header.size = mData.size();
+        header.checksum = checksum(mData.data() + sizeof(FileHeader), mData.size() - sizeof(FileHeader));
+        memcpy(mData.data(), &header, sizeof(header));
+
+        return std::move(mData);
+    }
+
+    HalfEdgeMeshReader::HalfEdgeMeshReader( const void *data, size_t size ) :
+        mData(static_cast<const uint8_t*>(data)),
+        mSize(data ? size : 0)
+    {
+    }
+
+    bool HalfEdgeMeshReader::open()
+    {
+        using namespace Serialize;
+
+        FileHeader header;
+        if (mSize < sizeof(header)) {
+            LOG_ERROR("Invalid mesh data - too small for the header (%llu bytes)", (unsigned long long)mSize);
+            return false;
+        }
+        memcpy(&header, mData, sizeof(header));
+
+        if (memcmp(header.sig, MESH_SIGNATURE, MESH_SIGNATURE_LEN) != 0) {
+            LOG_ERROR("Invalid mesh data - signature missmatch");
+            return false;
+        }
+        if (header.version != MeshVersion) {
+            LOG_ERROR("Unkown mesh version %i, expected %i", (int)header.version, (int)MeshVersion);
+            return false;
+        }
+        if (header.size != mSize) {
+            LOG_ERROR("Invalid mesh data - the header says %llu bytes, but there is %llu", (unsigned long long)header.size, (unsigned long long)mSize);
+            return false;
+        }
+        if (header.checksum != checksum(mData + sizeof(header), mSize - sizeof(header))) {
+            LOG_ERROR("Invalid mesh data - checksum missmatch");
+            return false;
+        }
+
+        mTableCount = header.tableCount;
+        mOffset = sizeof(header);
+        return true;
+    }
+
+    bool HalfEdgeMeshReader::atEnd() const
+    {
+        return mTable == mTableCount && mOffset == mSize;
+    }
+
+    COMMON_API bool HalfEdgeMeshReader::nextTable( size_t handleSize, size_t valueSize, size_t &count, const void *&handles, const void *&values, uint64_t &freeListHead, uint64_t &freeListTail, uint64_t &newSlotGeneration )
+    {
+        using namespace Serialize;
+
+        if (mTable >= mTableCount) {
+            LOG_ERROR("Invalid mesh data - table %u is missing (there is %u tables)", mTable, mTableCount);
+            return false;
+        }
+
+        TableHeader header;
+        if (mSize - mOffset < sizeof(header)) {
+            LOG_ERROR("Invalid mesh data - table %u is truncated", mTable);
+            return false;
+        }
+        memcpy(&header, mData + mOffset, sizeof(header));
+
+        if (header.handleSize != handleSize || header.valueSize != valueSize) {
+            LOG_ERROR("Invalid mesh data - table %u has %u byte handles and %u byte values, expected %u and %u",
+                      mTable, header.handleSize, header.valueSize, (unsigned)handleSize, (unsigned)valueSize);
+            return false;
+        }
+
+        // The sizes are checked before they are multiplied, so a corrupt count can't overflow
+        uint64_t handlesOffset = mOffset + sizeof(header);
+        if (header.count > (mSize - handlesOffset) / handleSize) {
+            LOG_ERROR("Invalid mesh data - table %u is truncated", mTable);
+            return false;
+        }
+        uint64_t valuesOffset = alignUp(handlesOffset + header.count*handleSize);
+        if (valuesOffset > mSize || header.count > (mSize - valuesOffset) / valueSize) {
+            LOG_ERROR("Invalid mesh data - table %u is truncated", mTable);
+            return false;
+        }
+        uint64_t end = alignUp(valuesOffset + header.count*valueSize);
+        if (end > mSize) {
+            LOG_ERROR("Invalid mesh data - table %u is truncated", mTable);
+            return false;
+        }
+
+        count = (size_t)header.count;
+        handles = mData + handlesOffset;
+        values = mData + valuesOffset;
+        freeListHead = header.freeListHead;
+        freeListTail = header.freeListTail;
+        newSlotGeneration = header.newSlotGeneration;
+
+        mOffset = (size_t)end;
+        mTable++;
+        return true;
+    }
+
+    COMMON_API bool HalfEdgeMeshReader::inconsistentTable()
+    {
+        LOG_ERROR("Invalid mesh data - table %u is inconsistent", mTable-1);
+        return false;
+    }
+
+    COMMON_API bool HalfEdgeMeshReader::unsupportedType()
+    {
+        LOG_ERROR("Failed to load mesh - the data of table %u isn't trivially copyable", mTable);
+        return false;
+    }
+
+    COMMON_API std::vector<uint8_t> HalfEdgeMeshBase::save() const
+    {
+        const internal::Impl *impl = mImpl;
+
+        HalfEdgeMeshWriter writer;
+        writer.write(impl->vertexes);
+        writer.write(impl->hedges);
+        writer.write(impl->edges);
+        writer.write(impl->faces);
+        if (!onSave(writer)) {
+            return std::vector<uint8_t>();
+        }
+        return writer.finish();
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::load( const void *data, size_t size )
+    {
+        internal::Impl *impl = mImpl;
+
+        HalfEdgeMeshReader reader(data, size);
+        bool ok = reader.open() &&
+                  reader.read(impl->vertexes) &&
+                  reader.read(impl->hedges) &&
+                  reader.read(impl->edges) &&
+                  reader.read(impl->faces) &&
+                  onLoad(reader);
+        if (ok && !reader.atEnd()) {
+            LOG_ERROR("Invalid mesh data - there is more tables than the mesh reads");
+            ok = false;
+        }
+
+        // Every element has been replaced
+        impl->vertexesLock++;
+        impl->hedgesLock++;
+        impl->edgesLock++;
+        impl->facesLock++;
+
+        // The topology isn't verified, but the edge index needs the pair of every half edge
+        if (ok && !internal::rebuildEdgeIndex(impl)) {
+            LOG_ERROR("Invalid mesh data - a half edge doesn't have a pair");
+            ok = false;
+        }
+        if (!ok) {
+            clear();
+        }
+        return ok;
+    }
+
+    COMMON_API bool HalfEdgeMeshBase::load( Archive &archive, const std::string &file )
+    {
+        ArchiveFileHandleRAII handle = archive.openFile(file);
+        if (!handle) {
+            LOG_ERROR("Failed to open mesh \"%s\" in archive \"%s\"", file.c_str(), archive.name());
+            clear();
+            return false;
+        }
+        return load(archive.mapFile(handle), archive.fileSize(handle));
+    }
+}
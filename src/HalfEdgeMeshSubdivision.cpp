@@ -0,0 +1,296 @@
+#include "HalfEdgeMeshSubdivision.h"
+#include "HalfEdgeMeshIterator.h"
+#include "HalfEdgeMeshTopology.h"
+
+#include "ErrorUtils.h"
+
+#include <cmath>
+
+namespace Common
+{
+    namespace SubdivisionImpl
+    {
+        using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+        using HEdgeHandle = HalfEdgeMeshBase::HEdgeHandle;
+        using EdgeHandle = HalfEdgeMeshBase::EdgeHandle;
+        using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+        using Topology = internal::HalfEdgeMeshTopology;
+
+        static const size_t GRAIN_SIZE = 1024;
+        static const double PI = 3.14159265358979323846;
+
+        inline const internal::HEdge& hedge( const Topology &topology, HEdgeHandle handle )
+        {
+            return *topology.hedges.find(handle);
+        }
+
+        inline size_t faceSize( const Topology &topology, FaceHandle face )
+        {
+            HEdgeHandle first = topology.faces.find(face)->hedge,
+                        current = first;
+            size_t count = 0;
+            do {
+                count++;
+                current = hedge(topology, current).next;
+            } while (current != first);
+            return count;
+        }
+
+        // Emits the vertexes of 'face', each with 'weight'
+        template< typename Emit >
+        void emitFace( const Topology &topology, FaceHandle face, float weight, Emit &emit )
+        {
+            HEdgeHandle first = topology.faces.find(face)->hedge,
+                        current = first;
+            do {
+                const internal::HEdge &h = hedge(topology, current);
+                emit(h.vertex, weight);
+                current = h.next;
+            } while (current != first);
+        }
+
+        // The stencils, emit(vertex, weight) is called for each source vertex that makes up the new vertex.
+        //  They are called twice, first to count the entries and then to write them.
+
+        template< typename Emit >
+        void vertexStencil( const Topology &topology, SubdivisionScheme scheme, VertexHandle vertex, Emit &emit )
+        {
+            HEdgeHandle first = topology.vertexes.find(vertex)->hedge;
+            if (!first) {
+                emit(vertex, 1.f);
+                return;
+            }
+
+            // The outgoing half edges, a edge is on the border if it is missing a face on either side
+            size_t valence = 0, borders = 0;
+            VertexHandle borderNeighbors[2];
+            HEdgeHandle current = first;
+            do {
+                const internal::HEdge &h = hedge(topology, current);
+                if (!h.face || !hedge(topology, h.pair).face) {
+                    if (borders < 2) borderNeighbors[borders] = h.vertex;
+                    borders++;
+                }
+                valence++;
+                current = hedge(topology, h.pair).next;
+            } while (current != first);
+
+            if (borders == 2) {
+                emit(vertex, 0.75f);
+                emit(borderNeighbors[0], 0.125f);
+                emit(borderNeighbors[1], 0.125f);
+                return;
+            }
+            if (borders > 0) {
+                emit(vertex, 1.f);
+                return;
+            }
+
+            double n = double(valence);
+            if (scheme == SubdivisionScheme::Loop) {
+                double c = 3.0/8.0 + 0.25 * std::cos(2.0*PI / n),
+                       beta = (5.0/8.0 - c*c) / n;
+                emit(vertex, float(1.0 - n*beta));
+                current = first;
+                do {
+                    const internal::HEdge &h = hedge(topology, current);
+                    emit(h.vertex, float(beta));
+                    current = hedge(topology, h.pair).next;
+                } while (current != first);
+            }
+            else {
+                // (F + 2R + (n-3)P) / n, where F is the average of the face points and R the average of the edge midpoints
+                emit(vertex, float((n - 2.0) / n));
+                current = first;
+                do {
+                    const internal::HEdge &h = hedge(topology, current);
+                    emit(h.vertex, float(1.0 / (n*n)));
+                    emitFace(topology, h.face, float(1.0 / (n*n*double(faceSize(topology, h.face)))), emit);
+                    current = hedge(topology, h.pair).next;
+                } while (current != first);
+            }
+        }
+
+        template< typename Emit >
+        void edgeStencil( const Topology &topology, SubdivisionScheme scheme, EdgeHandle edge, Emit &emit )
+        {
+            const internal::HEdge &h = hedge(topology, topology.edges.find(edge)->hedge),
+                                  &pair = hedge(topology, h.pair);
+            if (!h.face || !pair.face) {
+                emit(h.vertex, 0.5f);
+                emit(pair.vertex, 0.5f);
+                return;
+            }
+
+            if (scheme == SubdivisionScheme::Loop) {
+                emit(h.vertex, 0.375f);
+                emit(pair.vertex, 0.375f);
+                // The vertexes opposite to the edge
+                emit(hedge(topology, h.next).vertex, 0.125f);
+                emit(hedge(topology, pair.next).vertex, 0.125f);
+            }
+            else {
+                // The average of the end points and the two face points
+                emit(h.vertex, 0.25f);
+                emit(pair.vertex, 0.25f);
+                emitFace(topology, h.face, 0.25f / float(faceSize(topology, h.face)), emit);
+                emitFace(topology, pair.face, 0.25f / float(faceSize(topology, pair.face)), emit);
+            }
+        }
+
+        template< typename Emit >
+        void faceStencil( const Topology &topology, FaceHandle face, Emit &emit )
+        {
+            emitFace(topology, face, 1.f / float(faceSize(topology, face)), emit);
+        }
+    }
+
+    COMMON_API bool subdivide( const HalfEdgeMeshBase &source, HalfEdgeMeshBase &target, SubdivisionScheme scheme, const SubdivisionBlend &blend, ThreadPool *pool )
+    {
+        using namespace SubdivisionImpl;
+
+        if (&source == &target) {
+            LOG_ERROR("Can't subdivide a mesh into itself");
+            return false;
+        }
+        target.clear();
+        if (!pool) pool = &ThreadPool::Global();
+
+        const Topology &topology = source.topology();
+        const bool catmullClark = (scheme == SubdivisionScheme::CatmullClark);
+
+        std::vector<VertexHandle> vertexes;
+        std::vector<EdgeHandle> edges;
+        std::vector<FaceHandle> faces;
+        ManuelHandleVector<VertexHandle, uint32_t> vertexIndex;
+        ManuelHandleVector<EdgeHandle, uint32_t> edgeIndex;
+        for (VertexHandle vertex : source.vertexes()) {
+            vertexIndex.allocate(vertex, uint32_t(vertexes.size()));
+            vertexes.push_back(vertex);
+        }
+        for (EdgeHandle edge : source.edges()) {
+            edgeIndex.allocate(edge, uint32_t(vertexes.size() + edges.size()));
+            edges.push_back(edge);
+        }
+        for (FaceHandle face : source.faces()) {
+            faces.push_back(face);
+        }
+
+        // Where the new faces of each source face starts
+        std::vector<uint32_t> firstFace(faces.size() + 1);
+        pool->parallelFor(faces.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t f=begin; f < end; ++f) {
+                firstFace[f+1] = uint32_t(faceSize(topology, faces[f]));
+            }
+        });
+        for (size_t f=0; f < faces.size(); ++f) {
+            if (!catmullClark && firstFace[f+1] != 3) {
+                LOG_ERROR("Loop subdivision requires a triangle mesh, face %u has %u vertexes", (unsigned)f, firstFace[f+1]);
+                return false;
+            }
+            firstFace[f+1] = firstFace[f] + (catmullClark ? firstFace[f+1] : 4);
+        }
+
+        const size_t faceCount = firstFace.back(),
+                     faceVertexes = catmullClark ? 4 : 3,
+                     facePointsStart = vertexes.size() + edges.size(),
+                     vertexCount = facePointsStart + (catmullClark ? faces.size() : 0);
+
+        std::vector<uint32_t> indices(faceCount * faceVertexes);
+        pool->parallelFor(faces.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            // corners[i] is vertex i of the face, and sides[i] the point on the edge from it to the next vertex
+            std::vector<uint32_t> corners, sides;
+            for (size_t f=begin; f < end; ++f) {
+                corners.clear();
+                sides.clear();
+                HEdgeHandle first = topology.faces.find(faces[f])->hedge,
+                            current = first;
+                do {
+                    const internal::HEdge &h = hedge(topology, current);
+                    const internal::HEdge &next = hedge(topology, h.next);
+                    corners.push_back(*vertexIndex.find(h.vertex));
+                    sides.push_back(*edgeIndex.find(next.edge));
+                    current = h.next;
+                } while (current != first);
+
+                size_t n = corners.size();
+                uint32_t *out = &indices[firstFace[f] * faceVertexes];
+                for (size_t i=0; i < n; ++i) {
+                    uint32_t previous = sides[(i + n - 1) % n];
+                    if (catmullClark) {
+                        *out++ = corners[i];
+                        *out++ = sides[i];
+                        *out++ = uint32_t(facePointsStart + f);
+                        *out++ = previous;
+                    }
+                    else {
+                        *out++ = corners[i];
+                        *out++ = sides[i];
+                        *out++ = previous;
+                    }
+                }
+                if (!catmullClark) {
+                    *out++ = sides[0];
+                    *out++ = sides[1];
+                    *out++ = sides[2];
+                }
+            }
+        });
+
+        // The stencils of the new vertexes, counted first so they can be written in parallel
+        auto stencil = [&]( size_t vertex, auto &emit ) {
+            if (vertex < vertexes.size()) {
+                vertexStencil(topology, scheme, vertexes[vertex], emit);
+            }
+            else if (vertex < facePointsStart) {
+                edgeStencil(topology, scheme, edges[vertex - vertexes.size()], emit);
+            }
+            else {
+                faceStencil(topology, faces[vertex - facePointsStart], emit);
+            }
+        };
+
+        std::vector<size_t> firstEntry(vertexCount + 1, 0);
+        pool->parallelFor(vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t v=begin; v < end; ++v) {
+                size_t count = 0;
+                auto emit = [&]( VertexHandle, float ) {
+                    count++;
+                };
+                stencil(v, emit);
+                firstEntry[v+1] = count;
+            }
+        });
+        for (size_t v=0; v < vertexCount; ++v) {
+            firstEntry[v+1] += firstEntry[v];
+        }
+
+        std::vector<VertexHandle> sources(firstEntry.back());
+        std::vector<float> weights(firstEntry.back());
+        pool->parallelFor(vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t v=begin; v < end; ++v) {
+                size_t entry = firstEntry[v];
+                auto emit = [&]( VertexHandle vertex, float weight ) {
+                    sources[entry] = vertex;
+                    weights[entry] = weight;
+                    entry++;
+                };
+                stencil(v, emit);
+            }
+        });
+
+        std::vector<uint32_t> faceSizes(catmullClark ? faceCount : 0, 4);
+        std::vector<VertexHandle> newVertexes(vertexCount);
+        if (!target.buildFromIndexed(indices.data(), catmullClark ? faceSizes.data() : nullptr, faceCount, vertexCount, newVertexes.data(), nullptr, pool)) {
+            LOG_ERROR("Failed to build the subdivided mesh");
+            return false;
+        }
+
+        pool->parallelFor(vertexCount, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+            for (size_t v=begin; v < end; ++v) {
+                blend(newVertexes[v], &sources[firstEntry[v]], &weights[firstEntry[v]], firstEntry[v+1] - firstEntry[v]);
+            }
+        });
+        return true;
+    }
+}
@@ -0,0 +1,233 @@
+#include "ThreadPool.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+namespace Common
+{
+    namespace ThreadPoolImpl
+    {
+        // The chunks owned by a thread, other threads steals from it when they run out of their own
+        struct alignas(64) Slice {
+            std::atomic<size_t> next{0};
+            size_t end = 0;
+        };
+
+        struct Job {
+            const ThreadPool::RangeFunc *func = nullptr;
+            size_t count = 0,
+                   grainSize = 1;
+
+            std::unique_ptr<Slice[]> slices;
+            unsigned sliceCount = 0;
+            std::atomic<unsigned> nextSlice{0};
+
+            std::mutex exceptionMutex;
+            std::exception_ptr exception;
+        };
+
+        struct Impl {
+            std::vector<std::thread> workers;
+
+            std::mutex mutex;
+            std::condition_variable wake,
+                                    done;
+            Job *job = nullptr;
+            uint64_t jobId = 0;
+            unsigned active = 0;
+            bool quit = false;
+
+            // Only one loop can run on the pool at the time
+            std::mutex submitMutex;
+        };
+
+        thread_local bool tInsideJob = false;
+
+        bool runChunk( Job *job, Slice &slice )
+        {
+            size_t chunk = slice.next.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= slice.end) return false;
+
+            size_t begin = chunk * job->grainSize;
+            size_t end = std::min(begin + job->grainSize, job->count);
+
+            try {
+                (*job->func)(begin, end);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(job->exceptionMutex);
+                if (!job->exception) {
+                    job->exception = std::current_exception();
+                }
+            }
+            return true;
+        }
+
+        void runJob( Job *job, unsigned slice )
+        {
+            bool wasInside = tInsideJob;
+            tInsideJob = true;
+
+            // Start with our own chunks, then steal from the others
+            for (unsigned i=0; i < job->sliceCount; ++i) {
+                Slice &current = job->slices[(slice + i) % job->sliceCount];
+                while (runChunk(job, current)) {}
+            }
+
+            tInsideJob = wasInside;
+        }
+
+        void workerMain( Impl *impl )
+        {
+            std::unique_lock<std::mutex> lock(impl->mutex);
+            uint64_t seen = 0;
+            while (true) {
+                impl->wake.wait(lock, [&]() {
+                    return impl->quit || impl->jobId != seen;
+                });
+                if (impl->quit) return;
+
+                seen = impl->jobId;
+                Job *job = impl->job;
+                if (!job) continue;
+
+                impl->active++;
+                lock.unlock();
+
+                unsigned slice = job->nextSlice.fetch_add(1, std::memory_order_relaxed) % job->sliceCount;
+                runJob(job, slice);
+
+                lock.lock();
+                impl->active--;
+                if (impl->active == 0) {
+                    impl->done.notify_all();
+                }
+            }
+        }
+
+        void init( Impl *impl, unsigned workerCount )
+        {
+            impl->workers.reserve(workerCount);
+            for (unsigned i=0; i < workerCount; ++i) {
+                impl->workers.emplace_back(workerMain, impl);
+            }
+        }
+
+        void destroy( Impl *impl )
+        {
+            {
+                std::lock_guard<std::mutex> lock(impl->mutex);
+                impl->quit = true;
+            }
+            impl->wake.notify_all();
+
+            for (auto &worker : impl->workers) {
+                worker.join();
+            }
+            impl->workers.clear();
+        }
+
+        void runInline( size_t count, size_t grainSize, const ThreadPool::RangeFunc &func )
+        {
+            for (size_t begin=0; begin < count; begin += grainSize) {
+                func(begin, std::min(begin + grainSize, count));
+            }
+        }
+
+        void parallelFor( Impl *impl, size_t count, size_t grainSize, const ThreadPool::RangeFunc &func )
+        {
+            if (count == 0) return;
+            if (grainSize == 0) grainSize = 1;
+
+            size_t chunkCount = (count + grainSize - 1) / grainSize;
+            if (chunkCount == 1 || impl->workers.empty() || tInsideJob) {
+                runInline(count, grainSize, func);
+                return;
+            }
+
+            std::unique_lock<std::mutex> submitLock(impl->submitMutex, std::try_to_lock);
+            if (!submitLock.owns_lock()) {
+                // The pool is busy with another loop
+                runInline(count, grainSize, func);
+                return;
+            }
+
+            Job job;
+            job.func = &func;
+            job.count = count;
+            job.grainSize = grainSize;
+            job.sliceCount = (unsigned)std::min<size_t>(impl->workers.size() + 1, chunkCount);
+            job.slices.reset(new Slice[job.sliceCount]);
+            // slice 0 is reserved for the calling thread
+            job.nextSlice.store(1, std::memory_order_relaxed);
+
+            size_t perSlice = chunkCount / job.sliceCount,
+                   extra = chunkCount % job.sliceCount,
+                   first = 0;
+            for (unsigned i=0; i < job.sliceCount; ++i) {
+                size_t chunks = perSlice + (i < extra ? 1 : 0);
+                job.slices[i].next.store(first, std::memory_order_relaxed);
+                job.slices[i].end = first + chunks;
+                first += chunks;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(impl->mutex);
+                impl->job = &job;
+                impl->jobId++;
+            }
+            impl->wake.notify_all();
+
+            runJob(&job, 0);
+
+            // All chunks are taken, wait for the workers to finish theirs
+            {
+                std::unique_lock<std::mutex> lock(impl->mutex);
+                impl->job = nullptr;
+                impl->done.wait(lock, [&]() {
+                    return impl->active == 0;
+                });
+            }
+
+            if (job.exception) {
+                std::rethrow_exception(job.exception);
+            }
+        }
+    }
+
+    namespace impl = ThreadPoolImpl;
+
+    struct ThreadPool::Impl : public impl::Impl {};
+
+    COMMON_API ThreadPool& ThreadPool::Global()
+    {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    COMMON_API ThreadPool::ThreadPool( unsigned workerCount )
+    {
+        impl::init(mImpl, workerCount);
+    }
+
+    COMMON_API ThreadPool::~ThreadPool()
+    {
+        impl::destroy(mImpl);
+    }
+
+    COMMON_API unsigned ThreadPool::threadCount() const
+    {
+        return (unsigned)mImpl->workers.size() + 1;
+    }
+
+    COMMON_API void ThreadPool::parallelFor( size_t count, size_t grainSize, const RangeFunc &func )
+    {
+        impl::parallelFor(mImpl, count, grainSize, func);
+    }
+}
@@ -2,6 +2,114 @@
 #include "catch.hpp"
 
 #include "Common/Archive.h"
+#include "Common/ArchiveWriter.h"
+#include "Common/FileUtils.h"
+#include "Common/Murmur3_32.h"
+#include "Common/Clock.h"
+#include "Common/ThreadPool.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    struct ArchiveTestFile {
+        std::string name,
+                    content;
+        bool compressed;
+    };
+
+    uint32_t archiveChecksum( const void *data, size_t size, uint32_t hash=0 )
+    {
+        const size_t BlockSize = 1024 * 1024;
+        const char *bytes = static_cast<const char*>(data);
+        for (size_t offset=0; offset < size; offset += BlockSize) {
+            hash = Common::murmur3_32(bytes + offset, (uint32_t)std::min(BlockSize, size - offset), hash);
+        }
+        return hash;
+    }
+
+    // The hand written archives stores the compressed files as a LZ4 block with a single literal run
+    //  (valid, but not any smaller), so the reader is tested without the writer.
+    //  Files that are really compressed are written with ArchiveWriter, in the "Archive writer" tests.
+    std::string lz4Literals( const std::string &content )
+    {
+        std::string block;
+        size_t length = content.size();
+        block.push_back(char(std::min<size_t>(length, 15) << 4));
+        if (length >= 15) {
+            size_t rest = length - 15;
+            for (; rest >= 255; rest -= 255) block.push_back(char(255));
+            block.push_back(char(rest));
+        }
+        return block + content;
+    }
+
+    // Writes a version 2 archive, the layout is described in src/Archive.impl.h
+    std::string writeArchive( const std::vector<ArchiveTestFile> &files )
+    {
+        struct TableHeader {
+            uint64_t namesSize = 0,
+                     dataOffset = 0;
+            uint32_t checksum = 0,
+                     padding = 0;
+        };
+        struct FileTableEntry {
+            uint64_t offset = 0,
+                     compressedSize = 0,
+                     size = 0;
+            uint32_t nameOffset = 0,
+                     nameLength = 0,
+                     checksum = 0,
+                     flags = 0;
+        };
+
+        std::vector<FileTableEntry> table;
+        std::string names, data;
+        for (const ArchiveTestFile &file : files) {
+            std::string stored = file.compressed ? lz4Literals(file.content) : file.content;
+
+            FileTableEntry entry;
+            entry.offset = data.size();
+            entry.compressedSize = stored.size();
+            entry.size = file.content.size();
+            entry.nameOffset = (uint32_t)names.size();
+            entry.nameLength = (uint32_t)file.name.size();
+            entry.checksum = archiveChecksum(file.content.data(), file.content.size());
+            entry.flags = file.compressed ? 1 : 0;
+            table.push_back(entry);
+
+            names += file.name;
+            data += stored;
+        }
+
+        char header[24] = "Zodiac Archive";
+        uint32_t version = 2, fileCount = (uint32_t)files.size();
+        memcpy(header + 16, &version, 4);
+        memcpy(header + 20, &fileCount, 4);
+
+        TableHeader tableHeader;
+        tableHeader.namesSize = names.size();
+        tableHeader.dataOffset = sizeof(header) + sizeof(TableHeader) + table.size()*sizeof(FileTableEntry) + names.size();
+        tableHeader.checksum = archiveChecksum(names.data(), names.size(), archiveChecksum(table.data(), table.size()*sizeof(FileTableEntry)));
+
+        std::string archive(header, sizeof(header));
+        archive.append((const char*)&tableHeader, sizeof(tableHeader));
+        archive.append((const char*)table.data(), table.size()*sizeof(FileTableEntry));
+        return archive + names + data;
+    }
+
+    void writeFile( const std::string &path, const std::string &content )
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(content.data(), content.size());
+    }
+}
 
 
 TEST_CASE( "Archive Directory", "[Common][Archive]" )
@@ -43,3 +151,621 @@ TEST_CASE( "Archive Directory", "[Common][Archive]" )
     }
 
 }
+
+TEST_CASE( "Archive version 2", "[Common][Archive]" )
+{
+    using namespace Common;
+
+    std::string big;
+    for (int i=0; big.size() < 100000; ++i) {
+        big += "line " + std::to_string(i) + "\n";
+    }
+    const std::vector<ArchiveTestFile> files = {
+        {"hello world.txt", "Hello World", true},
+        {"stored.txt", "Stored as is", false},
+        {"empty.txt", "", false},
+        {"big file.txt", big, true},
+        {"dir/nested.txt", "Nested", true},
+    };
+    const std::string path = "version 2 test.archive";
+    const std::string data = writeArchive(files);
+    writeFile(path, data);
+
+    SECTION("Files")
+    {
+        Archive archive = Archive::OpenArchive(path);
+        REQUIRE(archive.name() == path);
+
+        for (const ArchiveTestFile &file : files) {
+            auto handle = archive.openFile(file.name);
+            REQUIRE((bool)handle);
+            REQUIRE(archive.fileSize(handle) == file.content.size());
+
+            const void *ptr = archive.mapFile(handle);
+            REQUIRE(ptr);
+            REQUIRE(memcmp(ptr, file.content.data(), file.content.size()) == 0);
+            // The file stays loaded while it is open
+            REQUIRE(archive.mapFile(handle) == ptr);
+        }
+
+        REQUIRE(!archive.openFile("missing.txt"));
+        REQUIRE(!archive.openFile("hello world"));
+        REQUIRE(!archive.openFile("nested.txt"));
+    }
+
+    SECTION("Several handles to a file")
+    {
+        Archive archive = Archive::OpenArchive(path);
+        ArchiveFileHandle first = archive.openFile("big file.txt"),
+                          second = archive.openFile("big file.txt");
+        REQUIRE(first != second);
+
+        const void *ptr = archive.mapFile(first);
+        REQUIRE(archive.mapFile(second) == ptr);
+
+        archive.closeFile(first);
+        REQUIRE(!archive.mapFile(first));
+        REQUIRE(archive.mapFile(second) == ptr);
+        archive.closeFile(second);
+
+        // Loaded again once it is opened again
+        auto handle = archive.openFile("big file.txt");
+        const void *reloaded = archive.mapFile(handle);
+        REQUIRE(reloaded);
+        REQUIRE(memcmp(reloaded, big.data(), big.size()) == 0);
+    }
+
+    SECTION("Corrupt files are found when they are mapped")
+    {
+        // Flip a byte in the last file, the archive still opens as the file table is intact
+        std::string corrupt = data;
+        corrupt[corrupt.size() - 2] ^= 1;
+        writeFile(path, corrupt);
+
+        Archive archive = Archive::OpenArchive(path);
+        auto good = archive.openFile("hello world.txt");
+        REQUIRE(archive.mapFile(good));
+
+        auto bad = archive.openFile("dir/nested.txt");
+        REQUIRE((bool)bad);
+        REQUIRE(archive.fileSize(bad) == 6);
+        REQUIRE(!archive.mapFile(bad));
+    }
+
+    SECTION("Invalid file table")
+    {
+        // A byte in the table, a truncated table and a unknown version
+        std::string corrupt = data;
+        corrupt[24 + 24 + 3] ^= 1;
+        writeFile(path, corrupt);
+        REQUIRE(!Archive::OpenArchive(path).openFile("hello world.txt"));
+
+        writeFile(path, data.substr(0, 24 + 24 + 20));
+        REQUIRE(!Archive::OpenArchive(path).openFile("hello world.txt"));
+
+        corrupt = data;
+        corrupt[16] = 9;
+        writeFile(path, corrupt);
+        REQUIRE(!Archive::OpenArchive(path).openFile("hello world.txt"));
+    }
+
+    SECTION("Prefetch")
+    {
+        Archive archive = Archive::OpenArchive(path);
+        auto open = archive.openFile("hello world.txt");
+        const void *loaded = archive.mapFile(open);
+
+        const std::string names[] = {"big file.txt", "missing.txt", "stored.txt", "hello world.txt", "empty.txt", "dir/nested.txt", "big file.txt"};
+        const size_t count = sizeof(names) / sizeof(names[0]);
+        ArchiveFileHandle handles[count];
+
+        Common::ThreadPool pool(3);
+        REQUIRE(archive.prefetch(names, count, handles, &pool) == count-1);
+        REQUIRE(!handles[1]);
+        // Already loaded files are kept
+        REQUIRE(archive.mapFile(handles[3]) == loaded);
+        REQUIRE(archive.mapFile(handles[0]) == archive.mapFile(handles[6]));
+
+        for (size_t i=0; i < count; ++i) {
+            if (!handles[i]) continue;
+
+            const ArchiveTestFile &file = *std::find_if(files.begin(), files.end(), [&]( const ArchiveTestFile &file ) {
+                return file.name == names[i];
+            });
+            REQUIRE(archive.fileSize(handles[i]) == file.content.size());
+            REQUIRE(memcmp(archive.mapFile(handles[i]), file.content.data(), file.content.size()) == 0);
+        }
+
+        // The buffer is shared, closing some of the files keeps the others
+        archive.closeFile(handles[0]);
+        REQUIRE(memcmp(archive.mapFile(handles[5]), "Nested", 6) == 0);
+        for (size_t i=1; i < count; ++i) {
+            archive.closeFile(handles[i]);
+        }
+        archive.closeFile(open);
+
+        // A corrupt file isn't loaded, but the others are
+        std::string corrupt = data;
+        corrupt[corrupt.size() - 2] ^= 1;
+        writeFile(path, corrupt);
+        Archive corruptArchive = Archive::OpenArchive(path);
+        REQUIRE(corruptArchive.prefetch(names, count, handles, &pool) == count-2);
+        REQUIRE(!corruptArchive.mapFile(handles[5]));
+        REQUIRE(corruptArchive.mapFile(handles[0]));
+        for (size_t i=0; i < count; ++i) {
+            corruptArchive.closeFile(handles[i]);
+        }
+
+        // A corrupt file that is listed twice isn't counted for either name
+        const std::string twice[] = {"dir/nested.txt", "hello world.txt", "dir/nested.txt"};
+        REQUIRE(corruptArchive.prefetch(twice, 3, handles, &pool) == 1);
+        REQUIRE(!corruptArchive.mapFile(handles[2]));
+        for (size_t i=0; i < 3; ++i) {
+            corruptArchive.closeFile(handles[i]);
+        }
+
+        // Directories opens the files one by one
+        Archive directory = Archive::OpenArchive("dir");
+        const std::string directoryNames[] = {"hello world.txt", "missing.txt"};
+        REQUIRE(directory.prefetch(directoryNames, 2, handles) == 1);
+        REQUIRE(memcmp(directory.mapFile(handles[0]), "Hello World", 11) == 0);
+        directory.closeFile(handles[0]);
+    }
+
+    SECTION("More files than version 1 allows")
+    {
+        std::vector<ArchiveTestFile> many;
+        for (int i=0; i < 10000; ++i) {
+            many.push_back({"file " + std::to_string(i), std::to_string(i), i % 2 == 0});
+        }
+        // The first file with a name is used
+        many.push_back({"file 10", "duplicate", false});
+        writeFile(path, writeArchive(many));
+
+        Archive archive = Archive::OpenArchive(path);
+        for (int i=0; i < 10000; ++i) {
+            auto handle = archive.openFile("file " + std::to_string(i));
+            REQUIRE((bool)handle);
+            REQUIRE(std::string((const char*)archive.mapFile(handle), archive.fileSize(handle)) == std::to_string(i));
+        }
+        REQUIRE(!archive.openFile("file 10000"));
+        REQUIRE(!archive.openFile(""));
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Archive writer", "[Common][Archive]" )
+{
+    using namespace Common;
+
+    std::string text, noise;
+    for (int i=0; text.size() < 200000; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+    }
+    uint32_t seed = 1;
+    while (noise.size() < 5000) {
+        seed = seed * 1664525u + 1013904223u;
+        noise.push_back(char(seed >> 24));
+    }
+    const std::string path = "writer test.archive",
+                      diskFile = "writer test input.txt";
+    writeFile(diskFile, text);
+
+    auto readFile = []( Archive &archive, const std::string &name ) {
+        auto handle = archive.openFile(name);
+        const void *ptr = handle ? archive.mapFile(handle) : nullptr;
+        return ptr ? std::string((const char*)ptr, archive.fileSize(handle)) : std::string("<missing>");
+    };
+
+    SECTION("Files")
+    {
+        for (int level : {0, 1, 9, 12}) {
+            ArchiveWriter::Settings settings;
+            settings.compressionLevel = level;
+            settings.deduplicate = false;
+
+            ArchiveWriter writer(settings);
+            REQUIRE(writer.addFile("text.txt", text.data(), text.size()));
+            REQUIRE(writer.addFile("noise.bin", noise.data(), noise.size()));
+            REQUIRE(writer.addFile("empty.txt", "", 0));
+            REQUIRE(writer.addFileFromDisk("dir/from disk.txt", diskFile));
+            REQUIRE(writer.fileCount() == 4);
+
+            ArchiveWriter::Stats stats;
+            REQUIRE(writer.write(path, &stats));
+            REQUIRE(stats.files == 4);
+            REQUIRE(stats.duplicates == 0);
+            REQUIRE(stats.size == 2*text.size() + noise.size());
+            // The noise doesn't compress, so it is stored
+            REQUIRE(stats.compressed == (level > 0 ? 2 : 0));
+            if (level > 0) {
+                REQUIRE(stats.storedSize < text.size());
+            }
+
+            Archive archive = Archive::OpenArchive(path);
+            REQUIRE(readFile(archive, "text.txt") == text);
+            REQUIRE(readFile(archive, "noise.bin") == noise);
+            REQUIRE(readFile(archive, "empty.txt") == "");
+            REQUIRE(readFile(archive, "dir/from disk.txt") == text);
+            REQUIRE(!archive.openFile("from disk.txt"));
+
+            // The compressed files are decoded by prefetch and readRange too
+            Archive other = Archive::OpenArchive(path);
+            const std::string prefetched[] = {"text.txt", "dir/from disk.txt"};
+            ArchiveFileHandle handles[2];
+            REQUIRE(other.prefetch(prefetched, 2, handles) == 2);
+            REQUIRE(memcmp(other.mapFile(handles[1]), text.data(), text.size()) == 0);
+            std::string range(100, '\0');
+            REQUIRE(other.readRange(handles[0], 1000, range.size(), &range[0]));
+            REQUIRE(range == text.substr(1000, range.size()));
+            other.closeFile(handles[0]);
+            other.closeFile(handles[1]);
+        }
+    }
+
+    SECTION("Identical files are stored once")
+    {
+        ArchiveWriter writer;
+        REQUIRE(writer.addFile("a.txt", text.data(), text.size()));
+        REQUIRE(writer.addFile("b.txt", noise.data(), noise.size()));
+        REQUIRE(writer.addFileFromDisk("c.txt", diskFile));
+        REQUIRE(writer.addFile("d.txt", noise.data(), noise.size()));
+        REQUIRE(writer.addFile("e.txt", text.data(), text.size()-1));
+
+        ArchiveWriter::Stats stats;
+        REQUIRE(writer.write(path, &stats));
+        REQUIRE(stats.duplicates == 2);
+
+        Archive archive = Archive::OpenArchive(path);
+        REQUIRE(readFile(archive, "a.txt") == text);
+        REQUIRE(readFile(archive, "b.txt") == noise);
+        REQUIRE(readFile(archive, "c.txt") == text);
+        REQUIRE(readFile(archive, "d.txt") == noise);
+        REQUIRE(readFile(archive, "e.txt") == text.substr(0, text.size()-1));
+
+        // Stored duplicates are the same bytes in the archive
+        auto b = archive.openFile("b.txt"), d = archive.openFile("d.txt");
+        REQUIRE(archive.mapFile(b) == archive.mapFile(d));
+    }
+
+    SECTION("Access order")
+    {
+        ArchiveWriter::Settings settings;
+        settings.compressionLevel = 0;
+
+        ArchiveWriter writer(settings);
+        for (const char *name : {"a", "b", "c", "d"}) {
+            REQUIRE(writer.addFile(name, name, 1));
+        }
+        const std::string trace[] = {"c", "missing", "a", "c"};
+        writer.setAccessOrder(trace, 4);
+        REQUIRE(writer.write(path));
+
+        // Stored files are used from the archive, so the pointers follows the order of the data
+        Archive archive = Archive::OpenArchive(path);
+        std::vector<const char*> data;
+        for (const char *name : {"c", "a", "b", "d"}) {
+            auto handle = archive.openFile(name);
+            data.push_back((const char*)archive.mapFile(handle));
+            REQUIRE(*data.back() == *name);
+        }
+        REQUIRE(std::is_sorted(data.begin(), data.end()));
+    }
+
+    SECTION("Invalid files")
+    {
+        ArchiveWriter writer;
+        REQUIRE(writer.addFile("a.txt", "a", 1));
+        REQUIRE(!writer.addFile("a.txt", "b", 1));
+        REQUIRE(!writer.addFileFromDisk("a.txt", diskFile));
+        REQUIRE(!writer.addFile(std::string(256, 'x'), "", 0));
+        REQUIRE(writer.fileCount() == 1);
+        REQUIRE(writer.write(path));
+
+        REQUIRE(writer.addFileFromDisk("missing.txt", "writer test missing file.txt"));
+        REQUIRE(!writer.write(path));
+
+        // A failed write keeps the archive that was there, and doesn't leave the temporary file
+        Archive archive = Archive::OpenArchive(path);
+        REQUIRE(readFile(archive, "a.txt") == "a");
+        REQUIRE(!FileUtils::isFile(path + ".tmp"));
+
+        ArchiveWriter other;
+        REQUIRE(other.addFile("a.txt", "a", 1));
+        REQUIRE(!other.write("writer test missing dir/test.archive"));
+    }
+
+    SECTION("Chunked files")
+    {
+        const size_t ChunkSize = 128 * 1024;
+        std::string large;
+        for (int i=0; large.size() < 24*ChunkSize + 1234; ++i) {
+            large += std::to_string(i * 7) + ",";
+        }
+
+        ArchiveWriter::Settings settings;
+        settings.compressionLevel = 1;
+
+        ArchiveWriter writer(settings);
+        REQUIRE(writer.addFile("noise.bin", noise.data(), noise.size()));
+        REQUIRE(writer.addFile("text.txt", text.data(), text.size()));
+        REQUIRE(writer.addFile("large.txt", large.data(), large.size()));
+
+        ArchiveWriter::Stats stats;
+        REQUIRE(writer.write(path, &stats));
+        REQUIRE(stats.chunked == 1);
+        REQUIRE(stats.compressed == 1);
+
+        Archive archive = Archive::OpenArchive(path);
+        auto handle = archive.openFile("large.txt");
+        REQUIRE(archive.fileSize(handle) == large.size());
+
+        struct Range {
+            uint64_t offset;
+            size_t size;
+        };
+        const Range ranges[] = {
+            {0, 1}, {0, ChunkSize}, {ChunkSize-1, 2}, {5*ChunkSize + 17, 4096}, {ChunkSize, 3*ChunkSize},
+            {large.size()-10, 10}, {0, large.size()}, {large.size(), 0}
+        };
+        for (int loaded=0; loaded < 2; ++loaded) {
+            // The second time the file is loaded, and the ranges are copied from it
+            if (loaded) {
+                REQUIRE(std::string((const char*)archive.mapFile(handle), large.size()) == large);
+            }
+            for (const Range &range : ranges) {
+                std::string buffer(range.size, '\0');
+                REQUIRE(archive.readRange(handle, range.offset, range.size, &buffer[0]));
+                REQUIRE(buffer == large.substr(range.offset, range.size));
+            }
+        }
+
+        std::string buffer(100, '\0');
+        REQUIRE(!archive.readRange(handle, large.size()-5, 10, &buffer[0]));
+        REQUIRE(!archive.readRange(handle, large.size()+1, 0, &buffer[0]));
+
+        // Stored and compressed files can be read in ranges too
+        auto noiseHandle = archive.openFile("noise.bin"),
+             textHandle = archive.openFile("text.txt");
+        REQUIRE(archive.readRange(noiseHandle, 100, 50, &buffer[0]));
+        REQUIRE(buffer.substr(0, 50) == noise.substr(100, 50));
+        REQUIRE(archive.readRange(textHandle, 1000, 100, &buffer[0]));
+        REQUIRE(buffer == text.substr(1000, 100));
+    }
+
+    SECTION("Corrupt chunks only fails the ranges that reads them")
+    {
+        std::string large;
+        for (int i=0; large.size() < 1024*1024 + 100; ++i) {
+            large += std::to_string(i) + " ";
+        }
+
+        ArchiveWriter writer;
+        REQUIRE(writer.addFile("large.txt", large.data(), large.size()));
+        REQUIRE(writer.write(path));
+
+        // The last byte of the archive is in the last chunk
+        std::ifstream in(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        data.back() ^= 1;
+        writeFile(path, data);
+
+        Archive archive = Archive::OpenArchive(path);
+        auto handle = archive.openFile("large.txt");
+        std::string buffer(100, '\0');
+        REQUIRE(archive.readRange(handle, 0, 100, &buffer[0]));
+        REQUIRE(buffer == large.substr(0, 100));
+        REQUIRE(!archive.readRange(handle, large.size()-100, 100, &buffer[0]));
+        REQUIRE(!archive.mapFile(handle));
+    }
+
+    SECTION("Files larger than 32 MiB")
+    {
+        std::string huge;
+        for (int i=0; huge.size() < 33*1024*1024; ++i) {
+            huge += std::to_string(i) + "\n";
+        }
+
+        for (int level : {0, 1}) {
+            ArchiveWriter::Settings settings;
+            settings.compressionLevel = level;
+            settings.chunkedFileSize = ~0ull;
+
+            ArchiveWriter writer(settings);
+            REQUIRE(writer.addFile("huge.txt", huge.data(), huge.size()));
+            ArchiveWriter::Stats stats;
+            REQUIRE(writer.write(path, &stats));
+            // Files that are too large to compress as a whole are always chunked
+            REQUIRE(stats.chunked == (level > 0 ? 1 : 0));
+
+            Archive archive = Archive::OpenArchive(path);
+            auto handle = archive.openFile("huge.txt");
+            std::string buffer(1000, '\0');
+            REQUIRE(archive.readRange(handle, huge.size()-1000, 1000, &buffer[0]));
+            REQUIRE(buffer == huge.substr(huge.size()-1000));
+            REQUIRE(readFile(archive, "huge.txt") == huge);
+        }
+    }
+
+    SECTION("Own thread pool")
+    {
+        ThreadPool pool(3);
+        ArchiveWriter::Settings settings;
+        settings.pool = &pool;
+
+        ArchiveWriter writer(settings);
+        for (int i=0; i < 100; ++i) {
+            std::string content = text.substr(i * 100, 10000);
+            REQUIRE(writer.addFile("file " + std::to_string(i), content.data(), content.size()));
+        }
+        REQUIRE(writer.write(path));
+
+        Archive archive = Archive::OpenArchive(path);
+        for (int i=0; i < 100; ++i) {
+            REQUIRE(readFile(archive, "file " + std::to_string(i)) == text.substr(i * 100, 10000));
+        }
+    }
+
+    std::remove(path.c_str());
+    std::remove(diskFile.c_str());
+}
+
+TEST_CASE( "Archive open benchmark", "[.][benchmark]" )
+{
+    using namespace Common;
+
+    const size_t FileCount = 4000,
+                 Opens = 200000;
+    std::vector<ArchiveTestFile> files;
+    for (size_t i=0; i < FileCount; ++i) {
+        files.push_back({"assets/textures/level " + std::to_string(i % 50) + "/texture " + std::to_string(i) + ".dds", std::to_string(i), false});
+    }
+    const std::string path = "open benchmark.archive";
+    writeFile(path, writeArchive(files));
+
+    Archive archive = Archive::OpenArchive(path);
+    std::vector<std::string> names;
+    for (size_t i=0; i < Opens; ++i) {
+        names.push_back(files[(i * 7919) % FileCount].name);
+    }
+
+    Clock clock;
+    clock.start();
+    size_t opened = 0;
+    for (const std::string &name : names) {
+        auto handle = archive.openFile(name);
+        if (handle) opened++;
+    }
+    double time = clock.seconds();
+
+    REQUIRE(opened == Opens);
+    WARN(Opens << " opens in a archive with " << FileCount << " files: " << time << "s");
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Archive prefetch benchmark", "[.][benchmark]" )
+{
+    using namespace Common;
+
+    const size_t FileCount = 400;
+    std::vector<ArchiveTestFile> files;
+    std::vector<std::string> names;
+    for (size_t i=0; i < FileCount; ++i) {
+        std::string content;
+        for (int j=0; content.size() < 256*1024; ++j) {
+            content += std::to_string(i * j);
+        }
+        files.push_back({"file " + std::to_string(i), content, true});
+        names.push_back(files.back().name);
+    }
+    const std::string path = "prefetch benchmark.archive";
+    writeFile(path, writeArchive(files));
+
+    Archive archive = Archive::OpenArchive(path);
+    std::vector<ArchiveFileHandle> handles(FileCount);
+
+    Clock clock;
+    clock.start();
+    for (size_t i=0; i < FileCount; ++i) {
+        handles[i] = archive.openFile(names[i]);
+        REQUIRE(archive.mapFile(handles[i]));
+    }
+    double sequentialTime = clock.seconds();
+    for (ArchiveFileHandle handle : handles) {
+        archive.closeFile(handle);
+    }
+
+    clock.restart();
+    size_t loaded = archive.prefetch(names.data(), FileCount, handles.data());
+    double prefetchTime = clock.seconds();
+    for (ArchiveFileHandle handle : handles) {
+        archive.closeFile(handle);
+    }
+
+    REQUIRE(loaded == FileCount);
+    WARN(FileCount << " files of 256 KiB: opening and mapping them one by one " << sequentialTime << "s, prefetch " << prefetchTime << "s "
+         << "(" << ThreadPool::Global().threadCount() << " threads)");
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Archive writer benchmark", "[.][benchmark]" )
+{
+    using namespace Common;
+
+    const size_t FileCount = 200;
+    std::vector<std::string> contents;
+    for (size_t i=0; i < FileCount; ++i) {
+        std::string content;
+        for (int j=0; content.size() < 256*1024; ++j) {
+            content += std::to_string(i * j) + " ";
+        }
+        contents.push_back(content);
+    }
+    const std::string path = "writer benchmark.archive";
+
+    double times[2] = {};
+    ThreadPool single(0);
+    ThreadPool *pools[2] = {&single, &ThreadPool::Global()};
+    for (int i=0; i < 2; ++i) {
+        ArchiveWriter::Settings settings;
+        settings.pool = pools[i];
+
+        ArchiveWriter writer(settings);
+        for (size_t j=0; j < FileCount; ++j) {
+            writer.addFile("file " + std::to_string(j), contents[j].data(), contents[j].size());
+        }
+
+        Clock clock;
+        clock.start();
+        REQUIRE(writer.write(path));
+        times[i] = clock.seconds();
+    }
+
+    WARN(FileCount << " files of 256 KiB at LZ4 HC level 9: one thread " << times[0] << "s, "
+         << ThreadPool::Global().threadCount() << " threads " << times[1] << "s");
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Archive range read benchmark", "[.][benchmark]" )
+{
+    using namespace Common;
+
+    std::string content;
+    for (int i=0; content.size() < 32*1024*1024; ++i) {
+        content += std::to_string(i) + "\n";
+    }
+    // The largest file that can be compressed as a whole
+    content.resize(32*1024*1024);
+    const std::string path = "range benchmark.archive";
+    const size_t Reads = 100,
+                 ReadSize = 4096;
+
+    // Compressed as a single block, and chunked
+    double times[2] = {};
+    for (int chunked=0; chunked < 2; ++chunked) {
+        ArchiveWriter::Settings settings;
+        settings.compressionLevel = 1;
+        settings.chunkedFileSize = chunked ? 0 : content.size();
+
+        ArchiveWriter writer(settings);
+        writer.addFile("file", content.data(), content.size());
+        REQUIRE(writer.write(path));
+
+        Archive archive = Archive::OpenArchive(path);
+        std::vector<char> buffer(ReadSize);
+
+        Clock clock;
+        clock.start();
+        for (size_t i=0; i < Reads; ++i) {
+            uint64_t offset = (i * 7919 * ReadSize) % (content.size() - ReadSize);
+            auto handle = archive.openFile("file");
+            REQUIRE(archive.readRange(handle, offset, ReadSize, buffer.data()));
+        }
+        times[chunked] = clock.seconds();
+    }
+
+    WARN(Reads << " reads of 4 KiB from a 32 MiB file: compressed as a whole " << times[0] << "s, chunked " << times[1] << "s");
+    std::remove(path.c_str());
+}
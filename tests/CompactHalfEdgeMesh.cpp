@@ -0,0 +1,232 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/CompactHalfEdgeMesh.h"
+#include "Common/HalfEdgeMesh.h"
+#include "Common/HalfEdgeMeshIterator.h"
+#include "Common/Clock.h"
+
+#include <vector>
+
+using Common::CompactHalfEdgeMesh;
+using Index = CompactHalfEdgeMesh::Index;
+
+namespace
+{
+    // A grid of Size*Size quads, or triangles if 'triangles' is true
+    std::vector<uint32_t> gridIndices( uint32_t size, bool triangles )
+    {
+        std::vector<uint32_t> indices;
+        for (uint32_t y=0; y < size; ++y) {
+            for (uint32_t x=0; x < size; ++x) {
+                uint32_t v0 = y*(size+1) + x, v1 = v0 + 1,
+                         v2 = v1 + size+1,    v3 = v0 + size+1;
+                if (triangles) {
+                    indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+                }
+                else {
+                    indices.insert(indices.end(), {v0, v1, v2, v3});
+                }
+            }
+        }
+        return indices;
+    }
+
+    size_t valence( const CompactHalfEdgeMesh &mesh, Index vertex )
+    {
+        Index first = mesh.getVertexHEdge(vertex),
+              hedge = first;
+        size_t count = 0;
+        do {
+            count++;
+            hedge = mesh.getHEdgeNext(mesh.getHEdgePair(hedge));
+        } while (hedge != first);
+        return count;
+    }
+}
+
+TEST_CASE( "CompactHalfEdgeMesh", "[Common][HalfEdgeMesh]" )
+{
+    CompactHalfEdgeMesh mesh;
+
+    SECTION("Quad grid")
+    {
+        const uint32_t Size = 8;
+        std::vector<uint32_t> indices = gridIndices(Size, false);
+        std::vector<uint32_t> faceSizes(Size*Size, 4);
+
+        REQUIRE(mesh.buildFromIndexed(indices.data(), faceSizes.data(), faceSizes.size(), (Size+1)*(Size+1)));
+#if COMMON_DEBUG_LEVEL > 0
+        mesh.verifyInvariants();
+#endif
+
+        REQUIRE(mesh.vertexCount() == (Size+1)*(Size+1));
+        REQUIRE(mesh.faceCount() == Size*Size);
+        REQUIRE(mesh.edgeCount() == 2*Size*(Size+1));
+        REQUIRE(mesh.hedgeCount() == 2*mesh.edgeCount());
+
+        for (Index hedge=0; hedge < mesh.hedgeCount(); ++hedge) {
+            Index pair = mesh.getHEdgePair(hedge);
+            REQUIRE(mesh.getHEdgePair(pair) == hedge);
+            REQUIRE(mesh.getHEdgeEdge(pair) == mesh.getHEdgeEdge(hedge));
+            REQUIRE(mesh.getHEdgeOrigin(pair) == mesh.getHEdgeVertex(hedge));
+            REQUIRE(mesh.getHEdgePrev(mesh.getHEdgeNext(hedge)) == hedge);
+            REQUIRE(mesh.getHEdgeNext(mesh.getHEdgePrev(hedge)) == hedge);
+            // Every edge has atleast one face
+            REQUIRE(!(mesh.isBorderHEdge(hedge) && mesh.isBorderHEdge(pair)));
+        }
+
+        for (Index edge=0; edge < mesh.edgeCount(); ++edge) {
+            Index hedge = mesh.getEdgeHEdge(edge);
+            REQUIRE(mesh.getHEdgeEdge(hedge) == edge);
+
+            auto vertexes = mesh.getEdgeVertexes(edge);
+            REQUIRE(vertexes.first == mesh.getHEdgeOrigin(hedge));
+            REQUIRE(vertexes.second == mesh.getHEdgeVertex(hedge));
+        }
+
+        // The faces keeps the vertex order of the input
+        for (Index face=0; face < mesh.faceCount(); ++face) {
+            Index hedge = mesh.getFaceHEdge(face);
+            for (uint32_t i=0; i < 4; ++i) {
+                REQUIRE(mesh.getHEdgeFace(hedge) == face);
+                REQUIRE(mesh.getHEdgeOrigin(hedge) == indices[face*4 + i]);
+                hedge = mesh.getHEdgeNext(hedge);
+            }
+            REQUIRE(hedge == mesh.getFaceHEdge(face));
+        }
+
+        for (uint32_t y=0; y <= Size; ++y) {
+            for (uint32_t x=0; x <= Size; ++x) {
+                Index vertex = y*(Size+1) + x;
+                bool border = x == 0 || y == 0 || x == Size || y == Size;
+                bool corner = (x == 0 || x == Size) && (y == 0 || y == Size);
+
+                REQUIRE(mesh.isBorderVertex(vertex) == border);
+                REQUIRE(valence(mesh, vertex) == (corner ? 2 : border ? 3 : 4));
+            }
+        }
+
+        REQUIRE(mesh.memoryUsage() >= (3*mesh.hedgeCount() + mesh.vertexCount() + mesh.faceCount()) * sizeof(Index));
+
+        mesh.clear();
+        REQUIRE(mesh.vertexCount() == 0);
+        REQUIRE(mesh.hedgeCount() == 0);
+        REQUIRE(mesh.faceCount() == 0);
+    }
+
+    SECTION("Closed mesh")
+    {
+        // Tetrahedron
+        uint32_t indices[] = {
+            0, 2, 1,
+            0, 1, 3,
+            1, 2, 3,
+            2, 0, 3
+        };
+        REQUIRE(mesh.buildFromIndexed(indices, nullptr, 4, 4));
+#if COMMON_DEBUG_LEVEL > 0
+        mesh.verifyInvariants();
+#endif
+        REQUIRE(mesh.edgeCount() == 6);
+        for (Index edge=0; edge < mesh.edgeCount(); ++edge) {
+            REQUIRE(!mesh.isBorderEdge(edge));
+        }
+        for (Index vertex=0; vertex < mesh.vertexCount(); ++vertex) {
+            REQUIRE(!mesh.isBorderVertex(vertex));
+            REQUIRE(valence(mesh, vertex) == 3);
+        }
+    }
+
+    SECTION("Isolated vertexes")
+    {
+        uint32_t indices[] = {0, 1, 2};
+        REQUIRE(mesh.buildFromIndexed(indices, nullptr, 1, 4));
+        REQUIRE(mesh.getVertexHEdge(3) == CompactHalfEdgeMesh::INVALID);
+        REQUIRE(!mesh.isBorderVertex(3));
+        REQUIRE(mesh.isBorderVertex(0));
+    }
+
+    SECTION("Invalid input keeps the mesh")
+    {
+        uint32_t indices[] = {0, 1, 2};
+        REQUIRE(mesh.buildFromIndexed(indices, nullptr, 1, 3));
+
+        uint32_t invalid[] = {0, 1, 3};
+        REQUIRE(!mesh.buildFromIndexed(invalid, nullptr, 1, 3));
+        REQUIRE(mesh.vertexCount() == 3);
+        REQUIRE(mesh.faceCount() == 1);
+        REQUIRE(mesh.edgeCount() == 3);
+    }
+
+    SECTION("Same topology as HalfEdgeMesh")
+    {
+        const uint32_t Size = 32;
+        std::vector<uint32_t> indices = gridIndices(Size, true);
+        const size_t vertexCount = (Size+1)*(Size+1),
+                     faceCount = indices.size() / 3;
+
+        Common::ThreadPool pool(3);
+        REQUIRE(mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, &pool));
+
+        Common::HalfEdgeMeshBase reference;
+        std::vector<Common::HalfEdgeMeshBase::VertexHandle> vertexes(vertexCount);
+        REQUIRE(reference.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, vertexes.data(), nullptr, &pool));
+
+        size_t referenceEdges = 0;
+        for (auto edge : reference.edges()) {
+            (void)edge;
+            referenceEdges++;
+        }
+        REQUIRE(mesh.edgeCount() == referenceEdges);
+
+        for (Index vertex=0; vertex < vertexCount; ++vertex) {
+            size_t referenceValence = 0;
+            for (auto hedge : reference.vertexOHEdges(vertexes[vertex])) {
+                (void)hedge;
+                referenceValence++;
+            }
+            REQUIRE(valence(mesh, vertex) == referenceValence);
+            REQUIRE(mesh.isBorderVertex(vertex) == !reference.getHEdgeFace(reference.getVertexHEdge(vertexes[vertex])));
+        }
+    }
+}
+
+// Hidden by default, run with: CompactHalfEdgeMesh [benchmark]
+TEST_CASE( "CompactHalfEdgeMesh benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 512;
+    std::vector<uint32_t> indices = gridIndices(Size, true);
+    const size_t vertexCount = (Size+1)*(Size+1),
+                 faceCount = indices.size() / 3;
+
+    Common::HalfEdgeMeshBase reference;
+    std::vector<Common::HalfEdgeMeshBase::VertexHandle> vertexes(vertexCount);
+    reference.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, vertexes.data());
+
+    CompactHalfEdgeMesh mesh;
+    mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount);
+
+    // Sum the valence of every vertex
+    Clock clock;
+    clock.start();
+    size_t referenceTotal = 0;
+    for (auto vertex : vertexes) {
+        for (auto hedge : reference.vertexOHEdges(vertex)) {
+            (void)hedge;
+            referenceTotal++;
+        }
+    }
+    double referenceTime = clock.seconds();
+
+    clock.restart();
+    size_t total = 0;
+    for (Index vertex=0; vertex < vertexCount; ++vertex) {
+        total += valence(mesh, vertex);
+    }
+    double compactTime = clock.seconds();
+
+    REQUIRE(total == referenceTotal);
+    WARN(faceCount << " triangles, walking around every vertex: HalfEdgeMesh " << referenceTime << "s, CompactHalfEdgeMesh " << compactTime << "s, "
+         << "topology " << mesh.memoryUsage() / (1024*1024) << "MB");
+}
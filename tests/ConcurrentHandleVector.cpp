@@ -0,0 +1,241 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/ConcurrentHandleVector.h"
+#include "Common/HandleVector.h"
+#include "Common/HandleType.h"
+#include "Common/Clock.h"
+
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+MAKE_HANDLE( ConcurrentTestHandle, uint32_t );
+
+TEST_CASE( "ConcurrentHandleVector", "[Common][HandleVector]" )
+{
+    SECTION("Single threaded")
+    {
+        ConcurrentHandleVector<ConcurrentTestHandle, uint32_t, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, 16> vector;
+
+        std::set<ConcurrentTestHandle> oldHandles;
+        std::vector<ConcurrentTestHandle> handles;
+        size_t size = 0;
+        for (int a=0; a < 20; ++a) {
+            for (uint32_t i=0; i < 100; ++i) {
+                ConcurrentTestHandle handle = vector.create(i);
+                REQUIRE((bool)handle);
+                REQUIRE(oldHandles.count(handle) == 0);
+                handles.push_back(handle);
+            }
+
+            for (uint32_t i=0; i < handles.size(); ++i) {
+                uint32_t *value = vector.find(handles[i]);
+                REQUIRE(value);
+                REQUIRE(*value == i);
+
+                uint32_t copy = 0;
+                REQUIRE(vector.get(handles[i], copy) == true);
+                REQUIRE(copy == i);
+            }
+
+            for (auto handle : handles) {
+                REQUIRE(vector.free(handle) == true);
+                REQUIRE(vector.free(handle) == false);
+                REQUIRE(vector.valid(handle) == false);
+                REQUIRE(vector.find(handle) == nullptr);
+                oldHandles.insert(handle);
+            }
+            handles.clear();
+
+            if (size == 0) size = vector.underlying_size();
+            // require that the slots are reused
+            REQUIRE(size == vector.underlying_size());
+        }
+
+        REQUIRE(vector.valid(ConcurrentTestHandle()) == false);
+    }
+
+    SECTION("Clear")
+    {
+        static int ValueInstances = 0;
+        struct Value {
+            Value() { ValueInstances++; }
+            Value( const Value& ) { ValueInstances++; }
+            ~Value() { ValueInstances--; }
+        };
+
+        {
+            ConcurrentHandleVector<ConcurrentTestHandle, Value> vector;
+            std::vector<ConcurrentTestHandle> handles;
+            for (int i=0; i < 100; ++i) {
+                handles.push_back(vector.emplace());
+            }
+            REQUIRE(ValueInstances == 100);
+
+            for (int i=0; i < 100; i += 2) {
+                REQUIRE(vector.free(handles[i]) == true);
+            }
+            REQUIRE(ValueInstances == 50);
+
+            int count = 0;
+            vector.forEach([&](Value&) {count++;});
+            REQUIRE(count == 50);
+
+            vector.clear();
+            REQUIRE(ValueInstances == 0);
+            for (auto handle : handles) {
+                REQUIRE(vector.valid(handle) == false);
+            }
+
+            for (int i=0; i < 10; ++i) {
+                vector.emplace();
+            }
+            REQUIRE(ValueInstances == 10);
+        }
+        REQUIRE(ValueInstances == 0);
+    }
+
+    SECTION("A value that throws")
+    {
+        struct Value {
+            explicit Value( bool fail ) {
+                if (fail) throw std::runtime_error("Value");
+            }
+        };
+
+        ConcurrentHandleVector<ConcurrentTestHandle, Value> vector;
+        ConcurrentTestHandle first = vector.emplace(false);
+        REQUIRE_THROWS_AS(vector.emplace(true), std::runtime_error);
+
+        // The slot is reused, not leaked
+        ConcurrentTestHandle second = vector.emplace(false);
+        REQUIRE(vector.underlying_size() == 2);
+        REQUIRE(vector.valid(first));
+        REQUIRE(vector.valid(second));
+
+        int count = 0;
+        vector.forEach([&](Value&) {count++;});
+        REQUIRE(count == 2);
+    }
+
+    SECTION("Multi threaded")
+    {
+        ConcurrentHandleVector<ConcurrentTestHandle, uint32_t, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, 64> vector;
+
+        const unsigned ThreadCount = std::max(4u, std::thread::hardware_concurrency());
+        const uint32_t Iterations = 20000;
+
+        // Catch isn't thread safe, so each thread records its own failures
+        std::vector<uint32_t> failures(ThreadCount, 0);
+        std::vector<std::vector<ConcurrentTestHandle>> alive(ThreadCount);
+
+        std::vector<std::thread> threads;
+        for (unsigned t=0; t < ThreadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                std::mt19937 rand(t);
+                std::vector<ConcurrentTestHandle> &handles = alive[t];
+
+                for (uint32_t i=0; i < Iterations; ++i) {
+                    uint32_t value = (t << 24) | i;
+                    if (handles.empty() || rand() % 3 != 0) {
+                        ConcurrentTestHandle handle = vector.create(value);
+                        if (!handle) failures[t]++;
+                        handles.push_back(handle);
+                    }
+                    else {
+                        size_t idx = rand() % handles.size();
+                        ConcurrentTestHandle handle = handles[idx];
+                        handles[idx] = handles.back();
+                        handles.pop_back();
+
+                        uint32_t copy = 0;
+                        if (!vector.get(handle, copy) || (copy >> 24) != t) failures[t]++;
+                        if (!vector.free(handle)) failures[t]++;
+                        if (vector.valid(handle)) failures[t]++;
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (unsigned t=0; t < ThreadCount; ++t) {
+            REQUIRE(failures[t] == 0);
+        }
+
+        std::set<ConcurrentTestHandle> unique;
+        size_t count = 0;
+        for (unsigned t=0; t < ThreadCount; ++t) {
+            for (auto handle : alive[t]) {
+                REQUIRE(vector.valid(handle));
+                REQUIRE((*vector.find(handle) >> 24) == t);
+                unique.insert(handle);
+                count++;
+            }
+        }
+        REQUIRE(unique.size() == count);
+
+        size_t found = 0;
+        vector.forEach([&](uint32_t&) {found++;});
+        REQUIRE(found == count);
+    }
+}
+
+// Hidden by default, run with: ConcurrentHandleVector [benchmark]
+TEST_CASE( "ConcurrentHandleVector benchmark", "[.][benchmark]" )
+{
+    const uint32_t Iterations = 200000;
+    const unsigned MaxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Each thread creates handles, looks them up and frees them in batches
+    auto run = [&]( unsigned threadCount, auto &&create, auto &&find, auto &&free ) {
+        Clock clock;
+        clock.start();
+
+        std::vector<std::thread> threads;
+        for (unsigned t=0; t < threadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                std::vector<ConcurrentTestHandle> handles;
+                handles.reserve(256);
+                for (uint32_t i=0; i < Iterations; ++i) {
+                    handles.push_back(create(i));
+                    if (handles.size() == 256) {
+                        for (auto handle : handles) find(handle);
+                        for (auto handle : handles) free(handle);
+                        handles.clear();
+                    }
+                }
+                for (auto handle : handles) free(handle);
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        return clock.seconds();
+    };
+
+    for (unsigned threadCount=1; threadCount <= MaxThreads; threadCount *= 2) {
+        ConcurrentHandleVector<ConcurrentTestHandle, uint32_t> concurrent;
+        double concurrentTime = run(threadCount,
+            [&](uint32_t value) { return concurrent.create(value); },
+            [&](ConcurrentTestHandle handle) { uint32_t value; concurrent.get(handle, value); },
+            [&](ConcurrentTestHandle handle) { concurrent.free(handle); }
+        );
+
+        std::mutex mutex;
+        HandleVector<ConcurrentTestHandle, uint32_t> locked;
+        double lockedTime = run(threadCount,
+            [&](uint32_t value) { std::lock_guard<std::mutex> lock(mutex); return locked.create(value); },
+            [&](ConcurrentTestHandle handle) { std::lock_guard<std::mutex> lock(mutex); uint32_t value; locked.get(handle, value); },
+            [&](ConcurrentTestHandle handle) { std::lock_guard<std::mutex> lock(mutex); locked.free(handle); }
+        );
+
+        WARN(threadCount << " threads: concurrent " << concurrentTime << "s, mutex " << lockedTime << "s");
+    }
+}
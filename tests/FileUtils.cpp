@@ -0,0 +1,61 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/FileUtils.h"
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+
+TEST_CASE( "FileUtils mapFile", "[Common][FileUtils]" )
+{
+    // Larger than a page, so the offsets aren't page aligned
+    std::string content;
+    for (int i=0; content.size() < 20000; ++i) {
+        content += std::to_string(i) + ' ';
+    }
+    const std::string path = "FileUtils map test.txt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(content.data(), content.size());
+    }
+
+    SECTION("Whole file")
+    {
+        FileUtils::FileMapping *mapping = FileUtils::mapFile(path);
+        REQUIRE(mapping);
+        REQUIRE(mapping->size == content.size());
+        REQUIRE(memcmp(mapping->ptr, content.data(), content.size()) == 0);
+        FileUtils::unmapFile(mapping);
+    }
+
+    SECTION("Ranges")
+    {
+        const uint64_t offsets[] = {0, 1, 4095, 4096, 4097, 12345, content.size()};
+        for (uint64_t offset : offsets) {
+            FileUtils::FileMapping *rest = FileUtils::mapFile(path, offset);
+            REQUIRE(rest->size == content.size() - offset);
+            REQUIRE(memcmp(rest->ptr, content.data() + offset, rest->size) == 0);
+            FileUtils::unmapFile(rest);
+
+            int64_t size = std::min<int64_t>(100, content.size() - offset);
+            FileUtils::FileMapping *range = FileUtils::mapFile(path, offset, size);
+            REQUIRE(range->ptr);
+            REQUIRE(range->size == (size_t)size);
+            REQUIRE(memcmp(range->ptr, content.data() + offset, size) == 0);
+            FileUtils::unmapFile(range);
+        }
+    }
+
+    SECTION("Invalid")
+    {
+        REQUIRE_THROWS_AS(FileUtils::mapFile("missing file.txt"), std::runtime_error);
+        REQUIRE_THROWS_AS(FileUtils::mapFile(path, content.size() + 1), std::runtime_error);
+        REQUIRE_THROWS_AS(FileUtils::mapFile(path, 10, content.size()), std::runtime_error);
+        FileUtils::unmapFile(nullptr);
+    }
+
+    std::remove(path.c_str());
+}
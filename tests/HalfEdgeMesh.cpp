@@ -3,8 +3,22 @@
 
 #include "Common/HalfEdgeMesh.h"
 #include "Common/HalfEdgeMeshIterator.h"
+#include "Common/HalfEdgeMeshCirculator.h"
+#include "Common/Clock.h"
+#include "Common/Archive.h"
+#include "Common/Murmur3_32.h"
 
 #include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+#include <fstream>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <cstring>
 
 struct Vertex {
     int data = 0;
@@ -455,4 +469,1177 @@ TEST_CASE( "HalfEdgeMesh", "[Common][HalfEdgeMesh]" )
         mesh.verifyInvariants();
 #endif
     }
+
+    SECTION("Build from indexed")
+    {
+        auto count = [](auto range) {
+            size_t count = 0;
+            for (auto handle : range) {
+                (void)handle;
+                count++;
+            }
+            return count;
+        };
+
+        SECTION("Quad grid")
+        {
+            const uint32_t Size = 8;
+            std::vector<uint32_t> indices, faceSizes;
+            for (uint32_t y=0; y < Size; ++y) {
+                for (uint32_t x=0; x < Size; ++x) {
+                    indices.insert(indices.end(), {
+                        y*(Size+1) + x, y*(Size+1) + x+1, (y+1)*(Size+1) + x+1, (y+1)*(Size+1) + x
+                    });
+                    faceSizes.push_back(4);
+                }
+            }
+
+            std::vector<VertexHandle> vertexes((Size+1)*(Size+1));
+            std::vector<FaceHandle> faces(Size*Size);
+            REQUIRE(mesh.buildFromIndexed(indices.data(), faceSizes.data(), faceSizes.size(), vertexes.size(), vertexes.data(), faces.data()));
+#if COMMON_DEBUG_LEVEL > 0
+            mesh.verifyInvariants();
+#endif
+
+            REQUIRE(count(mesh.vertexes()) == vertexes.size());
+            REQUIRE(count(mesh.faces()) == faces.size());
+            REQUIRE(count(mesh.edges()) == 2*Size*(Size+1));
+            REQUIRE(count(mesh.hedges()) == 4*Size*(Size+1));
+
+            std::vector<FaceInfo> faceInfos;
+            std::vector<EdgeInfo> edgeInfos;
+            std::set<std::pair<uint32_t, uint32_t>> edgeKeys;
+            for (size_t f=0; f < faces.size(); ++f) {
+                FaceInfo info{faces[f], {}};
+                for (size_t i=0; i < 4; ++i) {
+                    uint32_t v1 = indices[f*4+i],
+                             v2 = indices[f*4+(i+1)%4];
+                    info.vertexes.push_back(vertexes[v1]);
+                    if (edgeKeys.emplace(std::min(v1, v2), std::max(v1, v2)).second) {
+                        edgeInfos.push_back({{}, vertexes[v1], vertexes[v2]});
+                    }
+                }
+                faceInfos.push_back(info);
+            }
+            verifyMesh(mesh, vertexes, edgeInfos, faceInfos);
+
+            for (auto vertex : vertexes) {
+                REQUIRE(mesh.findData(vertex));
+            }
+            for (auto face : faces) {
+                REQUIRE(mesh.findData(face));
+            }
+            REQUIRE(mesh.isBorderFace(faces[0]));
+            REQUIRE(!mesh.isBorderFace(faces[Size+1]));
+
+            // The built mesh can be extended with createFace
+            auto v = mesh.createVertex();
+            VertexHandle triangle[] = {vertexes[1], vertexes[0], v};
+            REQUIRE(mesh.createFace(triangle, 3));
+#if COMMON_DEBUG_LEVEL > 0
+            mesh.verifyInvariants();
+#endif
+        }
+
+        SECTION("Closed mesh")
+        {
+            // Tetrahedron
+            uint32_t indices[] = {
+                0, 2, 1,
+                0, 1, 3,
+                1, 2, 3,
+                2, 0, 3
+            };
+            REQUIRE(mesh.buildFromIndexed(indices, nullptr, 4, 4));
+#if COMMON_DEBUG_LEVEL > 0
+            mesh.verifyInvariants();
+#endif
+            REQUIRE(count(mesh.edges()) == 6);
+            REQUIRE(count(mesh.hedges()) == 12);
+            for (auto face : mesh.faces()) {
+                REQUIRE(!mesh.isBorderFace(face));
+            }
+        }
+
+        SECTION("Faces sharing a vertex")
+        {
+            uint32_t indices[] = {
+                0, 1, 2,
+                0, 3, 4,
+            };
+            REQUIRE(mesh.buildFromIndexed(indices, nullptr, 2, 5));
+#if COMMON_DEBUG_LEVEL > 0
+            mesh.verifyInvariants();
+#endif
+            REQUIRE(count(mesh.edges()) == 6);
+        }
+
+        SECTION("Same handles on any number of threads")
+        {
+            // A triangle grid with some holes, large enough to be split over the threads
+            const uint32_t Size = 100;
+            std::vector<uint32_t> indices;
+            for (uint32_t y=0; y < Size; ++y) {
+                for (uint32_t x=0; x < Size; ++x) {
+                    if ((x*Size + y) % 7 == 0) continue;
+
+                    uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                             v2 = v1 + Size+1,    v3 = v0 + Size+1;
+                    indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+                }
+            }
+            const size_t vertexCount = (Size+1)*(Size+1),
+                         faceCount = indices.size() / 3;
+
+            Common::ThreadPool singleThread(0), multipleThreads(3);
+
+            HalfEdgeMesh other;
+            std::vector<VertexHandle> vertexes(vertexCount), otherVertexes(vertexCount);
+            std::vector<FaceHandle> faces(faceCount), otherFaces(faceCount);
+            REQUIRE(mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, vertexes.data(), faces.data(), &singleThread));
+            REQUIRE(other.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, otherVertexes.data(), otherFaces.data(), &multipleThreads));
+#if COMMON_DEBUG_LEVEL > 0
+            mesh.verifyInvariants();
+            other.verifyInvariants();
+#endif
+            REQUIRE(vertexes == otherVertexes);
+            REQUIRE(faces == otherFaces);
+
+            for (auto vertex : vertexes) {
+                REQUIRE(mesh.getVertexHEdge(vertex) == other.getVertexHEdge(vertex));
+            }
+            for (auto face : faces) {
+                REQUIRE(mesh.getFaceHEdge(face) == other.getFaceHEdge(face));
+            }
+            for (auto edge : mesh.edges()) {
+                REQUIRE(mesh.getEdgeHEdge(edge) == other.getEdgeHEdge(edge));
+            }
+            for (auto hedge : mesh.hedges()) {
+                REQUIRE(mesh.getHEdgePair(hedge) == other.getHEdgePair(hedge));
+                REQUIRE(mesh.getHEdgeNext(hedge) == other.getHEdgeNext(hedge));
+                REQUIRE(mesh.getHEdgeVertex(hedge) == other.getHEdgeVertex(hedge));
+                REQUIRE(mesh.getHEdgeEdge(hedge) == other.getHEdgeEdge(hedge));
+                REQUIRE(mesh.getHEdgeFace(hedge) == other.getHEdgeFace(hedge));
+            }
+            REQUIRE(count(mesh.hedges()) == count(other.hedges()));
+        }
+
+        SECTION("Invalid input")
+        {
+            auto requireFailure = [&]( std::vector<uint32_t> indices, std::vector<uint32_t> faceSizes, size_t vertexCount ) {
+                REQUIRE(!mesh.buildFromIndexed(indices.data(), faceSizes.data(), faceSizes.size(), vertexCount));
+                // The mesh must be left untouched
+                REQUIRE(count(mesh.vertexes()) == 0);
+                REQUIRE(count(mesh.hedges()) == 0);
+                REQUIRE(count(mesh.edges()) == 0);
+                REQUIRE(count(mesh.faces()) == 0);
+            };
+
+            // To few vertexes
+            requireFailure({0, 1}, {2}, 3);
+            // Invalid index
+            requireFailure({0, 1, 3}, {3}, 3);
+            // Vertex used twice in a face
+            requireFailure({0, 1, 2, 1}, {4}, 3);
+            // Edge shared by 3 faces
+            requireFailure({0, 1, 2,  1, 0, 3,  0, 1, 4}, {3, 3, 3}, 5);
+            // Inconsistent winding
+            requireFailure({0, 1, 2,  0, 1, 3}, {3, 3}, 4);
+            // Closed fan touching another face in a vertex
+            requireFailure({0, 2, 1,  0, 1, 3,  1, 2, 3,  2, 0, 3,  0, 4, 5}, {3, 3, 3, 3, 3}, 6);
+        }
+    }
+
+    SECTION("Parallel iteration")
+    {
+        // A grid of Size*Size quads
+        const int Size = 64;
+        std::vector<VertexHandle> vertexes;
+        for (int i=0; i < (Size+1)*(Size+1); ++i) {
+            vertexes.push_back(mesh.createVertex());
+        }
+        for (int y=0; y < Size; ++y) {
+            for (int x=0; x < Size; ++x) {
+                VertexHandle quad[] = {
+                    vertexes[y*(Size+1) + x],
+                    vertexes[y*(Size+1) + x+1],
+                    vertexes[(y+1)*(Size+1) + x+1],
+                    vertexes[(y+1)*(Size+1) + x]
+                };
+                REQUIRE(mesh.createFace(quad, 4));
+            }
+        }
+
+        Common::ThreadPool pool(3);
+
+        std::atomic<int> faceCount{0}, hedgeCount{0}, edgeCount{0};
+        mesh.parallelForEachFace([&](FaceHandle face) {
+            if (mesh.getFaceHEdge(face)) faceCount++;
+        }, 16, &pool);
+        mesh.parallelForEachHEdge([&](HEdgeHandle) {hedgeCount++;}, 16, &pool);
+        mesh.parallelForEachEdge([&](EdgeHandle) {edgeCount++;}, 16, &pool);
+
+        REQUIRE(faceCount == Size*Size);
+        REQUIRE(edgeCount == 2*Size*(Size+1));
+        REQUIRE(hedgeCount == 2*edgeCount);
+
+        // Each vertex is visited once
+        mesh.parallelForEachVertexData([&](VertexHandle, Vertex &vertex) {
+            vertex.data++;
+        }, 16, &pool);
+        mesh.parallelForEachVertex([&](VertexHandle vertex) {
+            mesh.findData(vertex);
+        }, 16, &pool);
+        for (auto vertex : vertexes) {
+            REQUIRE(mesh.findData(vertex)->data == 1);
+        }
+    }
+}
+
+TEST_CASE( "HalfEdgeMesh editing", "[Common][HalfEdgeMesh]" )
+{
+    auto count = [](auto range) {
+        size_t count = 0;
+        for (auto handle : range) {
+            (void)handle;
+            count++;
+        }
+        return count;
+    };
+    auto verify = [&]( const HalfEdgeMesh &mesh ) {
+#if COMMON_DEBUG_LEVEL > 0
+        mesh.verifyInvariants();
+#endif
+        // The data must follow the topology
+        for (auto vertex : mesh.vertexes()) REQUIRE(mesh.findData(vertex));
+        for (auto hedge : mesh.hedges()) REQUIRE(mesh.findData(hedge));
+        for (auto edge : mesh.edges()) REQUIRE(mesh.findData(edge));
+        for (auto face : mesh.faces()) REQUIRE(mesh.findData(face));
+    };
+    auto faceSize = [&]( const HalfEdgeMesh &mesh, FaceHandle face ) {
+        return count(mesh.faceVertexes(face));
+    };
+
+    // A grid of Size*Size quads split into triangles along the diagonal from (x,y) to (x+1,y+1)
+    const uint32_t Size = 6;
+    std::vector<uint32_t> indices;
+    for (uint32_t y=0; y < Size; ++y) {
+        for (uint32_t x=0; x < Size; ++x) {
+            uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                     v2 = v1 + Size+1,    v3 = v0 + Size+1;
+            indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+        }
+    }
+    auto at = [&]( uint32_t x, uint32_t y ) {
+        return y*(Size+1) + x;
+    };
+
+    HalfEdgeMesh mesh;
+    std::vector<VertexHandle> vertexes((Size+1)*(Size+1));
+    REQUIRE(mesh.buildFromIndexed(indices.data(), nullptr, indices.size() / 3, vertexes.size(), vertexes.data()));
+
+    const size_t vertexCount = vertexes.size(),
+                 edgeCount = count(mesh.edges()),
+                 faceCount = 2*Size*Size;
+
+    SECTION("Flip edge")
+    {
+        EdgeHandle edge = mesh.findEdge(vertexes[at(2,2)], vertexes[at(3,3)]);
+        REQUIRE(edge);
+
+        REQUIRE(mesh.flipEdge(edge));
+        verify(mesh);
+        REQUIRE(!mesh.findEdge(vertexes[at(2,2)], vertexes[at(3,3)]));
+        REQUIRE(mesh.findEdge(vertexes[at(3,2)], vertexes[at(2,3)]) == edge);
+        REQUIRE(count(mesh.edges()) == edgeCount);
+        REQUIRE(count(mesh.faces()) == faceCount);
+
+        auto faces = mesh.getEdgeFaces(edge);
+        REQUIRE(faceSize(mesh, faces.first) == 3);
+        REQUIRE(faceSize(mesh, faces.second) == 3);
+
+        // And back again
+        REQUIRE(mesh.flipEdge(edge));
+        verify(mesh);
+        REQUIRE(mesh.findEdge(vertexes[at(2,2)], vertexes[at(3,3)]) == edge);
+
+        // Border edges can't be flipped
+        REQUIRE(!mesh.flipEdge(mesh.findEdge(vertexes[at(0,0)], vertexes[at(1,0)])));
+    }
+
+    SECTION("Split edge and face")
+    {
+        EdgeHandle edge = mesh.findEdge(vertexes[at(2,2)], vertexes[at(3,3)]);
+        auto faces = mesh.getEdgeFaces(edge);
+
+        VertexHandle a, b;
+        std::tie(a, b) = mesh.getEdgeVertexes(edge);
+
+        VertexHandle vertex = mesh.splitEdge(edge);
+        REQUIRE(vertex);
+        verify(mesh);
+        REQUIRE(count(mesh.vertexes()) == vertexCount + 1);
+        REQUIRE(count(mesh.edges()) == edgeCount + 1);
+        REQUIRE(faceSize(mesh, faces.first) == 4);
+        REQUIRE(faceSize(mesh, faces.second) == 4);
+        REQUIRE(mesh.findEdge(a, vertex) == edge);
+        REQUIRE(mesh.findEdge(vertex, b));
+        REQUIRE(!mesh.findEdge(a, b));
+        REQUIRE(count(mesh.vertexVertexes(vertex)) == 2);
+
+        // Connect the new vertex with the opposite corners, like a 1:4 triangle split
+        auto opposite = [&]( FaceHandle face ) {
+            for (auto v : mesh.faceVertexes(face)) {
+                if (v != a && v != b && v != vertex) return v;
+            }
+            return VertexHandle();
+        };
+        VertexHandle c = opposite(faces.first),
+                     d = opposite(faces.second);
+        FaceHandle f1 = mesh.splitFace(faces.first, vertex, c),
+                   f2 = mesh.splitFace(faces.second, vertex, d);
+        REQUIRE(f1);
+        REQUIRE(f2);
+        verify(mesh);
+        REQUIRE(count(mesh.faces()) == faceCount + 2);
+        REQUIRE(count(mesh.edges()) == edgeCount + 3);
+        REQUIRE(count(mesh.vertexVertexes(vertex)) == 4);
+        for (FaceHandle face : {faces.first, faces.second, f1, f2}) {
+            REQUIRE(faceSize(mesh, face) == 3);
+        }
+
+        // The vertexes are already connected
+        REQUIRE(!mesh.splitFace(faces.first, vertex, c));
+        // Not a vertex in the face
+        REQUIRE(!mesh.splitFace(f1, vertexes[at(0,0)], vertex));
+    }
+
+    SECTION("Split border edge")
+    {
+        EdgeHandle edge = mesh.findEdge(vertexes[at(0,0)], vertexes[at(1,0)]);
+        VertexHandle vertex = mesh.splitEdge(edge);
+        REQUIRE(vertex);
+        verify(mesh);
+        REQUIRE(!mesh.getHEdgeFace(mesh.getVertexHEdge(vertex)));
+    }
+
+    SECTION("Collapse edge")
+    {
+        VertexHandle v0 = vertexes[at(2,2)],
+                     v1 = vertexes[at(3,3)];
+        HEdgeHandle hedge = mesh.findHEdge(v0, v1);
+        size_t valence = count(mesh.vertexVertexes(v0)) + count(mesh.vertexVertexes(v1)) - 4;
+
+        REQUIRE(mesh.isCollapseOk(hedge));
+        REQUIRE(mesh.collapseEdge(hedge));
+        verify(mesh);
+        REQUIRE(!mesh.findData(v0));
+        REQUIRE(!mesh.findData(hedge));
+        REQUIRE(count(mesh.vertexes()) == vertexCount - 1);
+        REQUIRE(count(mesh.edges()) == edgeCount - 3);
+        REQUIRE(count(mesh.faces()) == faceCount - 2);
+        REQUIRE(count(mesh.vertexVertexes(v1)) == valence);
+
+        // A inner edge between two border vertexes
+        HEdgeHandle pinch = mesh.findHEdge(vertexes[at(Size-1,0)], vertexes[at(Size,1)]);
+        REQUIRE(mesh.getHEdgeFace(pinch));
+        REQUIRE(mesh.getHEdgeFace(mesh.getHEdgePair(pinch)));
+        REQUIRE(!mesh.isCollapseOk(pinch));
+        REQUIRE(!mesh.collapseEdge(pinch));
+        verify(mesh);
+    }
+
+    SECTION("Collapse edge between high valence vertexes")
+    {
+        // A double pyramid with a ring of 40 vertexes, the link condition is checked with more neighbors than fits on the stack
+        const uint32_t Ring = 40, Top = Ring, Bottom = Ring+1;
+        std::vector<uint32_t> pyramid;
+        for (uint32_t i=0; i < Ring; ++i) {
+            uint32_t next = (i+1) % Ring;
+            pyramid.insert(pyramid.end(), {i, next, Top,  next, i, Bottom});
+        }
+        HalfEdgeMesh pyramidMesh;
+        std::vector<VertexHandle> ring(Ring+2);
+        REQUIRE(pyramidMesh.buildFromIndexed(pyramid.data(), nullptr, pyramid.size() / 3, ring.size(), ring.data()));
+
+        // The top only shares the two opposite vertexes with the ring vertex
+        HEdgeHandle hedge = pyramidMesh.findHEdge(ring[Top], ring[0]);
+        REQUIRE(pyramidMesh.isCollapseOk(hedge));
+        REQUIRE(pyramidMesh.collapseEdge(hedge));
+        verify(pyramidMesh);
+        REQUIRE(count(pyramidMesh.vertexVertexes(ring[0])) == Ring);
+
+        // Now the ring vertex shares the whole ring with the bottom
+        hedge = pyramidMesh.findHEdge(ring[0], ring[Bottom]);
+        REQUIRE(!pyramidMesh.isCollapseOk(hedge));
+        REQUIRE(!pyramidMesh.isCollapseOk(pyramidMesh.getHEdgePair(hedge)));
+        REQUIRE(!pyramidMesh.collapseEdge(hedge));
+        verify(pyramidMesh);
+    }
+
+    SECTION("Decimate")
+    {
+        // Collapse edges until nothing more can be collapsed
+        bool collapsed = true;
+        size_t collapses = 0;
+        while (collapsed) {
+            collapsed = false;
+            for (auto hedge : mesh.hedges()) {
+                if (mesh.isCollapseOk(hedge)) {
+                    REQUIRE(mesh.collapseEdge(hedge));
+                    collapses++;
+                    collapsed = true;
+                    break;
+                }
+            }
+        }
+        verify(mesh);
+        REQUIRE(collapses > 0);
+        REQUIRE(count(mesh.vertexes()) == vertexCount - collapses);
+
+        // Euler characteristic of a disc
+        REQUIRE(count(mesh.vertexes()) - count(mesh.edges()) + count(mesh.faces()) == 1);
+        for (auto face : mesh.faces()) {
+            REQUIRE(faceSize(mesh, face) == 3);
+        }
+    }
+
+    SECTION("Remove face")
+    {
+        // A inner face only leaves a hole
+        FaceHandle face = mesh.getHEdgeFace(mesh.findHEdge(vertexes[at(2,2)], vertexes[at(3,2)]));
+        REQUIRE(mesh.removeFace(face));
+        verify(mesh);
+        REQUIRE(!mesh.findData(face));
+        REQUIRE(count(mesh.faces()) == faceCount - 1);
+        REQUIRE(count(mesh.edges()) == edgeCount);
+        REQUIRE(!mesh.getHEdgeFace(mesh.getVertexHEdge(vertexes[at(2,2)])));
+
+        // The corner triangle takes one edge and the corner vertex with it
+        VertexHandle corner = vertexes[at(Size,0)];
+        face = mesh.getHEdgeFace(mesh.findHEdge(vertexes[at(Size-1,0)], corner));
+        REQUIRE(mesh.removeFace(face));
+        verify(mesh);
+        REQUIRE(count(mesh.edges()) == edgeCount - 2);
+        REQUIRE(!mesh.findData(corner));
+        REQUIRE(count(mesh.vertexes()) == vertexCount - 1);
+
+        // Removing every face removes everything
+        std::vector<FaceHandle> faces;
+        for (auto face : mesh.faces()) faces.push_back(face);
+        for (auto face : faces) REQUIRE(mesh.removeFace(face));
+        verify(mesh);
+        REQUIRE(count(mesh.vertexes()) == 0);
+        REQUIRE(count(mesh.edges()) == 0);
+        REQUIRE(count(mesh.hedges()) == 0);
+    }
+
+    SECTION("Remove vertex")
+    {
+        VertexHandle vertex = vertexes[at(2,2)];
+        REQUIRE(mesh.removeVertex(vertex));
+        verify(mesh);
+        REQUIRE(!mesh.findData(vertex));
+        REQUIRE(count(mesh.vertexes()) == vertexCount - 1);
+        REQUIRE(count(mesh.edges()) == edgeCount - 6);
+        REQUIRE(count(mesh.faces()) == faceCount - 6);
+
+        // A border vertex, and a vertex that only has edges
+        REQUIRE(mesh.removeVertex(vertexes[at(0,3)]));
+        verify(mesh);
+
+        auto v1 = mesh.createVertex(),
+             v2 = mesh.createVertex();
+        REQUIRE(mesh.createEdge(v1, v2));
+        REQUIRE(mesh.createEdge(v1, vertexes[at(0,0)]));
+        REQUIRE(mesh.removeVertex(v1));
+        verify(mesh);
+        REQUIRE(mesh.findData(v2));
+        REQUIRE(!mesh.getVertexHEdge(v2));
+    }
+
+    SECTION("Compact")
+    {
+        // Leave holes in every table, and a vertex and an edge without faces
+        REQUIRE(mesh.removeVertex(vertexes[at(2,2)]));
+        REQUIRE(mesh.collapseEdge(mesh.findHEdge(vertexes[at(4,4)], vertexes[at(4,5)])));
+        auto lonely = mesh.createVertex(),
+             wire = mesh.createVertex();
+        REQUIRE(mesh.createEdge(wire, vertexes[at(0,0)]));
+
+        // Tag the data with the vertexes, so it can be followed
+        for (auto vertex : mesh.vertexes()) mesh.findData(vertex)->data = int(vertex.handle);
+        for (auto hedge : mesh.hedges()) mesh.findData(hedge)->data = int(mesh.getHEdgeVertex(hedge).handle);
+        for (auto edge : mesh.edges()) mesh.findData(edge)->data = int(mesh.getEdgeVertexes(edge).first.handle);
+        for (auto face : mesh.faces()) mesh.findData(face)->data = int(mesh.getHEdgeVertex(mesh.getFaceHEdge(face)).handle);
+
+        const size_t vertexCount = count(mesh.vertexes()),
+                     hedgeCount = count(mesh.hedges()),
+                     edgeCount = count(mesh.edges()),
+                     faceCount = count(mesh.faces());
+
+        auto remap = mesh.compact();
+        verify(mesh);
+
+        REQUIRE(remap.newVertexes.size() == vertexCount);
+        REQUIRE(remap.newHEdges.size() == hedgeCount);
+        REQUIRE(remap.newEdges.size() == edgeCount);
+        REQUIRE(remap.newFaces.size() == faceCount);
+        REQUIRE(count(mesh.vertexes()) == vertexCount);
+        REQUIRE(count(mesh.faces()) == faceCount);
+
+        // The elements are stored in the new order, without holes
+        REQUIRE(std::equal(remap.newVertexes.begin(), remap.newVertexes.end(), mesh.vertexes().begin()));
+        REQUIRE(std::equal(remap.newHEdges.begin(), remap.newHEdges.end(), mesh.hedges().begin()));
+        REQUIRE(std::equal(remap.newFaces.begin(), remap.newFaces.end(), mesh.faces().begin()));
+        for (size_t i=0; i < remap.newHEdges.size(); i += 2) {
+            REQUIRE(mesh.getHEdgePair(remap.newHEdges[i]) == remap.newHEdges[i+1]);
+        }
+
+        // Vertexes without faces are last
+        size_t last = remap.oldVertexes.size() - 1;
+        REQUIRE(std::minmax(remap.oldVertexes[last-1], remap.oldVertexes[last]) == std::minmax(lonely, wire));
+        REQUIRE(!mesh.getVertexHEdge(remap.newVertexes[remap.oldVertexes[last] == lonely ? last : last-1]));
+
+        // The topology and the data have moved together
+        std::map<VertexHandle, VertexHandle> vertexMap;
+        for (size_t i=0; i < remap.oldVertexes.size(); ++i) {
+            vertexMap[remap.oldVertexes[i]] = remap.newVertexes[i];
+            REQUIRE(mesh.findData(remap.newVertexes[i])->data == int(remap.oldVertexes[i].handle));
+            REQUIRE(!mesh.findData(remap.oldVertexes[i]));
+        }
+        for (size_t i=0; i < remap.newHEdges.size(); ++i) {
+            VertexHandle vertex = mesh.getHEdgeVertex(remap.newHEdges[i]);
+            REQUIRE(mesh.findData(vertex)->data == mesh.findData(remap.newHEdges[i])->data);
+        }
+        for (size_t i=0; i < remap.newFaces.size(); ++i) {
+            FaceHandle face = remap.newFaces[i];
+            VertexHandle vertex = mesh.getHEdgeVertex(mesh.getFaceHEdge(face));
+            REQUIRE(mesh.findData(vertex)->data == mesh.findData(face)->data);
+            REQUIRE(!mesh.findData(remap.oldFaces[i]));
+        }
+
+        // Breadth first, the second face is a neighbor of the first
+        bool neighbor = false;
+        for (auto face : mesh.faceFaces(remap.newFaces[0])) {
+            if (face == remap.newFaces[1]) neighbor = true;
+        }
+        REQUIRE(neighbor);
+
+        // It can still be edited
+        VertexHandle corner = vertexMap[vertexes[at(0,0)]];
+        REQUIRE(mesh.collapseEdge(mesh.findHEdge(vertexMap[vertexes[at(1,4)]], vertexMap[vertexes[at(2,4)]])));
+        REQUIRE(mesh.splitEdge(mesh.findEdge(corner, vertexMap[vertexes[at(1,0)]])));
+        verify(mesh);
+
+        // The handles from before stays invalid in a saved & loaded copy, also when the slots compact released are used again
+        std::vector<VertexHandle> before(mesh.vertexes().begin(), mesh.vertexes().end());
+        REQUIRE(mesh.removeVertex(corner));
+        auto second = mesh.compact();
+        REQUIRE(second.newVertexes.size() < before.size());
+
+        std::vector<uint8_t> data = mesh.save();
+        HalfEdgeMesh loaded;
+        REQUIRE(loaded.load(data.data(), data.size()));
+        for (size_t i=0; i < before.size(); ++i) {
+            REQUIRE(loaded.createVertex() == mesh.createVertex());
+        }
+        for (auto vertex : before) {
+            REQUIRE(!loaded.findData(vertex));
+        }
+    }
+
+    SECTION("Save & load")
+    {
+        // Leave free slots in every table, they must survive the round trip
+        REQUIRE(mesh.removeVertex(vertexes[at(2,2)]));
+        REQUIRE(mesh.flipEdge(mesh.findEdge(vertexes[at(4,4)], vertexes[at(5,5)])));
+        for (auto vertex : mesh.vertexes()) mesh.findData(vertex)->data = int(vertex.handle);
+        for (auto hedge : mesh.hedges()) mesh.findData(hedge)->data = int(hedge.handle);
+        for (auto edge : mesh.edges()) mesh.findData(edge)->data = int(edge.handle);
+        for (auto face : mesh.faces()) mesh.findData(face)->data = int(face.handle);
+
+        std::vector<uint8_t> data = mesh.save();
+        REQUIRE(!data.empty());
+        REQUIRE(mesh.save() == data);
+
+        auto requireSame = [&]( const HalfEdgeMesh &loaded ) {
+            verify(loaded);
+            REQUIRE(std::equal(mesh.vertexes().begin(), mesh.vertexes().end(), loaded.vertexes().begin(), loaded.vertexes().end()));
+            REQUIRE(std::equal(mesh.hedges().begin(), mesh.hedges().end(), loaded.hedges().begin(), loaded.hedges().end()));
+            REQUIRE(std::equal(mesh.edges().begin(), mesh.edges().end(), loaded.edges().begin(), loaded.edges().end()));
+            REQUIRE(std::equal(mesh.faces().begin(), mesh.faces().end(), loaded.faces().begin(), loaded.faces().end()));
+            for (auto hedge : mesh.hedges()) {
+                REQUIRE(loaded.getHEdgePair(hedge) == mesh.getHEdgePair(hedge));
+                REQUIRE(loaded.getHEdgeNext(hedge) == mesh.getHEdgeNext(hedge));
+                REQUIRE(loaded.getHEdgeVertex(hedge) == mesh.getHEdgeVertex(hedge));
+                REQUIRE(loaded.getHEdgeFace(hedge) == mesh.getHEdgeFace(hedge));
+                REQUIRE(loaded.findData(hedge)->data == int(hedge.handle));
+            }
+            for (auto vertex : mesh.vertexes()) REQUIRE(loaded.findData(vertex)->data == int(vertex.handle));
+            for (auto face : mesh.faces()) REQUIRE(loaded.findData(face)->data == int(face.handle));
+        };
+
+        SECTION("Round trip")
+        {
+            HalfEdgeMesh loaded;
+            loaded.createVertex();
+            REQUIRE(loaded.load(data.data(), data.size()));
+            requireSame(loaded);
+
+            // The free lists are kept, so the same edits gives the same handles
+            REQUIRE(loaded.createVertex() == mesh.createVertex());
+            REQUIRE(loaded.splitEdge(loaded.findEdge(vertexes[at(0,0)], vertexes[at(1,0)])) ==
+                    mesh.splitEdge(mesh.findEdge(vertexes[at(0,0)], vertexes[at(1,0)])));
+            verify(loaded);
+
+            // Unaligned data
+            std::vector<uint8_t> shifted(data.size() + 1);
+            std::copy(data.begin(), data.end(), shifted.begin() + 1);
+            HalfEdgeMesh unaligned;
+            REQUIRE(unaligned.load(shifted.data() + 1, data.size()));
+            REQUIRE(unaligned.save() == data);
+        }
+
+        SECTION("Invalid data")
+        {
+            auto requireFails = [&]( const std::vector<uint8_t> &invalid ) {
+                HalfEdgeMesh loaded;
+                loaded.createVertex();
+                REQUIRE(!loaded.load(invalid.data(), invalid.size()));
+                REQUIRE(count(loaded.vertexes()) == 0);
+            };
+
+            std::vector<uint8_t> corrupt = data;
+            corrupt[corrupt.size() / 2] ^= 1;
+            requireFails(corrupt);
+            requireFails(std::vector<uint8_t>(data.begin(), data.end() - 16));
+            requireFails(std::vector<uint8_t>(data.begin(), data.begin() + 8));
+
+            // A mesh without data doesn't have the data tables, and the other way around
+            Common::HalfEdgeMeshBase base;
+            REQUIRE(!base.load(data.data(), data.size()));
+            base = mesh;
+            requireFails(base.save());
+            REQUIRE(base.load(base.save().data(), base.save().size()));
+
+            // Half edges without a pair, with a valid checksum (see the layout in src/HalfEdgeMeshSerialize.cpp).
+            //  The topology isn't verified, but the edge index can't be built
+            {
+                const size_t FileHeaderSize = 48, TableHeaderSize = 48, ChecksumOffset = 32;
+                auto alignUp = []( size_t offset ) { return (offset + 15) & ~size_t(15); };
+                auto tableValues = [&]( const std::vector<uint8_t> &file, size_t table, uint64_t &slots ) {
+                    uint32_t handleSize = 0, valueSize = 0;
+                    memcpy(&slots, file.data() + table, sizeof(slots));
+                    memcpy(&handleSize, file.data() + table + 8, sizeof(handleSize));
+                    memcpy(&valueSize, file.data() + table + 12, sizeof(valueSize));
+                    size_t values = alignUp(table + TableHeaderSize + slots*handleSize);
+                    return std::make_pair(values, alignUp(values + slots*valueSize));
+                };
+
+                std::vector<uint8_t> unpaired = data;
+                uint64_t slots = 0;
+                size_t hedgeTable = tableValues(unpaired, FileHeaderSize, slots).second;
+                size_t values = tableValues(unpaired, hedgeTable, slots).first;
+                for (uint64_t i=0; i < slots; ++i) {
+                    // The pair is the first member of a half edge
+                    memset(unpaired.data() + values + i*sizeof(Common::internal::HEdge), 0, sizeof(HalfEdgeMesh::HEdgeHandle));
+                }
+                REQUIRE(unpaired.size() - FileHeaderSize < 1024*1024); // the checksum is chained over 1MB blocks
+                uint32_t checksum = Common::murmur3_32((const char*)unpaired.data() + FileHeaderSize, uint32_t(unpaired.size() - FileHeaderSize));
+                memcpy(unpaired.data() + ChecksumOffset, &checksum, sizeof(checksum));
+
+                HalfEdgeMesh loaded;
+                REQUIRE(loaded.load(unpaired.data(), unpaired.size()));
+
+                loaded.setEdgeIndexEnabled(true);
+                REQUIRE(!loaded.load(unpaired.data(), unpaired.size()));
+                REQUIRE(count(loaded.vertexes()) == 0);
+                REQUIRE(loaded.isEdgeIndexEnabled());
+                REQUIRE(loaded.load(data.data(), data.size()));
+                requireSame(loaded);
+            }
+        }
+
+        SECTION("Archive")
+        {
+            const std::string file = "HalfEdgeMesh serialize test.mesh";
+            {
+                std::ofstream out(file, std::ios::binary);
+                out.write((const char*)data.data(), data.size());
+            }
+
+            Common::Archive archive = Common::Archive::OpenArchive(".");
+            HalfEdgeMesh loaded;
+            REQUIRE(loaded.load(archive, file));
+            requireSame(loaded);
+            REQUIRE(!loaded.load(archive, "missing.mesh"));
+            REQUIRE(count(loaded.faces()) == 0);
+
+            std::remove(file.c_str());
+        }
+    }
+
+    SECTION("Edge index")
+    {
+        mesh.setEdgeIndexEnabled(true);
+        REQUIRE(mesh.isEdgeIndexEnabled());
+
+        // The index must give the same answers as walking around the vertex
+        auto verifyIndex = [&]( const HalfEdgeMesh &indexed ) {
+            verify(indexed);
+            REQUIRE(indexed.isEdgeIndexEnabled());
+            HalfEdgeMesh walked = indexed;
+            walked.setEdgeIndexEnabled(false);
+
+            std::vector<VertexHandle> all(indexed.vertexes().begin(), indexed.vertexes().end());
+            size_t missmatches = 0;
+            for (VertexHandle v1 : all) {
+                for (VertexHandle v2 : all) {
+                    if (indexed.findHEdge(v1, v2) != walked.findHEdge(v1, v2)) missmatches++;
+                }
+            }
+            REQUIRE(missmatches == 0);
+            for (auto hedge : indexed.hedges()) {
+                REQUIRE(indexed.findHEdge(indexed.getHEdgeVertex(indexed.getHEdgePair(hedge)), indexed.getHEdgeVertex(hedge)) == hedge);
+            }
+        };
+        verifyIndex(mesh);
+
+        // Random edits of every kind
+        std::mt19937 random(3);
+        auto pick = [&]( auto range ) {
+            std::vector<typename decltype(range.begin())::value_type> handles(range.begin(), range.end());
+            return handles[random() % handles.size()];
+        };
+        for (int i=0; i < 60; ++i) {
+            switch (random() % 6) {
+            case 0:
+                mesh.flipEdge(pick(mesh.edges()));
+                break;
+            case 1:
+                mesh.splitEdge(pick(mesh.edges()));
+                break;
+            case 2: {
+                FaceHandle face = pick(mesh.faces());
+                std::vector<VertexHandle> corners(mesh.faceVertexes(face).begin(), mesh.faceVertexes(face).end());
+                if (corners.size() > 3) mesh.splitFace(face, corners[0], corners[2]);
+                break;
+            }
+            case 3: {
+                HEdgeHandle hedge = pick(mesh.hedges());
+                if (mesh.isCollapseOk(hedge)) REQUIRE(mesh.collapseEdge(hedge));
+                break;
+            }
+            case 4:
+                if (count(mesh.faces()) > 20) REQUIRE(mesh.removeFace(pick(mesh.faces())));
+                break;
+            case 5: {
+                VertexHandle triangle[] = {mesh.createVertex(), mesh.createVertex(), mesh.createVertex()};
+                REQUIRE(mesh.createFace(triangle, 3));
+                break;
+            }
+            }
+            verifyIndex(mesh);
+        }
+
+        REQUIRE(mesh.removeVertex(pick(mesh.vertexes())));
+        verifyIndex(mesh);
+
+        mesh.compact();
+        verifyIndex(mesh);
+
+        HalfEdgeMesh loaded;
+        loaded.setEdgeIndexEnabled(true);
+        std::vector<uint8_t> data = mesh.save();
+        REQUIRE(loaded.load(data.data(), data.size()));
+        verifyIndex(loaded);
+
+        HalfEdgeMesh moved = std::move(loaded);
+        verifyIndex(moved);
+
+        // Building on top of existing elements
+        REQUIRE(moved.buildFromIndexed(indices.data(), nullptr, indices.size() / 3, vertexes.size()));
+        verifyIndex(moved);
+
+        std::vector<VertexHandle> old(moved.vertexes().begin(), moved.vertexes().end());
+        moved.clear();
+        REQUIRE(moved.isEdgeIndexEnabled());
+        REQUIRE(!moved.findHEdge(old[0], old[1]));
+        REQUIRE(moved.buildFromIndexed(indices.data(), nullptr, indices.size() / 3, vertexes.size()));
+        verifyIndex(moved);
+
+        moved.setEdgeIndexEnabled(false);
+        REQUIRE(!moved.isEdgeIndexEnabled());
+        verify(moved);
+    }
+
+    SECTION("Snapshots")
+    {
+        int next = 0;
+        for (auto vertex : mesh.vertexes()) mesh.findData(vertex)->data = next++;
+        for (auto face : mesh.faces()) mesh.findData(face)->data = next++;
+
+        const HalfEdgeMesh snapshot = mesh;
+        const std::vector<uint8_t> saved = snapshot.save();
+        REQUIRE(mesh.save() == saved);
+
+        // A reader works from the snapshot while the mesh is edited
+        std::atomic<bool> done{false};
+        std::atomic<size_t> reads{0}, missmatches{0};
+        std::thread reader([&]() {
+            while (!done || reads == 0) {
+                if (snapshot.save() != saved) missmatches++;
+                reads++;
+            }
+        });
+
+        std::mt19937 random(5);
+        auto pick = [&]( auto range ) {
+            std::vector<typename decltype(range.begin())::value_type> handles(range.begin(), range.end());
+            return handles[random() % handles.size()];
+        };
+        for (int i=0; i < 40; ++i) {
+            switch (random() % 4) {
+            case 0:
+                mesh.flipEdge(pick(mesh.edges()));
+                break;
+            case 1:
+                mesh.splitEdge(pick(mesh.edges()));
+                break;
+            case 2: {
+                HEdgeHandle hedge = pick(mesh.hedges());
+                if (mesh.isCollapseOk(hedge)) REQUIRE(mesh.collapseEdge(hedge));
+                break;
+            }
+            case 3:
+                mesh.findData(pick(mesh.faces()))->data = -1;
+                break;
+            }
+        }
+        mesh.compact();
+        verify(mesh);
+
+        done = true;
+        reader.join();
+        REQUIRE(reads > 0);
+        REQUIRE(missmatches == 0);
+
+        REQUIRE(snapshot.save() == saved);
+        REQUIRE(count(snapshot.vertexes()) == vertexCount);
+        REQUIRE(count(snapshot.edges()) == edgeCount);
+        REQUIRE(count(snapshot.faces()) == faceCount);
+        verify(snapshot);
+
+        // Snapshots of snapshots (ex. a undo stack), editing one doesn't change the others
+        std::vector<HalfEdgeMesh> history = {snapshot};
+        for (int i=0; i < 5; ++i) {
+            history.push_back(history.back());
+            HalfEdgeMesh &current = history.back();
+            REQUIRE(current.removeFace(pick(current.faces())));
+        }
+        for (size_t i=0; i < history.size(); ++i) {
+            REQUIRE(count(history[i].faces()) == faceCount - i);
+            verify(history[i]);
+        }
+        mesh = HalfEdgeMesh();
+        history.erase(history.begin(), history.begin()+3);
+        REQUIRE(snapshot.save() == saved);
+        verify(history.back());
+    }
+}
+
+TEST_CASE( "HalfEdgeMesh circulators", "[Common][HalfEdgeMesh]" )
+{
+    namespace Circulators = Common::HalfEdgeMeshCirculators;
+
+    // A triangle grid with holes, so there are border vertexes and half edges without faces
+    const uint32_t Size = 16;
+    std::vector<uint32_t> indices;
+    for (uint32_t y=0; y < Size; ++y) {
+        for (uint32_t x=0; x < Size; ++x) {
+            uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                     v2 = v1 + Size+1,    v3 = v0 + Size+1;
+            if ((x*Size + y) % 5 != 0) indices.insert(indices.end(), {v0, v1, v2});
+            if ((x*Size + y) % 7 != 0) indices.insert(indices.end(), {v0, v2, v3});
+        }
+    }
+
+    HalfEdgeMesh mesh;
+    std::vector<VertexHandle> vertexes((Size+1)*(Size+1));
+    REQUIRE(mesh.buildFromIndexed(indices.data(), nullptr, indices.size() / 3, vertexes.size(), vertexes.data()));
+    // A isolated vertex
+    vertexes.push_back(mesh.createVertex());
+
+    auto collect = [](auto range) {
+        std::vector<decltype(*range.begin())> result;
+        for (auto handle : range) {
+            result.push_back(handle);
+        }
+        return result;
+    };
+
+    const auto &topology = mesh.topology();
+    for (auto vertex : vertexes) {
+        REQUIRE(collect(Circulators::vertexVertexes(topology, vertex)) == collect(mesh.vertexVertexes(vertex)));
+        REQUIRE(collect(Circulators::vertexOHEdges(topology, vertex)) == collect(mesh.vertexOHEdges(vertex)));
+        REQUIRE(collect(Circulators::vertexIHEdges(topology, vertex)) == collect(mesh.vertexIHEdges(vertex)));
+        REQUIRE(collect(Circulators::vertexEdges(topology, vertex)) == collect(mesh.vertexEdges(vertex)));
+        REQUIRE(collect(Circulators::vertexFaces(mesh, vertex)) == collect(mesh.vertexFaces(vertex)));
+    }
+    for (auto face : mesh.faces()) {
+        REQUIRE(collect(Circulators::faceVertexes(topology, face)) == collect(mesh.faceVertexes(face)));
+        REQUIRE(collect(Circulators::faceHEdges(topology, face)) == collect(mesh.faceHEdges(face)));
+        REQUIRE(collect(Circulators::faceEdges(topology, face)) == collect(mesh.faceEdges(face)));
+        REQUIRE(collect(Circulators::faceFaces(mesh, face)) == collect(mesh.faceFaces(face)));
+    }
+
+    // Invalid handles gives empty ranges
+    REQUIRE(collect(Circulators::vertexVertexes(topology, VertexHandle())).empty());
+    REQUIRE(collect(Circulators::faceVertexes(topology, FaceHandle())).empty());
+}
+
+// Hidden by default, run with: HalfEdgeMesh [benchmark]
+TEST_CASE( "HalfEdgeMesh circulator benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 512;
+    std::vector<uint32_t> indices;
+    for (uint32_t y=0; y < Size; ++y) {
+        for (uint32_t x=0; x < Size; ++x) {
+            uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                     v2 = v1 + Size+1,    v3 = v0 + Size+1;
+            indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+        }
+    }
+
+    HalfEdgeMesh mesh;
+    std::vector<VertexHandle> vertexes((Size+1)*(Size+1));
+    mesh.buildFromIndexed(indices.data(), nullptr, indices.size() / 3, vertexes.size(), vertexes.data());
+
+    // Sum the neighbors of every vertex, like a smoothing kernel would
+    Clock clock;
+    clock.start();
+    size_t iteratorTotal = 0;
+    for (auto vertex : vertexes) {
+        for (auto neighbor : mesh.vertexVertexes(vertex)) {
+            iteratorTotal += neighbor;
+        }
+    }
+    double iteratorTime = clock.seconds();
+
+    clock.restart();
+    size_t circulatorTotal = 0;
+    const auto &topology = mesh.topology();
+    for (auto vertex : vertexes) {
+        for (auto neighbor : Common::HalfEdgeMeshCirculators::vertexVertexes(topology, vertex)) {
+            circulatorTotal += neighbor;
+        }
+    }
+    double circulatorTime = clock.seconds();
+
+    REQUIRE(iteratorTotal == circulatorTotal);
+    WARN(vertexes.size() << " vertexes: VertexVertexIterator " << iteratorTime << "s, VertexVertexCirculator " << circulatorTime << "s");
+}
+
+// Hidden by default, run with: HalfEdgeMesh [benchmark]
+TEST_CASE( "HalfEdgeMesh build benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 512;
+    std::vector<uint32_t> indices;
+    for (uint32_t y=0; y < Size; ++y) {
+        for (uint32_t x=0; x < Size; ++x) {
+            uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                     v2 = v1 + Size+1,    v3 = v0 + Size+1;
+            indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+        }
+    }
+    const size_t vertexCount = (Size+1)*(Size+1),
+                 faceCount = indices.size() / 3;
+
+    Clock clock;
+    clock.start();
+    {
+        HalfEdgeMesh mesh;
+        std::vector<VertexHandle> vertexes;
+        for (size_t i=0; i < vertexCount; ++i) {
+            vertexes.push_back(mesh.createVertex());
+        }
+        for (size_t f=0; f < faceCount; ++f) {
+            VertexHandle face[] = {vertexes[indices[f*3]], vertexes[indices[f*3+1]], vertexes[indices[f*3+2]]};
+            mesh.createFace(face, 3);
+        }
+    }
+    double createFaceTime = clock.seconds();
+
+    Common::ThreadPool singleThread(0);
+    clock.restart();
+    {
+        HalfEdgeMesh mesh;
+        mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, nullptr, nullptr, &singleThread);
+    }
+    double indexedTime = clock.seconds();
+
+    clock.restart();
+    double parallelTime = 0;
+    std::vector<uint8_t> data;
+    {
+        HalfEdgeMesh mesh;
+        mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount);
+        parallelTime = clock.seconds();
+        data = mesh.save();
+    }
+
+    clock.restart();
+    {
+        HalfEdgeMesh mesh;
+        mesh.load(data.data(), data.size());
+    }
+    double loadTime = clock.seconds();
+
+    WARN(faceCount << " triangles: createFace " << createFaceTime << "s, buildFromIndexed " << indexedTime << "s, "
+         << "buildFromIndexed on " << Common::ThreadPool::Global().threadCount() << " threads " << parallelTime << "s, "
+         << "load " << loadTime << "s (" << data.size() / (1024*1024) << " MiB)");
+}
+
+// Hidden by default, run with: HalfEdgeMesh [benchmark]
+TEST_CASE( "HalfEdgeMesh edge index benchmark", "[.][benchmark]" )
+{
+    // A fan of triangles around a single hub vertex, then every spoke is looked up in random order
+    const uint32_t Valence = 20000;
+
+    auto run = [&]( bool indexed, double &buildTime, double &findTime ) {
+        Clock clock;
+        clock.start();
+
+        HalfEdgeMesh mesh;
+        mesh.setEdgeIndexEnabled(indexed);
+        std::vector<VertexHandle> spokes = {mesh.createVertex()};
+        VertexHandle hub = mesh.createVertex();
+        for (uint32_t i=0; i < Valence; ++i) {
+            spokes.push_back(mesh.createVertex());
+            VertexHandle triangle[] = {hub, spokes[i], spokes[i+1]};
+            REQUIRE(mesh.createFace(triangle, 3));
+        }
+        buildTime = clock.seconds();
+
+        std::mt19937 random(1);
+        std::shuffle(spokes.begin(), spokes.end(), random);
+        clock.restart();
+        size_t found = 0;
+        for (VertexHandle spoke : spokes) {
+            if (mesh.findEdge(hub, spoke)) found++;
+        }
+        findTime = clock.seconds();
+        REQUIRE(found == spokes.size());
+    };
+
+    double walkBuild, walkFind, indexBuild, indexFind;
+    run(false, walkBuild, walkFind);
+    run(true, indexBuild, indexFind);
+
+    WARN(Valence << " faces around one vertex: building " << walkBuild << "s, finding every edge " << walkFind << "s, "
+         << "with the edge index " << indexBuild << "s and " << indexFind << "s");
+}
+
+TEST_CASE( "HalfEdgeMesh edit benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 256;
+    std::vector<uint32_t> indices;
+    for (uint32_t y=0; y < Size; ++y) {
+        for (uint32_t x=0; x < Size; ++x) {
+            uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                     v2 = v1 + Size+1,    v3 = v0 + Size+1;
+            indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+        }
+    }
+    const size_t vertexCount = (Size+1)*(Size+1),
+                 faceCount = indices.size() / 3;
+
+    HalfEdgeMesh mesh;
+    std::vector<VertexHandle> vertexes(vertexCount);
+    mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount, vertexes.data());
+
+    // Collapse the diagonal of every other quad, they don't share any vertexes
+    std::vector<HEdgeHandle> hedges;
+    for (uint32_t y=1; y+1 < Size; y += 2) {
+        for (uint32_t x=1; x+1 < Size; x += 2) {
+            hedges.push_back(mesh.findHEdge(vertexes[y*(Size+1) + x], vertexes[(y+1)*(Size+1) + x+1]));
+        }
+    }
+
+    Clock clock;
+    clock.start();
+    size_t collapsed = 0;
+    for (auto hedge : hedges) {
+        if (mesh.collapseEdge(hedge)) collapsed++;
+    }
+    double collapseTime = clock.seconds();
+
+    clock.restart();
+    {
+        HalfEdgeMesh rebuilt;
+        rebuilt.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount);
+    }
+    double buildTime = clock.seconds();
+
+    REQUIRE(collapsed == hedges.size());
+    WARN(faceCount << " triangles: " << collapsed << " collapses " << collapseTime << "s, "
+         << "rebuilding the mesh once " << buildTime << "s");
+}
+
+TEST_CASE( "HalfEdgeMesh snapshot benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 1024;
+    std::vector<uint32_t> indices;
+    for (uint32_t y=0; y < Size; ++y) {
+        for (uint32_t x=0; x < Size; ++x) {
+            uint32_t v0 = y*(Size+1) + x, v1 = v0 + 1,
+                     v2 = v1 + Size+1,    v3 = v0 + Size+1;
+            indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+        }
+    }
+    const size_t vertexCount = (Size+1)*(Size+1),
+                 faceCount = indices.size() / 3;
+
+    HalfEdgeMesh mesh;
+    mesh.buildFromIndexed(indices.data(), nullptr, faceCount, vertexCount);
+    std::vector<EdgeHandle> edges(mesh.edges().begin(), mesh.edges().end());
+
+    // Takes a snapshot before each batch of edits, like a undo stack would
+    const int Batches = 100;
+    auto run = [&]( bool snapshots, double &snapshotTime, double &editTime ) {
+        std::mt19937 random(7);
+        std::vector<HalfEdgeMesh> history;
+        snapshotTime = editTime = 0;
+
+        Clock clock;
+        for (int i=0; i < Batches; ++i) {
+            clock.start();
+            if (snapshots) history.push_back(mesh);
+            snapshotTime += clock.seconds();
+
+            clock.restart();
+            for (int j=0; j < 10; ++j) {
+                mesh.flipEdge(edges[random() % edges.size()]);
+            }
+            editTime += clock.seconds();
+        }
+    };
+
+    double plainSnapshot, plainEdit, snapshotTime, snapshotEdit;
+    run(false, plainSnapshot, plainEdit);
+    run(true, snapshotTime, snapshotEdit);
+
+    Clock clock;
+    clock.start();
+    {
+        std::vector<uint8_t> data = mesh.save();
+        HalfEdgeMesh copy;
+        copy.load(data.data(), data.size());
+    }
+    double deepCopyTime = clock.seconds();
+
+    WARN(faceCount << " triangles, " << Batches << " batches of 10 flips: " << plainEdit << "s without snapshots, "
+         << "with a snapshot before each batch " << snapshotTime << "s taking the snapshots and " << snapshotEdit << "s editing. "
+         << "A deep copy through save & load " << deepCopyTime << "s");
 }
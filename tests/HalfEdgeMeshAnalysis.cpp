@@ -0,0 +1,371 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/HalfEdgeMeshAnalysis.h"
+#include "Common/HalfEdgeMeshIterator.h"
+#include "Common/Clock.h"
+
+#include <vector>
+#include <map>
+#include <set>
+#include <random>
+
+using Common::HalfEdgeMeshBase;
+using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+using HEdgeHandle = HalfEdgeMeshBase::HEdgeHandle;
+using EdgeHandle = HalfEdgeMeshBase::EdgeHandle;
+using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+
+namespace
+{
+    // A w*h grid of quads, the sides are joined if 'wrap' is true (which makes a torus)
+    std::vector<VertexHandle> buildGrid( HalfEdgeMeshBase &mesh, uint32_t w, uint32_t h, bool wrap )
+    {
+        uint32_t columns = wrap ? w : w+1,
+                 rows = wrap ? h : h+1;
+        std::vector<uint32_t> indices;
+        for (uint32_t y=0; y < h; ++y) {
+            for (uint32_t x=0; x < w; ++x) {
+                uint32_t x1 = (x+1) % columns, y1 = (y+1) % rows;
+                indices.insert(indices.end(), {y*columns + x, y*columns + x1, y1*columns + x1, y1*columns + x});
+            }
+        }
+
+        std::vector<uint32_t> faceSizes(w*h, 4);
+        std::vector<VertexHandle> vertexes(columns*rows);
+        REQUIRE(mesh.buildFromIndexed(indices.data(), faceSizes.data(), faceSizes.size(), vertexes.size(), vertexes.data()));
+        return vertexes;
+    }
+
+    void buildOctahedron( HalfEdgeMeshBase &mesh )
+    {
+        const uint32_t indices[] = {
+            0, 2, 4,  2, 1, 4,  1, 3, 4,  3, 0, 4,
+            2, 0, 5,  1, 2, 5,  3, 1, 5,  0, 3, 5
+        };
+        REQUIRE(mesh.buildFromIndexed(indices, nullptr, 8, 6));
+    }
+
+    // The components by walking the edges with the api, as a reference
+    std::map<VertexHandle, size_t> referenceComponents( const HalfEdgeMeshBase &mesh, size_t &count )
+    {
+        std::map<VertexHandle, size_t> result;
+        count = 0;
+        for (VertexHandle start : mesh.vertexes()) {
+            if (result.count(start)) continue;
+
+            std::vector<VertexHandle> stack = {start};
+            result[start] = count;
+            while (!stack.empty()) {
+                VertexHandle vertex = stack.back();
+                stack.pop_back();
+                if (!mesh.getVertexHEdge(vertex)) continue;
+                for (VertexHandle neighbor : mesh.vertexVertexes(vertex)) {
+                    if (result.count(neighbor)) continue;
+                    result[neighbor] = count;
+                    stack.push_back(neighbor);
+                }
+            }
+            count++;
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Boundary loops", "[HalfEdgeMesh]")
+{
+    HalfEdgeMeshBase mesh;
+
+    SECTION("Closed") {
+        buildOctahedron(mesh);
+        Common::MeshBoundaryLoops loops = Common::findBoundaryLoops(mesh);
+        CHECK(loops.size() == 0);
+        CHECK(loops.hedges.empty());
+    }
+    SECTION("Grid") {
+        buildGrid(mesh, 5, 3, false);
+        Common::MeshBoundaryLoops loops = Common::findBoundaryLoops(mesh);
+        REQUIRE(loops.size() == 1);
+        REQUIRE(loops.hedges.size() == 16);
+
+        // The loop is connected in order, and covers every border half edge
+        std::set<HEdgeHandle> border;
+        for (HEdgeHandle hedge : mesh.hedges()) {
+            if (!mesh.getHEdgeFace(hedge)) border.insert(hedge);
+        }
+        CHECK(std::set<HEdgeHandle>(loops.hedges.begin(), loops.hedges.end()) == border);
+        for (size_t i=0; i < loops.hedges.size(); ++i) {
+            CHECK(mesh.getHEdgeNext(loops.hedges[i]) == loops.hedges[(i+1) % loops.hedges.size()]);
+        }
+    }
+    SECTION("Holes") {
+        std::vector<VertexHandle> vertexes = buildGrid(mesh, 7, 7, false);
+        // Two holes, one quad and one of two quads
+        int removed = 0;
+        for (FaceHandle face : std::vector<FaceHandle>(mesh.faces().begin(), mesh.faces().end())) {
+            std::set<VertexHandle> corners(mesh.faceVertexes(face).begin(), mesh.faceVertexes(face).end());
+            if (corners.count(vertexes[1*8 + 1]) && corners.count(vertexes[2*8 + 2]) ||
+                corners.count(vertexes[4*8 + 4]) && corners.count(vertexes[5*8 + 5]) ||
+                corners.count(vertexes[4*8 + 5]) && corners.count(vertexes[5*8 + 6]))
+            {
+                REQUIRE(mesh.removeFace(face));
+                removed++;
+            }
+        }
+        REQUIRE(removed == 3);
+
+        Common::MeshBoundaryLoops loops = Common::findBoundaryLoops(mesh);
+        REQUIRE(loops.size() == 3);
+        std::multiset<uint32_t> lengths;
+        for (size_t i=0; i < loops.size(); ++i) {
+            lengths.insert(loops.loopStart[i+1] - loops.loopStart[i]);
+        }
+        CHECK(lengths == std::multiset<uint32_t>{4, 6, 28});
+
+        Common::MeshComponents components = Common::labelComponents(mesh);
+        REQUIRE(components.components.size() == 1);
+        CHECK(components.components[0].boundaryLoops == 3);
+        CHECK(components.eulerCharacteristic() == -1);
+        // A disc with holes still has genus 0
+        CHECK(components.genus() == 0);
+    }
+}
+
+TEST_CASE("Components", "[HalfEdgeMesh]")
+{
+    HalfEdgeMeshBase mesh;
+
+    SECTION("Genus") {
+        buildOctahedron(mesh);
+        buildGrid(mesh, 4, 3, false);
+        buildGrid(mesh, 6, 5, true);
+        VertexHandle lonely = mesh.createVertex();
+
+        Common::MeshComponents result = Common::labelComponents(mesh);
+        REQUIRE(result.components.size() == 4);
+
+        const Common::MeshComponents::Component &sphere = result.components[0],
+                                                &disc = result.components[1],
+                                                &torus = result.components[2],
+                                                &point = result.components[3];
+        CHECK(sphere.vertexes == 6);
+        CHECK(sphere.edges == 12);
+        CHECK(sphere.faces == 8);
+        CHECK(sphere.eulerCharacteristic == 2);
+        CHECK(sphere.genus == 0);
+
+        CHECK(disc.vertexes == 20);
+        CHECK(disc.faces == 12);
+        CHECK(disc.boundaryLoops == 1);
+        CHECK(disc.eulerCharacteristic == 1);
+        CHECK(disc.genus == 0);
+
+        CHECK(torus.vertexes == 30);
+        CHECK(torus.edges == 60);
+        CHECK(torus.faces == 30);
+        CHECK(torus.eulerCharacteristic == 0);
+        CHECK(torus.genus == 1);
+
+        CHECK(point.vertexes == 1);
+        CHECK(point.edges == 0);
+        CHECK(point.genus == 0);
+        CHECK(result.vertexComponent(lonely) == 3);
+
+        CHECK(result.eulerCharacteristic() == 4);
+        CHECK(result.genus() == 1);
+    }
+    SECTION("Labels") {
+        // Random pieces of a grid, so the components have odd shapes
+        buildGrid(mesh, 32, 32, false);
+        std::mt19937 random(42);
+        std::vector<FaceHandle> faces(mesh.faces().begin(), mesh.faces().end());
+        std::shuffle(faces.begin(), faces.end(), random);
+        faces.resize(faces.size() / 2);
+        for (FaceHandle face : faces) {
+            REQUIRE(mesh.removeFace(face, random() % 2));
+        }
+
+        Common::ThreadPool pool(3);
+        Common::MeshComponents result = Common::labelComponents(mesh, &pool);
+
+        size_t count = 0;
+        std::map<VertexHandle, size_t> reference = referenceComponents(mesh, count);
+        REQUIRE(result.components.size() == count);
+
+        // The same partition, numbered in a different order
+        std::map<uint32_t, size_t> labelToReference;
+        std::vector<uint32_t> vertexCount(count, 0);
+        for (VertexHandle vertex : mesh.vertexes()) {
+            uint32_t label = result.vertexComponent(vertex);
+            REQUIRE(label < count);
+            auto inserted = labelToReference.emplace(label, reference[vertex]);
+            CHECK(inserted.first->second == reference[vertex]);
+            vertexCount[label]++;
+        }
+        CHECK(labelToReference.size() == count);
+        for (size_t i=0; i < count; ++i) {
+            CHECK(result.components[i].vertexes == vertexCount[i]);
+        }
+
+        for (FaceHandle face : mesh.faces()) {
+            CHECK(result.faceComponent(face) == result.vertexComponent(*mesh.faceVertexes(face).begin()));
+        }
+
+        // Free slots aren't labeled
+        size_t labeled = 0;
+        for (uint32_t label : result.vertexLabels) {
+            if (label != Common::MeshComponents::INVALID) labeled++;
+        }
+        CHECK(labeled == reference.size());
+
+        // Pieces of a grid are discs (with holes), and so is the whole mesh
+        CHECK(result.genus() == 0);
+        CHECK(Common::labelComponents(mesh, &pool).vertexLabels == Common::labelComponents(mesh, nullptr).vertexLabels);
+    }
+    SECTION("Empty") {
+        Common::MeshComponents result = Common::labelComponents(mesh);
+        CHECK(result.components.empty());
+        CHECK(result.eulerCharacteristic() == 0);
+    }
+}
+
+TEST_CASE("Manifold validation", "[HalfEdgeMesh]")
+{
+    HalfEdgeMeshBase mesh;
+
+    SECTION("Valid") {
+        buildOctahedron(mesh);
+        buildGrid(mesh, 6, 5, true);
+        buildGrid(mesh, 9, 9, false);
+        mesh.createVertex();
+
+        Common::ManifoldReport report = Common::validateManifold(mesh);
+        CHECK(report.isManifold());
+    }
+    SECTION("Two fans") {
+        // Two triangles that only shares a vertex
+        VertexHandle v[5];
+        for (VertexHandle &vertex : v) vertex = mesh.createVertex();
+        const VertexHandle first[] = {v[0], v[1], v[2]},
+                           second[] = {v[0], v[3], v[4]};
+        REQUIRE(mesh.createFace(first, 3));
+        REQUIRE(mesh.createFace(second, 3));
+
+        Common::ManifoldReport report = Common::validateManifold(mesh);
+        CHECK_FALSE(report.isManifold());
+        CHECK(report.brokenHEdges.empty());
+        CHECK(report.nonManifoldEdges.empty());
+        CHECK(report.nonManifoldVertexes == std::vector<VertexHandle>{v[0]});
+    }
+    SECTION("Loose edges") {
+        buildOctahedron(mesh);
+        VertexHandle a = mesh.createVertex(),
+                     b = mesh.createVertex(),
+                     c = mesh.createVertex();
+        EdgeHandle ab = mesh.createEdge(a, b),
+                   bc = mesh.createEdge(b, c);
+        REQUIRE(ab);
+        REQUIRE(bc);
+
+        Common::ManifoldReport report = Common::validateManifold(mesh);
+        CHECK(report.nonManifoldEdges == std::vector<EdgeHandle>{ab, bc});
+        // The vertex in the middle of the wire has two gaps
+        CHECK(report.nonManifoldVertexes == std::vector<VertexHandle>{b});
+        CHECK(report.degenerateFaces.empty());
+
+        // The wire is its own component, a tree has genus 0
+        Common::MeshComponents components = Common::labelComponents(mesh);
+        REQUIRE(components.components.size() == 2);
+        CHECK(components.components[1].eulerCharacteristic == 1);
+        CHECK(components.components[1].boundaryLoops == 1);
+        CHECK(components.components[1].genus == 0);
+    }
+    SECTION("Broken links") {
+        buildGrid(mesh, 4, 4, false);
+        REQUIRE(Common::validateManifold(mesh).isManifold());
+
+        // Corrupt the topology directly, as a bad import could
+        auto &topology = const_cast<Common::internal::HalfEdgeMeshTopology&>(mesh.topology());
+        HEdgeHandle hedge = *mesh.faceHEdges(*mesh.faces().begin()).begin();
+        Common::internal::HEdge *h = topology.hedges.find(hedge);
+        HEdgeHandle oldNext = h->next;
+        h->next = h->prev;
+
+        Common::ManifoldReport report = Common::validateManifold(mesh);
+        CHECK_FALSE(report.isManifold());
+        REQUIRE_FALSE(report.brokenHEdges.empty());
+        CHECK(std::find(report.brokenHEdges.begin(), report.brokenHEdges.end(), hedge) != report.brokenHEdges.end());
+
+        h->next = oldNext;
+        CHECK(Common::validateManifold(mesh).isManifold());
+    }
+    SECTION("Same result on any number of threads") {
+        buildGrid(mesh, 40, 40, false);
+        std::mt19937 random(7);
+        std::vector<FaceHandle> faces(mesh.faces().begin(), mesh.faces().end());
+        std::shuffle(faces.begin(), faces.end(), random);
+        faces.resize(faces.size() / 3);
+        for (FaceHandle face : faces) {
+            mesh.removeFace(face, false);
+        }
+
+        Common::ThreadPool pool(4);
+        Common::ManifoldReport serial = Common::validateManifold(mesh, nullptr),
+                               parallel = Common::validateManifold(mesh, &pool);
+        // Removing random faces of a grid leaves vertexes that only touches diagonally
+        CHECK_FALSE(serial.nonManifoldVertexes.empty());
+        CHECK(serial.nonManifoldVertexes == parallel.nonManifoldVertexes);
+        CHECK(serial.nonManifoldEdges == parallel.nonManifoldEdges);
+        CHECK(parallel.degenerateFaces.empty());
+        CHECK(parallel.brokenHEdges.empty());
+
+        // Check against counting the gaps with the circulators
+        std::vector<VertexHandle> expected;
+        for (VertexHandle vertex : mesh.vertexes()) {
+            if (!mesh.getVertexHEdge(vertex)) continue;
+            int gaps = 0;
+            for (HEdgeHandle hedge : mesh.vertexOHEdges(vertex)) {
+                if (!mesh.getHEdgeFace(hedge)) gaps++;
+            }
+            if (gaps > 1) expected.push_back(vertex);
+        }
+        CHECK(std::set<VertexHandle>(expected.begin(), expected.end()) == std::set<VertexHandle>(serial.nonManifoldVertexes.begin(), serial.nonManifoldVertexes.end()));
+    }
+}
+
+// Hidden by default, run with: HalfEdgeMeshAnalysis [benchmark]
+TEST_CASE("HalfEdgeMesh analysis benchmark", "[.][benchmark]")
+{
+    HalfEdgeMeshBase mesh;
+    buildGrid(mesh, 1024, 1024, true);
+
+    Clock clock;
+    clock.start();
+    bool manifold = Common::validateManifold(mesh).isManifold();
+    Common::MeshComponents components = Common::labelComponents(mesh);
+    Common::MeshBoundaryLoops loops = Common::findBoundaryLoops(mesh);
+    double batchTime = clock.seconds();
+    REQUIRE(manifold);
+    REQUIRE(components.genus() == 1);
+    REQUIRE(loops.size() == 0);
+
+    // The same with the api, one call per element
+    clock.start();
+    size_t border = 0, gaps = 0;
+    for (FaceHandle face : mesh.faces()) {
+        if (mesh.isBorderFace(face)) border++;
+    }
+    for (VertexHandle vertex : mesh.vertexes()) {
+        for (HEdgeHandle hedge : mesh.vertexOHEdges(vertex)) {
+            if (!mesh.getHEdgeFace(hedge)) gaps++;
+        }
+    }
+    size_t count = 0;
+    referenceComponents(mesh, count);
+    double apiTime = clock.seconds();
+    REQUIRE(border == 0);
+    REQUIRE(gaps == 0);
+    REQUIRE(count == 1);
+
+    WARN(components.components[0].faces << " quads: validate, label & loops " << batchTime << "s, with the api " << apiTime << "s");
+}
@@ -0,0 +1,309 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/HalfEdgeMeshBVH.h"
+#include "Common/HalfEdgeMeshIterator.h"
+#include "Common/Clock.h"
+
+#include <vector>
+#include <random>
+#include <cmath>
+
+struct Vertex {
+    float position[3] = {0, 0, 0};
+};
+struct HalfEdge {};
+struct Edge {};
+struct Face {};
+
+using HalfEdgeMesh = Common::HalfEdgeMesh<Vertex, HalfEdge, Edge, Face>;
+using VertexHandle = HalfEdgeMesh::VertexHandle;
+using FaceHandle = HalfEdgeMesh::FaceHandle;
+using Common::HalfEdgeMeshBVH;
+
+namespace
+{
+    // A Size*Size quad grid over [0,1]x[0,1], with the height given by 'height'
+    template< typename Height >
+    std::vector<VertexHandle> buildGrid( HalfEdgeMesh &mesh, uint32_t size, Height height )
+    {
+        std::vector<uint32_t> indices;
+        for (uint32_t y=0; y < size; ++y) {
+            for (uint32_t x=0; x < size; ++x) {
+                uint32_t v0 = y*(size+1) + x, v1 = v0 + 1,
+                         v2 = v1 + size+1,    v3 = v0 + size+1;
+                indices.insert(indices.end(), {v0, v1, v2, v3});
+            }
+        }
+
+        std::vector<uint32_t> faceSizes(size*size, 4);
+        std::vector<VertexHandle> vertexes((size+1)*(size+1));
+        REQUIRE(mesh.buildFromIndexed(indices.data(), faceSizes.data(), faceSizes.size(), vertexes.size(), vertexes.data()));
+
+        for (uint32_t y=0; y <= size; ++y) {
+            for (uint32_t x=0; x <= size; ++x) {
+                float fx = float(x) / size,
+                      fy = float(y) / size;
+
+                Vertex *vertex = mesh.findData(vertexes[y*(size+1) + x]);
+                vertex->position[0] = fx;
+                vertex->position[1] = fy;
+                vertex->position[2] = height(fx, fy);
+            }
+        }
+        return vertexes;
+    }
+
+    auto position = []( const Vertex &vertex ) {
+        return vertex.position;
+    };
+
+    // The reference, tests every triangle of the fans
+    bool bruteRaycast( const HalfEdgeMesh &mesh, const float *origin, const float *direction, float &best, FaceHandle &face )
+    {
+        bool found = false;
+        for (auto f : mesh.faces()) {
+            std::vector<const float*> corners;
+            for (auto vertex : mesh.faceVertexes(f)) {
+                corners.push_back(mesh.findData(vertex)->position);
+            }
+            for (size_t i=2; i < corners.size(); ++i) {
+                const float *p0 = corners[0], *p1 = corners[i-1], *p2 = corners[i];
+                float e1[3], e2[3], s[3];
+                for (int k=0; k < 3; ++k) {
+                    e1[k] = p1[k] - p0[k];
+                    e2[k] = p2[k] - p0[k];
+                    s[k] = origin[k] - p0[k];
+                }
+                // Cramer's rule on origin + t*direction = p0 + u*e1 + v*e2
+                auto det3 = []( const float *a, const float *b, const float *c ) {
+                    return a[0]*(b[1]*c[2] - b[2]*c[1]) - a[1]*(b[0]*c[2] - b[2]*c[0]) + a[2]*(b[0]*c[1] - b[1]*c[0]);
+                };
+                float nd[3] = {-direction[0], -direction[1], -direction[2]};
+                float det = det3(e1, e2, nd);
+                if (det == 0) continue;
+                float u = det3(s, e2, nd) / det,
+                      v = det3(e1, s, nd) / det,
+                      t = det3(e1, e2, s) / det;
+                if (u < 0 || v < 0 || u + v > 1 || t < 0 || t > best) continue;
+                best = t;
+                face = f;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    float brutePointDistance( const HalfEdgeMesh &mesh, const float *point )
+    {
+        // The grid is a height field, sample it densely enough for the tolerance below
+        float best = INFINITY;
+        for (auto vertex : mesh.vertexes()) {
+            const float *p = mesh.findData(vertex)->position;
+            float dx = p[0] - point[0], dy = p[1] - point[1], dz = p[2] - point[2];
+            best = std::min(best, std::sqrt(dx*dx + dy*dy + dz*dz));
+        }
+        return best;
+    }
+}
+
+TEST_CASE( "HalfEdgeMesh BVH", "[Common][HalfEdgeMesh]" )
+{
+    HalfEdgeMesh mesh;
+    auto height = [](float x, float y) {
+        return 0.25f * std::sin(x * 7.f) * std::cos(y * 5.f);
+    };
+    const uint32_t Size = 32;
+    std::vector<VertexHandle> vertexes = buildGrid(mesh, Size, height);
+
+    HalfEdgeMeshBVH bvh;
+    bvh.build(mesh, position);
+    REQUIRE(bvh.triangleCount() == 2*Size*Size);
+    REQUIRE(bvh.nodeCount() > 0);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    SECTION("Raycast")
+    {
+        for (int i=0; i < 500; ++i) {
+            float origin[3] = {unit(random)*1.4f - 0.2f, unit(random)*1.4f - 0.2f, 1.f},
+                  target[3] = {unit(random), unit(random), unit(random) - 0.5f};
+            float direction[3] = {target[0] - origin[0], target[1] - origin[1], target[2] - origin[2]};
+
+            float expected = HalfEdgeMeshBVH::INFINITE_DISTANCE;
+            FaceHandle expectedFace;
+            bool found = bruteRaycast(mesh, origin, direction, expected, expectedFace);
+
+            HalfEdgeMeshBVH::Hit hit;
+            REQUIRE(bvh.raycast(origin, direction, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit) == found);
+            if (found) {
+                REQUIRE(hit.distance == Approx(expected).margin(1e-4));
+                for (int k=0; k < 3; ++k) {
+                    REQUIRE(hit.point[k] == Approx(origin[k] + direction[k] * expected).margin(1e-4));
+                }
+                // Both faces must contain the point if it is on an edge between them
+                if (hit.face != expectedFace) {
+                    REQUIRE(hit.distance == Approx(expected).margin(1e-6));
+                }
+            }
+        }
+    }
+
+    SECTION("Raycast max distance")
+    {
+        float origin[3] = {0.5f, 0.5f, 1.f},
+              direction[3] = {0.f, 0.f, -1.f};
+        float surface = height(0.5f, 0.5f);
+
+        HalfEdgeMeshBVH::Hit hit;
+        REQUIRE(bvh.raycast(origin, direction, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+        REQUIRE(hit.distance == Approx(1.f - surface).margin(1e-3));
+        REQUIRE_FALSE(bvh.raycast(origin, direction, 0.5f * (1.f - surface), hit));
+
+        // Hits the backside too
+        float below[3] = {0.5f, 0.5f, -1.f},
+              up[3] = {0.f, 0.f, 1.f};
+        REQUIRE(bvh.raycast(below, up, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+        REQUIRE(hit.distance == Approx(1.f + surface).margin(1e-3));
+
+        // Pointing away from the mesh
+        REQUIRE_FALSE(bvh.raycast(origin, up, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+    }
+
+    SECTION("Closest point")
+    {
+        const float cellSize = 1.f / Size;
+        for (int i=0; i < 200; ++i) {
+            float point[3] = {unit(random), unit(random), unit(random) - 0.5f};
+
+            HalfEdgeMeshBVH::Hit hit;
+            REQUIRE(bvh.closestPoint(point, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+            REQUIRE(hit.face);
+
+            float dx = hit.point[0] - point[0], dy = hit.point[1] - point[1], dz = hit.point[2] - point[2];
+            REQUIRE(hit.distance == Approx(std::sqrt(dx*dx + dy*dy + dz*dz)).margin(1e-5));
+
+            // Never further away than the closest vertex, and not much closer than it either
+            float vertexDistance = brutePointDistance(mesh, point);
+            REQUIRE(hit.distance <= vertexDistance + 1e-5f);
+            REQUIRE(hit.distance >= vertexDistance - cellSize);
+        }
+
+        // Exactly on the surface
+        for (uint32_t i=0; i < 10; ++i) {
+            const float *p = mesh.findData(vertexes[i * 37 % vertexes.size()])->position;
+            HalfEdgeMeshBVH::Hit hit;
+            REQUIRE(bvh.closestPoint(p, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+            REQUIRE(hit.distance == Approx(0.f).margin(1e-6));
+        }
+
+        float far[3] = {0.5f, 0.5f, 10.f};
+        HalfEdgeMeshBVH::Hit hit;
+        REQUIRE_FALSE(bvh.closestPoint(far, 1.f, hit));
+    }
+
+    SECTION("Refit")
+    {
+        // Move everything up, the old positions are no longer hit
+        for (auto vertex : vertexes) {
+            mesh.findData(vertex)->position[2] += 2.f;
+        }
+        bvh.refit(mesh, position);
+
+        float origin[3] = {0.5f, 0.5f, 5.f},
+              direction[3] = {0.f, 0.f, -1.f};
+        HalfEdgeMeshBVH::Hit hit;
+        REQUIRE(bvh.raycast(origin, direction, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+        REQUIRE(hit.distance == Approx(3.f - height(0.5f, 0.5f)).margin(1e-3));
+
+        float below[3] = {0.5f, 0.5f, 1.f};
+        REQUIRE_FALSE(bvh.raycast(below, direction, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+
+        // Same result as a rebuild
+        HalfEdgeMeshBVH rebuilt;
+        rebuilt.build(mesh, position);
+        for (int i=0; i < 100; ++i) {
+            float o[3] = {unit(random), unit(random), 4.f},
+                  d[3] = {unit(random) - 0.5f, unit(random) - 0.5f, -1.f};
+            HalfEdgeMeshBVH::Hit a, b;
+            bool hitA = bvh.raycast(o, d, HalfEdgeMeshBVH::INFINITE_DISTANCE, a),
+                 hitB = rebuilt.raycast(o, d, HalfEdgeMeshBVH::INFINITE_DISTANCE, b);
+            REQUIRE(hitA == hitB);
+            if (hitA) {
+                REQUIRE(a.distance == Approx(b.distance).margin(1e-5));
+            }
+        }
+    }
+
+    SECTION("Thread count")
+    {
+        Common::ThreadPool single(0), multiple(3);
+        HalfEdgeMeshBVH a, b;
+        a.build(mesh, position, &single);
+        b.build(mesh, position, &multiple);
+        REQUIRE(a.nodeCount() == b.nodeCount());
+
+        for (int i=0; i < 100; ++i) {
+            float o[3] = {unit(random), unit(random), 1.f},
+                  d[3] = {unit(random) - 0.5f, unit(random) - 0.5f, -1.f};
+            HalfEdgeMeshBVH::Hit hitA, hitB;
+            REQUIRE(a.raycast(o, d, HalfEdgeMeshBVH::INFINITE_DISTANCE, hitA) ==
+                    b.raycast(o, d, HalfEdgeMeshBVH::INFINITE_DISTANCE, hitB));
+            REQUIRE(hitA.face == hitB.face);
+            REQUIRE(hitA.distance == hitB.distance);
+        }
+    }
+
+    SECTION("Empty")
+    {
+        HalfEdgeMesh empty;
+        HalfEdgeMeshBVH emptyBvh;
+        emptyBvh.build(empty, position);
+        REQUIRE(emptyBvh.triangleCount() == 0);
+
+        float origin[3] = {0, 0, 0}, direction[3] = {0, 0, 1};
+        HalfEdgeMeshBVH::Hit hit;
+        REQUIRE_FALSE(emptyBvh.raycast(origin, direction, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+        REQUIRE_FALSE(emptyBvh.closestPoint(origin, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit));
+    }
+}
+
+// Hidden by default, run with: HalfEdgeMeshBVH [benchmark]
+TEST_CASE( "HalfEdgeMesh BVH benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 1024;
+    HalfEdgeMesh mesh;
+    std::vector<VertexHandle> vertexes = buildGrid(mesh, Size, [](float x, float y) {
+        return 0.25f * std::sin(x * 12.f) * std::cos(y * 9.f);
+    });
+
+    HalfEdgeMeshBVH bvh;
+    Clock clock;
+    clock.start();
+    bvh.build(mesh, position);
+    double buildTime = clock.seconds();
+
+    for (auto vertex : vertexes) {
+        mesh.findData(vertex)->position[2] *= 1.1f;
+    }
+    clock.start();
+    bvh.refit(mesh, position);
+    double refitTime = clock.seconds();
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    const int RayCount = 1000000;
+    int hits = 0;
+    clock.start();
+    for (int i=0; i < RayCount; ++i) {
+        float o[3] = {unit(random), unit(random), 1.f},
+              d[3] = {unit(random) - 0.5f, unit(random) - 0.5f, -1.f};
+        HalfEdgeMeshBVH::Hit hit;
+        hits += bvh.raycast(o, d, HalfEdgeMeshBVH::INFINITE_DISTANCE, hit) ? 1 : 0;
+    }
+    double rayTime = clock.seconds();
+
+    WARN(bvh.triangleCount() << " triangles, " << bvh.nodeCount() << " nodes, built in " << buildTime
+         << "s, refit in " << refitTime << "s, " << RayCount << " rays (" << hits << " hits) in " << rayTime << "s");
+}
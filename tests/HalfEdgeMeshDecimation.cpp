@@ -0,0 +1,202 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/HalfEdgeMeshDecimation.h"
+#include "Common/HalfEdgeMeshIterator.h"
+#include "Common/Clock.h"
+
+#include <vector>
+#include <cmath>
+
+struct Vertex {
+    float position[3] = {0, 0, 0};
+};
+struct HalfEdge {};
+struct Edge {};
+struct Face {};
+
+using HalfEdgeMesh = Common::HalfEdgeMesh<Vertex, HalfEdge, Edge, Face>;
+using VertexHandle = HalfEdgeMesh::VertexHandle;
+
+namespace
+{
+    template< typename Range >
+    size_t count( Range range )
+    {
+        size_t count = 0;
+        for (auto handle : range) {
+            (void)handle;
+            count++;
+        }
+        return count;
+    }
+
+    // A Size*Size triangle grid over [0,1]x[0,1], with the height given by 'height'
+    template< typename Height >
+    std::vector<VertexHandle> buildGrid( HalfEdgeMesh &mesh, uint32_t size, Height height )
+    {
+        std::vector<uint32_t> indices;
+        for (uint32_t y=0; y < size; ++y) {
+            for (uint32_t x=0; x < size; ++x) {
+                uint32_t v0 = y*(size+1) + x, v1 = v0 + 1,
+                         v2 = v1 + size+1,    v3 = v0 + size+1;
+                indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+            }
+        }
+
+        std::vector<VertexHandle> vertexes((size+1)*(size+1));
+        REQUIRE(mesh.buildFromIndexed(indices.data(), nullptr, indices.size() / 3, vertexes.size(), vertexes.data()));
+
+        for (uint32_t y=0; y <= size; ++y) {
+            for (uint32_t x=0; x <= size; ++x) {
+                float fx = float(x) / size,
+                      fy = float(y) / size;
+
+                Vertex *vertex = mesh.findData(vertexes[y*(size+1) + x]);
+                vertex->position[0] = fx;
+                vertex->position[1] = fy;
+                vertex->position[2] = height(fx, fy);
+            }
+        }
+        return vertexes;
+    }
+
+    auto position = []( Vertex &vertex ) {
+        return vertex.position;
+    };
+}
+
+TEST_CASE( "HalfEdgeMesh decimation", "[Common][HalfEdgeMesh]" )
+{
+    HalfEdgeMesh mesh;
+
+    SECTION("Flat grid")
+    {
+        const uint32_t Size = 16;
+        std::vector<VertexHandle> vertexes = buildGrid(mesh, Size, [](float, float) { return 0.f; });
+
+        Common::DecimationSettings settings;
+        settings.targetFaceCount = 2;
+        Common::DecimationResult result = Common::decimate(mesh, settings, position);
+#if COMMON_DEBUG_LEVEL > 0
+        mesh.verifyInvariants();
+#endif
+
+        // A plane can be represented without any error, down to the two triangles
+        REQUIRE(result.faceCount == 2);
+        REQUIRE(count(mesh.faces()) == 2);
+        REQUIRE(count(mesh.vertexes()) == 4);
+        REQUIRE(result.collapses == vertexes.size() - 4);
+        REQUIRE(result.maxError < 1e-9);
+
+        // Only the corners are left, where they were
+        for (auto vertex : mesh.vertexes()) {
+            const Vertex *data = mesh.findData(vertex);
+            REQUIRE(data);
+            REQUIRE(std::abs(data->position[2]) < 1e-5);
+            for (int i=0; i < 2; ++i) {
+                float p = data->position[i];
+                REQUIRE((std::abs(p) < 1e-5 || std::abs(p - 1.f) < 1e-5));
+            }
+        }
+    }
+
+    SECTION("Curved grid")
+    {
+        const uint32_t Size = 32;
+        auto height = [](float x, float y) {
+            return 0.25f * std::sin(x * 3.1415f) * std::sin(y * 3.1415f);
+        };
+        std::vector<VertexHandle> vertexes = buildGrid(mesh, Size, height);
+        const size_t faceCount = count(mesh.faces());
+
+        Common::DecimationSettings settings;
+        settings.targetFaceCount = faceCount / 10;
+        Common::DecimationResult result = Common::decimate(mesh, settings, position);
+#if COMMON_DEBUG_LEVEL > 0
+        mesh.verifyInvariants();
+#endif
+
+        REQUIRE(result.faceCount <= settings.targetFaceCount);
+        REQUIRE(count(mesh.faces()) == result.faceCount);
+        REQUIRE(count(mesh.vertexes()) == vertexes.size() - result.collapses);
+
+        // Still a disc
+        REQUIRE(count(mesh.vertexes()) - count(mesh.edges()) + count(mesh.faces()) == 1);
+
+        // The vertexes stays close to the surface
+        for (auto vertex : mesh.vertexes()) {
+            const Vertex *data = mesh.findData(vertex);
+            REQUIRE(data);
+            REQUIRE(std::abs(data->position[2] - height(data->position[0], data->position[1])) < 0.05f);
+        }
+
+        // No face is flipped
+        for (auto face : mesh.faces()) {
+            std::vector<const Vertex*> corners;
+            for (auto vertex : mesh.faceVertexes(face)) {
+                corners.push_back(mesh.findData(vertex));
+            }
+            REQUIRE(corners.size() == 3);
+
+            float ax = corners[1]->position[0] - corners[0]->position[0],
+                  ay = corners[1]->position[1] - corners[0]->position[1],
+                  bx = corners[2]->position[0] - corners[0]->position[0],
+                  by = corners[2]->position[1] - corners[0]->position[1];
+            REQUIRE(ax*by - ay*bx > 0);
+        }
+    }
+
+    SECTION("Max error")
+    {
+        const uint32_t Size = 16;
+        buildGrid(mesh, Size, [](float x, float y) { return x*x + y*y; });
+        const size_t faceCount = count(mesh.faces());
+
+        Common::DecimationSettings settings;
+        settings.maxError = 1e-6;
+        Common::DecimationResult result = Common::decimate(mesh, settings, position);
+
+        REQUIRE(result.collapses > 0);
+        REQUIRE(result.maxError <= settings.maxError);
+        REQUIRE(result.faceCount > 2);
+        REQUIRE(result.faceCount < faceCount);
+    }
+
+    SECTION("Only triangles")
+    {
+        auto v0 = mesh.createVertex(),
+             v1 = mesh.createVertex(),
+             v2 = mesh.createVertex(),
+             v3 = mesh.createVertex();
+        VertexHandle quad[] = {v0, v1, v2, v3};
+        REQUIRE(mesh.createFace(quad, 4));
+
+        Common::DecimationSettings settings;
+        Common::DecimationResult result = Common::decimate(mesh, settings, position);
+        REQUIRE(result.collapses == 0);
+        REQUIRE(count(mesh.vertexes()) == 4);
+    }
+}
+
+// Hidden by default, run with: HalfEdgeMeshDecimation [benchmark]
+TEST_CASE( "HalfEdgeMesh decimation benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 256;
+    HalfEdgeMesh mesh;
+    buildGrid(mesh, Size, [](float x, float y) {
+        return 0.25f * std::sin(x * 12.f) * std::cos(y * 9.f);
+    });
+    const size_t faceCount = 2*Size*Size;
+
+    Common::DecimationSettings settings;
+    settings.targetFaceCount = faceCount / 100;
+
+    Clock clock;
+    clock.start();
+    Common::DecimationResult result = Common::decimate(mesh, settings, position);
+    double time = clock.seconds();
+
+    WARN(faceCount << " triangles decimated to " << result.faceCount << " in " << time << "s, "
+         << result.collapses << " collapses, max error " << result.maxError);
+}
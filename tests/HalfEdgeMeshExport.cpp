@@ -0,0 +1,332 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/HalfEdgeMeshExport.h"
+#include "Common/HalfEdgeMeshIterator.h"
+#include "Common/Clock.h"
+
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <random>
+#include <algorithm>
+
+using Common::HalfEdgeMeshBase;
+using VertexHandle = HalfEdgeMeshBase::VertexHandle;
+using FaceHandle = HalfEdgeMeshBase::FaceHandle;
+
+namespace
+{
+    // A Size*Size grid, made of quads if 'quads' is true, otherwise of triangles. The faces are shuffled with 'seed' if it isn't 0
+    std::vector<VertexHandle> buildGrid( HalfEdgeMeshBase &mesh, uint32_t size, bool quads, unsigned seed=0 )
+    {
+        std::vector<std::vector<uint32_t>> faces;
+        for (uint32_t y=0; y < size; ++y) {
+            for (uint32_t x=0; x < size; ++x) {
+                uint32_t v0 = y*(size+1) + x, v1 = v0 + 1,
+                         v2 = v1 + size+1,    v3 = v0 + size+1;
+                if (quads) {
+                    faces.push_back({v0, v1, v2, v3});
+                }
+                else {
+                    faces.push_back({v0, v1, v2});
+                    faces.push_back({v0, v2, v3});
+                }
+            }
+        }
+        if (seed) {
+            std::mt19937 random(seed);
+            std::shuffle(faces.begin(), faces.end(), random);
+        }
+
+        std::vector<uint32_t> indices, faceSizes;
+        for (const auto &face : faces) {
+            indices.insert(indices.end(), face.begin(), face.end());
+            faceSizes.push_back(uint32_t(face.size()));
+        }
+
+        std::vector<VertexHandle> vertexes((size+1)*(size+1));
+        REQUIRE(mesh.buildFromIndexed(indices.data(), faceSizes.data(), faceSizes.size(), vertexes.size(), vertexes.data()));
+        return vertexes;
+    }
+
+    // Average cache miss ratio (misses per triangle) with a fifo cache
+    double acmr( const std::vector<uint32_t> &triangles, size_t cacheSize )
+    {
+        std::deque<uint32_t> cache;
+        size_t misses = 0;
+        for (uint32_t index : triangles) {
+            if (std::find(cache.begin(), cache.end(), index) != cache.end()) continue;
+            misses++;
+            cache.push_back(index);
+            if (cache.size() > cacheSize) cache.pop_front();
+        }
+        return double(misses) / (triangles.size() / 3);
+    }
+
+    // Checks that the triangles are the fans of their faces, in the same winding
+    void checkTriangles( const HalfEdgeMeshBase &mesh, const Common::IndexedExport &result )
+    {
+        std::map<FaceHandle, std::vector<std::vector<VertexHandle>>> fans;
+        for (size_t t=0; t < result.triangleFaces.size(); ++t) {
+            fans[result.triangleFaces[t]].push_back({
+                result.vertexes[result.triangles[t*3]],
+                result.vertexes[result.triangles[t*3+1]],
+                result.vertexes[result.triangles[t*3+2]]
+            });
+        }
+
+        size_t faceCount = 0;
+        for (FaceHandle face : mesh.faces()) {
+            faceCount++;
+            std::vector<VertexHandle> corners;
+            for (VertexHandle vertex : mesh.faceVertexes(face)) {
+                corners.push_back(vertex);
+            }
+
+            std::vector<std::vector<VertexHandle>> expected;
+            for (size_t i=1; i+1 < corners.size(); ++i) {
+                expected.push_back({corners[0], corners[i], corners[i+1]});
+            }
+            auto &fan = fans[face];
+            std::sort(fan.begin(), fan.end());
+            std::sort(expected.begin(), expected.end());
+            REQUIRE(fan == expected);
+        }
+        REQUIRE(fans.size() == faceCount);
+    }
+
+    void checkAdjacency( const Common::IndexedExport &result )
+    {
+        const size_t triangleCount = result.triangles.size() / 3;
+        REQUIRE(result.adjacency.size() == triangleCount * 6);
+
+        // The opposite vertexes of each directed edge
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> opposite;
+        for (size_t t=0; t < triangleCount; ++t) {
+            const uint32_t *tri = &result.triangles[t*3];
+            for (int k=0; k < 3; ++k) {
+                opposite[{tri[k], tri[(k+1)%3]}] = tri[(k+2)%3];
+            }
+        }
+
+        for (size_t t=0; t < triangleCount; ++t) {
+            const uint32_t *tri = &result.triangles[t*3],
+                           *adj = &result.adjacency[t*6];
+            for (int k=0; k < 3; ++k) {
+                REQUIRE(adj[k*2] == tri[k]);
+
+                uint32_t a = tri[k], b = tri[(k+1)%3];
+                auto neighbor = opposite.find({b, a});
+                if (neighbor != opposite.end()) {
+                    REQUIRE(adj[k*2+1] == neighbor->second);
+                }
+                else {
+                    REQUIRE(adj[k*2+1] == tri[(k+2)%3]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "HalfEdgeMesh export", "[Common][HalfEdgeMesh]" )
+{
+    HalfEdgeMeshBase mesh;
+
+    SECTION("Triangles and adjacency")
+    {
+        const uint32_t Size = 8;
+        for (bool quads : {false, true}) {
+            mesh.clear();
+            std::vector<VertexHandle> vertexes = buildGrid(mesh, Size, quads);
+
+            Common::ExportSettings settings;
+            settings.adjacency = true;
+            Common::IndexedExport result = Common::exportIndexed(mesh, settings);
+
+            REQUIRE(result.vertexes.size() == vertexes.size());
+            REQUIRE(result.triangles.size() == 2*Size*Size * 3);
+            REQUIRE(result.triangleFaces.size() == 2*Size*Size);
+            REQUIRE(result.edges.empty());
+
+            std::set<VertexHandle> unique(result.vertexes.begin(), result.vertexes.end());
+            REQUIRE(unique.size() == vertexes.size());
+
+            checkTriangles(mesh, result);
+            checkAdjacency(result);
+        }
+    }
+
+    SECTION("Pentagon fan")
+    {
+        VertexHandle vertexes[5];
+        for (VertexHandle &vertex : vertexes) {
+            vertex = mesh.createVertex();
+        }
+        REQUIRE(mesh.createFace(vertexes, 5));
+
+        Common::ExportSettings settings;
+        settings.adjacency = true;
+        settings.edges = true;
+        Common::IndexedExport result = Common::exportIndexed(mesh, settings);
+
+        REQUIRE(result.triangles.size() == 9);
+        REQUIRE(result.edges.size() == 10);
+        checkTriangles(mesh, result);
+        checkAdjacency(result);
+    }
+
+    SECTION("Edges")
+    {
+        buildGrid(mesh, 4, true);
+
+        Common::ExportSettings settings;
+        settings.triangles = false;
+        settings.edges = true;
+        Common::IndexedExport result = Common::exportIndexed(mesh, settings);
+
+        REQUIRE(result.triangles.empty());
+        REQUIRE(result.triangleFaces.empty());
+        REQUIRE(result.edges.size() == result.edgeHandles.size() * 2);
+        REQUIRE(result.edgeHandles.size() == 2*4*5);
+
+        for (size_t i=0; i < result.edgeHandles.size(); ++i) {
+            auto vertexes = mesh.getEdgeVertexes(result.edgeHandles[i]);
+            // getEdgeVertexes gives the target first
+            REQUIRE(result.vertexes[result.edges[i*2]] == vertexes.second);
+            REQUIRE(result.vertexes[result.edges[i*2+1]] == vertexes.first);
+        }
+    }
+
+    SECTION("Vertex cache")
+    {
+        buildGrid(mesh, 32, false, 1234);
+
+        Common::ExportSettings settings;
+        settings.adjacency = true;
+        Common::IndexedExport original = Common::exportIndexed(mesh, settings);
+
+        settings.optimizeVertexCache = true;
+        Common::IndexedExport optimized = Common::exportIndexed(mesh, settings);
+
+        REQUIRE(optimized.triangles.size() == original.triangles.size());
+        checkTriangles(mesh, optimized);
+        checkAdjacency(optimized);
+
+        double before = acmr(original.triangles, 16),
+               after = acmr(optimized.triangles, 16);
+        REQUIRE(before > 1.5);
+        REQUIRE(after < 0.8);
+    }
+
+    SECTION("Vertex fetch")
+    {
+        buildGrid(mesh, 16, true, 99);
+        mesh.createVertex();
+
+        Common::ExportSettings settings;
+        settings.adjacency = true;
+        settings.edges = true;
+        settings.optimizeVertexCache = true;
+        settings.optimizeVertexFetch = true;
+        Common::IndexedExport result = Common::exportIndexed(mesh, settings);
+
+        checkTriangles(mesh, result);
+        checkAdjacency(result);
+
+        // Each index is used for the first time in order, the isolated vertex is last
+        uint32_t next = 0;
+        for (uint32_t index : result.triangles) {
+            REQUIRE(index <= next);
+            if (index == next) next++;
+        }
+        REQUIRE(next == result.vertexes.size() - 1);
+        REQUIRE(mesh.getVertexHEdge(result.vertexes.back()) == HalfEdgeMeshBase::HEdgeHandle());
+
+        for (size_t i=0; i < result.edgeHandles.size(); ++i) {
+            auto vertexes = mesh.getEdgeVertexes(result.edgeHandles[i]);
+            REQUIRE(result.vertexes[result.edges[i*2]] == vertexes.second);
+        }
+    }
+
+    SECTION("Thread count")
+    {
+        buildGrid(mesh, 32, true, 7);
+
+        Common::ExportSettings settings;
+        settings.adjacency = true;
+        settings.edges = true;
+        settings.optimizeVertexCache = true;
+
+        Common::ThreadPool single(0), multiple(3);
+        Common::IndexedExport a = Common::exportIndexed(mesh, settings, &single),
+                              b = Common::exportIndexed(mesh, settings, &multiple);
+        REQUIRE(a.vertexes == b.vertexes);
+        REQUIRE(a.triangles == b.triangles);
+        REQUIRE(a.triangleFaces == b.triangleFaces);
+        REQUIRE(a.adjacency == b.adjacency);
+        REQUIRE(a.edges == b.edges);
+    }
+
+    SECTION("Empty")
+    {
+        Common::ExportSettings settings;
+        settings.adjacency = true;
+        settings.edges = true;
+        settings.optimizeVertexCache = true;
+        settings.optimizeVertexFetch = true;
+        Common::IndexedExport result = Common::exportIndexed(mesh, settings);
+        REQUIRE(result.vertexes.empty());
+        REQUIRE(result.triangles.empty());
+        REQUIRE(result.edges.empty());
+    }
+}
+
+// Hidden by default, run with: HalfEdgeMeshExport [benchmark]
+TEST_CASE( "HalfEdgeMesh export benchmark", "[.][benchmark]" )
+{
+    const uint32_t Size = 1024;
+    HalfEdgeMeshBase mesh;
+    buildGrid(mesh, Size, true, 5);
+
+    Clock clock;
+
+    // What everyone did before
+    clock.start();
+    std::map<VertexHandle, uint32_t> index;
+    for (VertexHandle vertex : mesh.vertexes()) {
+        uint32_t next = uint32_t(index.size());
+        index[vertex] = next;
+    }
+    std::vector<uint32_t> naive;
+    for (FaceHandle face : mesh.faces()) {
+        std::vector<uint32_t> corners;
+        for (VertexHandle vertex : mesh.faceVertexes(face)) {
+            corners.push_back(index[vertex]);
+        }
+        for (size_t i=1; i+1 < corners.size(); ++i) {
+            naive.insert(naive.end(), {corners[0], corners[i], corners[i+1]});
+        }
+    }
+    double naiveTime = clock.seconds();
+
+    Common::ExportSettings settings;
+    clock.start();
+    Common::IndexedExport result = Common::exportIndexed(mesh, settings);
+    double exportTime = clock.seconds();
+
+    settings.adjacency = true;
+    settings.edges = true;
+    clock.start();
+    result = Common::exportIndexed(mesh, settings);
+    double allTime = clock.seconds();
+
+    settings.optimizeVertexCache = true;
+    clock.start();
+    result = Common::exportIndexed(mesh, settings);
+    double optimizeTime = clock.seconds();
+
+    WARN(result.triangleFaces.size() << " triangles, naive " << naiveTime << "s, export " << exportTime
+         << "s, with adjacency and edges " << allTime << "s, vertex cache optimized " << optimizeTime << "s");
+}
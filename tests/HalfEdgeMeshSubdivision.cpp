@@ -0,0 +1,307 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/HalfEdgeMeshSubdivision.h"
+#include "Common/HalfEdgeMeshIterator.h"
+#include "Common/Clock.h"
+
+#include <vector>
+#include <cmath>
+
+struct Vertex {
+    float position[3] = {0, 0, 0};
+};
+struct HalfEdge {};
+struct Edge {};
+struct Face {};
+
+using HalfEdgeMesh = Common::HalfEdgeMesh<Vertex, HalfEdge, Edge, Face>;
+using VertexHandle = HalfEdgeMesh::VertexHandle;
+using Common::SubdivisionScheme;
+
+namespace
+{
+    template< typename Range >
+    size_t count( Range range )
+    {
+        size_t count = 0;
+        for (auto handle : range) {
+            (void)handle;
+            count++;
+        }
+        return count;
+    }
+
+    void blendPositions( Vertex &out, const Vertex *const *sources, const float *weights, size_t count )
+    {
+        out = Vertex();
+        for (size_t i=0; i < count; ++i) {
+            for (int c=0; c < 3; ++c) {
+                out.position[c] += weights[i] * sources[i]->position[c];
+            }
+        }
+    }
+
+    std::vector<VertexHandle> build( HalfEdgeMesh &mesh, const std::vector<uint32_t> &indices, const std::vector<uint32_t> &faceSizes, const std::vector<Vertex> &positions )
+    {
+        std::vector<VertexHandle> vertexes(positions.size());
+        REQUIRE(mesh.buildFromIndexed(indices.data(), faceSizes.empty() ? nullptr : faceSizes.data(),
+                                      faceSizes.empty() ? indices.size() / 3 : faceSizes.size(), vertexes.size(), vertexes.data()));
+        for (size_t i=0; i < vertexes.size(); ++i) {
+            *mesh.findData(vertexes[i]) = positions[i];
+        }
+        return vertexes;
+    }
+
+    // A Size*Size grid in the xy plane with a unit spacing, of triangles (split from (x,y) to (x+1,y+1)) or quads
+    std::vector<VertexHandle> buildGrid( HalfEdgeMesh &mesh, uint32_t size, bool quads )
+    {
+        std::vector<uint32_t> indices, faceSizes;
+        for (uint32_t y=0; y < size; ++y) {
+            for (uint32_t x=0; x < size; ++x) {
+                uint32_t v0 = y*(size+1) + x, v1 = v0 + 1,
+                         v2 = v1 + size+1,    v3 = v0 + size+1;
+                if (quads) {
+                    indices.insert(indices.end(), {v0, v1, v2, v3});
+                    faceSizes.push_back(4);
+                }
+                else {
+                    indices.insert(indices.end(), {v0, v1, v2,  v0, v2, v3});
+                }
+            }
+        }
+        std::vector<Vertex> positions;
+        for (uint32_t y=0; y <= size; ++y) {
+            for (uint32_t x=0; x <= size; ++x) {
+                positions.push_back(Vertex{{float(x), float(y), 0.f}});
+            }
+        }
+        return build(mesh, indices, faceSizes, positions);
+    }
+
+    void buildCube( HalfEdgeMesh &mesh )
+    {
+        std::vector<Vertex> positions;
+        for (int i=0; i < 8; ++i) {
+            positions.push_back(Vertex{{float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1)}});
+        }
+        std::vector<uint32_t> indices = {
+            0, 2, 3, 1,   4, 5, 7, 6,
+            0, 1, 5, 4,   2, 6, 7, 3,
+            0, 4, 6, 2,   1, 3, 7, 5
+        };
+        build(mesh, indices, std::vector<uint32_t>(6, 4), positions);
+    }
+
+    void buildOctahedron( HalfEdgeMesh &mesh )
+    {
+        std::vector<Vertex> positions = {
+            {{1, 0, 0}}, {{-1, 0, 0}}, {{0, 1, 0}}, {{0, -1, 0}}, {{0, 0, 1}}, {{0, 0, -1}}
+        };
+        std::vector<uint32_t> indices = {
+            0, 2, 4,   2, 1, 4,   1, 3, 4,   3, 0, 4,
+            2, 0, 5,   1, 2, 5,   3, 1, 5,   0, 3, 5
+        };
+        build(mesh, indices, {}, positions);
+    }
+
+    bool isBorder( const HalfEdgeMesh &mesh, VertexHandle vertex )
+    {
+        for (auto hedge : mesh.vertexOHEdges(vertex)) {
+            if (!mesh.getHEdgeFace(hedge) || !mesh.getHEdgeFace(mesh.getHEdgePair(hedge))) return true;
+        }
+        return false;
+    }
+}
+
+TEST_CASE( "HalfEdgeMesh subdivision", "[Common][HalfEdgeMesh]" )
+{
+    HalfEdgeMesh source, target;
+
+    auto requireCounts = [&]( size_t faceVertexes, size_t vertexCount, size_t edgeCount, size_t faceCount ) {
+        REQUIRE(count(target.vertexes()) == vertexCount);
+        REQUIRE(count(target.edges()) == edgeCount);
+        REQUIRE(count(target.faces()) == faceCount);
+        for (auto face : target.faces()) {
+            REQUIRE(count(target.faceVertexes(face)) == faceVertexes);
+        }
+#if COMMON_DEBUG_LEVEL > 0
+        target.verifyInvariants();
+#endif
+    };
+
+    SECTION("Stencils")
+    {
+        // On one thread, catch isn't thread safe
+        Common::ThreadPool singleThread(0);
+        buildGrid(source, 4, false);
+        for (auto scheme : {SubdivisionScheme::Loop, SubdivisionScheme::CatmullClark}) {
+            size_t calls = 0;
+            REQUIRE(subdivide(static_cast<const Common::HalfEdgeMeshBase&>(source), static_cast<Common::HalfEdgeMeshBase&>(target), scheme,
+                [&]( VertexHandle vertex, const VertexHandle *sources, const float *weights, size_t count ) {
+                    float sum = 0;
+                    for (size_t i=0; i < count; ++i) {
+                        REQUIRE(source.findData(sources[i]));
+                        REQUIRE(weights[i] > 0);
+                        sum += weights[i];
+                    }
+                    REQUIRE(std::abs(sum - 1.f) < 1e-5f);
+                    REQUIRE(target.findData(vertex));
+                    calls++;
+                }, &singleThread));
+            size_t expected = count(source.vertexes()) + count(source.edges()) + (scheme == SubdivisionScheme::CatmullClark ? count(source.faces()) : 0);
+            REQUIRE(calls == expected);
+            REQUIRE(count(target.vertexes()) == expected);
+        }
+    }
+
+    SECTION("Loop")
+    {
+        SECTION("Closed")
+        {
+            buildOctahedron(source);
+            REQUIRE(subdivide(source, target, SubdivisionScheme::Loop, blendPositions));
+            requireCounts(3, 6 + 12, 2*12 + 3*8, 4*8);
+
+            // Valence 4 vertexes: beta = (5/8 - (3/8 + 1/4 cos(pi/2))^2) / 4, and the ring sums to 0
+            float beta = float((5.0/8.0 - (3.0/8.0)*(3.0/8.0)) / 4.0);
+            Vertex first = *target.findData(*target.vertexes().begin());
+            REQUIRE(first.position[0] == Approx(1.f - 4*beta));
+            REQUIRE(first.position[1] == Approx(0.f).margin(1e-6));
+
+            // Edge points: 3/8 of the ends and 1/8 of the opposite vertexes (which cancels out)
+            for (auto vertex : target.vertexes()) {
+                const Vertex &v = *target.findData(vertex);
+                float length = std::sqrt(v.position[0]*v.position[0] + v.position[1]*v.position[1] + v.position[2]*v.position[2]);
+                REQUIRE(length > 0.5f);
+                REQUIRE(length <= 1.f);
+            }
+        }
+
+        SECTION("Flat grid")
+        {
+            buildGrid(source, 4, false);
+            REQUIRE(subdivide(source, target, SubdivisionScheme::Loop, blendPositions));
+            requireCounts(3, 25 + 56, 2*56 + 3*32, 4*32);
+
+            // The interior of a regular flat grid doesn't move, and the borders stays straight
+            for (auto vertex : target.vertexes()) {
+                const Vertex &v = *target.findData(vertex);
+                REQUIRE(v.position[2] == 0.f);
+                if (!isBorder(target, vertex)) {
+                    REQUIRE(std::abs(v.position[0]*2 - std::round(v.position[0]*2)) < 1e-5f);
+                    REQUIRE(std::abs(v.position[1]*2 - std::round(v.position[1]*2)) < 1e-5f);
+                }
+                else if ((v.position[0] > 1 && v.position[0] < 3) || (v.position[1] > 1 && v.position[1] < 3)) {
+                    // Away from the corners, which are rounded
+                    bool onBorder = v.position[0] == 0 || v.position[0] == 4 || v.position[1] == 0 || v.position[1] == 4;
+                    REQUIRE(onBorder);
+                }
+            }
+        }
+
+        SECTION("Not triangles")
+        {
+            buildCube(source);
+            target.createVertex();
+            REQUIRE(!subdivide(source, target, SubdivisionScheme::Loop, blendPositions));
+            REQUIRE(count(target.vertexes()) == 0);
+        }
+    }
+
+    SECTION("Catmull-Clark")
+    {
+        SECTION("Cube")
+        {
+            buildCube(source);
+            REQUIRE(subdivide(source, target, SubdivisionScheme::CatmullClark, blendPositions));
+            requireCounts(4, 8 + 12 + 6, 2*12 + 24, 24);
+
+            // The corner at the origin moves to (F + 2R) / 3 = 2/9 from each side
+            const Vertex &corner = *target.findData(*target.vertexes().begin());
+            for (int c=0; c < 3; ++c) {
+                REQUIRE(corner.position[c] == Approx(2.f / 9.f));
+            }
+
+            // Two levels, from the template
+            REQUIRE(subdivide(source, target, SubdivisionScheme::CatmullClark, blendPositions, 2));
+            requireCounts(4, 98, 192, 96);
+        }
+
+        SECTION("Flat grid")
+        {
+            buildGrid(source, 4, true);
+            REQUIRE(subdivide(source, target, SubdivisionScheme::CatmullClark, blendPositions));
+            requireCounts(4, 25 + 40 + 16, 2*40 + 4*16, 4*16);
+
+            for (auto vertex : target.vertexes()) {
+                const Vertex &v = *target.findData(vertex);
+                REQUIRE(v.position[2] == 0.f);
+                if (!isBorder(target, vertex)) {
+                    REQUIRE(std::abs(v.position[0]*2 - std::round(v.position[0]*2)) < 1e-5f);
+                    REQUIRE(std::abs(v.position[1]*2 - std::round(v.position[1]*2)) < 1e-5f);
+                }
+            }
+        }
+
+        SECTION("Mixed polygons")
+        {
+            // A quad with a triangle on two sides, and a hole between them
+            std::vector<Vertex> positions = {
+                {{0, 0, 0}}, {{1, 0, 0}}, {{1, 1, 0}}, {{0, 1, 0}}, {{2, 0.5f, 0}}, {{0.5f, 2, 0}}
+            };
+            build(source, {0, 1, 2, 3,  1, 4, 2,  3, 2, 5}, {4, 3, 3}, positions);
+            REQUIRE(subdivide(source, target, SubdivisionScheme::CatmullClark, blendPositions));
+            requireCounts(4, 6 + 8 + 3, 2*8 + 10, 10);
+        }
+    }
+
+    SECTION("Same result on any number of threads")
+    {
+        buildGrid(source, 24, false);
+        Common::ThreadPool singleThread(0), threads(3);
+        for (auto scheme : {SubdivisionScheme::Loop, SubdivisionScheme::CatmullClark}) {
+            HalfEdgeMesh other;
+            REQUIRE(subdivide(source, target, scheme, blendPositions, 2, &singleThread));
+            REQUIRE(subdivide(source, other, scheme, blendPositions, 2, &threads));
+
+            REQUIRE(std::equal(target.vertexes().begin(), target.vertexes().end(), other.vertexes().begin(), other.vertexes().end()));
+            REQUIRE(std::equal(target.faces().begin(), target.faces().end(), other.faces().begin(), other.faces().end()));
+            for (auto vertex : target.vertexes()) {
+                for (int c=0; c < 3; ++c) {
+                    REQUIRE(target.findData(vertex)->position[c] == other.findData(vertex)->position[c]);
+                }
+            }
+        }
+    }
+
+    SECTION("Empty")
+    {
+        REQUIRE(subdivide(source, target, SubdivisionScheme::CatmullClark, blendPositions));
+        REQUIRE(count(target.vertexes()) == 0);
+    }
+}
+
+// Hidden by default, run with: HalfEdgeMeshSubdivision [benchmark]
+TEST_CASE( "HalfEdgeMesh subdivision benchmark", "[.][benchmark]" )
+{
+    HalfEdgeMesh source;
+    buildGrid(source, 256, false);
+
+    Common::ThreadPool singleThread(0);
+    for (auto scheme : {SubdivisionScheme::Loop, SubdivisionScheme::CatmullClark}) {
+        Clock clock;
+        clock.start();
+        HalfEdgeMesh single;
+        subdivide(source, single, scheme, blendPositions, 2, &singleThread);
+        double singleTime = clock.seconds();
+
+        clock.restart();
+        HalfEdgeMesh parallel;
+        subdivide(source, parallel, scheme, blendPositions, 2);
+        double parallelTime = clock.seconds();
+
+        WARN((scheme == SubdivisionScheme::Loop ? "Loop" : "Catmull-Clark") << ", 2 levels to " << count(parallel.faces()) << " faces: "
+             << singleTime << "s on 1 thread, " << parallelTime << "s on " << Common::ThreadPool::Global().threadCount() << " threads");
+    }
+}
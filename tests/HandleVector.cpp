@@ -3,14 +3,18 @@
 
 #include "Common/HandleVector.h"
 #include "Common/HandleType.h"
+#include "Common/Clock.h"
 
 #include <map>
 #include <set>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
 
-template< typename TestHandle, typename Value >
+template< typename TestHandle, typename Value, typename Storage=HandleVectorStorage::Contiguous >
 void testFunctionality()
 {
-    HandleVector<TestHandle, Value> vector;
+    HandleVector<TestHandle, Value, HANDLE_VECTOR_DEFAULT, HANDLE_VECTOR_DEFAULT, 0, false, Storage> vector;
     std::set<TestHandle> handles;
     std::vector<TestHandle> vhandles;
 
@@ -446,5 +450,635 @@ TEST_CASE( "HandleVector", "[Common][HandleVector]" )
         testFunctionality<TestHandle, NonMoveAssingable>();
     }
 
+    SECTION("Chunked storage")
+    {
+        using Vector = ChunkedHandleVector<TestHandle, Value, 64>;
+
+        Vector vector;
+        std::map<TestHandle, const Value*> pointers;
+
+        for (int i=0; i < 1000; ++i) {
+            auto handle = vector.create(i);
+            REQUIRE((bool)handle);
+            pointers[handle] = vector.find(handle);
+        }
+
+        // Growing the vector must not move any values
+        int movesMade = MovesMade;
+        for (int i=0; i < 1000; ++i) {
+            vector.emplace(i);
+        }
+        REQUIRE(movesMade == MovesMade);
+
+        for (const auto &entry : pointers) {
+            REQUIRE(vector.find(entry.first) == entry.second);
+            REQUIRE(entry.second->this_ == entry.second);
+        }
+
+        std::set<TestHandle> visited;
+        for (auto iter = vector.begin(); iter != vector.end(); ++iter) {
+            REQUIRE(visited.count(iter.handle()) == 0);
+            visited.insert(iter.handle());
+        }
+        REQUIRE(visited.size() == 2000);
+
+        Vector copy = vector;
+        for (const auto &entry : pointers) {
+            REQUIRE(copy.valid(entry.first));
+            REQUIRE(copy.find(entry.first) != entry.second);
+            REQUIRE(copy.find(entry.first)->val == entry.second->val);
+        }
+
+        testFunctionality<TestHandle, uint32_t, HandleVectorStorage::Chunked<64>>();
+    }
+
+    SECTION("Chunked array")
+    {
+        using Array = Common::ChunkedArray<Value, 16>;
+        Array array;
+
+        // Pointers stays valid while the array grows
+        std::vector<const Value*> pointers;
+        for (uint32_t i=0; i < 100; ++i) {
+            pointers.push_back(&array.emplace_back(i));
+        }
+        REQUIRE(array.chunkCount() == 7);
+        REQUIRE(array.capacity() == 112);
+        int movesMade = MovesMade;
+        array.reserve(1000);
+        while (array.size() < 1000) {
+            array.emplace_back(0u);
+        }
+        REQUIRE(movesMade == MovesMade);
+        for (uint32_t i=0; i < 100; ++i) {
+            REQUIRE(&array[i] == pointers[i]);
+            REQUIRE(pointers[i]->this_ == pointers[i]);
+            REQUIRE(pointers[i]->val == i);
+        }
+
+        // Values on both sides of a chunk boundary, by index and through the iterators
+        for (size_t i=0; i < array.size(); ++i) {
+            array[i].val = uint32_t(i * 3);
+        }
+        for (size_t boundary=16; boundary < array.size(); boundary += 16) {
+            REQUIRE(array[boundary-1].val == (boundary-1) * 3);
+            REQUIRE(array[boundary].val == boundary * 3);
+            REQUIRE(&array[boundary-1] + 1 != &array[boundary]);
+        }
+        size_t index = 0;
+        for (auto iter = array.begin(); iter != array.end(); ++iter, ++index) {
+            REQUIRE(iter->val == index * 3);
+        }
+        REQUIRE(index == 1000);
+        REQUIRE((array.end() - 1)->val == 999 * 3);
+        REQUIRE((array.begin() + 17)->val == 17 * 3);
+
+        // Shrinking only releases the chunks after the last element, clear keeps them all
+        while (array.size() > 33) {
+            array.pop_back();
+        }
+        REQUIRE(ValueInstances == 33);
+        REQUIRE(array.chunkCount() == 63);
+        array.shrink_to_fit();
+        REQUIRE(array.chunkCount() == 3);
+        REQUIRE(&array[0] == pointers[0]);
+        array.clear();
+        REQUIRE(ValueInstances == 0);
+        REQUIRE(array.chunkCount() == 3);
+        array.shrink_to_fit();
+        REQUIRE(array.chunkCount() == 0);
+        REQUIRE(array.capacity() == 0);
+    }
+
+    SECTION("Chunked storage with allocator")
+    {
+        struct Allocator :
+            public Common::IAllocator
+        {
+            int allocations = 0;
+
+            virtual uintptr_t allocate( size_t size ) override {
+                allocations++;
+                return (uintptr_t)::operator new(size);
+            }
+            virtual void free( uintptr_t ptr ) override {
+                allocations--;
+                ::operator delete((void*)ptr);
+            }
+        } allocator;
+
+        {
+            ChunkedHandleVector<TestHandle, Value, 16> vector(&allocator);
+            std::vector<TestHandle> handles;
+            for (int i=0; i < 100; ++i) {
+                handles.push_back(vector.create(i));
+                REQUIRE((bool)handles.back());
+            }
+            REQUIRE(allocator.allocations == 7);
+
+            // Compacting releases the chunks after the values that are kept
+            std::vector<TestHandle> compacted(20);
+            vector.compact(handles.data(), compacted.size(), compacted.data());
+            REQUIRE(allocator.allocations == 2);
+        }
+        REQUIRE(allocator.allocations == 0);
+    }
+
+    SECTION("Shared chunked storage")
+    {
+        using Vector = SharedChunkedHandleVector<TestHandle, Value, 64>;
+
+        Vector vector;
+        std::vector<TestHandle> handles;
+        for (int i=0; i < 1000; ++i) {
+            handles.push_back(vector.create(i));
+        }
+
+        // Copies shares the chunks, nothing is copied until it is written
+        int copiesMade = CopiesMade;
+        const Vector copy = vector;
+        REQUIRE(CopiesMade == copiesMade);
+        for (size_t i=0; i < handles.size(); ++i) {
+            REQUIRE(copy.find(handles[i]) == static_cast<const Vector&>(vector).find(handles[i]));
+        }
+
+        // Writing clones only the chunk of the value
+        uint32_t version = vector.storageVersion();
+        REQUIRE(version != 0);
+        vector.find(handles[100])->val = 5000;
+        REQUIRE(CopiesMade == copiesMade + 64);
+        REQUIRE(vector.storageVersion() != version);
+        version = vector.storageVersion();
+        vector.find(handles[101])->val = 101;
+        REQUIRE(vector.storageVersion() == version);
+        REQUIRE(copy.find(handles[100])->val == 100);
+        REQUIRE(copy.find(handles[101]) != static_cast<const Vector&>(vector).find(handles[101]));
+        REQUIRE(copy.find(handles[200]) == static_cast<const Vector&>(vector).find(handles[200]));
+
+        // Pointers from the non-const find stays valid as the vector grows
+        Value *ptr = vector.find(handles[100]);
+        for (int i=0; i < 1000; ++i) {
+            vector.emplace(i);
+        }
+        REQUIRE(vector.find(handles[100]) == ptr);
+
+        for (size_t i=0; i < handles.size(); i += 2) {
+            REQUIRE(vector.free(handles[i]));
+        }
+        REQUIRE(vector.freeN(handles.data()+1, 10) == 5);
+        for (size_t i=0; i < handles.size(); ++i) {
+            REQUIRE(copy.valid(handles[i]));
+            REQUIRE(copy.find(handles[i])->val == i);
+            REQUIRE(vector.valid(handles[i]) == (i % 2 == 1 && i > 10));
+        }
+        REQUIRE(copy.underlying_size() == 1000);
+
+        vector.parallelForEach([](Value &value) {
+            value.val += 1;
+        }, 16);
+        copy.forEach([&](const Value &value) {
+            REQUIRE(value.val < 1000);
+        });
+
+        {
+            Vector other = copy;
+            other.clear();
+            REQUIRE(copy.underlying_size() == 1000);
+        }
+        vector.clear();
+        REQUIRE(copy.underlying_size() == 1000);
+        REQUIRE(copy.find(handles[999])->val == 999);
+    }
+
+    SECTION("Bulk create & free")
+    {
+        HandleVector<TestHandle, Value> vector;
+        vector.reserve(1000);
+
+        std::vector<TestHandle> handles(1000);
+        REQUIRE(vector.createN(handles.size(), handles.data(), 7u) == 1000);
+        REQUIRE(vector.underlying_size() == 1000);
+        REQUIRE(ValueInstances == 1000);
+
+        std::set<TestHandle> unique(handles.begin(), handles.end());
+        REQUIRE(unique.size() == 1000);
+        for (auto handle : handles) {
+            REQUIRE(vector.valid(handle));
+            REQUIRE(vector.find(handle)->val == 7);
+        }
+
+        // Free every other handle, and a invalid handle
+        std::vector<TestHandle> freed;
+        for (size_t i=0; i < handles.size(); i += 2) {
+            freed.push_back(handles[i]);
+        }
+        freed.push_back(TestHandle());
+        REQUIRE(vector.freeN(freed.data(), freed.size()) == 500);
+        REQUIRE(ValueInstances == 500);
+        // free'ing again should fail
+        REQUIRE(vector.freeN(freed.data(), freed.size()) == 0);
+
+        for (size_t i=0; i < handles.size(); ++i) {
+            REQUIRE(vector.valid(handles[i]) == (i % 2 == 1));
+        }
+
+        // The free'd slots should be reused before the vector grows
+        std::vector<TestHandle> created(600);
+        REQUIRE(vector.createN(created.size(), created.data(), 9u) == 600);
+        REQUIRE(vector.underlying_size() == 1100);
+        for (auto handle : created) {
+            REQUIRE(unique.count(handle) == 0);
+            REQUIRE(vector.find(handle)->val == 9);
+            unique.insert(handle);
+        }
+
+        // Mixing single and bulk operations should keep the free list intact
+        REQUIRE(vector.freeN(created.data(), created.size()) == 600);
+        for (int i=0; i < 600; ++i) {
+            TestHandle handle = vector.create(i);
+            REQUIRE(unique.count(handle) == 0);
+            unique.insert(handle);
+        }
+        REQUIRE(vector.underlying_size() == 1100);
+    }
+
+    SECTION("Bulk create with a value that throws")
+    {
+        struct Throwing {
+            Throwing( int *budget ) {
+                if ((*budget)-- == 0) throw std::runtime_error("out of budget");
+            }
+        };
+        HandleVector<TestHandle, Throwing> vector;
+
+        int budget = 100;
+        std::vector<TestHandle> handles(100);
+        REQUIRE(vector.createN(handles.size(), handles.data(), &budget) == 100);
+        REQUIRE(vector.freeN(handles.data(), handles.size()) == 100);
+
+        // Throws after 10 of the free slots is used, the other 90 should still be free
+        budget = 10;
+        REQUIRE_THROWS_AS(vector.createN(handles.size(), handles.data(), &budget), std::runtime_error);
+        size_t count = 0;
+        vector.forEach([&](const Throwing&) { count++; });
+        REQUIRE(count == 10);
+
+        // The values created before the throw are kept, and their slots aren't reused
+        std::set<TestHandle> unique(handles.begin(), handles.begin() + 10);
+        budget = 1000;
+        std::vector<TestHandle> created(90);
+        REQUIRE(vector.createN(created.size(), created.data(), &budget) == 90);
+        REQUIRE(vector.underlying_size() == 100);
+        unique.insert(created.begin(), created.end());
+        REQUIRE(unique.size() == 100);
+        for (auto handle : unique) {
+            REQUIRE(vector.valid(handle));
+        }
+    }
+
+    SECTION("Wide handles")
+    {
+        MAKE_HANDLE( WideHandle, uint64_t );
+        using Vector = HandleVector<WideHandle, Value>;
+
+        static_assert(Vector::GenerationBits == 32, "64 bit handles should default to 32 generation bits");
+        static_assert(Vector::IndexBits == 31, "");
+        static_assert(Vector::IndexMask == 0x7FFFFFFFull, "");
+        static_assert(Vector::GenerationMask == 0xFFFFFFFFull, "");
+        static_assert(Vector::DataMask == 1, "");
+        static_assert(Vector::MaxValues == 0x7FFFFFFFull, "");
+
+        static_assert(HandleVector<WideHandle, int, 8>::MaxValues == size_t((uint64_t(1) << 55) - 1), "");
+        static_assert(HandleVector<TestHandle, int>::MaxValues == (1u << 23) - 1, "");
+
+        Vector vector;
+        std::set<WideHandle> handles;
+        // Reuse the same slot more times than a 8 bit generation allows
+        for (int i=0; i < 1000; ++i) {
+            WideHandle handle = vector.create(i);
+            REQUIRE(handles.count(handle) == 0);
+            handles.insert(handle);
+            REQUIRE(vector.find(handle)->val == i);
+            REQUIRE(vector.free(handle));
+        }
+        REQUIRE(vector.underlying_size() == 1);
+        for (auto handle : handles) {
+            REQUIRE(vector.valid(handle) == false);
+        }
+
+        testFunctionality<WideHandle, uint32_t>();
+    }
+
+    SECTION("Slot retirement")
+    {
+        // 2 generation bits, so each slot can be used 4 times
+        using Vector = HandleVector<TestHandle, Value, 2, HANDLE_VECTOR_DEFAULT, 0, false, HandleVectorStorage::Contiguous, true>;
+        Vector vector;
+
+        std::set<TestHandle> handles;
+        for (int i=0; i < 1000; ++i) {
+            TestHandle handle = vector.create(i);
+            REQUIRE((bool)handle);
+            REQUIRE(handles.count(handle) == 0);
+            handles.insert(handle);
+            REQUIRE(vector.free(handle));
+        }
+        // Every slot is retired after 4 uses
+        REQUIRE(vector.underlying_size() == 250);
+
+        // Retired slots must not be reused by the bulk functions or clear
+        std::vector<TestHandle> created(100);
+        REQUIRE(vector.createN(created.size(), created.data(), 1u) == 100);
+        for (auto handle : created) {
+            REQUIRE(handles.count(handle) == 0);
+            handles.insert(handle);
+        }
+        vector.clear();
+        for (int i=0; i < 1000; ++i) {
+            TestHandle handle = vector.create(i);
+            REQUIRE(handles.count(handle) == 0);
+            handles.insert(handle);
+            REQUIRE(vector.free(handle));
+        }
+        for (auto handle : handles) {
+            REQUIRE(vector.valid(handle) == false);
+        }
+
+        WideHandleVector<HandleType<uint64_t, struct WideTag>, int> wide;
+        REQUIRE(wide.RetireSaturatedSlots);
+        REQUIRE(wide.valid(wide.create(1)));
+    }
+
+    SECTION("Clear keeps generations")
+    {
+        HandleVector<TestHandle, Value> vector;
+        std::vector<TestHandle> handles;
+        for (int i=0; i < 100; ++i) {
+            handles.push_back(vector.create(i));
+        }
+        vector.clear();
+
+        for (int i=0; i < 100; ++i) {
+            TestHandle handle = vector.create(i);
+            REQUIRE(std::find(handles.begin(), handles.end(), handle) == handles.end());
+        }
+        for (auto handle : handles) {
+            REQUIRE(vector.valid(handle) == false);
+        }
+        vector.clear();
+    }
+
+    SECTION("Parallel for each")
+    {
+        HandleVector<TestHandle, Value> vector;
+        std::vector<TestHandle> handles;
+        for (int i=0; i < 10000; ++i) {
+            handles.push_back(vector.create(i));
+        }
+        // Free some handles, so there are holes in every chunk
+        for (size_t i=0; i < handles.size(); i += 3) {
+            vector.free(handles[i]);
+        }
+
+        Common::ThreadPool pool(3);
+        vector.parallelForEach([](Value &value) {
+            value.val *= 2;
+        }, 64, &pool);
+
+        for (size_t i=0; i < handles.size(); ++i) {
+            if (i % 3 == 0) continue;
+            REQUIRE(vector.find(handles[i])->val == 2*i);
+        }
+
+        std::atomic<size_t> visited{0};
+        const auto &cvector = vector;
+        cvector.parallelForEachHandle([&](TestHandle handle) {
+            if (cvector.valid(handle)) visited++;
+        }, 64, &pool);
+        REQUIRE(visited == handles.size() - (handles.size()+2)/3);
+    }
+
+    SECTION("Compact")
+    {
+        ChunkedHandleVector<TestHandle, Value, 16> vector;
+        ManuelHandleVector<TestHandle, Value> manual;
+        std::vector<TestHandle> handles;
+        for (int i=0; i < 100; ++i) {
+            handles.push_back(vector.create(i));
+            manual.allocate(handles.back(), 1000 + i);
+        }
+        for (size_t i=0; i < handles.size(); i += 3) {
+            vector.free(handles[i]);
+            manual.free(handles[i]);
+        }
+
+        // Reversed, and without the last value (which is destroyed)
+        std::vector<TestHandle> order;
+        for (size_t i=handles.size(); i-- > 0;) {
+            if (i % 3 != 0) order.push_back(handles[i]);
+        }
+        order.erase(order.begin());
+        REQUIRE(order.size() == 65);
+
+        std::vector<TestHandle> compacted(order.size());
+        vector.compact(order.data(), order.size(), compacted.data());
+        manual.relocate(order.data(), compacted.data(), order.size());
+        REQUIRE(vector.underlying_size() == order.size());
+        REQUIRE(ValueInstances == 2*order.size());
+
+        for (size_t i=0; i < order.size(); ++i) {
+            uint32_t original = uint32_t(std::find(handles.begin(), handles.end(), order[i]) - handles.begin());
+            REQUIRE(vector.find(compacted[i])->val == original);
+            REQUIRE(manual.find(compacted[i])->val == 1000 + original);
+        }
+        for (auto handle : handles) {
+            REQUIRE(!vector.valid(handle));
+            REQUIRE(!manual.valid(handle));
+        }
+
+        // Stored in the new order, and it keeps working
+        size_t index = 0;
+        for (auto iter = vector.begin(); iter != vector.end(); ++iter) {
+            REQUIRE(iter.handle() == compacted[index++]);
+        }
+        REQUIRE(index == compacted.size());
+        TestHandle added = vector.create(7);
+        REQUIRE(vector.find(added)->val == 7);
+        REQUIRE(vector.free(compacted[3]));
+        REQUIRE(vector.valid(compacted[4]));
+    }
+
+    SECTION("Compact keeps released handles invalid")
+    {
+        HandleVector<TestHandle, uint32_t> vector;
+        TestHandle handles[5];
+        for (uint32_t i=0; i < 5; ++i) {
+            handles[i] = vector.create(100 * i);
+        }
+
+        TestHandle compacted[3];
+        vector.compact(handles, 3, compacted);
+        REQUIRE(vector.underlying_size() == 3);
+
+        // The released slots are added again, but not with the generations they had
+        TestHandle added[2] = {vector.create(1), vector.create(2)};
+        REQUIRE(vector.underlying_size() == 5);
+        for (int i=0; i < 5; ++i) {
+            REQUIRE(!vector.valid(handles[i]));
+            REQUIRE(vector.find(handles[i]) == nullptr);
+        }
+        REQUIRE(*vector.find(added[0]) == 1);
+        REQUIRE(*vector.find(added[1]) == 2);
+
+        // The same for slots added by createN
+        TestHandle again[3], more[2];
+        vector.compact(compacted, 3, again);
+        REQUIRE(vector.createN(2, more, 3u) == 2);
+        REQUIRE(!vector.valid(added[0]));
+        REQUIRE(!vector.valid(added[1]));
+    }
+
+    SECTION("Compact with slot retirement")
+    {
+        // 2 generation bits, so each slot can be used 4 times
+        using Vector = HandleVector<TestHandle, uint32_t, 2, HANDLE_VECTOR_DEFAULT, 0, false, HandleVectorStorage::Contiguous, true>;
+        Vector vector;
+
+        std::set<TestHandle> seen;
+        std::vector<TestHandle> handles;
+        for (uint32_t i=0; i < 4; ++i) {
+            handles.push_back(vector.create(i));
+            seen.insert(handles.back());
+        }
+        // Each compact uses a generation of the slots, until they saturate and are retired
+        for (int round=0; round < 5; ++round) {
+            std::vector<TestHandle> compacted(handles.size());
+            vector.compact(handles.data(), handles.size(), compacted.data());
+            for (size_t i=0; i < handles.size(); ++i) {
+                REQUIRE(seen.count(compacted[i]) == 0);
+                seen.insert(compacted[i]);
+                REQUIRE(*vector.find(compacted[i]) == i);
+            }
+            handles = compacted;
+        }
+        for (auto handle : seen) {
+            REQUIRE(vector.valid(handle) == (std::find(handles.begin(), handles.end(), handle) != handles.end()));
+        }
+
+        // Dropping the values that are in saturated slots keeps the slots, so they aren't reused
+        TestHandle kept;
+        vector.compact(handles.data(), 1, &kept);
+        for (int i=0; i < 20; ++i) {
+            TestHandle handle = vector.create(i);
+            REQUIRE(seen.count(handle) == 0);
+            seen.insert(handle);
+            REQUIRE(vector.free(handle));
+        }
+        REQUIRE(*vector.find(kept) == 0);
+    }
+
+    SECTION("Save & load slots")
+    {
+        using Vector = HandleVector<TestHandle, uint64_t>;
+        using underlaying_type = Vector::underlaying_type;
+        Vector vector;
+        std::vector<TestHandle> handles;
+        for (int i=0; i < 100; ++i) {
+            handles.push_back(vector.create(i * 1000));
+        }
+        for (size_t i=0; i < handles.size(); i += 3) {
+            vector.free(handles[i]);
+        }
+
+        size_t count = vector.underlying_size();
+        std::vector<underlaying_type> slotHandles(count);
+        std::vector<uint64_t> slotValues(count);
+        underlaying_type head = 0, tail = 0, generation = 0;
+        vector.saveSlots(slotHandles.data(), slotValues.data(), head, tail, generation);
+        REQUIRE(head != 0);
+
+        Vector loaded;
+        loaded.create(7);
+        REQUIRE(loaded.loadSlots(slotHandles.data(), slotValues.data(), count, head, tail, generation));
+        for (size_t i=0; i < handles.size(); ++i) {
+            REQUIRE(loaded.valid(handles[i]) == (i % 3 != 0));
+            if (i % 3 != 0) REQUIRE(*loaded.find(handles[i]) == i * 1000);
+        }
+        // The free list is kept
+        for (int i=0; i < 40; ++i) {
+            REQUIRE(loaded.create(i) == vector.create(i));
+        }
+
+        // A cycle in the free list
+        std::vector<underlaying_type> corrupt = slotHandles;
+        corrupt[tail-1] = underlaying_type(TestHandle(corrupt[tail-1])) | head;
+        REQUIRE(!loaded.loadSlots(corrupt.data(), slotValues.data(), count, head, tail, generation));
+        REQUIRE(loaded.underlying_size() == 0);
+        // A handle that doesn't match its slot
+        corrupt = slotHandles;
+        std::swap(corrupt[1], corrupt[2]);
+        REQUIRE(!loaded.loadSlots(corrupt.data(), slotValues.data(), count, head, tail, generation));
+        REQUIRE(!loaded.loadSlots(slotHandles.data(), slotValues.data(), count, underlaying_type(count+1), tail, generation));
+        REQUIRE(!loaded.loadSlots(slotHandles.data(), slotValues.data(), count, head, tail, Vector::GenerationMask+1));
+
+        // The generation of appended slots is kept, so the handles compact released stays invalid after a round trip
+        Vector compacted;
+        TestHandle created[5], kept[3];
+        for (int i=0; i < 5; ++i) {
+            created[i] = compacted.create(i);
+        }
+        compacted.compact(created, 3, kept);
+        slotHandles.resize(3);
+        slotValues.resize(3);
+        compacted.saveSlots(slotHandles.data(), slotValues.data(), head, tail, generation);
+        REQUIRE(generation != 0);
+
+        Vector reloaded;
+        REQUIRE(reloaded.loadSlots(slotHandles.data(), slotValues.data(), 3, head, tail, generation));
+        REQUIRE(reloaded.create(10) == compacted.create(10));
+        REQUIRE(reloaded.create(11) == compacted.create(11));
+        for (auto handle : created) {
+            REQUIRE(!reloaded.valid(handle));
+            REQUIRE(reloaded.find(handle) == nullptr);
+        }
+        for (auto handle : kept) {
+            REQUIRE(*reloaded.find(handle) == *compacted.find(handle));
+        }
+    }
+
     REQUIRE(ValueInstances == 0);
+}
+
+// Hidden by default, run with: HandleVector [benchmark]
+TEST_CASE( "HandleVector bulk benchmark", "[.][benchmark]" )
+{
+    MAKE_HANDLE( BenchHandle, uint32_t );
+    using Vector = HandleVector<BenchHandle, uint64_t>;
+
+    const size_t Count = 50000;
+    const int Rounds = 20;
+    std::vector<BenchHandle> handles(Count);
+
+    Vector single;
+    Clock clock;
+    clock.start();
+    for (int r=0; r < Rounds; ++r) {
+        for (size_t i=0; i < Count; ++i) {
+            handles[i] = single.create(i);
+        }
+        for (size_t i=0; i < Count; ++i) {
+            single.free(handles[i]);
+        }
+    }
+    double singleTime = clock.seconds();
+
+    Vector bulk;
+    clock.restart();
+    for (int r=0; r < Rounds; ++r) {
+        bulk.createN(Count, handles.data(), uint64_t(0));
+        bulk.freeN(handles.data(), Count);
+    }
+    double bulkTime = clock.seconds();
+
+    WARN(Count << " values x " << Rounds << " rounds: per element " << singleTime << "s, bulk " << bulkTime << "s");
 }
\ No newline at end of file
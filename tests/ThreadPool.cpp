@@ -0,0 +1,105 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "Common/ThreadPool.h"
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+TEST_CASE( "ThreadPool", "[Common][ThreadPool]" )
+{
+    SECTION("Every index is visited once")
+    {
+        for (unsigned workers : {0u, 1u, 3u, 7u}) {
+            Common::ThreadPool pool(workers);
+            REQUIRE(pool.threadCount() == workers+1);
+
+            for (size_t count : {0u, 1u, 17u, 1000u, 12345u}) {
+                for (size_t grainSize : {0u, 1u, 7u, 1024u, 100000u}) {
+                    std::vector<std::atomic<int>> visits(count);
+                    for (auto &visit : visits) visit = 0;
+
+                    pool.parallelFor(count, grainSize, [&](size_t begin, size_t end) {
+                        for (size_t i=begin; i < end; ++i) {
+                            visits[i]++;
+                        }
+                    });
+
+                    for (auto &visit : visits) {
+                        REQUIRE(visit == 1);
+                    }
+                }
+            }
+        }
+    }
+
+    SECTION("Ranges respect the grain size")
+    {
+        // Each range is a whole chunk, also when the loop runs inline (without workers, or nested)
+        for (unsigned workers : {0u, 3u}) {
+            Common::ThreadPool pool(workers);
+
+            std::atomic<size_t> ranges{0};
+            std::atomic<bool> invalid{false};
+            auto check = [&](size_t begin, size_t end) {
+                if (begin % 64 != 0 || end != std::min<size_t>(begin + 64, 1000)) invalid = true;
+                ranges++;
+            };
+            pool.parallelFor(1000, 64, check);
+            pool.parallelFor(2, 1, [&](size_t, size_t) {
+                pool.parallelFor(1000, 64, check);
+            });
+            REQUIRE(invalid == false);
+            REQUIRE(ranges == 3*16);
+        }
+    }
+
+    SECTION("Nested loops runs inline")
+    {
+        Common::ThreadPool pool(3);
+
+        std::atomic<size_t> total{0};
+        pool.parallelFor(64, 1, [&](size_t, size_t) {
+            pool.parallelFor(64, 1, [&](size_t begin, size_t end) {
+                total += end - begin;
+            });
+        });
+        REQUIRE(total == 64*64);
+    }
+
+    SECTION("Exceptions are forwarded")
+    {
+        Common::ThreadPool pool(3);
+
+        std::atomic<size_t> visited{0};
+        REQUIRE_THROWS_AS(
+            pool.parallelFor(100, 1, [&](size_t begin, size_t) {
+                visited++;
+                if (begin == 50) throw std::runtime_error("failed");
+            }),
+            std::runtime_error
+        );
+        // The other chunks are still run
+        REQUIRE(visited == 100);
+
+        // The pool is still usable
+        visited = 0;
+        pool.parallelFor(100, 1, [&](size_t, size_t) {visited++;});
+        REQUIRE(visited == 100);
+    }
+
+    SECTION("Global pool")
+    {
+        Common::ThreadPool &pool = Common::ThreadPool::Global();
+        REQUIRE(pool.threadCount() >= 1);
+        REQUIRE(&pool == &Common::ThreadPool::Global());
+
+        std::atomic<size_t> total{0};
+        pool.parallelFor(10000, 100, [&](size_t begin, size_t end) {
+            total += end - begin;
+        });
+        REQUIRE(total == 10000);
+    }
+}
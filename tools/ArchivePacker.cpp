@@ -0,0 +1,115 @@
+#include "Common/ArchiveWriter.h"
+#include "Common/CommandLineParse.h"
+#include "Common/FileUtils.h"
+#include "Common/ThreadPool.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <exception>
+#include <cstdio>
+
+// Packs a directory (with its sub directories) into a archive file.
+//
+// Usage:
+//      ArchivePacker -out=<archive> [-level=<0-12>] [-chunked=<bytes>] [-threads=<count>] [-trace=<file>] [-nodedup] <directory>
+//
+//  -level      The LZ4 HC level, 0 stores the files as is (default 9)
+//  -chunked    Files larger than this are compressed in chunks, so they can be read in parts (default 1 MiB)
+//  -threads    The number of threads that compresses (default one per hardware thread)
+//  -trace      A file with a name per line, in the order they are used, the data is ordered by it
+//  -nodedup    Store identical files once for each name
+//
+// The names in the archive are the paths relative to the directory, with '/' as separator.
+
+namespace
+{
+    void addDirectory( Common::ArchiveWriter &writer, const std::string &path, const std::string &prefix, bool &ok )
+    {
+        for (const std::string &file : FileUtils::getFileList(path)) {
+            ok &= writer.addFileFromDisk(prefix + FileUtils::removePath(file), file);
+        }
+        for (const std::string &dir : FileUtils::getDirectoryList(path)) {
+            std::string name = FileUtils::removePath(dir);
+            addDirectory(writer, path + '/' + name, prefix + name + '/', ok);
+        }
+    }
+
+    std::vector<std::string> readTrace( const std::string &path )
+    {
+        std::vector<std::string> names;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) names.push_back(line);
+        }
+        return names;
+    }
+}
+
+int main( int argc, char **argv )
+{
+    using namespace Common;
+
+    CommandLine commandLine(argc, argv);
+
+    std::string input;
+    for (int i=1; i < argc; ++i) {
+        if (argv[i][0] != '-') input = argv[i];
+    }
+
+    std::string out, trace;
+    int level = 0, threads = 0;
+    uint64_t chunkedFileSize = 0;
+    commandLine.get("-level=", level, 9);
+    commandLine.get("-chunked=", chunkedFileSize, ArchiveWriter::Settings().chunkedFileSize);
+    commandLine.get("-threads=", threads, 0);
+    commandLine.get("-trace=", trace, std::string());
+    if (!commandLine.get("-out=", out) || input.empty() || !FileUtils::isDirectory(input)) {
+        printf("Usage: %s -out=<archive> [-level=<0-12>] [-chunked=<bytes>] [-threads=<count>] [-trace=<file>] [-nodedup] <directory>\n", argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 0) {
+        pool.reset(new ThreadPool(threads - 1));
+    }
+
+    ArchiveWriter::Settings settings;
+    settings.compressionLevel = level;
+    settings.chunkedFileSize = chunkedFileSize;
+    settings.deduplicate = !commandLine.has("-nodedup");
+    settings.pool = pool.get();
+
+    ArchiveWriter writer(settings);
+    bool ok = true;
+    try {
+        addDirectory(writer, input, "", ok);
+    }
+    catch (const std::exception &e) {
+        printf("Failed to list \"%s\": %s\n", input.c_str(), e.what());
+        return 1;
+    }
+    if (!ok) return 1;
+
+    if (!trace.empty()) {
+        if (!FileUtils::isFile(trace)) {
+            printf("Failed to open trace \"%s\"\n", trace.c_str());
+            return 1;
+        }
+        std::vector<std::string> names = readTrace(trace);
+        writer.setAccessOrder(names.data(), names.size());
+    }
+
+    ArchiveWriter::Stats stats;
+    if (!writer.write(out, &stats)) {
+        return 1;
+    }
+
+    printf("Packed %u files (%u duplicates, %u compressed, %u chunked) into \"%s\": %llu bytes -> %llu bytes\n",
+           stats.files, stats.duplicates, stats.compressed, stats.chunked, out.c_str(),
+           (unsigned long long)stats.size, (unsigned long long)stats.storedSize);
+    return 0;
+}